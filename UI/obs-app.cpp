@@ -64,6 +64,7 @@ static string lastLogFile;
 static bool portable_mode = false;
 static bool log_verbose = false;
 static bool unfiltered_log = false;
+static bool profiler_timeline = false;
 bool opt_start_streaming = false;
 bool opt_start_recording = false;
 bool opt_studio_mode = false;
@@ -877,7 +878,13 @@ static bool StartupOBS(const char *locale, profiler_name_store_t *store)
 	if (GetConfigPath(path, sizeof(path), "obs-studio/plugin_config") <= 0)
 		return false;
 
-	return obs_startup(locale, path, store);
+	if (!obs_startup(locale, path, store))
+		return false;
+
+	if (GetConfigPath(path, sizeof(path), "obs-studio/shader_cache") > 0)
+		obs_set_shader_cache_path(path);
+
+	return true;
 }
 
 bool OBSApp::OBSInit()
@@ -1244,6 +1251,36 @@ static void SaveProfilerData(const ProfilerSnapshot &snap)
 				static_cast<const char*>(path));
 }
 
+#define TIMELINE_WINDOW_NS (10ULL * 1000000000ULL)
+
+/* Saves the 10 seconds before the last lagged frame (or before exit, if no
+ * frames were lagged) as a Chrome trace */
+static void SaveProfilerTimeline()
+{
+	if (!profiler_timeline || currentLogFile.empty())
+		return;
+
+	auto pos = currentLogFile.rfind('.');
+	if (pos == currentLogFile.npos)
+		return;
+
+	uint64_t end = profiler_timeline_last_mark("lagged_frame");
+	if (!end)
+		end = os_gettime_ns();
+
+	uint64_t start = end > TIMELINE_WINDOW_NS ?
+		end - TIMELINE_WINDOW_NS : 0;
+
+	string dst = "obs-studio/profiler_data/";
+	dst.append(currentLogFile, 0, pos);
+	dst += ".trace.json";
+
+	BPtr<char> path = GetConfigPathPtr(dst.c_str());
+	if (!profiler_timeline_dump_json(path, start, end))
+		blog(LOG_WARNING, "Could not save profiler timeline to '%s'",
+				static_cast<const char*>(path));
+}
+
 static auto ProfilerFree = [](void *)
 {
 	profiler_stop();
@@ -1254,6 +1291,7 @@ static auto ProfilerFree = [](void *)
 	profiler_print_time_between_calls(snap.get());
 
 	SaveProfilerData(snap);
+	SaveProfilerTimeline();
 
 	profiler_free();
 };
@@ -1270,6 +1308,7 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 				ProfilerFree);
 
 	profiler_start();
+	profiler_timeline_enable(profiler_timeline);
 	profile_register_root(run_program_init, 0);
 
 	ScopeProfiler prof{run_program_init};
@@ -1759,6 +1798,9 @@ int main(int argc, char *argv[])
 		} else if (arg_is(argv[i], "--unfiltered_log", nullptr)) {
 			unfiltered_log = true;
 
+		} else if (arg_is(argv[i], "--profiler-timeline", nullptr)) {
+			profiler_timeline = true;
+
 		} else if (arg_is(argv[i], "--startstreaming", nullptr)) {
 			opt_start_streaming = true;
 
@@ -1797,7 +1839,9 @@ int main(int argc, char *argv[])
 			"--minimize-to-tray: Minimize to system tray.\n" <<
 			"--portable, -p: Use portable mode.\n\n" <<
 			"--verbose: Make log more verbose.\n" <<
-			"--unfiltered_log: Make log unfiltered.\n\n" <<
+			"--unfiltered_log: Make log unfiltered.\n" <<
+			"--profiler-timeline: Save a trace of the last lag "
+				"on exit.\n\n" <<
 			"--version, -V: Get current version.\n";
 
 			exit(0);
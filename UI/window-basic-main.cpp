@@ -1053,6 +1053,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 			Str("Basic.Settings.Advanced.Audio.MonitoringDevice"
 				".Default"));
 	config_set_default_uint  (basicConfig, "Audio", "SampleRate", 44100);
+	config_set_default_uint  (basicConfig, "Audio", "FramesPerTick",
+			AUDIO_OUTPUT_FRAMES);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
 			"Stereo");
 
@@ -2540,7 +2542,7 @@ void OBSBasic::RenderMain(void *data, uint32_t cx, uint32_t cy)
 		if (source)
 			obs_source_video_render(source);
 	} else {
-		obs_render_main_view();
+		obs_render_main_texture();
 	}
 	gs_load_vertexbuffer(nullptr);
 
@@ -2729,6 +2731,9 @@ bool OBSBasic::ResetAudio()
 	else
 		ai.speakers = SPEAKERS_STEREO;
 
+	obs_set_audio_frames_per_tick((uint32_t)config_get_uint(basicConfig,
+			"Audio", "FramesPerTick"));
+
 	return obs_reset_audio(&ai);
 }
 
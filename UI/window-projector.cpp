@@ -108,7 +108,7 @@ void OBSProjector::OBSRender(void *data, uint32_t cx, uint32_t cy)
 	if (window->source)
 		obs_source_video_render(window->source);
 	else
-		obs_render_main_view();
+		obs_render_main_texture();
 
 	gs_projection_pop();
 	gs_viewport_pop();
@@ -0,0 +1,595 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include <graphics/vec4.h>
+#include "null-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Null";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_NULL;
+}
+
+bool device_enum_adapters(
+		bool (*callback)(void *param, const char *name, uint32_t id),
+		void *param)
+{
+	callback(param, "Null (no GPU)", 0);
+	return true;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_NULL";
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	matrix4_identity(&device->cur_proj);
+	device->cur_cull_mode = GS_BACK;
+
+	blog(LOG_INFO, "Null graphics device created, nothing will be "
+	               "rendered");
+
+	*p_device = device;
+
+	UNUSED_PARAMETER(adapter);
+	return GS_SUCCESS;
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (!device)
+		return;
+
+	blog(LOG_INFO, "Null graphics device totals: "
+	               "%"PRIu64" draws (%"PRIu64" vertices), "
+	               "%"PRIu64" bytes uploaded, "
+	               "%"PRIu64" bytes copied, "
+	               "%"PRIu64" bytes staged",
+	               device->draws, device->vertices,
+	               device->bytes_uploaded, device->bytes_copied,
+	               device->bytes_staged);
+
+	da_free(device->proj_stack);
+	bfree(device);
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+		const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info   = *info;
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		swapchain->device->cur_swap = NULL;
+
+	bfree(swapchain);
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	if (!device->cur_swap) {
+		blog(LOG_WARNING, "device_resize (null): No active swap");
+		return;
+	}
+
+	device->cur_swap->info.cx = cx;
+	device->cur_swap->info.cy = cy;
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cx : 0;
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cy : 0;
+}
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vb)
+{
+	device->cur_vertex_buffer = vb;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *ib)
+{
+	device->cur_index_buffer = ib;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device,
+		gs_samplerstate_t *ss, int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_samplers[unit] = ss;
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	device->cur_pixel_shader = pixelshader;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d,
+		int unit)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(b_3d);
+	UNUSED_PARAMETER(unit);
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+		gs_zstencil_t *zstencil)
+{
+	if (tex && tex->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_set_render_target (null): texture is "
+		                "not a 2D texture");
+		return;
+	}
+
+	device->cur_render_target   = tex;
+	device->cur_render_side     = 0;
+	device->cur_zstencil_buffer = zstencil;
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+		int side, gs_zstencil_t *zstencil)
+{
+	if (cubetex && cubetex->type != GS_TEXTURE_CUBE) {
+		blog(LOG_ERROR, "device_set_cube_render_target (null): "
+		                "texture is not a cube texture");
+		return;
+	}
+
+	device->cur_render_target   = cubetex;
+	device->cur_render_side     = side;
+	device->cur_zstencil_buffer = zstencil;
+}
+
+void device_copy_texture_region(gs_device_t *device,
+		gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	uint32_t bpp;
+	size_t row_size;
+
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+		                "NULL source or destination");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D || dst->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+		                "only 2D textures can be copied");
+		return;
+	}
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+		                "formats do not match");
+		return;
+	}
+
+	if (!src_w) src_w = src->width  - src_x;
+	if (!src_h) src_h = src->height - src_y;
+
+	if (src_x + src_w > src->width  || src_y + src_h > src->height ||
+	    dst_x + src_w > dst->width  || dst_y + src_h > dst->height) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+		                "region is out of bounds");
+		return;
+	}
+
+	bpp = gs_get_format_bpp(src->format);
+	row_size = (size_t)src_w * bpp / 8;
+
+	for (uint32_t y = 0; y < src_h; y++) {
+		const uint8_t *in = src->data +
+			(size_t)(src_y + y) * src->linesize +
+			(size_t)src_x * bpp / 8;
+		uint8_t *out = dst->data +
+			(size_t)(dst_y + y) * dst->linesize +
+			(size_t)dst_x * bpp / 8;
+
+		memcpy(out, in, row_size);
+	}
+
+	device->bytes_copied += (uint64_t)row_size * src_h;
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+		gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+		gs_texture_t *src)
+{
+	size_t row_size;
+
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+		                "NULL source or destination");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+		                "source is not a 2D texture");
+		return;
+	}
+	if (src->format != dst->format || src->width != dst->width ||
+	    src->height != dst->height) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+		                "source and destination do not match");
+		return;
+	}
+
+	row_size = dst->linesize;
+	for (uint32_t y = 0; y < dst->height; y++)
+		memcpy(dst->data + y * dst->linesize,
+				src->data + y * src->linesize, row_size);
+
+	device->bytes_staged += (uint64_t)row_size * dst->height;
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	memset(device->cur_textures, 0, sizeof(device->cur_textures));
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	if (!device->cur_vertex_shader || !device->cur_pixel_shader) {
+		blog(LOG_ERROR, "device_draw (null): No shader loaded");
+		return;
+	}
+	if (!device->cur_vertex_buffer) {
+		blog(LOG_ERROR, "device_draw (null): No vertex buffer loaded");
+		return;
+	}
+
+	if (!num_verts) {
+		if (device->cur_index_buffer)
+			num_verts = (uint32_t)device->cur_index_buffer->num;
+		else
+			num_verts = (uint32_t)device->cur_vertex_buffer->data->num;
+	}
+
+	device->draws++;
+	device->vertices += num_verts;
+
+	UNUSED_PARAMETER(draw_mode);
+	UNUSED_PARAMETER(start_vert);
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+}
+
+static inline uint8_t color_byte(float val)
+{
+	if (val <= 0.0f) return 0;
+	if (val >= 1.0f) return 255;
+	return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+static void fill_texture(gs_texture_t *tex, const struct vec4 *color)
+{
+	uint8_t pixel[4] = {0};
+	uint32_t pixel_size = 0;
+	size_t size = (size_t)tex->linesize * tex->height *
+		(tex->type == GS_TEXTURE_CUBE ? 6 : 1);
+
+	switch (tex->format) {
+	case GS_RGBA:
+		pixel[0] = color_byte(color->x);
+		pixel[1] = color_byte(color->y);
+		pixel[2] = color_byte(color->z);
+		pixel[3] = color_byte(color->w);
+		pixel_size = 4;
+		break;
+	case GS_BGRA:
+	case GS_BGRX:
+		pixel[0] = color_byte(color->z);
+		pixel[1] = color_byte(color->y);
+		pixel[2] = color_byte(color->x);
+		pixel[3] = tex->format == GS_BGRX ? 255 : color_byte(color->w);
+		pixel_size = 4;
+		break;
+	case GS_R8:
+		pixel[0] = color_byte(color->x);
+		pixel_size = 1;
+		break;
+	case GS_A8:
+		pixel[0] = color_byte(color->w);
+		pixel_size = 1;
+		break;
+	default:
+		break;
+	}
+
+	if (pixel_size == 1) {
+		memset(tex->data, pixel[0], size);
+
+	} else if (pixel_size == 4) {
+		for (size_t i = 0; i < size; i += 4)
+			memcpy(tex->data + i, pixel, 4);
+
+	/* other formats can only be cleared to zero */
+	} else {
+		memset(tex->data, 0, size);
+	}
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		const struct vec4 *color, float depth, uint8_t stencil)
+{
+	if ((clear_flags & GS_CLEAR_COLOR) != 0 && device->cur_render_target)
+		fill_texture(device->cur_render_target, color);
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green,
+		bool blue, bool alpha)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(red);
+	UNUSED_PARAMETER(green);
+	UNUSED_PARAMETER(blue);
+	UNUSED_PARAMETER(alpha);
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+		enum gs_blend_type dest)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src);
+	UNUSED_PARAMETER(dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src_c);
+	UNUSED_PARAMETER(dest_c);
+	UNUSED_PARAMETER(src_a);
+	UNUSED_PARAMETER(dest_a);
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_stencil_op_type fail, enum gs_stencil_op_type zfail,
+		enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+		int height)
+{
+	device->cur_viewport.x  = x;
+	device->cur_viewport.y  = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(rect);
+}
+
+/* nothing is rasterized, so the projection only has to survive push/pop */
+void device_ortho(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	matrix4_identity(&device->cur_proj);
+
+	UNUSED_PARAMETER(left);
+	UNUSED_PARAMETER(right);
+	UNUSED_PARAMETER(top);
+	UNUSED_PARAMETER(bottom);
+	UNUSED_PARAMETER(near);
+	UNUSED_PARAMETER(far);
+}
+
+void device_frustum(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	matrix4_identity(&device->cur_proj);
+
+	UNUSED_PARAMETER(left);
+	UNUSED_PARAMETER(right);
+	UNUSED_PARAMETER(top);
+	UNUSED_PARAMETER(bottom);
+	UNUSED_PARAMETER(near);
+	UNUSED_PARAMETER(far);
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+#ifdef _WIN32
+EXPORT bool device_gdi_texture_available(void)
+{
+	return false;
+}
+
+EXPORT bool device_shared_texture_available(void)
+{
+	return false;
+}
+#endif
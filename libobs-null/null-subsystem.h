@@ -0,0 +1,138 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/darray.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+
+/*
+ *   Graphics subsystem that doesn't use a GPU at all, so that libobs can run
+ * headless (for example on build machines, or to benchmark outputs and
+ * encoders).  Textures and stage surfaces are plain memory buffers, copies,
+ * staging and clears really copy and fill that memory, and everything that
+ * would rasterize (draws and presents) only counts what it was asked to do.
+ */
+
+struct gs_texture {
+	gs_device_t          *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             depth;
+	uint32_t             linesize;
+	uint32_t             flags;
+	uint8_t              *data;
+};
+
+struct gs_stage_surface {
+	gs_device_t          *device;
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+	uint8_t              *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t            *device;
+	enum gs_zstencil_format format;
+	uint32_t               width;
+	uint32_t               height;
+};
+
+struct gs_sampler_state {
+	gs_device_t            *device;
+	struct gs_sampler_info info;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t          *device;
+	struct gs_vb_data    *data;
+	uint32_t             flags;
+};
+
+struct gs_index_buffer {
+	gs_device_t          *device;
+	enum gs_index_type   type;
+	void                 *indices;
+	size_t               num;
+	uint32_t             flags;
+};
+
+struct gs_shader_param {
+	char                      *name;
+	enum gs_shader_param_type type;
+	int                       array_count;
+
+	DARRAY(uint8_t)           cur_value;
+	DARRAY(uint8_t)           def_value;
+	gs_texture_t              *texture;
+	gs_samplerstate_t         *next_sampler;
+};
+
+struct gs_shader {
+	gs_device_t              *device;
+	enum gs_shader_type      type;
+
+	DARRAY(struct gs_shader_param) params;
+	struct gs_shader_param   *viewproj;
+	struct gs_shader_param   *world;
+};
+
+struct gs_swap_chain {
+	gs_device_t              *device;
+	struct gs_init_data      info;
+};
+
+struct gs_device {
+	gs_texture_t             *cur_render_target;
+	gs_zstencil_t            *cur_zstencil_buffer;
+	int                      cur_render_side;
+	gs_texture_t             *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t        *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t          *cur_vertex_buffer;
+	gs_indexbuffer_t         *cur_index_buffer;
+	gs_shader_t              *cur_vertex_shader;
+	gs_shader_t              *cur_pixel_shader;
+	gs_swapchain_t           *cur_swap;
+
+	enum gs_cull_mode        cur_cull_mode;
+	struct gs_rect           cur_viewport;
+
+	struct matrix4           cur_proj;
+	DARRAY(struct matrix4)   proj_stack;
+
+	/* totals, logged when the device is destroyed */
+	uint64_t                 draws;
+	uint64_t                 vertices;
+	uint64_t                 bytes_uploaded;
+	uint64_t                 bytes_copied;
+	uint64_t                 bytes_staged;
+};
+
+static inline uint32_t null_get_linesize(enum gs_color_format format,
+		uint32_t width)
+{
+	uint32_t bits = gs_get_format_bpp(format) * width;
+	return (bits + 7) / 8;
+}
+
+extern void null_shader_param_free(struct gs_shader_param *param);
@@ -0,0 +1,343 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+
+#include <util/crc32.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/file-serializer.h>
+#include "gl-subsystem.h"
+
+/*
+ * Linked program binaries are stored in a directory specific to the current
+ * driver (vendor/renderer/version), one file per vertex/pixel shader pair.
+ * Files are named after the hashes of both shader sources, and contain the
+ * full sources as well so that hash collisions can never load the wrong
+ * binary.  Shaders that are part of a cached program are not compiled until
+ * a program actually has to be linked from source.
+ */
+
+#define PROGRAM_CACHE_MAGIC   0x4E494250 /* "PBIN" */
+#define PROGRAM_CACHE_VERSION 1
+
+static inline bool gl_program_binary_supported(void)
+{
+	GLint num_formats = 0;
+
+	if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+		return false;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	return gl_success("glGetIntegerv") && num_formats > 0;
+}
+
+static uint32_t gl_driver_hash(void)
+{
+	const char *strings[] = {
+		(const char*)glGetString(GL_VENDOR),
+		(const char*)glGetString(GL_RENDERER),
+		(const char*)glGetString(GL_VERSION)
+	};
+	uint32_t crc = 0;
+
+	for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+		if (strings[i])
+			crc = calc_crc32(crc, strings[i], strlen(strings[i]));
+	}
+
+	return crc;
+}
+
+static void gl_program_cache_scan(struct gs_device *device)
+{
+	struct os_dirent *ent;
+	os_dir_t *dir;
+
+	dir = os_opendir(device->program_cache_dir);
+	if (!dir)
+		return;
+
+	while ((ent = os_readdir(dir)) != NULL) {
+		struct program_cache_key key;
+		char ext[8] = {0};
+
+		if (ent->directory)
+			continue;
+		if (sscanf(ent->d_name, "%8X-%8X.%3s", &key.vertex_hash,
+					&key.pixel_hash, ext) != 3)
+			continue;
+		if (strcmp(ext, "bin") != 0)
+			continue;
+
+		da_push_back(device->program_cache_keys, &key);
+	}
+
+	os_closedir(dir);
+}
+
+void device_set_cache_dir(gs_device_t *device, const char *dir)
+{
+	struct dstr path = {0};
+
+	gl_program_cache_free(device);
+
+	if (!dir || !*dir)
+		return;
+
+	if (!gl_program_binary_supported()) {
+		blog(LOG_INFO, "OpenGL program binaries not supported, "
+		               "shader program cache disabled");
+		return;
+	}
+
+	dstr_printf(&path, "%s/programs/%08X", dir, gl_driver_hash());
+	if (os_mkdirs(path.array) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "Failed to create shader program cache "
+		                  "directory '%s'", path.array);
+		dstr_free(&path);
+		return;
+	}
+
+	device->program_cache_dir = path.array;
+	gl_program_cache_scan(device);
+
+	blog(LOG_DEBUG, "Shader program cache: %s (%u cached programs)",
+			device->program_cache_dir,
+			(unsigned int)device->program_cache_keys.num);
+}
+
+void gl_program_cache_free(struct gs_device *device)
+{
+	bfree(device->program_cache_dir);
+	device->program_cache_dir = NULL;
+	da_free(device->program_cache_keys);
+}
+
+bool gl_program_cache_has_shader(const struct gs_shader *shader)
+{
+	struct gs_device *device = shader->device;
+
+	for (size_t i = 0; i < device->program_cache_keys.num; i++) {
+		struct program_cache_key *key =
+			device->program_cache_keys.array + i;
+
+		if (shader->type == GS_SHADER_VERTEX &&
+		    key->vertex_hash == shader->hash)
+			return true;
+		if (shader->type == GS_SHADER_PIXEL &&
+		    key->pixel_hash == shader->hash)
+			return true;
+	}
+
+	return false;
+}
+
+static inline bool gl_program_cache_has(struct gs_program *program)
+{
+	struct gs_device *device = program->device;
+
+	for (size_t i = 0; i < device->program_cache_keys.num; i++) {
+		struct program_cache_key *key =
+			device->program_cache_keys.array + i;
+
+		if (key->vertex_hash == program->vertex_shader->hash &&
+		    key->pixel_hash  == program->pixel_shader->hash)
+			return true;
+	}
+
+	return false;
+}
+
+static inline void gl_program_cache_remove(struct gs_program *program)
+{
+	struct gs_device *device = program->device;
+
+	for (size_t i = 0; i < device->program_cache_keys.num; i++) {
+		struct program_cache_key *key =
+			device->program_cache_keys.array + i;
+
+		if (key->vertex_hash == program->vertex_shader->hash &&
+		    key->pixel_hash  == program->pixel_shader->hash) {
+			da_erase(device->program_cache_keys, i);
+			return;
+		}
+	}
+}
+
+static char *gl_program_cache_file(struct gs_program *program)
+{
+	struct dstr path = {0};
+	dstr_printf(&path, "%s/%08X-%08X.bin",
+			program->device->program_cache_dir,
+			program->vertex_shader->hash,
+			program->pixel_shader->hash);
+	return path.array;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool read_u32(struct serializer *s, uint32_t *val)
+{
+	return s_read(s, val, sizeof(*val)) == sizeof(*val);
+}
+
+static bool read_check_source(struct serializer *s, const char *source)
+{
+	size_t len = strlen(source);
+	uint32_t size;
+	char *str;
+	bool match;
+
+	if (!read_u32(s, &size) || size != len)
+		return false;
+
+	str = bmalloc(len + 1);
+	match = s_read(s, str, len) == len && memcmp(str, source, len) == 0;
+	bfree(str);
+	return match;
+}
+
+static bool gl_program_cache_read(struct gs_program *program,
+		struct serializer *s, int64_t file_size)
+{
+	uint32_t magic, version, format, size;
+	int64_t pos;
+	uint8_t *binary;
+	GLint linked = GL_FALSE;
+	bool success;
+
+	if (!read_u32(s, &magic) || magic != PROGRAM_CACHE_MAGIC)
+		return false;
+	if (!read_u32(s, &version) || version != PROGRAM_CACHE_VERSION)
+		return false;
+	if (!read_check_source(s, program->vertex_shader->source))
+		return false;
+	if (!read_check_source(s, program->pixel_shader->source))
+		return false;
+	if (!read_u32(s, &format) || !read_u32(s, &size) || !size)
+		return false;
+
+	/* don't trust the size of the binary more than the file itself */
+	pos = serializer_get_pos(s);
+	if (pos < 0 || (int64_t)size > file_size - pos)
+		return false;
+
+	binary = bmalloc(size);
+	success = s_read(s, binary, size) == size;
+	if (success) {
+		glProgramBinary(program->obj, format, binary, (GLsizei)size);
+		success = gl_success("glProgramBinary");
+	}
+	bfree(binary);
+
+	if (!success)
+		return false;
+
+	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+	return gl_success("glGetProgramiv") && linked == GL_TRUE;
+}
+
+bool gl_program_cache_load(struct gs_program *program)
+{
+	struct serializer s;
+	char *file;
+	bool success = false;
+
+	if (!program->device->program_cache_dir)
+		return false;
+	if (!gl_program_cache_has(program))
+		return false;
+
+	file = gl_program_cache_file(program);
+
+	if (file_input_serializer_init(&s, file)) {
+		success = gl_program_cache_read(program, &s,
+				os_fgetsize(s.data));
+		file_input_serializer_free(&s);
+	}
+
+	/* the program gets linked from source and saved again */
+	if (!success) {
+		blog(LOG_DEBUG, "Removing stale or invalid cached shader "
+		                "program '%s'", file);
+		os_unlink(file);
+		gl_program_cache_remove(program);
+	}
+
+	bfree(file);
+	return success;
+}
+
+static inline void write_u32(struct serializer *s, uint32_t val)
+{
+	s_write(s, &val, sizeof(val));
+}
+
+static inline void write_source(struct serializer *s, const char *source)
+{
+	uint32_t len = (uint32_t)strlen(source);
+	write_u32(s, len);
+	s_write(s, source, len);
+}
+
+void gl_program_cache_save(struct gs_program *program)
+{
+	struct program_cache_key key;
+	struct serializer s;
+	GLint size = 0;
+	GLsizei written = 0;
+	GLenum format = 0;
+	uint8_t *binary;
+	char *file;
+
+	if (!program->device->program_cache_dir)
+		return;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (!gl_success("glGetProgramiv") || size <= 0)
+		return;
+
+	binary = bmalloc(size);
+	glGetProgramBinary(program->obj, size, &written, &format, binary);
+	if (!gl_success("glGetProgramBinary") || written <= 0)
+		goto exit;
+
+	file = gl_program_cache_file(program);
+
+	if (file_output_serializer_init_safe(&s, file, "tmp")) {
+		write_u32(&s, PROGRAM_CACHE_MAGIC);
+		write_u32(&s, PROGRAM_CACHE_VERSION);
+		write_source(&s, program->vertex_shader->source);
+		write_source(&s, program->pixel_shader->source);
+		write_u32(&s, (uint32_t)format);
+		write_u32(&s, (uint32_t)written);
+		s_write(&s, binary, written);
+		file_output_serializer_free(&s);
+
+		if (!gl_program_cache_has(program)) {
+			key.vertex_hash = program->vertex_shader->hash;
+			key.pixel_hash  = program->pixel_shader->hash;
+			da_push_back(program->device->program_cache_keys, &key);
+		}
+	}
+
+	bfree(file);
+
+exit:
+	bfree(binary);
+}
@@ -22,6 +22,7 @@
 #include <graphics/vec4.h>
 #include <graphics/matrix3.h>
 #include <graphics/matrix4.h>
+#include <util/crc32.h>
 #include "gl-subsystem.h"
 #include "gl-shaderparser.h"
 
@@ -187,20 +188,16 @@ static inline bool gl_process_attribs(struct gs_shader *shader,
 	return true;
 }
 
-static bool gl_shader_init(struct gs_shader *shader,
-		struct gl_shader_parser *glsp,
-		const char *file, char **error_string)
+bool gl_shader_compile(struct gs_shader *shader, char **error_string)
 {
 	GLenum type = convert_shader_type(shader->type);
 	int compiled = 0;
-	bool success = true;
 
 	shader->obj = glCreateShader(type);
 	if (!gl_success("glCreateShader") || !shader->obj)
 		return false;
 
-	glShaderSource(shader->obj, 1, (const GLchar**)&glsp->gl_string.array,
-			0);
+	glShaderSource(shader->obj, 1, (const GLchar**)&shader->source, 0);
 	if (!gl_success("glShaderSource"))
 		return false;
 
@@ -210,9 +207,9 @@ static bool gl_shader_init(struct gs_shader *shader,
 
 #if 0
 	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
-	blog(LOG_DEBUG, "  GL shader string for: %s", file);
+	blog(LOG_DEBUG, "  GL shader string for: %s", shader->file);
 	blog(LOG_DEBUG, "-----------------------------------");
-	blog(LOG_DEBUG, "%s", glsp->gl_string.array);
+	blog(LOG_DEBUG, "%s", shader->source);
 	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
 #endif
 
@@ -220,10 +217,25 @@ static bool gl_shader_init(struct gs_shader *shader,
 	if (!gl_success("glGetShaderiv"))
 		return false;
 
-	if (!compiled)
-		success = false;
+	gl_get_shader_info(shader->obj, shader->file, error_string);
+	return !!compiled;
+}
 
-	gl_get_shader_info(shader->obj, file, error_string);
+static bool gl_shader_init(struct gs_shader *shader,
+		struct gl_shader_parser *glsp,
+		const char *file, char **error_string)
+{
+	bool success = true;
+
+	shader->file   = bstrdup(file);
+	shader->source = bstrdup(glsp->gl_string.array);
+	shader->hash   = calc_crc32(0, glsp->gl_string.array,
+			glsp->gl_string.len);
+
+	/* if a cached program binary uses this shader, compiling is deferred
+	 * until a program actually has to be linked from source */
+	if (!gl_program_cache_has_shader(shader))
+		success = gl_shader_compile(shader, error_string);
 
 	if (success)
 		success = gl_add_params(shader, glsp);
@@ -332,6 +344,9 @@ void gs_shader_destroy(gs_shader_t *shader)
 		gl_success("glDeleteShader");
 	}
 
+	bfree(shader->file);
+	bfree(shader->source);
+
 	da_free(shader->samplers);
 	da_free(shader->params);
 	da_free(shader->attribs);
@@ -443,11 +458,38 @@ static inline bool validate_param(struct program_param *pp,
 	return true;
 }
 
+static inline bool param_value_changed(struct program_param *pp)
+{
+	return pp->uploaded_value.num != pp->param->cur_value.num ||
+		memcmp(pp->uploaded_value.array, pp->param->cur_value.array,
+				pp->uploaded_value.num) != 0;
+}
+
 static void program_set_param_data(struct gs_program *program,
 		struct program_param *pp)
 {
 	void *array = pp->param->cur_value.array;
 
+	if (pp->param->type == GS_SHADER_PARAM_TEXTURE) {
+		if (pp->param->next_sampler) {
+			program->device->cur_samplers[pp->param->sampler_id] =
+				pp->param->next_sampler;
+			pp->param->next_sampler = NULL;
+		}
+
+		if (!pp->sampler_set) {
+			glUniform1i(pp->obj, pp->param->texture_id);
+			pp->sampler_set = true;
+		}
+
+		device_load_texture(program->device, pp->param->texture,
+				pp->param->texture_id);
+		return;
+	}
+
+	if (!param_value_changed(pp))
+		return;
+
 	if (pp->param->type == GS_SHADER_PARAM_BOOL ||
 	    pp->param->type == GS_SHADER_PARAM_INT) {
 		if (validate_param(pp, sizeof(int))) {
@@ -485,18 +527,9 @@ static void program_set_param_data(struct gs_program *program,
 					(float*)array);
 			gl_success("glUniformMatrix4fv");
 		}
-
-	} else if (pp->param->type == GS_SHADER_PARAM_TEXTURE) {
-		if (pp->param->next_sampler) {
-			program->device->cur_samplers[pp->param->sampler_id] =
-				pp->param->next_sampler;
-			pp->param->next_sampler = NULL;
-		}
-
-		glUniform1i(pp->obj, pp->param->texture_id);
-		device_load_texture(program->device, pp->param->texture,
-				pp->param->texture_id);
 	}
+
+	da_copy(pp->uploaded_value, pp->param->cur_value);
 }
 
 void program_update_params(struct gs_program *program)
@@ -559,7 +592,7 @@ static inline bool assign_program_attribs(struct gs_program *program)
 static bool assign_program_param(struct gs_program *program,
 		struct gs_shader_param *param)
 {
-	struct program_param info;
+	struct program_param info = {0};
 
 	info.obj = glGetUniformLocation(program->obj, param->name);
 	if (!gl_success("glGetUniformLocation"))
@@ -596,22 +629,38 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+static inline bool gl_program_compile_shader(struct gs_shader *shader)
+{
+	if (shader->obj)
+		return true;
+
+	if (!gl_shader_compile(shader, NULL)) {
+		blog(LOG_ERROR, "Failed to compile deferred shader '%s'",
+				shader->file);
+		return false;
+	}
+
+	return true;
+}
+
+static bool gl_program_link(struct gs_program *program)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
 	int linked = false;
 
-	program->device        = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader  = device->cur_pixel_shader;
+	if (!gl_program_compile_shader(program->vertex_shader))
+		return false;
+	if (!gl_program_compile_shader(program->pixel_shader))
+		return false;
 
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
+	if (program->device->program_cache_dir) {
+		glProgramParameteri(program->obj,
+				GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		gl_success("glProgramParameteri");
+	}
 
 	glAttachShader(program->obj, program->vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
 	glAttachShader(program->obj, program->pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
@@ -630,24 +679,14 @@ struct gs_program *gs_program_create(struct gs_device *device)
 		goto error;
 	}
 
-	if (!assign_program_attribs(program))
-		goto error;
-	if (!assign_program_params(program))
-		goto error;
-
 	glDetachShader(program->obj, program->vertex_shader->obj);
 	gl_success("glDetachShader (vertex)");
 
 	glDetachShader(program->obj, program->pixel_shader->obj);
 	gl_success("glDetachShader (pixel)");
 
-	program->next = device->first_program;
-	program->prev_next = &device->first_program;
-	device->first_program = program;
-	if (program->next)
-		program->next->prev_next = &program->next;
-
-	return program;
+	gl_program_cache_save(program);
+	return true;
 
 error:
 	glDetachShader(program->obj, program->pixel_shader->obj);
@@ -656,8 +695,56 @@ error:
 error_detach_vertex:
 	glDetachShader(program->obj, program->vertex_shader->obj);
 	gl_success("glDetachShader (vertex)");
+	return false;
+}
+
+static inline bool gl_program_load_binary(struct gs_program *program)
+{
+	if (gl_program_cache_load(program))
+		return true;
+
+	/* a failed glProgramBinary leaves the object in an unlinked state,
+	 * start from a fresh program object to link from source */
+	if (program->device->program_cache_dir) {
+		glDeleteProgram(program->obj);
+		gl_success("glDeleteProgram");
+
+		program->obj = glCreateProgram();
+		gl_success("glCreateProgram");
+	}
+
+	return false;
+}
+
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+
+	program->device        = device;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader  = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
+		goto error;
+
+	if (!gl_program_load_binary(program) && !gl_program_link(program))
+		goto error;
+
+	if (!assign_program_attribs(program))
+		goto error;
+	if (!assign_program_params(program))
+		goto error;
+
+	program->next = device->first_program;
+	program->prev_next = &device->first_program;
+	device->first_program = program;
+	if (program->next)
+		program->next->prev_next = &program->next;
 
-error_detach_neither:
+	return program;
+
+error:
 	gs_program_destroy(program);
 	return NULL;
 }
@@ -673,6 +760,9 @@ void gs_program_destroy(struct gs_program *program)
 		gl_success("glUseProgram (zero)");
 	}
 
+	for (size_t i = 0; i < program->params.num; i++)
+		da_free(program->params.array[i].uploaded_value);
+
 	da_free(program->attribs);
 	da_free(program->params);
 
@@ -251,6 +251,8 @@ void device_destroy(gs_device_t *device)
 		while (device->first_program)
 			gs_program_destroy(device->first_program);
 
+		gl_program_cache_free(device);
+
 		da_free(device->proj_stack);
 		da_free(device->fbos);
 		gl_platform_destroy(device->plat);
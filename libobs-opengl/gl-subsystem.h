@@ -331,6 +331,9 @@ struct gs_shader {
 	gs_device_t          *device;
 	enum gs_shader_type  type;
 	GLuint               obj;
+	char                 *file;
+	char                 *source;
+	uint32_t             hash;
 
 	struct gs_shader_param  *viewproj;
 	struct gs_shader_param  *world;
@@ -343,6 +346,11 @@ struct gs_shader {
 struct program_param {
 	GLint                  obj;
 	struct gs_shader_param *param;
+
+	/* last value uploaded to the program, uniforms are only uploaded
+	 * again when the value differs */
+	DARRAY(uint8_t)        uploaded_value;
+	bool                   sampler_set;
 };
 
 struct gs_program {
@@ -360,6 +368,18 @@ struct gs_program {
 
 extern struct gs_program *gs_program_create(struct gs_device *device);
 extern void gs_program_destroy(struct gs_program *program);
+
+struct program_cache_key {
+	uint32_t vertex_hash;
+	uint32_t pixel_hash;
+};
+
+extern bool gl_shader_compile(struct gs_shader *shader, char **error_string);
+
+extern void gl_program_cache_free(struct gs_device *device);
+extern bool gl_program_cache_has_shader(const struct gs_shader *shader);
+extern bool gl_program_cache_load(struct gs_program *program);
+extern void gl_program_cache_save(struct gs_program *program);
 extern void program_update_params(struct gs_program *shader);
 
 struct gs_vertex_buffer {
@@ -492,6 +512,9 @@ struct gs_device {
 
 	struct gs_program    *first_program;
 
+	char                 *program_cache_dir;
+	DARRAY(struct program_cache_key) program_cache_keys;
+
 	enum gs_cull_mode    cur_cull_mode;
 	struct gs_rect       cur_viewport;
 
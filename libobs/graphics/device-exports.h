@@ -31,6 +31,7 @@ EXPORT bool device_enum_adapters(
 EXPORT const char *device_preprocessor_name(void);
 EXPORT int device_create(gs_device_t **device, uint32_t adapter);
 EXPORT void device_destroy(gs_device_t *device);
+EXPORT void device_set_cache_dir(gs_device_t *device, const char *dir);
 EXPORT void device_enter_context(gs_device_t *device);
 EXPORT void device_leave_context(gs_device_t *device);
 EXPORT gs_swapchain_t *device_swapchain_create(gs_device_t *device,
@@ -0,0 +1,462 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <assert.h>
+#include <limits.h>
+#include "../util/platform.h"
+#include "../util/crc32.h"
+#include "../util/dstr.h"
+#include "../util/file-serializer.h"
+#include "effect-cache.h"
+#include "effect.h"
+
+#define EC_MAGIC   0x43464545 /* "EEFC" */
+#define EC_VERSION 1
+
+#define EC_NULL_STR UINT32_MAX
+
+/* ------------------------------------------------------------------------- */
+
+static bool ec_compile_shader_params(gs_effect_t *effect,
+		struct darray *pass_params, struct ec_shader *shader_in,
+		gs_shader_t *shader)
+{
+	darray_resize(sizeof(struct pass_shaderparam), pass_params,
+			shader_in->params.num);
+
+	for (size_t i = 0; i < pass_params->num; i++) {
+		const char *param_name = shader_in->params.array[i];
+		struct pass_shaderparam *param;
+
+		param = darray_item(sizeof(struct pass_shaderparam),
+				pass_params, i);
+
+		param->eparam = gs_effect_get_param_by_name(effect, param_name);
+		param->sparam = gs_shader_get_param_by_name(shader, param_name);
+
+		if (!param->sparam) {
+			blog(LOG_ERROR, "Effect shader parameter not found");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool ec_compile_shader(struct effect_cache *ec, gs_effect_t *effect,
+		struct gs_effect_technique *tech, struct gs_effect_pass *pass,
+		struct ec_pass *pass_in, size_t pass_idx,
+		enum gs_shader_type type)
+{
+	struct ec_shader *shader_in;
+	struct darray *pass_params;
+	struct dstr location;
+	gs_shader_t *shader;
+	bool success;
+
+	dstr_init_copy(&location, ec->file);
+	if (type == GS_SHADER_VERTEX)
+		dstr_cat(&location, " (Vertex ");
+	else if (type == GS_SHADER_PIXEL)
+		dstr_cat(&location, " (Pixel ");
+
+	assert(pass_idx <= UINT_MAX);
+	dstr_catf(&location, "shader, technique %s, pass %u)", tech->name,
+			(unsigned)pass_idx);
+
+	if (type == GS_SHADER_VERTEX) {
+		shader_in = &pass_in->vertex;
+		pass->vertshader = gs_vertexshader_create(shader_in->str,
+				location.array, NULL);
+
+		shader = pass->vertshader;
+		pass_params = &pass->vertshader_params.da;
+	} else {
+		shader_in = &pass_in->pixel;
+		pass->pixelshader = gs_pixelshader_create(shader_in->str,
+				location.array, NULL);
+
+		shader = pass->pixelshader;
+		pass_params = &pass->pixelshader_params.da;
+	}
+
+	if (shader)
+		success = ec_compile_shader_params(effect, pass_params,
+				shader_in, shader);
+	else
+		success = false;
+
+	dstr_free(&location);
+	return success;
+}
+
+static bool ec_compile_technique(struct effect_cache *ec, gs_effect_t *effect,
+		size_t idx)
+{
+	struct gs_effect_technique *tech = effect->techniques.array+idx;
+	struct ec_technique *tech_in = ec->techniques.array+idx;
+	bool success = true;
+
+	tech->name    = bstrdup(tech_in->name);
+	tech->section = EFFECT_TECHNIQUE;
+	tech->effect  = effect;
+
+	da_resize(tech->passes, tech_in->passes.num);
+
+	for (size_t i = 0; i < tech->passes.num; i++) {
+		struct gs_effect_pass *pass = tech->passes.array+i;
+		struct ec_pass *pass_in = tech_in->passes.array+i;
+
+		pass->name    = bstrdup(pass_in->name);
+		pass->section = EFFECT_PASS;
+
+		if (!ec_compile_shader(ec, effect, tech, pass, pass_in, i,
+					GS_SHADER_VERTEX))
+			success = false;
+		if (!ec_compile_shader(ec, effect, tech, pass, pass_in, i,
+					GS_SHADER_PIXEL))
+			success = false;
+	}
+
+	return success;
+}
+
+bool ec_compile(struct effect_cache *ec, gs_effect_t *effect)
+{
+	bool success = true;
+	size_t i;
+
+	da_resize(effect->params, ec->params.num);
+	da_resize(effect->techniques, ec->techniques.num);
+
+	for (i = 0; i < ec->params.num; i++) {
+		struct gs_effect_param *param = effect->params.array+i;
+		struct ec_param *param_in = ec->params.array+i;
+
+		param->name    = bstrdup(param_in->name);
+		param->section = EFFECT_PARAM;
+		param->effect  = effect;
+		param->type    = param_in->type;
+		da_copy(param->default_val, param_in->default_val);
+
+		if (strcmp(param_in->name, "ViewProj") == 0)
+			effect->view_proj = param;
+		else if (strcmp(param_in->name, "World") == 0)
+			effect->world = param;
+	}
+
+	for (i = 0; i < ec->techniques.num; i++) {
+		if (!ec_compile_technique(ec, effect, i))
+			success = false;
+	}
+
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* cache files are machine-local, so values are stored in native byte order */
+
+static inline void ec_write_u32(struct serializer *s, uint32_t val)
+{
+	s_write(s, &val, sizeof(val));
+}
+
+static inline void ec_write_str(struct serializer *s, const char *str)
+{
+	uint32_t len = str ? (uint32_t)strlen(str) : EC_NULL_STR;
+	ec_write_u32(s, len);
+	if (str)
+		s_write(s, str, len);
+}
+
+static inline void ec_write_shader(struct serializer *s,
+		const struct ec_shader *shader)
+{
+	ec_write_str(s, shader->str);
+	ec_write_u32(s, (uint32_t)shader->params.num);
+	for (size_t i = 0; i < shader->params.num; i++)
+		ec_write_str(s, shader->params.array[i]);
+}
+
+bool ec_save(const struct effect_cache *ec, const char *cache_file,
+		const char *source, const char *preprocessor)
+{
+	struct serializer s;
+	size_t i, j;
+
+	if (!file_output_serializer_init_safe(&s, cache_file, "tmp"))
+		return false;
+
+	ec_write_u32(&s, EC_MAGIC);
+	ec_write_u32(&s, EC_VERSION);
+	ec_write_str(&s, ec->file);
+	ec_write_str(&s, preprocessor);
+	ec_write_u32(&s, calc_crc32(0, source, strlen(source)));
+	ec_write_u32(&s, (uint32_t)strlen(source));
+
+	ec_write_u32(&s, (uint32_t)ec->deps.num);
+	for (i = 0; i < ec->deps.num; i++) {
+		struct ec_dependency *dep = ec->deps.array+i;
+		ec_write_str(&s, dep->file);
+		ec_write_u32(&s, dep->crc);
+		ec_write_u32(&s, dep->size);
+	}
+
+	ec_write_u32(&s, (uint32_t)ec->params.num);
+	for (i = 0; i < ec->params.num; i++) {
+		struct ec_param *param = ec->params.array+i;
+		ec_write_str(&s, param->name);
+		ec_write_u32(&s, (uint32_t)param->type);
+		ec_write_u32(&s, (uint32_t)param->default_val.num);
+		s_write(&s, param->default_val.array, param->default_val.num);
+	}
+
+	ec_write_u32(&s, (uint32_t)ec->techniques.num);
+	for (i = 0; i < ec->techniques.num; i++) {
+		struct ec_technique *tech = ec->techniques.array+i;
+		ec_write_str(&s, tech->name);
+		ec_write_u32(&s, (uint32_t)tech->passes.num);
+
+		for (j = 0; j < tech->passes.num; j++) {
+			struct ec_pass *pass = tech->passes.array+j;
+			ec_write_str(&s, pass->name);
+			ec_write_shader(&s, &pass->vertex);
+			ec_write_shader(&s, &pass->pixel);
+		}
+	}
+
+	file_output_serializer_free(&s);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* lengths and counts in the file are checked against the bytes that are
+ * actually left in it before anything is allocated, so that a truncated or
+ * corrupt cache file is only a cache miss */
+struct ec_reader {
+	struct serializer s;
+	uint64_t          left;
+};
+
+static inline bool ec_read(struct ec_reader *r, void *data, size_t size)
+{
+	if (size > r->left || s_read(&r->s, data, size) != size)
+		return false;
+
+	r->left -= size;
+	return true;
+}
+
+static inline bool ec_read_u32(struct ec_reader *r, uint32_t *val)
+{
+	return ec_read(r, val, sizeof(*val));
+}
+
+/* every counted item starts with at least one u32 */
+static inline bool ec_read_count(struct ec_reader *r, uint32_t *num)
+{
+	return ec_read_u32(r, num) && *num <= r->left / sizeof(uint32_t);
+}
+
+static bool ec_read_str(struct ec_reader *r, char **str)
+{
+	uint32_t len;
+
+	*str = NULL;
+	if (!ec_read_u32(r, &len))
+		return false;
+	if (len == EC_NULL_STR)
+		return true;
+	if (len > r->left)
+		return false;
+
+	*str = bmalloc(len + 1);
+	(*str)[len] = 0;
+	return ec_read(r, *str, len);
+}
+
+static bool ec_read_shader(struct ec_reader *r, struct ec_shader *shader)
+{
+	uint32_t num;
+
+	if (!ec_read_str(r, &shader->str) || !ec_read_count(r, &num))
+		return false;
+
+	da_resize(shader->params, num);
+
+	for (uint32_t i = 0; i < num; i++) {
+		if (!ec_read_str(r, shader->params.array+i))
+			return false;
+	}
+
+	return true;
+}
+
+static bool ec_check_str(struct ec_reader *r, const char *expected)
+{
+	char *str;
+	bool match;
+
+	if (!ec_read_str(r, &str))
+		return false;
+
+	match = (!str && !expected) ||
+		(str && expected && strcmp(str, expected) == 0);
+	bfree(str);
+	return match;
+}
+
+static bool ec_check_dependency(const struct ec_dependency *dep)
+{
+	char *text = os_quick_read_utf8_file(dep->file);
+	bool match = false;
+
+	if (text) {
+		size_t size = strlen(text);
+		match = size == dep->size &&
+			calc_crc32(0, text, size) == dep->crc;
+		bfree(text);
+	}
+
+	return match;
+}
+
+static bool ec_read_header(struct ec_reader *r, const char *file,
+		const char *source, const char *preprocessor)
+{
+	uint32_t magic, version, crc, size;
+
+	if (!ec_read_u32(r, &magic) || magic != EC_MAGIC)
+		return false;
+	if (!ec_read_u32(r, &version) || version != EC_VERSION)
+		return false;
+	if (!ec_check_str(r, file) || !ec_check_str(r, preprocessor))
+		return false;
+	if (!ec_read_u32(r, &crc) || !ec_read_u32(r, &size))
+		return false;
+
+	return size == (uint32_t)strlen(source) &&
+		crc == calc_crc32(0, source, size);
+}
+
+static bool ec_read_data(struct effect_cache *ec, struct ec_reader *r)
+{
+	uint32_t num, num_passes, size;
+	size_t i, j;
+
+	if (!ec_read_count(r, &num))
+		return false;
+
+	da_resize(ec->deps, num);
+
+	for (i = 0; i < num; i++) {
+		struct ec_dependency *dep = ec->deps.array+i;
+		if (!ec_read_str(r, &dep->file) || !dep->file)
+			return false;
+		if (!ec_read_u32(r, &dep->crc) || !ec_read_u32(r, &dep->size))
+			return false;
+		if (!ec_check_dependency(dep))
+			return false;
+	}
+
+	if (!ec_read_count(r, &num))
+		return false;
+
+	da_resize(ec->params, num);
+
+	for (i = 0; i < num; i++) {
+		struct ec_param *param = ec->params.array+i;
+		uint32_t type;
+
+		if (!ec_read_str(r, &param->name) || !param->name)
+			return false;
+		if (!ec_read_u32(r, &type) || !ec_read_u32(r, &size))
+			return false;
+
+		if (size > r->left)
+			return false;
+
+		param->type = (enum gs_shader_param_type)type;
+		da_resize(param->default_val, size);
+		if (!ec_read(r, param->default_val.array, size))
+			return false;
+	}
+
+	if (!ec_read_count(r, &num))
+		return false;
+
+	da_resize(ec->techniques, num);
+
+	for (i = 0; i < num; i++) {
+		struct ec_technique *tech = ec->techniques.array+i;
+
+		if (!ec_read_str(r, &tech->name) || !tech->name)
+			return false;
+		if (!ec_read_count(r, &num_passes))
+			return false;
+
+		da_resize(tech->passes, num_passes);
+
+		for (j = 0; j < num_passes; j++) {
+			struct ec_pass *pass = tech->passes.array+j;
+
+			if (!ec_read_str(r, &pass->name))
+				return false;
+			if (!ec_read_shader(r, &pass->vertex))
+				return false;
+			if (!ec_read_shader(r, &pass->pixel))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool ec_load(struct effect_cache *ec, const char *cache_file,
+		const char *file, const char *source,
+		const char *preprocessor)
+{
+	struct ec_reader r;
+	int64_t size;
+	bool success;
+
+	if (!os_file_exists(cache_file))
+		return false;
+	if (!file_input_serializer_init(&r.s, cache_file))
+		return false;
+
+	size = os_fgetsize(r.s.data);
+	r.left = size > 0 ? (uint64_t)size : 0;
+
+	success = ec_read_header(&r, file, source, preprocessor);
+	if (success) {
+		ec->file = bstrdup(file);
+		success = ec_read_data(ec, &r);
+	}
+
+	file_input_serializer_free(&r.s);
+
+	/* stale or damaged, it's rewritten once the effect has been parsed */
+	if (!success) {
+		blog(LOG_DEBUG, "Removing invalid effect cache file '%s' "
+		                "for '%s'", cache_file, file);
+		os_unlink(cache_file);
+		ec_free(ec);
+	}
+	return success;
+}
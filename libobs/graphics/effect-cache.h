@@ -0,0 +1,156 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/darray.h"
+#include "../util/bmem.h"
+#include "graphics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The effect cache holds the output of the effect parser: the parameter
+ * list plus the generated shader text of every technique pass.  This is
+ * everything needed to build a gs_effect without running the preprocessor
+ * and parser again, so it can be written to disk and used to skip parsing
+ * on the next startup as long as the effect source and its includes are
+ * unchanged.
+ */
+
+/* ------------------------------------------------------------------------- */
+
+struct ec_param {
+	char *name;
+	enum gs_shader_param_type type;
+	DARRAY(uint8_t) default_val;
+};
+
+static inline void ec_param_free(struct ec_param *param)
+{
+	bfree(param->name);
+	da_free(param->default_val);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct ec_shader {
+	char *str;
+	DARRAY(char*) params;
+};
+
+static inline void ec_shader_free(struct ec_shader *shader)
+{
+	for (size_t i = 0; i < shader->params.num; i++)
+		bfree(shader->params.array[i]);
+
+	bfree(shader->str);
+	da_free(shader->params);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct ec_pass {
+	char *name;
+	struct ec_shader vertex;
+	struct ec_shader pixel;
+};
+
+static inline void ec_pass_free(struct ec_pass *pass)
+{
+	bfree(pass->name);
+	ec_shader_free(&pass->vertex);
+	ec_shader_free(&pass->pixel);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct ec_technique {
+	char *name;
+	DARRAY(struct ec_pass) passes;
+};
+
+static inline void ec_technique_free(struct ec_technique *tech)
+{
+	for (size_t i = 0; i < tech->passes.num; i++)
+		ec_pass_free(tech->passes.array+i);
+
+	bfree(tech->name);
+	da_free(tech->passes);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct ec_dependency {
+	char     *file;
+	uint32_t crc;
+	uint32_t size;
+};
+
+/* ------------------------------------------------------------------------- */
+
+struct effect_cache {
+	char *file;
+
+	DARRAY(struct ec_param)      params;
+	DARRAY(struct ec_technique)  techniques;
+	DARRAY(struct ec_dependency) deps;
+};
+
+static inline void ec_init(struct effect_cache *ec)
+{
+	memset(ec, 0, sizeof(struct effect_cache));
+}
+
+static inline void ec_free(struct effect_cache *ec)
+{
+	size_t i;
+	for (i = 0; i < ec->params.num; i++)
+		ec_param_free(ec->params.array+i);
+	for (i = 0; i < ec->techniques.num; i++)
+		ec_technique_free(ec->techniques.array+i);
+	for (i = 0; i < ec->deps.num; i++)
+		bfree(ec->deps.array[i].file);
+
+	bfree(ec->file);
+	da_free(ec->params);
+	da_free(ec->techniques);
+	da_free(ec->deps);
+	ec->file = NULL;
+}
+
+/** Builds the params, techniques and shaders of an effect from cached data */
+extern bool ec_compile(struct effect_cache *ec, gs_effect_t *effect);
+
+/**
+ * Loads cached effect data from cache_file.  Fails if the cached data was
+ * not generated from the same source text (and includes) with the same
+ * graphics preprocessor.
+ */
+extern bool ec_load(struct effect_cache *ec, const char *cache_file,
+		const char *file, const char *source,
+		const char *preprocessor);
+
+/** Writes effect data to cache_file */
+extern bool ec_save(const struct effect_cache *ec, const char *cache_file,
+		const char *source, const char *preprocessor);
+
+#ifdef __cplusplus
+}
+#endif
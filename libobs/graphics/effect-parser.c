@@ -18,6 +18,7 @@
 #include <assert.h>
 #include <limits.h>
 #include "../util/platform.h"
+#include "../util/crc32.h"
 #include "effect-parser.h"
 #include "effect.h"
 
@@ -37,6 +38,7 @@ void ep_free(struct effect_parser *ep)
 
 	ep->cur_pass = NULL;
 	cf_parser_free(&ep->cfp);
+	ec_free(&ep->cache);
 	da_free(ep->params);
 	da_free(ep->structs);
 	da_free(ep->funcs);
@@ -1306,16 +1308,13 @@ static void ep_makeshaderstring(struct effect_parser *ep,
 
 static void ep_compile_param(struct effect_parser *ep, size_t idx)
 {
-	struct gs_effect_param *param;
+	struct ec_param *param;
 	struct ep_param *param_in;
 
-	param = ep->effect->params.array+idx;
+	param = ep->cache.params.array+idx;
 	param_in = ep->params.array+idx;
-	param_in->param = param;
 
-	param->name    = bstrdup(param_in->name);
-	param->section = EFFECT_PARAM;
-	param->effect  = ep->effect;
+	param->name = bstrdup(param_in->name);
 	da_move(param->default_val, param_in->default_val);
 
 	if (strcmp(param_in->type, "bool") == 0)
@@ -1334,179 +1333,92 @@ static void ep_compile_param(struct effect_parser *ep, size_t idx)
 		param->type = GS_SHADER_PARAM_MATRIX4X4;
 	else if (param_in->is_texture)
 		param->type = GS_SHADER_PARAM_TEXTURE;
-
-	if (strcmp(param_in->name, "ViewProj") == 0)
-		ep->effect->view_proj = param;
-	else if (strcmp(param_in->name, "World") == 0)
-		ep->effect->world = param;
 }
 
-static bool ep_compile_pass_shaderparams(struct effect_parser *ep,
-		struct darray *pass_params, struct darray *used_params,
-		gs_shader_t *shader)
-{
-	size_t i;
-	darray_resize(sizeof(struct pass_shaderparam), pass_params,
-			used_params->num);
-
-	for (i = 0; i < pass_params->num; i++) {
-		struct dstr *param_name;
-		struct pass_shaderparam *param;
-
-		param_name = darray_item(sizeof(struct dstr), used_params, i);
-		param = darray_item(sizeof(struct pass_shaderparam),
-				pass_params, i);
-
-		param->eparam = gs_effect_get_param_by_name(ep->effect,
-				param_name->array);
-		param->sparam = gs_shader_get_param_by_name(shader,
-				param_name->array);
-
-		if (!param->sparam) {
-			blog(LOG_ERROR, "Effect shader parameter not found");
-			return false;
-		}
-	}
-
-	return true;
-}
-
-static inline bool ep_compile_pass_shader(struct effect_parser *ep,
-		struct gs_effect_technique *tech,
-		struct gs_effect_pass *pass, struct ep_pass *pass_in,
-		size_t pass_idx, enum gs_shader_type type)
+static inline void ep_compile_pass_shader(struct effect_parser *ep,
+		struct ec_shader *shader, struct darray *shader_call)
 {
 	struct dstr shader_str;
-	struct dstr location;
 	struct darray used_params; /* struct dstr */
-	struct darray *pass_params = NULL; /* struct pass_shaderparam */
-	gs_shader_t *shader = NULL;
-	bool success = true;
 
 	dstr_init(&shader_str);
 	darray_init(&used_params);
-	dstr_init(&location);
-
-	dstr_copy(&location, ep->cfp.lex.file);
-	if (type == GS_SHADER_VERTEX)
-		dstr_cat(&location, " (Vertex ");
-	else if (type == GS_SHADER_PIXEL)
-		dstr_cat(&location, " (Pixel ");
-	/*else if (type == SHADER_GEOMETRY)
-		dstr_cat(&location, " (Geometry ");*/
-
-	assert(pass_idx <= UINT_MAX);
-	dstr_catf(&location, "shader, technique %s, pass %u)", tech->name,
-			(unsigned)pass_idx);
-
-	if (type == GS_SHADER_VERTEX) {
-		ep_makeshaderstring(ep, &shader_str,
-				&pass_in->vertex_program.da, &used_params);
-
-		pass->vertshader = gs_vertexshader_create(shader_str.array,
-				location.array, NULL);
-
-		shader = pass->vertshader;
-		pass_params = &pass->vertshader_params.da;
-	} else if (type == GS_SHADER_PIXEL) {
-		ep_makeshaderstring(ep, &shader_str,
-				&pass_in->fragment_program.da, &used_params);
-
-		pass->pixelshader = gs_pixelshader_create(shader_str.array,
-				location.array, NULL);
-
-		shader = pass->pixelshader;
-		pass_params = &pass->pixelshader_params.da;
-	}
-
-#if 0
-	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
-	blog(LOG_DEBUG, "  %s", location.array);
-	blog(LOG_DEBUG, "-----------------------------------");
-	blog(LOG_DEBUG, "%s", shader_str.array);
-	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
-#endif
-
-	if (shader)
-		success = ep_compile_pass_shaderparams(ep, pass_params,
-				&used_params, shader);
-	else
-		success = false;
-
-	dstr_free(&location);
-	dstr_array_free(used_params.array, used_params.num);
-	darray_free(&used_params);
-	dstr_free(&shader_str);
-
-	return success;
-}
 
-static bool ep_compile_pass(struct effect_parser *ep,
-		struct gs_effect_technique *tech,
-		struct ep_technique *tech_in,
-		size_t idx)
-{
-	struct gs_effect_pass *pass;
-	struct ep_pass *pass_in;
-	bool success = true;
-
-	pass = tech->passes.array+idx;
-	pass_in = tech_in->passes.array+idx;
+	ep_makeshaderstring(ep, &shader_str, shader_call, &used_params);
 
-	pass->name = bstrdup(pass_in->name);
-	pass->section = EFFECT_PASS;
+	shader->str = shader_str.array;
+	da_resize(shader->params, used_params.num);
 
-	if (!ep_compile_pass_shader(ep, tech, pass, pass_in, idx,
-				GS_SHADER_VERTEX))
-		success = false;
+	for (size_t i = 0; i < used_params.num; i++) {
+		struct dstr *param_name;
+		param_name = darray_item(sizeof(struct dstr), &used_params, i);
 
-	if (!ep_compile_pass_shader(ep, tech, pass, pass_in, idx,
-				GS_SHADER_PIXEL))
-		success = false;
+		shader->params.array[i] = param_name->array;
+	}
 
-	return success;
+	darray_free(&used_params);
 }
 
-static inline bool ep_compile_technique(struct effect_parser *ep, size_t idx)
+static inline void ep_compile_technique(struct effect_parser *ep, size_t idx)
 {
-	struct gs_effect_technique *tech;
+	struct ec_technique *tech;
 	struct ep_technique *tech_in;
-	bool success = true;
-	size_t i;
 
-	tech = ep->effect->techniques.array+idx;
+	tech = ep->cache.techniques.array+idx;
 	tech_in = ep->techniques.array+idx;
 
 	tech->name = bstrdup(tech_in->name);
-	tech->section = EFFECT_TECHNIQUE;
-	tech->effect = ep->effect;
 
 	da_resize(tech->passes, tech_in->passes.num);
 
-	for (i = 0; i < tech->passes.num; i++) {
-		if (!ep_compile_pass(ep, tech, tech_in, i))
-			success = false;
+	for (size_t i = 0; i < tech->passes.num; i++) {
+		struct ec_pass *pass = tech->passes.array+i;
+		struct ep_pass *pass_in = tech_in->passes.array+i;
+
+		pass->name = bstrdup(pass_in->name);
+
+		ep_compile_pass_shader(ep, &pass->vertex,
+				&pass_in->vertex_program.da);
+		ep_compile_pass_shader(ep, &pass->pixel,
+				&pass_in->fragment_program.da);
 	}
+}
 
-	return success;
+static void ep_compile_dependencies(struct effect_parser *ep)
+{
+	struct cf_preprocessor *pp = &ep->cfp.pp;
+
+	da_resize(ep->cache.deps, pp->dependencies.num);
+
+	for (size_t i = 0; i < pp->dependencies.num; i++) {
+		struct cf_lexer *dep_in = pp->dependencies.array+i;
+		struct ec_dependency *dep = ep->cache.deps.array+i;
+		const char *text = dep_in->base_lexer.text;
+		size_t size = text ? strlen(text) : 0;
+
+		dep->file = bstrdup(dep_in->file);
+		dep->size = (uint32_t)size;
+		dep->crc  = calc_crc32(0, text, size);
+	}
 }
 
 static bool ep_compile(struct effect_parser *ep)
 {
-	bool success = true;
 	size_t i;
 
 	assert(ep->effect);
 
-	da_resize(ep->effect->params, ep->params.num);
-	da_resize(ep->effect->techniques, ep->techniques.num);
+	ep->cache.file = bstrdup(ep->cfp.lex.file);
+
+	da_resize(ep->cache.params, ep->params.num);
+	da_resize(ep->cache.techniques, ep->techniques.num);
 
 	for (i = 0; i < ep->params.num; i++)
 		ep_compile_param(ep, i);
-	for (i = 0; i < ep->techniques.num; i++) {
-		if (!ep_compile_technique(ep, i))
-			success = false;
-	}
+	for (i = 0; i < ep->techniques.num; i++)
+		ep_compile_technique(ep, i);
 
-	return success;
+	ep_compile_dependencies(ep);
+
+	return ec_compile(&ep->cache, ep->effect);
 }
@@ -20,6 +20,7 @@
 #include "../util/darray.h"
 #include "../util/cf-parser.h"
 #include "graphics.h"
+#include "effect-cache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -257,6 +258,9 @@ struct effect_parser {
 	struct gs_effect_pass *cur_pass;
 
 	struct cf_parser cfp;
+
+	/* parser output, used to build the effect and for the disk cache */
+	struct effect_cache cache;
 };
 
 static inline void ep_init(struct effect_parser *ep)
@@ -271,6 +275,7 @@ static inline void ep_init(struct effect_parser *ep)
 
 	ep->cur_pass = NULL;
 	cf_parser_init(&ep->cfp);
+	ec_init(&ep->cache);
 }
 
 extern void ep_free(struct effect_parser *ep);
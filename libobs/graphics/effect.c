@@ -286,6 +286,63 @@ gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect,
 	return NULL;
 }
 
+size_t gs_effect_intern_param_name(const char *name)
+{
+	graphics_t *graphics = gs_get_context();
+	size_t id;
+
+	if (!graphics || !name) {
+		blog(LOG_ERROR, "gs_effect_intern_param_name: invalid "
+		                "parameter or no graphics context");
+		return DARRAY_INVALID;
+	}
+
+	pthread_mutex_lock(&graphics->effect_mutex);
+
+	for (id = 0; id < graphics->interned_params.num; id++) {
+		if (strcmp(graphics->interned_params.array[id], name) == 0)
+			goto exit;
+	}
+
+	char *new_name = bstrdup(name);
+	id = da_push_back(graphics->interned_params, &new_name);
+
+exit:
+	pthread_mutex_unlock(&graphics->effect_mutex);
+	return id;
+}
+
+static void resolve_interned_params(gs_effect_t *effect)
+{
+	graphics_t *graphics = effect->graphics;
+
+	pthread_mutex_lock(&graphics->effect_mutex);
+
+	for (size_t i = effect->interned_params.num;
+	     i < graphics->interned_params.num; i++) {
+		const char *name = graphics->interned_params.array[i];
+		gs_eparam_t *param = gs_effect_get_param_by_name(effect, name);
+
+		da_push_back(effect->interned_params, &param);
+	}
+
+	pthread_mutex_unlock(&graphics->effect_mutex);
+}
+
+gs_eparam_t *gs_effect_get_param_by_id(gs_effect_t *effect, size_t id)
+{
+	if (!effect) return NULL;
+
+	if (id >= effect->interned_params.num) {
+		resolve_interned_params(effect);
+
+		if (id >= effect->interned_params.num)
+			return NULL;
+	}
+
+	return effect->interned_params.array[id];
+}
+
 gs_eparam_t *gs_effect_get_viewproj_matrix(const gs_effect_t *effect)
 {
 	return effect ? effect->view_proj : NULL;
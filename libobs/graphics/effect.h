@@ -150,6 +150,9 @@ struct gs_effect {
 	gs_eparam_t *view_proj, *world, *scale;
 	graphics_t *graphics;
 
+	/* params indexed by interned name ID, resolved on first use */
+	DARRAY(gs_eparam_t*) interned_params;
+
 	struct gs_effect *next;
 
 	size_t loop_pass;
@@ -171,6 +174,7 @@ static inline void effect_free(gs_effect_t *effect)
 
 	da_free(effect->params);
 	da_free(effect->techniques);
+	da_free(effect->interned_params);
 
 	bfree(effect->effect_path);
 	bfree(effect->effect_dir);
@@ -32,6 +32,7 @@ struct gs_exports {
 	const char *(*device_preprocessor_name)(void);
 	int (*device_create)(gs_device_t **device, uint32_t adapter);
 	void (*device_destroy)(gs_device_t *device);
+	void (*device_set_cache_dir)(gs_device_t *device, const char *dir);
 	void (*device_enter_context)(gs_device_t *device);
 	void (*device_leave_context)(gs_device_t *device);
 	gs_swapchain_t *(*device_swapchain_create)(gs_device_t *device,
@@ -159,6 +160,9 @@ struct gs_exports {
 	bool     (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			uint32_t *linesize);
 	void     (*gs_texture_unmap)(gs_texture_t *tex);
+	bool     (*gs_texture_set_image_region)(gs_texture_t *tex,
+			uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+			const uint8_t *data, uint32_t linesize);
 	bool     (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void    *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -293,6 +297,8 @@ struct graphics_subsystem {
 
 	pthread_mutex_t        effect_mutex;
 	struct gs_effect       *first_effect;
+	char                   *cache_dir;
+	DARRAY(char*)          interned_params;
 
 	pthread_mutex_t        mutex;
 	volatile long          ref;
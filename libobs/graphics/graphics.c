@@ -20,6 +20,8 @@
 #include "../util/base.h"
 #include "../util/bmem.h"
 #include "../util/platform.h"
+#include "../util/crc32.h"
+#include "../util/dstr.h"
 #include "graphics-internal.h"
 #include "vec2.h"
 #include "vec3.h"
@@ -245,6 +247,10 @@ void gs_destroy(graphics_t *graphics)
 
 	pthread_mutex_destroy(&graphics->mutex);
 	pthread_mutex_destroy(&graphics->effect_mutex);
+	bfree(graphics->cache_dir);
+	for (size_t i = 0; i < graphics->interned_params.num; i++)
+		bfree(graphics->interned_params.array[i]);
+	da_free(graphics->interned_params);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
@@ -311,6 +317,36 @@ static inline struct matrix4 *top_matrix(graphics_t *graphics)
 	return graphics->matrix_stack.array + graphics->cur_matrix;
 }
 
+void gs_set_cache_dir(const char *dir)
+{
+	graphics_t *graphics = thread_graphics;
+	struct dstr path = {0};
+
+	if (!gs_valid("gs_set_cache_dir"))
+		return;
+
+	bfree(graphics->cache_dir);
+	graphics->cache_dir = NULL;
+
+	if (!dir || !*dir)
+		return;
+
+	dstr_printf(&path, "%s/effects", dir);
+	if (os_mkdirs(path.array) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "gs_set_cache_dir: Failed to create cache "
+		                  "directory '%s'", path.array);
+		dstr_free(&path);
+		return;
+	}
+
+	graphics->cache_dir = bstrdup(dir);
+
+	if (graphics->exports.device_set_cache_dir)
+		graphics->exports.device_set_cache_dir(graphics->device, dir);
+
+	dstr_free(&path);
+}
+
 void gs_matrix_push(void)
 {
 	graphics_t *graphics = thread_graphics;
@@ -789,36 +825,67 @@ static inline struct gs_effect *find_cached_effect(const char *filename)
 	return effect;
 }
 
-gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string)
+extern const char *gs_preprocessor_name(void);
+
+static inline void add_effect_to_list(struct gs_effect *effect)
 {
-	char *file_string;
-	gs_effect_t *effect = NULL;
+	pthread_mutex_lock(&thread_graphics->effect_mutex);
 
-	if (!gs_valid_p("gs_effect_create_from_file", file))
+	if (effect->effect_path) {
+		effect->cached = true;
+		effect->next = thread_graphics->first_effect;
+		thread_graphics->first_effect = effect;
+	}
+
+	pthread_mutex_unlock(&thread_graphics->effect_mutex);
+}
+
+static char *get_effect_cache_file(const char *file)
+{
+	struct dstr path = {0};
+
+	if (!thread_graphics->cache_dir)
 		return NULL;
 
-	effect = find_cached_effect(file);
-	if (effect)
-		return effect;
+	dstr_printf(&path, "%s/effects/%08X.cache",
+			thread_graphics->cache_dir,
+			calc_crc32(0, file, strlen(file)));
+	return path.array;
+}
 
-	file_string = os_quick_read_utf8_file(file);
-	if (!file_string) {
-		blog(LOG_ERROR, "Could not load effect file '%s'", file);
+static gs_effect_t *effect_create_from_cache(const char *file_string,
+		const char *file, const char *cache_file)
+{
+	struct gs_effect *effect;
+	struct effect_cache ec;
+
+	ec_init(&ec);
+	if (!ec_load(&ec, cache_file, file, file_string,
+				gs_preprocessor_name()))
 		return NULL;
-	}
 
-	effect = gs_effect_create(file_string, file, error_string);
-	bfree(file_string);
+	effect = bzalloc(sizeof(struct gs_effect));
+	effect->graphics = thread_graphics;
+	effect->effect_path = bstrdup(file);
 
+	if (!ec_compile(&ec, effect)) {
+		blog(LOG_WARNING, "Failed to build effect '%s' from cache, "
+		                  "reparsing", file);
+		gs_effect_actually_destroy(effect);
+		effect = NULL;
+	} else {
+		blog(LOG_DEBUG, "Loaded effect '%s' from cache", file);
+		add_effect_to_list(effect);
+	}
+
+	ec_free(&ec);
 	return effect;
 }
 
-gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
-		char **error_string)
+static gs_effect_t *effect_create(const char *effect_string,
+		const char *filename, char **error_string,
+		const char *cache_file)
 {
-	if (!gs_valid_p("gs_effect_create", effect_string))
-		return NULL;
-
 	struct gs_effect *effect = bzalloc(sizeof(struct gs_effect));
 	struct effect_parser parser;
 	bool success;
@@ -837,21 +904,61 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 	}
 
 	if (effect) {
-		pthread_mutex_lock(&thread_graphics->effect_mutex);
-
-		if (effect->effect_path) {
-			effect->cached = true;
-			effect->next = thread_graphics->first_effect;
-			thread_graphics->first_effect = effect;
-		}
+		add_effect_to_list(effect);
 
-		pthread_mutex_unlock(&thread_graphics->effect_mutex);
+		if (cache_file && !ec_save(&parser.cache, cache_file,
+					effect_string,
+					gs_preprocessor_name()))
+			blog(LOG_DEBUG, "Could not write effect cache file "
+			                "'%s'", cache_file);
 	}
 
 	ep_free(&parser);
 	return effect;
 }
 
+gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string)
+{
+	char *file_string;
+	char *cache_file;
+	gs_effect_t *effect = NULL;
+
+	if (!gs_valid_p("gs_effect_create_from_file", file))
+		return NULL;
+
+	effect = find_cached_effect(file);
+	if (effect)
+		return effect;
+
+	file_string = os_quick_read_utf8_file(file);
+	if (!file_string) {
+		blog(LOG_ERROR, "Could not load effect file '%s'", file);
+		return NULL;
+	}
+
+	cache_file = get_effect_cache_file(file);
+	if (cache_file)
+		effect = effect_create_from_cache(file_string, file,
+				cache_file);
+	if (!effect)
+		effect = effect_create(file_string, file, error_string,
+				cache_file);
+
+	bfree(cache_file);
+	bfree(file_string);
+
+	return effect;
+}
+
+gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
+		char **error_string)
+{
+	if (!gs_valid_p("gs_effect_create", effect_string))
+		return NULL;
+
+	return effect_create(effect_string, filename, error_string, NULL);
+}
+
 gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 		char **error_string)
 {
@@ -1052,8 +1159,14 @@ void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 		}
 	}
 
-	fcx = (float)gs_texture_get_width(tex);
-	fcy = (float)gs_texture_get_height(tex);
+	/* rectangle textures are addressed in pixels */
+	if (tex && gs_texture_is_rect(tex)) {
+		fcx = 1.0f;
+		fcy = 1.0f;
+	} else {
+		fcx = (float)gs_texture_get_width(tex);
+		fcy = (float)gs_texture_get_height(tex);
+	}
 
 	data = gs_vertexbuffer_get_data(graphics->sprite_buffer);
 	build_subsprite_norm(data,
@@ -2218,6 +2331,22 @@ void gs_texture_unmap(gs_texture_t *tex)
 	graphics->exports.gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy, const uint8_t *data,
+		uint32_t linesize)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_region", tex, data))
+		return false;
+
+	if (graphics->exports.gs_texture_set_image_region)
+		return graphics->exports.gs_texture_set_image_region(tex,
+				x, y, cx, cy, data, linesize);
+	else
+		return false;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	graphics_t *graphics = thread_graphics;
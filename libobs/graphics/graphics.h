@@ -247,6 +247,7 @@ struct gs_sampler_state;
 struct gs_shader;
 struct gs_swap_chain;
 struct gs_texrender;
+struct gs_sprite_batch;
 struct gs_shader_param;
 struct gs_effect;
 struct gs_effect_technique;
@@ -263,6 +264,7 @@ typedef struct gs_index_buffer     gs_indexbuffer_t;
 typedef struct gs_sampler_state    gs_samplerstate_t;
 typedef struct gs_swap_chain       gs_swapchain_t;
 typedef struct gs_texture_render   gs_texrender_t;
+typedef struct gs_sprite_batch     gs_sprite_batch_t;
 typedef struct gs_shader           gs_shader_t;
 typedef struct gs_shader_param     gs_sparam_t;
 typedef struct gs_effect           gs_effect_t;
@@ -371,6 +373,17 @@ EXPORT gs_eparam_t *gs_effect_get_param_by_idx(const gs_effect_t *effect,
 EXPORT gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect,
 		const char *name);
 
+/**
+ * Interns a parameter name and returns its ID.  Looking a parameter up by ID
+ * is resolved once per effect and is then a simple array lookup, so it is
+ * preferred over gs_effect_get_param_by_name in hot render paths where the
+ * effect is not known in advance.  Interned IDs are valid for the lifetime
+ * of the graphics subsystem.
+ */
+EXPORT size_t gs_effect_intern_param_name(const char *name);
+EXPORT gs_eparam_t *gs_effect_get_param_by_id(gs_effect_t *effect,
+		size_t id);
+
 /** Helper function to simplify effect usage.  Use with a while loop that
  * contains drawing functions.  Automatically handles techniques, passes, and
  * unloading. */
@@ -411,6 +424,40 @@ EXPORT void gs_texrender_end(gs_texrender_t *texrender);
 EXPORT void gs_texrender_reset(gs_texrender_t *texrender);
 EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 
+/* ---------------------------------------------------
+ * sprite batch helper functions
+ * --------------------------------------------------- */
+
+EXPORT gs_sprite_batch_t *gs_sprite_batch_create(void);
+EXPORT void gs_sprite_batch_destroy(gs_sprite_batch_t *batch);
+
+/**
+ * Adds a sprite transformed by the current matrix.  Parameters are the same
+ * as gs_draw_sprite.
+ */
+EXPORT void gs_sprite_batch_add(gs_sprite_batch_t *batch, gs_texture_t *tex,
+		uint32_t flip, uint32_t width, uint32_t height);
+
+/**
+ * Adds a subregion of a texture transformed by the current matrix.
+ * Parameters are the same as gs_draw_sprite_subregion.
+ */
+EXPORT void gs_sprite_batch_add_subregion(gs_sprite_batch_t *batch,
+		gs_texture_t *tex, uint32_t flip,
+		uint32_t sub_x, uint32_t sub_y,
+		uint32_t sub_cx, uint32_t sub_cy);
+EXPORT size_t gs_sprite_batch_count(const gs_sprite_batch_t *batch);
+EXPORT void gs_sprite_batch_clear(gs_sprite_batch_t *batch);
+
+/**
+ * Draws all added sprites with the given effect technique, setting the
+ * effect's "image" parameter to each sprite's texture, then clears the batch.
+ * Sprites that share a texture are drawn together where that doesn't change
+ * the result of drawing them in order.
+ */
+EXPORT void gs_sprite_batch_draw(gs_sprite_batch_t *batch, gs_effect_t *effect,
+		const char *technique);
+
 /* ---------------------------------------------------
  * graphics subsystem
  * --------------------------------------------------- */
@@ -451,6 +498,7 @@ struct gs_init_data {
 
 #define GS_DEVICE_OPENGL      1
 #define GS_DEVICE_DIRECT3D_11 2
+#define GS_DEVICE_NULL        3
 
 EXPORT const char *gs_get_device_name(void);
 EXPORT int gs_get_device_type(void);
@@ -466,6 +514,13 @@ EXPORT void gs_enter_context(graphics_t *graphics);
 EXPORT void gs_leave_context(void);
 EXPORT graphics_t *gs_get_context(void);
 
+/**
+ * Sets the directory used to cache parsed effects and compiled shader
+ * programs between runs.  Must be called within the graphics context before
+ * any effects are created.  NULL disables the cache.
+ */
+EXPORT void gs_set_cache_dir(const char *dir);
+
 EXPORT void gs_matrix_push(void);
 EXPORT void gs_matrix_pop(void);
 EXPORT void gs_matrix_identity(void);
@@ -679,6 +734,15 @@ EXPORT enum gs_color_format gs_texture_get_color_format(
 EXPORT bool     gs_texture_map(gs_texture_t *tex, uint8_t **ptr,
 		uint32_t *linesize);
 EXPORT void     gs_texture_unmap(gs_texture_t *tex);
+/**
+ * Uploads a rectangular region of a 2D texture from system memory, leaving
+ * the rest of the texture untouched.  linesize is the row pitch of data.
+ * Returns false if the region could not be uploaded or if partial updates
+ * are not supported by the graphics subsystem.
+ */
+EXPORT bool     gs_texture_set_image_region(gs_texture_t *tex,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+		const uint8_t *data, uint32_t linesize);
 /** special-case function (GL only) - specifies whether the texture is a
  * GL_TEXTURE_RECTANGLE type, which doesn't use normalized texture
  * coordinates, doesn't support mipmapping, and requires address clamping */
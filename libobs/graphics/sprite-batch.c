@@ -0,0 +1,319 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ *   Gathers sprites into a single dynamic vertex buffer so that many of them
+ * can be drawn with one buffer upload.  Sprites are transformed by the
+ * current matrix when they're added, so the effect's parameters (other than
+ * the texture) only have to be uploaded once, and sprites that use the same
+ * texture are drawn with a single draw call.
+ *
+ *   Before drawing, a sprite is moved back next to an earlier sprite with the
+ * same texture if none of the sprites in between overlap it, which keeps the
+ * result the same as drawing them in the order they were added.
+ */
+
+#include "../util/darray.h"
+#include "graphics.h"
+#include "matrix4.h"
+#include "vec2.h"
+
+#define VERTS_PER_SPRITE 6
+#define MIN_CAPACITY     16
+
+struct batch_sprite {
+	gs_texture_t *tex;
+	struct vec3  points[4];
+	struct vec2  uvs[4];
+
+	/* bounds of the transformed points */
+	struct vec2  min;
+	struct vec2  max;
+};
+
+struct gs_sprite_batch {
+	DARRAY(struct batch_sprite) sprites;
+	DARRAY(struct batch_sprite) ordered;
+
+	gs_vertbuffer_t *vertbuffer;
+	size_t          capacity;
+};
+
+gs_sprite_batch_t *gs_sprite_batch_create(void)
+{
+	return bzalloc(sizeof(struct gs_sprite_batch));
+}
+
+void gs_sprite_batch_destroy(gs_sprite_batch_t *batch)
+{
+	if (batch) {
+		gs_vertexbuffer_destroy(batch->vertbuffer);
+		da_free(batch->sprites);
+		da_free(batch->ordered);
+		bfree(batch);
+	}
+}
+
+static inline void assign_uv(float *start, float *end, float sub,
+		float sub_size, float size, bool flip)
+{
+	*start = (flip ? sub + sub_size : sub) / size;
+	*end   = (flip ? sub : sub + sub_size) / size;
+}
+
+static bool batch_texture_valid(gs_texture_t *tex)
+{
+	if (gs_get_texture_type(tex) != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "A sprite must be a 2D texture");
+		return false;
+	}
+
+	return true;
+}
+
+static void sprite_batch_push(gs_sprite_batch_t *batch, gs_texture_t *tex,
+		uint32_t flip, float fcx, float fcy,
+		float sub_x, float sub_y, float sub_cx, float sub_cy)
+{
+	struct batch_sprite *sprite;
+	struct matrix4 transform;
+	float size_u = 1.0f;
+	float size_v = 1.0f;
+	float start_u, end_u;
+	float start_v, end_v;
+
+	/* rectangle textures are addressed in pixels */
+	if (!gs_texture_is_rect(tex)) {
+		size_u = (float)gs_texture_get_width(tex);
+		size_v = (float)gs_texture_get_height(tex);
+	}
+
+	assign_uv(&start_u, &end_u, sub_x, sub_cx, size_u,
+			(flip & GS_FLIP_U) != 0);
+	assign_uv(&start_v, &end_v, sub_y, sub_cy, size_v,
+			(flip & GS_FLIP_V) != 0);
+
+	gs_matrix_get(&transform);
+
+	sprite = da_push_back_new(batch->sprites);
+	sprite->tex = tex;
+
+	vec3_set(sprite->points,   0.0f, 0.0f, 0.0f);
+	vec3_set(sprite->points+1,  fcx, 0.0f, 0.0f);
+	vec3_set(sprite->points+2, 0.0f,  fcy, 0.0f);
+	vec3_set(sprite->points+3,  fcx,  fcy, 0.0f);
+
+	for (size_t i = 0; i < 4; i++)
+		vec3_transform(sprite->points+i, sprite->points+i, &transform);
+
+	vec2_set(&sprite->min, sprite->points[0].x, sprite->points[0].y);
+	vec2_copy(&sprite->max, &sprite->min);
+
+	for (size_t i = 1; i < 4; i++) {
+		struct vec2 point;
+
+		vec2_set(&point, sprite->points[i].x, sprite->points[i].y);
+		vec2_min(&sprite->min, &sprite->min, &point);
+		vec2_max(&sprite->max, &sprite->max, &point);
+	}
+
+	vec2_set(sprite->uvs,   start_u, start_v);
+	vec2_set(sprite->uvs+1, end_u,   start_v);
+	vec2_set(sprite->uvs+2, start_u, end_v);
+	vec2_set(sprite->uvs+3, end_u,   end_v);
+}
+
+void gs_sprite_batch_add(gs_sprite_batch_t *batch, gs_texture_t *tex,
+		uint32_t flip, uint32_t width, uint32_t height)
+{
+	float tex_cx, tex_cy;
+
+	if (!batch || !tex || !batch_texture_valid(tex))
+		return;
+
+	tex_cx = (float)gs_texture_get_width(tex);
+	tex_cy = (float)gs_texture_get_height(tex);
+
+	sprite_batch_push(batch, tex, flip,
+			width  ? (float)width  : tex_cx,
+			height ? (float)height : tex_cy,
+			0.0f, 0.0f, tex_cx, tex_cy);
+}
+
+void gs_sprite_batch_add_subregion(gs_sprite_batch_t *batch,
+		gs_texture_t *tex, uint32_t flip,
+		uint32_t sub_x, uint32_t sub_y,
+		uint32_t sub_cx, uint32_t sub_cy)
+{
+	if (!batch || !tex || !batch_texture_valid(tex))
+		return;
+
+	sprite_batch_push(batch, tex, flip, (float)sub_cx, (float)sub_cy,
+			(float)sub_x, (float)sub_y,
+			(float)sub_cx, (float)sub_cy);
+}
+
+size_t gs_sprite_batch_count(const gs_sprite_batch_t *batch)
+{
+	return batch ? batch->sprites.num : 0;
+}
+
+void gs_sprite_batch_clear(gs_sprite_batch_t *batch)
+{
+	if (batch)
+		da_resize(batch->sprites, 0);
+}
+
+static bool sprite_batch_reserve(gs_sprite_batch_t *batch, size_t count)
+{
+	struct gs_vb_data *vbd;
+	size_t capacity = batch->capacity ? batch->capacity : MIN_CAPACITY;
+	size_t num_verts;
+
+	if (batch->vertbuffer && count <= batch->capacity)
+		return true;
+
+	while (capacity < count)
+		capacity *= 2;
+
+	num_verts = capacity * VERTS_PER_SPRITE;
+
+	vbd = gs_vbdata_create();
+	vbd->num     = num_verts;
+	vbd->points  = bzalloc(sizeof(struct vec3) * num_verts);
+	vbd->num_tex = 1;
+	vbd->tvarray = bzalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec2) * num_verts);
+
+	gs_vertexbuffer_destroy(batch->vertbuffer);
+	batch->vertbuffer = gs_vertexbuffer_create(vbd, GS_DYNAMIC);
+	batch->capacity   = batch->vertbuffer ? capacity : 0;
+	return batch->vertbuffer != NULL;
+}
+
+/* two triangles per sprite, in the same winding as the sprite tristrip */
+static const size_t sprite_indices[VERTS_PER_SPRITE] = {0, 1, 2, 2, 1, 3};
+
+static inline bool sprites_overlap(const struct batch_sprite *a,
+		const struct batch_sprite *b)
+{
+	return a->min.x < b->max.x && b->min.x < a->max.x &&
+	       a->min.y < b->max.y && b->min.y < a->max.y;
+}
+
+/* groups sprites with the same texture, a sprite is only moved back past
+ * sprites it doesn't overlap, so the order of overlapping sprites (and with
+ * it the result of blending) stays the same */
+static void sprite_batch_order(gs_sprite_batch_t *batch)
+{
+	da_resize(batch->ordered, 0);
+	da_reserve(batch->ordered, batch->sprites.num);
+
+	for (size_t i = 0; i < batch->sprites.num; i++) {
+		struct batch_sprite *sprite = batch->sprites.array + i;
+		size_t idx = batch->ordered.num;
+
+		for (size_t j = batch->ordered.num; j > 0; j--) {
+			struct batch_sprite *prev = batch->ordered.array + j - 1;
+
+			if (prev->tex == sprite->tex) {
+				idx = j;
+				break;
+			}
+			if (sprites_overlap(prev, sprite))
+				break;
+		}
+
+		da_insert(batch->ordered, idx, sprite);
+	}
+}
+
+static void sprite_batch_build(gs_sprite_batch_t *batch)
+{
+	struct gs_vb_data *vbd = gs_vertexbuffer_get_data(batch->vertbuffer);
+	struct vec3 *points = vbd->points;
+	struct vec2 *uvs    = vbd->tvarray[0].array;
+
+	for (size_t i = 0; i < batch->ordered.num; i++) {
+		struct batch_sprite *sprite = batch->ordered.array + i;
+
+		for (size_t j = 0; j < VERTS_PER_SPRITE; j++) {
+			size_t idx = sprite_indices[j];
+			vec3_copy(points++, sprite->points+idx);
+			vec2_copy(uvs++,    sprite->uvs+idx);
+		}
+	}
+
+	gs_vertexbuffer_flush(batch->vertbuffer);
+}
+
+static void sprite_batch_draw_runs(gs_sprite_batch_t *batch,
+		gs_eparam_t *image)
+{
+	size_t start = 0;
+
+	while (start < batch->ordered.num) {
+		gs_texture_t *tex = batch->ordered.array[start].tex;
+		size_t end = start + 1;
+
+		while (end < batch->ordered.num &&
+		       batch->ordered.array[end].tex == tex)
+			end++;
+
+		gs_effect_set_texture(image, tex);
+		gs_draw(GS_TRIS, (uint32_t)(start * VERTS_PER_SPRITE),
+				(uint32_t)((end - start) * VERTS_PER_SPRITE));
+
+		start = end;
+	}
+}
+
+void gs_sprite_batch_draw(gs_sprite_batch_t *batch, gs_effect_t *effect,
+		const char *technique)
+{
+	gs_eparam_t *image;
+
+	if (!batch || !batch->sprites.num)
+		return;
+
+	if (!sprite_batch_reserve(batch, batch->sprites.num)) {
+		blog(LOG_ERROR, "gs_sprite_batch_draw: failed to create "
+		                "vertex buffer");
+		gs_sprite_batch_clear(batch);
+		return;
+	}
+
+	sprite_batch_order(batch);
+	sprite_batch_build(batch);
+
+	image = gs_effect_get_param_by_name(effect, "image");
+
+	gs_load_vertexbuffer(batch->vertbuffer);
+	gs_load_indexbuffer(NULL);
+
+	/* sprites were already transformed when they were added */
+	gs_matrix_push();
+	gs_matrix_identity();
+
+	while (gs_effect_loop(effect, technique))
+		sprite_batch_draw_runs(batch, image);
+
+	gs_matrix_pop();
+
+	gs_sprite_batch_clear(batch);
+}
@@ -0,0 +1,331 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include <string.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+/*
+ *   SSE kernels for the per-sample loops of audio filters.  Everything works
+ * on planar float buffers of any length; the samples left over after the
+ * last full vector are finished with a scalar loop.  The exception is
+ * audio_dsp_compressor_gain, whose log/exp approximations have no scalar
+ * equivalent: it runs the last (frames % 4) samples through the same vector
+ * code on a padded copy, so that a sample gives the same result no matter
+ * where it falls in a packet.
+ *
+ *   The log/exp functions are approximations (about 1e-4 dB worst case for
+ * mul_to_db_ps/db_to_mul_ps over the range audio gain computations use), not
+ * replacements for mul_to_db/db_to_mul in audio-math.h.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_DSP_LOG2_10_DIV_20  0.16609640474f /* log2(10) / 20 */
+#define AUDIO_DSP_20_DIV_LOG2_10  6.02059991328f /* 20 / log2(10) */
+
+/** Approximate log2 of x (x > 0) from its exponent and a mantissa polynomial */
+static inline __m128 log2_ps(__m128 x)
+{
+	const __m128i exp_mask = _mm_set1_epi32(0x7F800000);
+	const __m128i man_mask = _mm_set1_epi32(0x007FFFFF);
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128i xi = _mm_castps_si128(x);
+	__m128 e, m, p;
+
+	e = _mm_cvtepi32_ps(_mm_sub_epi32(
+			_mm_srli_epi32(_mm_and_si128(xi, exp_mask), 23),
+			_mm_set1_epi32(127)));
+	m = _mm_or_ps(_mm_castsi128_ps(_mm_and_si128(xi, man_mask)), one);
+
+	/* minimax fit of log2(m) / (m - 1) on [1, 2) */
+	p = _mm_set1_ps(-3.4436006e-2f);
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(3.1821337e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-1.2315303f));
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(2.5988452f));
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-3.3241990f));
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(3.1157899f));
+
+	return _mm_add_ps(_mm_mul_ps(p, _mm_sub_ps(m, one)), e);
+}
+
+/** Approximate 2^x, clamped to the range of normal floats */
+static inline __m128 exp2_ps(__m128 x)
+{
+	__m128i ipart;
+	__m128 fpart, expipart, p;
+
+	x = _mm_min_ps(x, _mm_set1_ps(127.99999f));
+	x = _mm_max_ps(x, _mm_set1_ps(-126.99999f));
+
+	/* round to nearest of (x - 0.5) is floor(x) */
+	ipart = _mm_cvtps_epi32(_mm_sub_ps(x, _mm_set1_ps(0.5f)));
+	fpart = _mm_sub_ps(x, _mm_cvtepi32_ps(ipart));
+	expipart = _mm_castsi128_ps(_mm_slli_epi32(
+			_mm_add_epi32(ipart, _mm_set1_epi32(127)), 23));
+
+	/* minimax fit of 2^f on [0, 1) */
+	p = _mm_set1_ps(1.8775767e-3f);
+	p = _mm_add_ps(_mm_mul_ps(p, fpart), _mm_set1_ps(8.9893397e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, fpart), _mm_set1_ps(5.5826318e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, fpart), _mm_set1_ps(2.4015361e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, fpart), _mm_set1_ps(6.9315308e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, fpart), _mm_set1_ps(9.9999994e-1f));
+
+	return _mm_mul_ps(expipart, p);
+}
+
+/** Approximate mul_to_db; zero and denormals map to about -759 dB */
+static inline __m128 mul_to_db_ps(__m128 mul)
+{
+	mul = _mm_max_ps(mul, _mm_set1_ps(1.17549435e-38f));
+	return _mm_mul_ps(log2_ps(mul), _mm_set1_ps(AUDIO_DSP_20_DIV_LOG2_10));
+}
+
+/** Approximate db_to_mul; anything below about -764 dB maps to ~0 */
+static inline __m128 db_to_mul_ps(__m128 db)
+{
+	return exp2_ps(_mm_mul_ps(db, _mm_set1_ps(AUDIO_DSP_LOG2_10_DIV_20)));
+}
+
+/* ------------------------------------------------------------------------- */
+
+/** data[i] *= mul */
+static inline void audio_dsp_scale(float *data, size_t frames, float mul)
+{
+	const __m128 m = _mm_set1_ps(mul);
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4)
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), m));
+	for (; i < frames; i++)
+		data[i] *= mul;
+}
+
+/** data[i] *= mul[i] */
+static inline void audio_dsp_mul(float *data, const float *mul, size_t frames)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4)
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i),
+					_mm_loadu_ps(mul + i)));
+	for (; i < frames; i++)
+		data[i] *= mul[i];
+}
+
+/** dst[i] = max(dst[i], |src[i]|) */
+static inline void audio_dsp_abs_max(float *dst, const float *src,
+		size_t frames)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 v = _mm_and_ps(_mm_loadu_ps(src + i), abs_mask);
+		_mm_storeu_ps(dst + i, _mm_max_ps(_mm_loadu_ps(dst + i), v));
+	}
+	for (; i < frames; i++) {
+		float v = src[i] < 0.0f ? -src[i] : src[i];
+		if (v > dst[i])
+			dst[i] = v;
+	}
+}
+
+/**
+ * Peak envelope follower.  Every channel starts at env and follows its own
+ * |sample| with the attack or release coefficient; env_buf receives the
+ * largest of the channel envelopes for each frame.  Null channels are
+ * skipped.
+ *
+ * The follower is a recurrence over time, so the vectors run across channels
+ * instead: 4x4 blocks of samples are transposed, stepped, and transposed
+ * back.  The results are the same as the scalar loop.
+ */
+static inline void audio_dsp_envelope(float *env_buf, const float **data,
+		size_t channels, size_t frames, float env, float attack_gain,
+		float release_gain)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 atk = _mm_set1_ps(attack_gain);
+	const __m128 rls = _mm_set1_ps(release_gain);
+
+	memset(env_buf, 0, frames * sizeof(float));
+
+	for (size_t c = 0; c < channels; c += 4) {
+		const float *src[4] = {NULL, NULL, NULL, NULL};
+		const float *first = NULL;
+		float lane_env[4];
+		__m128 e = _mm_set1_ps(env);
+		size_t i = 0;
+
+		for (size_t l = 0; l < 4 && c + l < channels; l++) {
+			src[l] = data[c + l];
+			if (!first)
+				first = src[l];
+		}
+		if (!first)
+			continue;
+
+		/* unused lanes repeat a channel so they don't change the max */
+		for (size_t l = 0; l < 4; l++) {
+			if (!src[l])
+				src[l] = first;
+		}
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 r0 = _mm_loadu_ps(src[0] + i);
+			__m128 r1 = _mm_loadu_ps(src[1] + i);
+			__m128 r2 = _mm_loadu_ps(src[2] + i);
+			__m128 r3 = _mm_loadu_ps(src[3] + i);
+
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+#define envelope_step(r) \
+	do { \
+		__m128 in = _mm_and_ps(r, abs_mask); \
+		__m128 mask = _mm_cmplt_ps(e, in); \
+		__m128 g = _mm_or_ps(_mm_and_ps(mask, atk), \
+				_mm_andnot_ps(mask, rls)); \
+		e = _mm_add_ps(in, _mm_mul_ps(g, _mm_sub_ps(e, in))); \
+		r = e; \
+	} while (false)
+
+			envelope_step(r0);
+			envelope_step(r1);
+			envelope_step(r2);
+			envelope_step(r3);
+
+#undef envelope_step
+
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			r0 = _mm_max_ps(_mm_max_ps(r0, r1), _mm_max_ps(r2, r3));
+			_mm_storeu_ps(env_buf + i,
+					_mm_max_ps(_mm_loadu_ps(env_buf + i), r0));
+		}
+
+		_mm_storeu_ps(lane_env, e);
+
+		for (; i < frames; i++) {
+			for (size_t l = 0; l < 4; l++) {
+				float in = src[l][i] < 0.0f ? -src[l][i] :
+					src[l][i];
+				float g = lane_env[l] < in ?
+					attack_gain : release_gain;
+
+				lane_env[l] = in + g * (lane_env[l] - in);
+				if (lane_env[l] > env_buf[i])
+					env_buf[i] = lane_env[l];
+			}
+		}
+	}
+}
+
+/**
+ * Turns an envelope into a compressor gain, in place:
+ *
+ *   buf[i] = db_to_mul(min(0, slope * (threshold - mul_to_db(buf[i])))) * out
+ */
+static inline void audio_dsp_compressor_gain(float *buf, size_t frames,
+		float slope, float threshold_db, float output_gain)
+{
+	const __m128 s = _mm_set1_ps(slope);
+	const __m128 t = _mm_set1_ps(threshold_db);
+	const __m128 o = _mm_set1_ps(output_gain);
+	const __m128 zero = _mm_setzero_ps();
+	size_t i = 0;
+
+#define compressor_gain_ps(env) \
+	_mm_mul_ps(db_to_mul_ps(_mm_min_ps(zero, \
+			_mm_mul_ps(s, _mm_sub_ps(t, mul_to_db_ps(env))))), o)
+
+	for (; i + 4 <= frames; i += 4)
+		_mm_storeu_ps(buf + i, compressor_gain_ps(_mm_loadu_ps(buf + i)));
+
+	if (i < frames) {
+		float tail[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		size_t left = frames - i;
+
+		memcpy(tail, buf + i, left * sizeof(float));
+		_mm_storeu_ps(tail, compressor_gain_ps(_mm_loadu_ps(tail)));
+		memcpy(buf + i, tail, left * sizeof(float));
+	}
+
+#undef compressor_gain_ps
+}
+
+/**
+ * dst[i] = (int16_t)(src[i] * mul), truncated like a C cast but clamped
+ * instead of wrapping when the result is out of range
+ */
+static inline void audio_dsp_float_to_s16(int16_t *dst, const float *src,
+		size_t frames, float mul)
+{
+	const __m128 m = _mm_set1_ps(mul);
+	const __m128 max = _mm_set1_ps(32767.0f);
+	const __m128 min = _mm_set1_ps(-32768.0f);
+	size_t i = 0;
+
+#define scale_clamp_ps(v) \
+	_mm_cvttps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(v, m), max), min))
+
+	for (; i + 8 <= frames; i += 8) {
+		__m128i lo = scale_clamp_ps(_mm_loadu_ps(src + i));
+		__m128i hi = scale_clamp_ps(_mm_loadu_ps(src + i + 4));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+	}
+
+#undef scale_clamp_ps
+
+	for (; i < frames; i++) {
+		float v = src[i] * mul;
+		if (v >= 32767.0f)
+			dst[i] = INT16_MAX;
+		else if (v <= -32768.0f)
+			dst[i] = INT16_MIN;
+		else
+			dst[i] = (int16_t)v;
+	}
+}
+
+/** dst[i] = (float)src[i] * mul */
+static inline void audio_dsp_s16_to_float(float *dst, const int16_t *src,
+		size_t frames, float mul)
+{
+	const __m128 m = _mm_set1_ps(mul);
+	size_t i = 0;
+
+	for (; i + 8 <= frames; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(dst + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), m));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), m));
+	}
+	for (; i < frames; i++)
+		dst[i] = (float)src[i] * mul;
+}
+
+#ifdef __cplusplus
+}
+#endif
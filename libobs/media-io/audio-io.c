@@ -66,6 +66,16 @@ struct audio_output {
 	void                       *input_param;
 	pthread_mutex_t            input_mutex;
 	struct audio_mix           mixes[MAX_AUDIO_MIXES];
+
+	pthread_mutex_t            stats_mutex;
+	uint64_t                   total_ticks;
+	uint64_t                   total_wakeups;
+	uint64_t                   late_ticks;
+	uint64_t                   total_latency;
+	uint64_t                   max_latency;
+	uint64_t                   total_jitter;
+	uint64_t                   max_jitter;
+	uint64_t                   last_latency;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -192,7 +202,8 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 static void input_and_output(struct audio_output *audio,
 		uint64_t audio_time, uint64_t prev_time)
 {
-	size_t bytes = AUDIO_OUTPUT_FRAMES * audio->block_size;
+	uint32_t frames = audio->info.frames_per_tick;
+	size_t bytes = frames * audio->block_size;
 	struct audio_output_data data[MAX_AUDIO_MIXES];
 	uint32_t active_mixes = 0;
 	uint64_t new_ts = 0;
@@ -235,20 +246,45 @@ static void input_and_output(struct audio_output *audio,
 
 	/* output */
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+		do_audio_output(audio, i, new_ts, frames);
+}
+
+static void update_tick_stats(struct audio_output *audio, uint64_t latency,
+		uint64_t ticks)
+{
+	uint64_t jitter;
+
+	pthread_mutex_lock(&audio->stats_mutex);
+
+	jitter = latency > audio->last_latency ?
+		latency - audio->last_latency : audio->last_latency - latency;
+	if (!audio->total_wakeups)
+		jitter = 0;
+
+	audio->total_ticks   += ticks;
+	audio->late_ticks    += ticks > 1 ? ticks - 1 : 0;
+	audio->total_latency += latency;
+	audio->total_jitter  += jitter;
+	audio->last_latency   = latency;
+	audio->total_wakeups++;
+
+	if (latency > audio->max_latency)
+		audio->max_latency = latency;
+	if (jitter > audio->max_jitter)
+		audio->max_jitter = jitter;
+
+	pthread_mutex_unlock(&audio->stats_mutex);
 }
 
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
 	size_t rate = audio->info.samples_per_sec;
+	uint32_t frames = audio->info.frames_per_tick;
 	uint64_t samples = 0;
 	uint64_t start_time = os_gettime_ns();
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
-	uint32_t audio_wait_time =
-		(uint32_t)(audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) /
-				1000000);
 
 	os_set_thread_name("audio-io: audio thread");
 
@@ -258,21 +294,30 @@ static void *audio_thread(void *param)
 
 	while (os_event_try(audio->stop_event) == EAGAIN) {
 		uint64_t cur_time;
+		uint64_t ticks = 0;
+		uint64_t latency;
 
-		os_sleep_ms(audio_wait_time);
+		/* wake up exactly when the next tick is due rather than
+		 * sleeping in whole milliseconds */
+		os_sleepto_ns(audio_time);
 
 		profile_start(audio_thread_name);
 
 		cur_time = os_gettime_ns();
+		latency = cur_time > audio_time ? cur_time - audio_time : 0;
+
 		while (audio_time <= cur_time) {
-			samples += AUDIO_OUTPUT_FRAMES;
+			samples += frames;
 			audio_time = start_time +
 				audio_frames_to_ns(rate, samples);
 
 			input_and_output(audio, audio_time, prev_time);
 			prev_time = audio_time;
+			ticks++;
 		}
 
+		update_tick_stats(audio, latency, ticks);
+
 		profile_end(audio_thread_name);
 
 		profile_reenable_thread();
@@ -392,7 +437,10 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 static inline bool valid_audio_params(const struct audio_output_info *info)
 {
 	return info->format && info->name && info->samples_per_sec > 0 &&
-	       info->speakers > 0;
+	       info->speakers > 0 &&
+	       (!info->frames_per_tick ||
+	        (info->frames_per_tick >= AUDIO_OUTPUT_MIN_FRAMES &&
+	         info->frames_per_tick <= AUDIO_OUTPUT_FRAMES));
 }
 
 int audio_output_open(audio_t **audio, struct audio_output_info *info)
@@ -409,6 +457,9 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail;
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
+	if (!out->info.frames_per_tick)
+		out->info.frames_per_tick = AUDIO_OUTPUT_FRAMES;
+	pthread_mutex_init_value(&out->stats_mutex);
 	out->channels   = get_audio_channels(info->speakers);
 	out->planes     = planar ? out->channels : 1;
 	out->input_cb   = info->input_callback;
@@ -422,6 +473,8 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&out->stats_mutex, NULL) != 0)
+		goto fail;
 	if (os_event_init(&out->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
 	if (pthread_create(&out->thread, NULL, audio_thread, out) != 0)
@@ -444,8 +497,21 @@ void audio_output_close(audio_t *audio)
 		return;
 
 	if (audio->initialized) {
+		struct audio_output_stats stats;
+
 		os_event_signal(audio->stop_event);
 		pthread_join(audio->thread, &thread_ret);
+
+		audio_output_get_stats(audio, &stats);
+		blog(LOG_INFO, "audio thread (%s): %"PRIu64" ticks of %"PRIu32
+				" frames, %"PRIu64" late, latency avg %g ms "
+				"max %g ms, jitter avg %g ms max %g ms",
+				audio->info.name, stats.ticks,
+				audio->info.frames_per_tick, stats.late_ticks,
+				(double)stats.avg_latency_ns / 1000000.0,
+				(double)stats.max_latency_ns / 1000000.0,
+				(double)stats.avg_jitter_ns / 1000000.0,
+				(double)stats.max_jitter_ns / 1000000.0);
 	}
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
@@ -458,6 +524,7 @@ void audio_output_close(audio_t *audio)
 	}
 
 	os_event_destroy(audio->stop_event);
+	pthread_mutex_destroy(&audio->stats_mutex);
 	bfree(audio);
 }
 
@@ -499,3 +566,32 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 {
 	return audio ? audio->info.samples_per_sec : 0;
 }
+
+uint32_t audio_output_get_frames_per_tick(const audio_t *audio)
+{
+	return audio ? audio->info.frames_per_tick : 0;
+}
+
+void audio_output_get_stats(const audio_t *audio,
+		struct audio_output_stats *stats)
+{
+	struct audio_output *out = (struct audio_output*)audio;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!audio)
+		return;
+
+	pthread_mutex_lock(&out->stats_mutex);
+
+	stats->ticks          = out->total_ticks;
+	stats->late_ticks     = out->late_ticks;
+	stats->max_latency_ns = out->max_latency;
+	stats->max_jitter_ns  = out->max_jitter;
+
+	if (out->total_wakeups) {
+		stats->avg_latency_ns = out->total_latency / out->total_wakeups;
+		stats->avg_jitter_ns  = out->total_jitter  / out->total_wakeups;
+	}
+
+	pthread_mutex_unlock(&out->stats_mutex);
+}
@@ -27,7 +27,11 @@ extern "C" {
 
 #define MAX_AUDIO_MIXES     6
 #define MAX_AUDIO_CHANNELS  2
+
+/* maximum (and default) number of frames processed per audio tick */
 #define AUDIO_OUTPUT_FRAMES 1024
+/* minimum number of frames processed per audio tick */
+#define AUDIO_OUTPUT_MIN_FRAMES 128
 
 /*
  * Base audio output component.  Use this to create an audio output track
@@ -88,6 +92,23 @@ struct audio_output_info {
 
 	audio_input_callback_t input_callback;
 	void                   *input_param;
+
+	/* frames per audio tick (AUDIO_OUTPUT_MIN_FRAMES to
+	 * AUDIO_OUTPUT_FRAMES), 0 for AUDIO_OUTPUT_FRAMES */
+	uint32_t            frames_per_tick;
+};
+
+struct audio_output_stats {
+	uint64_t            ticks;
+	/* ticks that had to be caught up on because the thread woke up more
+	 * than a tick late */
+	uint64_t            late_ticks;
+	/* how late the thread woke up relative to the tick deadline */
+	uint64_t            avg_latency_ns;
+	uint64_t            max_latency_ns;
+	/* change of the wake up latency from one wake up to the next */
+	uint64_t            avg_jitter_ns;
+	uint64_t            max_jitter_ns;
 };
 
 struct audio_convert_info {
@@ -217,6 +238,9 @@ EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
+EXPORT uint32_t audio_output_get_frames_per_tick(const audio_t *audio);
+EXPORT void audio_output_get_stats(const audio_t *audio,
+		struct audio_output_stats *stats);
 EXPORT const struct audio_output_info *audio_output_get_info(
 		const audio_t *audio);
 
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include <assert.h>
+#include <inttypes.h>
 #include "../util/bmem.h"
 #include "../util/platform.h"
 #include "../util/profiler.h"
@@ -42,6 +43,7 @@ struct video_input {
 	video_scaler_t            *scaler;
 	struct video_frame        frame[MAX_CONVERT_BUFFERS];
 	int                       cur_frame;
+	bool                      scaled;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
@@ -65,6 +67,8 @@ struct video_output {
 	uint64_t                   frame_time;
 	uint32_t                   skipped_frames;
 	uint32_t                   total_frames;
+	uint32_t                   scaled_frames;
+	uint32_t                   shared_frames;
 
 	bool                       initialized;
 
@@ -110,6 +114,68 @@ static inline bool scale_video_output(struct video_input *input,
 	return success;
 }
 
+static inline bool same_conversion(const struct video_scale_info *a,
+		const struct video_scale_info *b)
+{
+	return a->format     == b->format &&
+	       a->width      == b->width  &&
+	       a->height     == b->height &&
+	       a->range      == b->range  &&
+	       a->colorspace == b->colorspace;
+}
+
+/* finds an input earlier in the list that has already scaled the current
+ * frame with the same conversion, so its output can be reused */
+static inline struct video_input *find_scaled_input(
+		struct video_output *video, size_t idx)
+{
+	struct video_input *input = video->inputs.array+idx;
+
+	for (size_t i = 0; i < idx; i++) {
+		struct video_input *other = video->inputs.array+i;
+
+		if (other->scaled &&
+		    same_conversion(&other->conversion, &input->conversion))
+			return other;
+	}
+
+	return NULL;
+}
+
+static inline bool convert_input_frame(struct video_output *video,
+		size_t idx, struct video_data *data)
+{
+	struct video_input *input = video->inputs.array+idx;
+	struct video_input *shared;
+	bool success;
+
+	input->scaled = false;
+
+	if (!input->scaler)
+		return true;
+
+	shared = find_scaled_input(video, idx);
+	if (shared) {
+		struct video_frame *frame = &shared->frame[shared->cur_frame];
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			data->data[i]     = frame->data[i];
+			data->linesize[i] = frame->linesize[i];
+		}
+
+		video->shared_frames++;
+		return true;
+	}
+
+	success = scale_video_output(input, data);
+	if (success) {
+		input->scaled = true;
+		video->scaled_frames++;
+	}
+
+	return success;
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
@@ -131,7 +197,7 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		struct video_input *input = video->inputs.array+i;
 		struct video_data frame = frame_info->frame;
 
-		if (scale_video_output(input, &frame))
+		if (convert_input_frame(video, i, &frame))
 			input->callback(input->param, &frame);
 	}
 
@@ -259,6 +325,13 @@ void video_output_close(video_t *video)
 
 	video_output_stop(video);
 
+	if (video->shared_frames)
+		blog(LOG_INFO, "video-io (%s): %"PRIu32" frame conversions "
+				"performed, %"PRIu32" shared between inputs "
+				"with identical conversions",
+				video->info.name, video->scaled_frames,
+				video->shared_frames);
+
 	for (size_t i = 0; i < video->inputs.num; i++)
 		video_input_free(&video->inputs.array[i]);
 	da_free(video->inputs);
@@ -495,6 +568,16 @@ uint32_t video_output_get_skipped_frames(const video_t *video)
 	return video->skipped_frames;
 }
 
+uint32_t video_output_get_scaled_frames(const video_t *video)
+{
+	return video ? video->scaled_frames : 0;
+}
+
+uint32_t video_output_get_shared_frames(const video_t *video)
+{
+	return video ? video->shared_frames : 0;
+}
+
 uint32_t video_output_get_total_frames(const video_t *video)
 {
 	return video->total_frames;
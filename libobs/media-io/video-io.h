@@ -180,6 +180,15 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/** Returns the number of frames converted by the scaler for inputs */
+EXPORT uint32_t video_output_get_scaled_frames(const video_t *video);
+
+/**
+ * Returns the number of frame conversions that were skipped because another
+ * input had already converted the frame with identical parameters
+ */
+EXPORT uint32_t video_output_get_shared_frames(const video_t *video);
+
 
 #ifdef __cplusplus
 }
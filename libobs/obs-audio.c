@@ -24,7 +24,14 @@ struct ts_info {
 };
 
 #define DEBUG_AUDIO 0
-#define MAX_BUFFERING_TICKS 45
+
+/* maximum amount of audio buffering (about 1 second at 48khz) */
+#define MAX_BUFFERING_FRAMES (45 * AUDIO_OUTPUT_FRAMES)
+
+static inline int max_buffering_ticks(const struct obs_core_audio *audio)
+{
+	return (int)(MAX_BUFFERING_FRAMES / audio->frames_per_tick);
+}
 
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
@@ -47,7 +54,8 @@ static inline void mix_audio(struct audio_output_data *mixes,
 		obs_source_t *source, size_t channels, size_t sample_rate,
 		struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t frames = obs->audio.frames_per_tick;
+	size_t total_floats = frames;
 	size_t start_point = 0;
 
 	if (source->audio_ts < ts->start || ts->end <= source->audio_ts)
@@ -56,7 +64,7 @@ static inline void mix_audio(struct audio_output_data *mixes,
 	if (source->audio_ts != ts->start) {
 		start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES)
+		if (start_point == frames)
 			return;
 
 		total_floats -= start_point;
@@ -125,13 +133,12 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 	}
 }
 
-#define MAX_AUDIO_SIZE (AUDIO_OUTPUT_FRAMES * sizeof(float))
-
 static inline void discard_audio(struct obs_core_audio *audio,
 		obs_source_t *source, size_t channels, size_t sample_rate,
 		struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t frames = audio->frames_per_tick;
+	size_t total_floats = frames;
 	size_t size;
 
 #if DEBUG_AUDIO == 1
@@ -155,7 +162,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 
 	if (source->audio_ts < (ts->start - 1)) {
 		if (source->audio_pending &&
-		    source->audio_input_buf[0].size < MAX_AUDIO_SIZE &&
+		    source->audio_input_buf[0].size < frames * sizeof(float) &&
 		    discard_if_stopped(source, channels))
 			return;
 
@@ -167,7 +174,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 					source->audio_ts, ts->start);
 		}
 #endif
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
+		if (audio->total_buffering_ticks == max_buffering_ticks(audio))
 			ignore_audio(source, channels, sample_rate);
 		return;
 	}
@@ -176,7 +183,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	    source->audio_ts != (ts->start - 1)) {
 		size_t start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES) {
+		if (start_point == frames) {
 #if DEBUG_AUDIO == 1
 			if (is_audio_source)
 				blog(LOG_DEBUG, "can't dicard, start point is "
@@ -221,11 +228,13 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	struct ts_info new_ts;
 	uint64_t offset;
 	uint64_t frames;
+	size_t tick_frames = audio->frames_per_tick;
+	int max_ticks = max_buffering_ticks(audio);
 	size_t total_ms;
 	size_t ms;
 	int ticks;
 
-	if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
+	if (audio->total_buffering_ticks == max_ticks)
 		return;
 
 	if (!audio->buffering_wait_ticks)
@@ -233,18 +242,18 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 
 	offset = ts->start - min_ts;
 	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+	ticks = (int)((frames + tick_frames - 1) / tick_frames);
 
 	audio->total_buffering_ticks += ticks;
 
-	if (audio->total_buffering_ticks >= MAX_BUFFERING_TICKS) {
-		ticks -= audio->total_buffering_ticks - MAX_BUFFERING_TICKS;
-		audio->total_buffering_ticks = MAX_BUFFERING_TICKS;
+	if (audio->total_buffering_ticks >= max_ticks) {
+		ticks -= audio->total_buffering_ticks - max_ticks;
+		audio->total_buffering_ticks = max_ticks;
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+	ms = ticks * tick_frames * 1000 / sample_rate;
+	total_ms = audio->total_buffering_ticks * tick_frames * 1000 /
 		sample_rate;
 
 	blog(LOG_INFO, "adding %d milliseconds of audio buffering, total "
@@ -258,7 +267,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 #endif
 
 	new_ts.start = audio->buffered_ts - audio_frames_to_ns(sample_rate,
-			audio->buffering_wait_ticks * AUDIO_OUTPUT_FRAMES);
+			audio->buffering_wait_ticks * tick_frames);
 
 	while (ticks--) {
 		int cur_ticks = ++audio->buffering_wait_ticks;
@@ -266,7 +275,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		new_ts.end = new_ts.start;
 		new_ts.start = audio->buffered_ts - audio_frames_to_ns(
 				sample_rate,
-				cur_ticks * AUDIO_OUTPUT_FRAMES);
+				cur_ticks * tick_frames);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %"PRIu64"-%"PRIu64,
@@ -283,7 +292,8 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 static bool audio_buffer_insuffient(struct obs_source *source,
 		size_t sample_rate, uint64_t min_ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t frames = obs->audio.frames_per_tick;
+	size_t total_floats = frames;
 	size_t size;
 
 	if (source->info.audio_render || source->audio_pending ||
@@ -295,7 +305,7 @@ static bool audio_buffer_insuffient(struct obs_source *source,
 	    source->audio_ts != (min_ts - 1)) {
 		size_t start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - min_ts);
-		if (start_point >= AUDIO_OUTPUT_FRAMES)
+		if (start_point >= frames)
 			return false;
 
 		total_floats -= start_point;
@@ -373,7 +383,7 @@ bool audio_callback(void *param,
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+	audio_size = audio->frames_per_tick * sizeof(float);
 
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
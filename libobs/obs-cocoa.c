@@ -1340,3 +1340,14 @@ bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *plat,
 
 	return false;
 }
+
+bool obs_hotkeys_platform_wait_events(obs_hotkeys_platform_t *plat,
+		uint32_t timeout_ms,
+		void (*changed)(void *param, obs_key_t key), void *param)
+{
+	UNUSED_PARAMETER(plat);
+	UNUSED_PARAMETER(timeout_ms);
+	UNUSED_PARAMETER(changed);
+	UNUSED_PARAMETER(param);
+	return false;
+}
@@ -15,6 +15,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
+
 #include "obs.h"
 #include "obs-internal.h"
 
@@ -49,6 +51,7 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->init_mutex);
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
+	pthread_mutex_init_value(&encoder->audio_stats_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -63,6 +66,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->outputs_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->audio_stats_mutex, NULL) != 0)
+		return false;
 
 	if (encoder->info.get_defaults)
 		encoder->info.get_defaults(encoder->context.settings);
@@ -130,6 +135,10 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 
 static void receive_video(void *param, struct video_data *frame);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static bool start_audio_worker(struct obs_encoder *encoder);
+static void stop_audio_worker(struct obs_encoder *encoder,
+		struct audio_encode_worker *worker, bool self);
+static bool on_audio_worker(const struct obs_encoder *encoder);
 
 static inline void get_audio_info(const struct obs_encoder *encoder,
 		struct audio_convert_info *info)
@@ -183,6 +192,9 @@ static void add_connection(struct obs_encoder *encoder)
 		struct audio_convert_info audio_info = {0};
 		get_audio_info(encoder, &audio_info);
 
+		if (!start_audio_worker(encoder))
+			return;
+
 		audio_output_connect(encoder->media, encoder->mixer_idx,
 				&audio_info, receive_audio, encoder);
 	} else {
@@ -198,12 +210,26 @@ static void add_connection(struct obs_encoder *encoder)
 
 static void remove_connection(struct obs_encoder *encoder)
 {
-	if (encoder->info.type == OBS_ENCODER_AUDIO)
+	if (encoder->info.type == OBS_ENCODER_AUDIO) {
+		struct audio_encode_worker *worker = encoder->audio_worker;
+		bool self = on_audio_worker(encoder);
+
+		/* when an encode error stops the encoder from its own worker,
+		 * the audio thread must stop waiting on the queue before it
+		 * can be disconnected */
+		if (self)
+			stop_audio_worker(encoder, worker, true);
+
 		audio_output_disconnect(encoder->media, encoder->mixer_idx,
 				receive_audio, encoder);
-	else
+
+		if (!self)
+			stop_audio_worker(encoder, worker, false);
+		encoder->audio_worker = NULL;
+	} else {
 		video_output_disconnect(encoder->media, receive_video,
 				encoder);
+	}
 
 	obs_encoder_shutdown(encoder);
 	set_encoder_active(encoder, false);
@@ -239,6 +265,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->init_mutex);
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
+		pthread_mutex_destroy(&encoder->audio_stats_mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void*)encoder->info.id);
@@ -990,12 +1017,64 @@ static void send_audio_data(struct obs_encoder *encoder)
 	encoder->cur_pts += encoder->framesize;
 }
 
-static const char *receive_audio_name = "receive_audio";
-static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
+/* ------------------------------------------------------------------------- */
+/* Audio encode worker                                                       */
+
+/*
+ * Each audio encoder encodes on its own thread so that one slow track does
+ * not hold up the audio thread (and thus every other track).  The audio
+ * thread copies each tick into a fixed ring of slots; there is exactly one
+ * producer and one consumer, so the ring only needs the two indices.  If the
+ * encoder falls a whole ring behind, the audio thread waits for it, exactly
+ * as it would have when encoding synchronously.
+ */
+
+#define AUDIO_QUEUE_SIZE 8
+
+struct audio_queue_slot {
+	uint8_t                    *data[MAX_AV_PLANES];
+	size_t                     capacity;
+	uint32_t                   frames;
+	uint64_t                   timestamp;
+	uint64_t                   queued_ns;
+};
+
+struct audio_encode_worker {
+	struct obs_encoder         *encoder;
+	pthread_t                  thread;
+	os_sem_t                   *sem;
+
+	volatile long              write_idx;
+	volatile long              read_idx;
+	struct audio_queue_slot    slots[AUDIO_QUEUE_SIZE];
+
+	volatile bool              stop;
+	bool                       detached;
+
+	uint64_t                   encode_ns_total;
+	uint64_t                   lag_ns_total;
+
+	obs_stat_t                 *queue_depth_stat;
+	obs_stat_t                 *encode_time_stat;
+};
+
+static void audio_worker_destroy(struct audio_encode_worker *worker)
 {
-	profile_start(receive_audio_name);
+	obs_stat_destroy(worker->queue_depth_stat);
+	obs_stat_destroy(worker->encode_time_stat);
 
-	struct obs_encoder *encoder = param;
+	for (size_t i = 0; i < AUDIO_QUEUE_SIZE; i++)
+		for (size_t j = 0; j < MAX_AV_PLANES; j++)
+			bfree(worker->slots[i].data[j]);
+
+	os_sem_destroy(worker->sem);
+	bfree(worker);
+}
+
+static void encode_audio(struct audio_encode_worker *worker,
+		struct audio_data *data)
+{
+	struct obs_encoder *encoder = worker->encoder;
 
 	if (!encoder->first_received) {
 		encoder->first_raw_ts = data->timestamp;
@@ -1004,10 +1083,249 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
 	}
 
 	if (!buffer_audio(encoder, data))
-		goto end;
+		return;
 
-	while (encoder->audio_input_buffer[0].size >= encoder->framesize_bytes)
+	/* an encode error stops the encoder from within send_audio_data */
+	while (!worker->detached &&
+	       encoder->audio_input_buffer[0].size >= encoder->framesize_bytes)
 		send_audio_data(encoder);
+}
+
+static void update_audio_stats(struct audio_encode_worker *worker,
+		uint64_t encode_ns, uint64_t lag_ns)
+{
+	struct obs_encoder_audio_stats *stats = &worker->encoder->audio_stats;
+
+	worker->encode_ns_total += encode_ns;
+	worker->lag_ns_total    += lag_ns;
+
+	obs_stat_observe(worker->encode_time_stat,
+			(double)encode_ns / 1000000.0);
+
+	pthread_mutex_lock(&worker->encoder->audio_stats_mutex);
+	stats->frames_encoded++;
+	stats->avg_encode_ns    = worker->encode_ns_total / stats->frames_encoded;
+	stats->avg_queue_lag_ns = worker->lag_ns_total / stats->frames_encoded;
+	if (encode_ns > stats->max_encode_ns)
+		stats->max_encode_ns = encode_ns;
+	if (lag_ns > stats->max_queue_lag_ns)
+		stats->max_queue_lag_ns = lag_ns;
+	pthread_mutex_unlock(&worker->encoder->audio_stats_mutex);
+}
+
+static void process_audio_queue(struct audio_encode_worker *worker)
+{
+	long idx = os_atomic_load_long(&worker->read_idx);
+
+	while (!worker->detached &&
+	       idx != os_atomic_load_long(&worker->write_idx)) {
+		struct audio_queue_slot *slot =
+			&worker->slots[idx % AUDIO_QUEUE_SIZE];
+		struct audio_data data = {0};
+		uint64_t start_ns = os_gettime_ns();
+
+		for (size_t i = 0; i < worker->encoder->planes; i++)
+			data.data[i] = slot->data[i];
+		data.frames    = slot->frames;
+		data.timestamp = slot->timestamp;
+
+		encode_audio(worker, &data);
+
+		/* the encoder may already be gone once the worker detached */
+		if (worker->detached)
+			break;
+
+		update_audio_stats(worker, os_gettime_ns() - start_ns,
+				start_ns - slot->queued_ns);
+
+		os_atomic_set_long(&worker->read_idx, ++idx);
+	}
+}
+
+static void log_audio_stats(struct obs_encoder *encoder)
+{
+	struct obs_encoder_audio_stats *stats = &encoder->audio_stats;
+
+	if (!stats->frames_encoded)
+		return;
+
+	blog(LOG_INFO, "audio encoder '%s' (track %d): %"PRIu64" ticks, "
+			"encode avg %.3f ms / max %.3f ms, "
+			"queue lag avg %.3f ms / max %.3f ms, "
+			"%"PRIu64" queue stalls",
+			encoder->context.name, (int)encoder->mixer_idx + 1,
+			stats->frames_encoded,
+			(double)stats->avg_encode_ns / 1000000.0,
+			(double)stats->max_encode_ns / 1000000.0,
+			(double)stats->avg_queue_lag_ns / 1000000.0,
+			(double)stats->max_queue_lag_ns / 1000000.0,
+			stats->queue_stalls);
+}
+
+static void *audio_worker_thread(void *param)
+{
+	struct audio_encode_worker *worker = param;
+
+	os_set_thread_name("obs-encoder: audio worker");
+
+	const char *worker_name =
+		profile_store_name(obs_get_profiler_name_store(),
+				"audio_encode_thread(%s)",
+				worker->encoder->context.name);
+
+	while (os_sem_wait(worker->sem) == 0) {
+		profile_start(worker_name);
+		process_audio_queue(worker);
+		profile_end(worker_name);
+
+		profile_reenable_thread();
+
+		if (worker->detached || os_atomic_load_bool(&worker->stop))
+			break;
+	}
+
+	/* stopped by an encode error from this thread; nobody joins us, and
+	 * the encoder must not be touched anymore */
+	if (worker->detached)
+		audio_worker_destroy(worker);
+
+	return NULL;
+}
+
+static double get_queue_depth(void *param)
+{
+	struct audio_encode_worker *worker = param;
+	return (double)(os_atomic_load_long(&worker->write_idx) -
+			os_atomic_load_long(&worker->read_idx));
+}
+
+static void create_audio_worker_stats(struct audio_encode_worker *worker)
+{
+	char *labels = obs_stat_label("encoder", worker->encoder->context.name);
+
+	worker->queue_depth_stat = obs_stat_create_sampled(
+			"obs_encoder_audio_queue_depth", labels,
+			"Audio ticks waiting to be encoded", OBS_STAT_GAUGE,
+			get_queue_depth, worker);
+	worker->encode_time_stat = obs_stat_create(
+			"obs_encoder_audio_encode_time_ms", labels,
+			"Time taken to encode an audio tick",
+			OBS_STAT_HISTOGRAM);
+
+	bfree(labels);
+}
+
+static bool start_audio_worker(struct obs_encoder *encoder)
+{
+	struct audio_encode_worker *worker;
+
+	worker = bzalloc(sizeof(struct audio_encode_worker));
+	worker->encoder = encoder;
+	create_audio_worker_stats(worker);
+
+	if (os_sem_init(&worker->sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&worker->thread, NULL, audio_worker_thread,
+				worker) != 0)
+		goto fail;
+
+	pthread_mutex_lock(&encoder->audio_stats_mutex);
+	memset(&encoder->audio_stats, 0, sizeof(encoder->audio_stats));
+	pthread_mutex_unlock(&encoder->audio_stats_mutex);
+
+	encoder->audio_worker = worker;
+	return true;
+
+fail:
+	blog(LOG_ERROR, "Failed to create audio worker for encoder '%s'",
+			encoder->context.name);
+	audio_worker_destroy(worker);
+	return false;
+}
+
+static bool on_audio_worker(const struct obs_encoder *encoder)
+{
+	return encoder->audio_worker &&
+		pthread_equal(pthread_self(), encoder->audio_worker->thread);
+}
+
+/* when called from the worker itself (self), the stats are logged while the
+ * encoder is still valid, and the worker only gets flagged and frees itself
+ * once the current encode call unwinds */
+static void stop_audio_worker(struct obs_encoder *encoder,
+		struct audio_encode_worker *worker, bool self)
+{
+	if (!worker)
+		return;
+
+	os_atomic_set_bool(&worker->stop, true);
+
+	if (self) {
+		log_audio_stats(encoder);
+		worker->detached = true;
+		pthread_detach(worker->thread);
+		return;
+	}
+
+	/* the audio thread is disconnected at this point, so waking the
+	 * worker lets it drain what is left in the queue and exit */
+	os_sem_post(worker->sem);
+	pthread_join(worker->thread, NULL);
+
+	log_audio_stats(encoder);
+	audio_worker_destroy(worker);
+}
+
+static inline void copy_to_slot(struct obs_encoder *encoder,
+		struct audio_queue_slot *slot, const struct audio_data *data)
+{
+	size_t size = data->frames * encoder->blocksize;
+
+	if (size > slot->capacity) {
+		for (size_t i = 0; i < encoder->planes; i++)
+			slot->data[i] = brealloc(slot->data[i], size);
+		slot->capacity = size;
+	}
+
+	for (size_t i = 0; i < encoder->planes; i++)
+		memcpy(slot->data[i], data->data[i], size);
+
+	slot->frames    = data->frames;
+	slot->timestamp = data->timestamp;
+	slot->queued_ns = os_gettime_ns();
+}
+
+static const char *receive_audio_name = "receive_audio";
+static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
+{
+	profile_start(receive_audio_name);
+
+	struct obs_encoder *encoder = param;
+	struct audio_encode_worker *worker = encoder->audio_worker;
+	long idx;
+
+	if (!worker)
+		goto end;
+
+	idx = os_atomic_load_long(&worker->write_idx);
+
+	if (idx - os_atomic_load_long(&worker->read_idx) >= AUDIO_QUEUE_SIZE) {
+		pthread_mutex_lock(&encoder->audio_stats_mutex);
+		encoder->audio_stats.queue_stalls++;
+		pthread_mutex_unlock(&encoder->audio_stats_mutex);
+
+		while (idx - os_atomic_load_long(&worker->read_idx) >=
+				AUDIO_QUEUE_SIZE) {
+			if (os_atomic_load_bool(&worker->stop))
+				goto end;
+			os_sleep_ms(1);
+		}
+	}
+
+	copy_to_slot(encoder, &worker->slots[idx % AUDIO_QUEUE_SIZE], data);
+
+	os_atomic_set_long(&worker->write_idx, idx + 1);
+	os_sem_post(worker->sem);
 
 	UNUSED_PARAMETER(mix_idx);
 
@@ -1015,6 +1333,22 @@ end:
 	profile_end(receive_audio_name);
 }
 
+bool obs_encoder_get_audio_stats(const obs_encoder_t *encoder,
+		struct obs_encoder_audio_stats *stats)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_audio_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_audio_stats"))
+		return false;
+	if (encoder->info.type != OBS_ENCODER_AUDIO)
+		return false;
+
+	pthread_mutex_lock((pthread_mutex_t*)&encoder->audio_stats_mutex);
+	*stats = encoder->audio_stats;
+	pthread_mutex_unlock((pthread_mutex_t*)&encoder->audio_stats_mutex);
+	return true;
+}
+
 void obs_encoder_add_output(struct obs_encoder *encoder,
 		struct obs_output *output)
 {
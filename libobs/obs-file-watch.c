@@ -0,0 +1,478 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "util/platform.h"
+#include "obs-internal.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+/*
+ * All file watches are serviced by one thread.  On linux, the parent
+ * directory of each watched file is watched with inotify (so that files
+ * replaced by a rename are still picked up), otherwise the file is polled
+ * with os_stat once per second.  Changes are only reported once no further
+ * change has been seen for COALESCE_NS, so a file being written in several
+ * chunks results in a single callback.
+ */
+
+#define COALESCE_NS      100000000ULL
+#define POLL_INTERVAL_NS 1000000000ULL
+
+struct obs_file_watch {
+	char              *path;
+	char              *dir;
+	char              *name; /* NULL if the watch is for a directory */
+
+	int               wd;
+	time_t            mtime;
+
+	bool              pending;
+	uint64_t          pending_ts;
+
+	obs_file_watch_cb callback;
+	void              *param;
+};
+
+static inline time_t get_modified_timestamp(const char *path)
+{
+	struct stat stats;
+	if (os_stat(path, &stats) != 0)
+		return -1;
+	return stats.st_mtime;
+}
+
+static void split_path(struct obs_file_watch *watch)
+{
+	os_dir_t *dir = os_opendir(watch->path);
+	const char *slash;
+
+	if (dir) {
+		os_closedir(dir);
+		watch->dir = bstrdup(watch->path);
+		return;
+	}
+
+	slash = strrchr(watch->path, '/');
+#ifdef _WIN32
+	const char *backslash = strrchr(watch->path, '\\');
+	if (backslash > slash)
+		slash = backslash;
+#endif
+
+	if (slash) {
+		watch->dir  = bstrdup_n(watch->path, slash - watch->path);
+		watch->name = bstrdup(slash + 1);
+	} else {
+		watch->dir  = bstrdup(".");
+		watch->name = bstrdup(watch->path);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef __linux__
+#define INOTIFY_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | \
+		IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | \
+		IN_MOVE_SELF)
+
+static void add_inotify_watch(struct obs_core_file_watch *fw,
+		struct obs_file_watch *watch)
+{
+	if (fw->inotify_fd == -1)
+		return;
+
+	/* inotify returns the same descriptor for a directory that is
+	 * already being watched */
+	watch->wd = inotify_add_watch(fw->inotify_fd, watch->dir,
+			INOTIFY_MASK);
+}
+
+static void remove_inotify_watch(struct obs_core_file_watch *fw,
+		struct obs_file_watch *watch)
+{
+	if (watch->wd == -1)
+		return;
+
+	for (size_t i = 0; i < fw->watches.num; i++) {
+		if (fw->watches.array[i]->wd == watch->wd)
+			return;
+	}
+
+	inotify_rm_watch(fw->inotify_fd, watch->wd);
+}
+
+static void mark_pending(struct obs_core_file_watch *fw,
+		const struct inotify_event *event, uint64_t ts)
+{
+	for (size_t i = 0; i < fw->watches.num; i++) {
+		struct obs_file_watch *watch = fw->watches.array[i];
+
+		if (event->mask & IN_Q_OVERFLOW) {
+			watch->pending    = true;
+			watch->pending_ts = ts;
+			continue;
+		}
+
+		if (watch->wd != event->wd)
+			continue;
+
+		/* directory is gone, fall back to polling until it shows up
+		 * again */
+		if (event->mask & IN_IGNORED)
+			watch->wd = -1;
+
+		if (watch->name && event->len &&
+		    strcmp(watch->name, event->name) != 0)
+			continue;
+
+		watch->pending    = true;
+		watch->pending_ts = ts;
+	}
+}
+
+static void read_events(struct obs_core_file_watch *fw, uint64_t ts)
+{
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	ssize_t len;
+
+	if (fw->inotify_fd == -1)
+		return;
+
+	while ((len = read(fw->inotify_fd, buf, sizeof(buf))) > 0) {
+		for (char *ptr = buf; ptr < buf + len;
+				ptr += sizeof(struct inotify_event) +
+					event->len) {
+			event = (const struct inotify_event *)ptr;
+			mark_pending(fw, event, ts);
+		}
+	}
+}
+
+static void wake_thread(struct obs_core_file_watch *fw)
+{
+	uint64_t val = 1;
+	if (fw->wake_fd != -1 && write(fw->wake_fd, &val, sizeof(val)) < 0)
+		blog(LOG_DEBUG, "file watch: failed to wake thread");
+}
+
+static bool wait_for_events(struct obs_core_file_watch *fw, int timeout_ms)
+{
+	struct pollfd fds[2] = {
+		{fw->wake_fd,    POLLIN, 0},
+		{fw->inotify_fd, POLLIN, 0}
+	};
+
+	if (poll(fds, fw->inotify_fd == -1 ? 1 : 2, timeout_ms) > 0 &&
+	    (fds[0].revents & POLLIN)) {
+		uint64_t val;
+		if (read(fw->wake_fd, &val, sizeof(val)) < 0)
+			blog(LOG_DEBUG, "file watch: failed to read eventfd");
+	}
+
+	return os_event_try(fw->stop_event) == EAGAIN;
+}
+
+static bool init_platform(struct obs_core_file_watch *fw)
+{
+	fw->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fw->wake_fd == -1)
+		return false;
+
+	fw->inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (fw->inotify_fd == -1)
+		blog(LOG_WARNING, "file watch: inotify not available, files "
+		                  "will be polled");
+	return true;
+}
+
+static void free_platform(struct obs_core_file_watch *fw)
+{
+	if (fw->inotify_fd != -1)
+		close(fw->inotify_fd);
+	if (fw->wake_fd != -1)
+		close(fw->wake_fd);
+
+	fw->inotify_fd = -1;
+	fw->wake_fd    = -1;
+}
+
+#else
+
+static inline void add_inotify_watch(struct obs_core_file_watch *fw,
+		struct obs_file_watch *watch)
+{
+	UNUSED_PARAMETER(fw);
+	UNUSED_PARAMETER(watch);
+}
+
+static inline void remove_inotify_watch(struct obs_core_file_watch *fw,
+		struct obs_file_watch *watch)
+{
+	UNUSED_PARAMETER(fw);
+	UNUSED_PARAMETER(watch);
+}
+
+static inline void read_events(struct obs_core_file_watch *fw, uint64_t ts)
+{
+	UNUSED_PARAMETER(fw);
+	UNUSED_PARAMETER(ts);
+}
+
+static inline void wake_thread(struct obs_core_file_watch *fw)
+{
+	UNUSED_PARAMETER(fw);
+}
+
+static bool wait_for_events(struct obs_core_file_watch *fw, int timeout_ms)
+{
+	const int max_timeout_ms = (int)(POLL_INTERVAL_NS / 1000000);
+
+	if (timeout_ms < 0 || timeout_ms > max_timeout_ms)
+		timeout_ms = max_timeout_ms;
+
+	return os_event_timedwait(fw->stop_event,
+			(unsigned long)timeout_ms) == ETIMEDOUT;
+}
+
+static inline bool init_platform(struct obs_core_file_watch *fw)
+{
+	UNUSED_PARAMETER(fw);
+	return true;
+}
+
+static inline void free_platform(struct obs_core_file_watch *fw)
+{
+	UNUSED_PARAMETER(fw);
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static void poll_watches(struct obs_core_file_watch *fw, uint64_t ts)
+{
+	for (size_t i = 0; i < fw->watches.num; i++) {
+		struct obs_file_watch *watch = fw->watches.array[i];
+		time_t mtime;
+
+		if (watch->wd != -1)
+			continue;
+
+		/* the directory may have been (re)created since */
+		add_inotify_watch(fw, watch);
+
+		mtime = get_modified_timestamp(watch->path);
+		if (mtime != watch->mtime) {
+			watch->mtime      = mtime;
+			watch->pending    = true;
+			watch->pending_ts = ts;
+		}
+	}
+}
+
+static void dispatch_changes(struct obs_core_file_watch *fw, uint64_t ts)
+{
+	for (size_t i = 0; i < fw->watches.num; i++) {
+		struct obs_file_watch *watch = fw->watches.array[i];
+
+		if (!watch->pending || ts - watch->pending_ts < COALESCE_NS)
+			continue;
+
+		watch->pending = false;
+		watch->callback(watch->param, watch->path);
+	}
+}
+
+static int get_timeout_ms(struct obs_core_file_watch *fw, uint64_t ts,
+		uint64_t next_poll)
+{
+	uint64_t wake_ts = 0;
+
+	for (size_t i = 0; i < fw->watches.num; i++) {
+		struct obs_file_watch *watch = fw->watches.array[i];
+		uint64_t cur_wake_ts;
+
+		if (watch->pending)
+			cur_wake_ts = watch->pending_ts + COALESCE_NS;
+		else if (watch->wd == -1)
+			cur_wake_ts = next_poll;
+		else
+			continue;
+
+		if (!wake_ts || cur_wake_ts < wake_ts)
+			wake_ts = cur_wake_ts;
+	}
+
+	if (!wake_ts)
+		return -1;
+
+	return wake_ts > ts ? (int)((wake_ts - ts + 999999) / 1000000) : 0;
+}
+
+static void *file_watch_thread(void *param)
+{
+	struct obs_core_file_watch *fw = param;
+	uint64_t next_poll = 0;
+
+	os_set_thread_name("libobs: file watch thread");
+
+	for (;;) {
+		uint64_t ts = os_gettime_ns();
+		int timeout_ms;
+
+		pthread_mutex_lock(&fw->mutex);
+		timeout_ms = get_timeout_ms(fw, ts, next_poll);
+		pthread_mutex_unlock(&fw->mutex);
+
+		if (!wait_for_events(fw, timeout_ms))
+			break;
+
+		ts = os_gettime_ns();
+
+		pthread_mutex_lock(&fw->mutex);
+
+		read_events(fw, ts);
+
+		if (ts >= next_poll) {
+			poll_watches(fw, ts);
+			next_poll = ts + POLL_INTERVAL_NS;
+		}
+
+		dispatch_changes(fw, ts);
+
+		pthread_mutex_unlock(&fw->mutex);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool obs_init_file_watch(void)
+{
+	struct obs_core_file_watch *fw = &obs->file_watch;
+	pthread_mutexattr_t attr;
+	bool success = false;
+
+	if (pthread_mutexattr_init(&attr) != 0)
+		return false;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		goto fail;
+	if (pthread_mutex_init(&fw->mutex, &attr) != 0)
+		goto fail;
+	if (os_event_init(&fw->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (!init_platform(fw))
+		goto fail;
+	if (pthread_create(&fw->thread, NULL, file_watch_thread, fw) != 0)
+		goto fail;
+
+	fw->thread_initialized = true;
+	success = true;
+
+fail:
+	pthread_mutexattr_destroy(&attr);
+	return success;
+}
+
+void obs_free_file_watch(void)
+{
+	struct obs_core_file_watch *fw = &obs->file_watch;
+
+	if (fw->thread_initialized) {
+		os_event_signal(fw->stop_event);
+		wake_thread(fw);
+		pthread_join(fw->thread, NULL);
+		fw->thread_initialized = false;
+	}
+
+	for (size_t i = 0; i < fw->watches.num; i++) {
+		struct obs_file_watch *watch = fw->watches.array[i];
+		blog(LOG_WARNING, "file watch for '%s' was never removed",
+				watch->path);
+	}
+
+	da_free(fw->watches);
+	free_platform(fw);
+	os_event_destroy(fw->stop_event);
+	fw->stop_event = NULL;
+	pthread_mutex_destroy(&fw->mutex);
+}
+
+obs_file_watch_t *obs_file_watch_add(const char *path,
+		obs_file_watch_cb callback, void *param)
+{
+	struct obs_core_file_watch *fw;
+	struct obs_file_watch *watch;
+
+	if (!obs)
+		return NULL;
+	if (!obs_ptr_valid(path, "obs_file_watch_add"))
+		return NULL;
+	if (!obs_ptr_valid(callback, "obs_file_watch_add"))
+		return NULL;
+	if (!*path)
+		return NULL;
+
+	fw = &obs->file_watch;
+
+	watch = bzalloc(sizeof(struct obs_file_watch));
+	watch->path     = bstrdup(path);
+	watch->wd       = -1;
+	watch->mtime    = get_modified_timestamp(path);
+	watch->callback = callback;
+	watch->param    = param;
+	split_path(watch);
+
+	pthread_mutex_lock(&fw->mutex);
+	add_inotify_watch(fw, watch);
+	da_push_back(fw->watches, &watch);
+	pthread_mutex_unlock(&fw->mutex);
+
+	wake_thread(fw);
+	return watch;
+}
+
+void obs_file_watch_remove(obs_file_watch_t *watch)
+{
+	struct obs_core_file_watch *fw;
+
+	if (!obs || !watch)
+		return;
+
+	fw = &obs->file_watch;
+
+	pthread_mutex_lock(&fw->mutex);
+	da_erase_item(fw->watches, &watch);
+	remove_inotify_watch(fw, watch);
+	pthread_mutex_unlock(&fw->mutex);
+
+	bfree(watch->path);
+	bfree(watch->dir);
+	bfree(watch->name);
+	bfree(watch);
+}
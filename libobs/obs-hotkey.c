@@ -589,6 +589,8 @@ static inline void create_binding(obs_hotkey_t *hotkey,
 	binding->key = combo;
 	binding->hotkey_id = hotkey->id;
 	binding->hotkey    = hotkey;
+
+	obs->hotkeys.binding_index_dirty = true;
 }
 
 static inline void load_binding(obs_hotkey_t *hotkey, obs_data_t *data)
@@ -915,6 +917,7 @@ static inline void remove_bindings(obs_hotkey_id id)
 			release_pressed_binding(binding);
 
 		da_erase(obs->hotkeys.bindings, idx);
+		obs->hotkeys.binding_index_dirty = true;
 	}
 }
 
@@ -1069,6 +1072,8 @@ void obs_hotkeys_free(void)
 		release_registerer(&hotkeys[i]);
 	}
 	da_free(obs->hotkeys.bindings);
+	da_free(obs->hotkeys.binding_index);
+	da_free(obs->hotkeys.modifier_bindings);
 	da_free(obs->hotkeys.hotkeys);
 	da_free(obs->hotkeys.hotkey_pairs);
 
@@ -1268,7 +1273,7 @@ static inline bool query_hotkey(void *data,
 	return true;
 }
 
-static inline void query_hotkeys()
+static inline uint32_t query_modifiers(void)
 {
 	uint32_t modifiers = 0;
 	if (is_pressed(OBS_KEY_SHIFT))
@@ -1279,15 +1284,142 @@ static inline void query_hotkeys()
 		modifiers |= INTERACT_ALT_KEY;
 	if (is_pressed(OBS_KEY_META))
 		modifiers |= INTERACT_COMMAND_KEY;
+	return modifiers;
+}
 
+static inline void query_hotkeys()
+{
 	struct obs_query_hotkeys_helper param = {
-		modifiers,
+		query_modifiers(),
 		obs->hotkeys.thread_disable_press,
 		obs->hotkeys.strict_modifiers,
 	};
 	enum_bindings(query_hotkey, &param);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Event driven key handling                                                 */
+
+static int binding_key_compare(const void *a_, const void *b_)
+{
+	const struct obs_hotkey_binding_key *a = a_;
+	const struct obs_hotkey_binding_key *b = b_;
+
+	if (a->key != b->key)
+		return a->key < b->key ? -1 : 1;
+	if (a->modifiers != b->modifiers)
+		return a->modifiers < b->modifiers ? -1 : 1;
+	return a->binding_idx < b->binding_idx ? -1 :
+		(a->binding_idx > b->binding_idx ? 1 : 0);
+}
+
+static void rebuild_binding_index(void)
+{
+	struct obs_core_hotkeys *hotkeys = &obs->hotkeys;
+
+	da_resize(hotkeys->binding_index, 0);
+	da_resize(hotkeys->modifier_bindings, 0);
+
+	for (size_t i = 0; i < hotkeys->bindings.num; i++) {
+		obs_hotkey_binding_t *binding = hotkeys->bindings.array + i;
+		struct obs_hotkey_binding_key entry = {
+			binding->key.key, binding->key.modifiers, i
+		};
+
+		da_push_back(hotkeys->binding_index, &entry);
+
+		/* bindings that depend on the modifier state, see
+		 * handle_binding */
+		if (binding->key.modifiers || binding->key.key == OBS_KEY_NONE)
+			da_push_back(hotkeys->modifier_bindings, &i);
+	}
+
+	qsort(hotkeys->binding_index.array, hotkeys->binding_index.num,
+			sizeof(struct obs_hotkey_binding_key),
+			binding_key_compare);
+
+	hotkeys->binding_index_dirty = false;
+}
+
+static size_t binding_index_lower_bound(obs_key_t key)
+{
+	struct obs_hotkey_binding_key *index = obs->hotkeys.binding_index.array;
+	size_t lo = 0;
+	size_t hi = obs->hotkeys.binding_index.num;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (index[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+struct hotkey_event_state {
+	DARRAY(obs_key_t) changed;
+	uint32_t          modifiers;
+};
+
+static void add_changed_key(void *param, obs_key_t key)
+{
+	struct hotkey_event_state *state = param;
+
+	for (size_t i = 0; i < state->changed.num; i++) {
+		if (state->changed.array[i] == key)
+			return;
+	}
+
+	da_push_back(state->changed, &key);
+}
+
+static void handle_changed_keys(struct hotkey_event_state *state,
+		struct obs_query_hotkeys_helper *param)
+{
+	obs_hotkey_binding_t *bindings = obs->hotkeys.bindings.array;
+	struct obs_hotkey_binding_key *index = obs->hotkeys.binding_index.array;
+	size_t num = obs->hotkeys.binding_index.num;
+
+	if (param->modifiers != state->modifiers) {
+		for (size_t i = 0; i < obs->hotkeys.modifier_bindings.num; i++) {
+			size_t idx = obs->hotkeys.modifier_bindings.array[i];
+			query_hotkey(param, idx, bindings + idx);
+		}
+	}
+
+	for (size_t i = 0; i < state->changed.num; i++) {
+		obs_key_t key = state->changed.array[i];
+
+		for (size_t j = binding_index_lower_bound(key);
+				j < num && index[j].key == key; j++) {
+			size_t idx = index[j].binding_idx;
+			query_hotkey(param, idx, bindings + idx);
+		}
+	}
+}
+
+/* only evaluates the bindings affected by the keys that changed.  each batch
+ * is evaluated twice so that a modifier and key pressed in the same batch
+ * trigger the binding just like two consecutive polls would */
+static void query_changed_hotkeys(struct hotkey_event_state *state)
+{
+	if (obs->hotkeys.binding_index_dirty)
+		rebuild_binding_index();
+
+	struct obs_query_hotkeys_helper param = {
+		query_modifiers(),
+		obs->hotkeys.thread_disable_press,
+		obs->hotkeys.strict_modifiers,
+	};
+
+	handle_changed_keys(state, &param);
+	handle_changed_keys(state, &param);
+
+	state->modifiers = param.modifiers;
+}
+
 #define NBSP "\xC2\xA0"
 
 void *obs_hotkey_thread(void *arg)
@@ -1299,7 +1431,32 @@ void *obs_hotkey_thread(void *arg)
 				"obs_hotkey_thread(%g"NBSP"ms)", 25.);
 	profile_register_root(hotkey_thread_name, (uint64_t)25000000);
 
-	while (os_event_timedwait(obs->hotkeys.stop_event, 25) == ETIMEDOUT) {
+	struct hotkey_event_state state = {0};
+
+	while (os_event_try(obs->hotkeys.stop_event) == EAGAIN) {
+		da_resize(state.changed, 0);
+
+		/* key events are waited on for at most the polling interval
+		 * so that the stop event is still checked regularly */
+		if (obs_hotkeys_platform_wait_events(
+					obs->hotkeys.platform_context, 25,
+					add_changed_key, &state)) {
+			if (!state.changed.num || !lock())
+				continue;
+
+			profile_start(hotkey_thread_name);
+			query_changed_hotkeys(&state);
+			profile_end(hotkey_thread_name);
+
+			unlock();
+
+			profile_reenable_thread();
+			continue;
+		}
+
+		if (os_event_timedwait(obs->hotkeys.stop_event, 25) !=
+				ETIMEDOUT)
+			break;
 		if (!lock())
 			continue;
 
@@ -1311,6 +1468,8 @@ void *obs_hotkey_thread(void *arg)
 
 		profile_reenable_thread();
 	}
+
+	da_free(state.changed);
 	return NULL;
 }
 
@@ -0,0 +1,437 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "util/platform.h"
+#include "graphics/image-file.h"
+#include "obs-internal.h"
+
+/*
+ * Images are shared between all users of the same file, and are looked up
+ * by path and modification time, so a file that changed on disk gets a new
+ * entry while the old one stays valid for anyone still holding it.
+ *
+ * Decoding happens on worker threads.  The texture is only created the
+ * first time obs_image_get_texture is called from the graphics thread, so
+ * nothing ever blocks the graphics thread on file I/O or decoding.
+ *
+ * Images nobody holds any more are kept around (up to UNUSED_BUDGET bytes)
+ * so that sources which unload when hidden, and preloaded images, don't
+ * have to be decoded again when they are shown.
+ *
+ * Unshared images (animated gifs, which keep their own animation state) only
+ * use the decode threads.  They are never found by a lookup, and are freed
+ * as soon as they are released.
+ */
+
+#define DECODE_THREADS (sizeof(obs->image_cache.threads) / sizeof(pthread_t))
+#define UNUSED_BUDGET  (128 * 1024 * 1024)
+
+struct obs_image {
+	long             refs;
+	char             *path;
+	time_t           mtime;
+	uint64_t         last_used;
+
+	gs_image_file_t  image;
+	size_t           size;
+	volatile bool    decoded;
+	bool             uploaded;
+	bool             unshared;
+	bool             taken;
+};
+
+static inline time_t get_modified_timestamp(const char *path)
+{
+	struct stat stats;
+	if (os_stat(path, &stats) != 0)
+		return -1;
+	return stats.st_mtime;
+}
+
+static void image_destroy(struct obs_image *image)
+{
+	if (image->uploaded) {
+		obs_enter_graphics();
+		gs_image_file_free(&image->image);
+		obs_leave_graphics();
+	} else {
+		gs_image_file_free(&image->image);
+	}
+
+	bfree(image->path);
+	bfree(image);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline size_t unused_size(struct obs_core_image_cache *cache)
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < cache->images.num; i++) {
+		struct obs_image *image = cache->images.array[i];
+		if (!image->refs)
+			size += image->size;
+	}
+
+	return size;
+}
+
+static struct obs_image *find_oldest_unused(
+		struct obs_core_image_cache *cache, size_t *idx)
+{
+	struct obs_image *oldest = NULL;
+
+	for (size_t i = 0; i < cache->images.num; i++) {
+		struct obs_image *image = cache->images.array[i];
+
+		if (image->refs)
+			continue;
+		if (!oldest || image->last_used < oldest->last_used) {
+			oldest = image;
+			*idx = i;
+		}
+	}
+
+	return oldest;
+}
+
+/* removes unused images beyond the budget from the cache, the caller destroys
+ * them outside of the cache mutex */
+static void trim_unused(struct obs_core_image_cache *cache,
+		struct darray *removed_da)
+{
+	DARRAY(struct obs_image*) removed;
+	size_t size = unused_size(cache);
+
+	removed.da = *removed_da;
+
+	while (size > UNUSED_BUDGET) {
+		struct obs_image *image;
+		size_t idx;
+
+		image = find_oldest_unused(cache, &idx);
+		if (!image)
+			break;
+
+		size -= image->size;
+		da_erase(cache->images, idx);
+		da_push_back(removed, &image);
+	}
+
+	*removed_da = removed.da;
+}
+
+static void destroy_removed(struct darray *removed_da)
+{
+	DARRAY(struct obs_image*) removed;
+	removed.da = *removed_da;
+
+	for (size_t i = 0; i < removed.num; i++)
+		image_destroy(removed.array[i]);
+
+	da_free(removed);
+}
+
+static void release_locked(struct obs_core_image_cache *cache,
+		struct obs_image *image, struct darray *removed)
+{
+	if (--image->refs > 0)
+		return;
+
+	image->last_used = os_gettime_ns();
+
+	/* failed images are not worth keeping */
+	if (image->unshared || (image->decoded && !image->image.loaded)) {
+		da_erase_item(cache->images, &image);
+		darray_push_back(sizeof(struct obs_image*), removed, &image);
+		return;
+	}
+
+	trim_unused(cache, removed);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *decode_thread(void *param)
+{
+	struct obs_core_image_cache *cache = param;
+
+	os_set_thread_name("libobs: image decode thread");
+
+	while (os_sem_wait(cache->decode_sem) == 0) {
+		struct darray removed = {0};
+		struct obs_image *image = NULL;
+		uint64_t start;
+
+		if (os_atomic_load_bool(&cache->stop))
+			break;
+
+		pthread_mutex_lock(&cache->mutex);
+		if (cache->decode_queue.num) {
+			image = cache->decode_queue.array[0];
+			da_erase(cache->decode_queue, 0);
+		}
+		pthread_mutex_unlock(&cache->mutex);
+
+		if (!image)
+			continue;
+
+		start = os_gettime_ns();
+		gs_image_file_init(&image->image, image->path);
+
+		pthread_mutex_lock(&cache->mutex);
+		image->size = (size_t)image->image.cx * image->image.cy * 4;
+		os_atomic_set_bool(&image->decoded, true);
+		cache->decode_ns += os_gettime_ns() - start;
+		cache->decodes++;
+		release_locked(cache, image, &removed);
+		pthread_mutex_unlock(&cache->mutex);
+
+		destroy_removed(&removed);
+	}
+
+	return NULL;
+}
+
+static struct obs_image *find_image(struct obs_core_image_cache *cache,
+		const char *path, time_t mtime, struct darray *removed)
+{
+	struct obs_image *found = NULL;
+
+	for (size_t i = cache->images.num; i > 0; i--) {
+		struct obs_image *image = cache->images.array[i - 1];
+
+		if (image->unshared || strcmp(image->path, path) != 0)
+			continue;
+
+		if (image->mtime == mtime) {
+			found = image;
+
+		/* an older version of the file that nobody uses any more */
+		} else if (!image->refs) {
+			da_erase(cache->images, i - 1);
+			darray_push_back(sizeof(struct obs_image*), removed,
+					&image);
+		}
+	}
+
+	return found;
+}
+
+/* must be called with the cache mutex held */
+static struct obs_image *queue_image(struct obs_core_image_cache *cache,
+		const char *path, time_t mtime)
+{
+	struct obs_image *image = bzalloc(sizeof(struct obs_image));
+	image->path  = bstrdup(path);
+	image->mtime = mtime;
+
+	/* one reference for the caller, one for the decode thread */
+	image->refs  = 2;
+
+	da_push_back(cache->images, &image);
+	da_push_back(cache->decode_queue, &image);
+	os_sem_post(cache->decode_sem);
+	return image;
+}
+
+obs_image_t *obs_image_cache_get(const char *path)
+{
+	struct obs_core_image_cache *cache;
+	struct darray removed = {0};
+	struct obs_image *image;
+	time_t mtime;
+
+	if (!obs || !obs_ptr_valid(path, "obs_image_cache_get") || !*path)
+		return NULL;
+
+	cache = &obs->image_cache;
+	mtime = get_modified_timestamp(path);
+
+	pthread_mutex_lock(&cache->mutex);
+
+	image = find_image(cache, path, mtime, &removed);
+	if (image) {
+		image->refs++;
+		cache->hits++;
+
+	} else {
+		image = queue_image(cache, path, mtime);
+		cache->misses++;
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	destroy_removed(&removed);
+	return image;
+}
+
+obs_image_t *obs_image_load_unshared(const char *path)
+{
+	struct obs_core_image_cache *cache;
+	struct obs_image *image;
+
+	if (!obs || !obs_ptr_valid(path, "obs_image_load_unshared") || !*path)
+		return NULL;
+
+	cache = &obs->image_cache;
+
+	pthread_mutex_lock(&cache->mutex);
+	image = queue_image(cache, path, get_modified_timestamp(path));
+	image->unshared = true;
+	pthread_mutex_unlock(&cache->mutex);
+
+	return image;
+}
+
+bool obs_image_take_file(obs_image_t *image, gs_image_file_t *file)
+{
+	bool taken = false;
+
+	if (!obs || !image || !file)
+		return false;
+
+	pthread_mutex_lock(&obs->image_cache.mutex);
+
+	if (image->unshared && !image->taken && !image->uploaded &&
+	    os_atomic_load_bool(&image->decoded)) {
+		*file = image->image;
+		memset(&image->image, 0, sizeof(image->image));
+		image->taken = true;
+		taken = true;
+	}
+
+	pthread_mutex_unlock(&obs->image_cache.mutex);
+	return taken;
+}
+
+void obs_image_release(obs_image_t *image)
+{
+	struct obs_core_image_cache *cache;
+	struct darray removed = {0};
+
+	if (!obs || !image)
+		return;
+
+	cache = &obs->image_cache;
+
+	pthread_mutex_lock(&cache->mutex);
+	release_locked(cache, image, &removed);
+	pthread_mutex_unlock(&cache->mutex);
+
+	destroy_removed(&removed);
+}
+
+void obs_image_cache_preload(const char *path)
+{
+	obs_image_release(obs_image_cache_get(path));
+}
+
+bool obs_image_decoded(const obs_image_t *image)
+{
+	return image ? os_atomic_load_bool(&image->decoded) : false;
+}
+
+uint32_t obs_image_get_width(const obs_image_t *image)
+{
+	return obs_image_decoded(image) ? image->image.cx : 0;
+}
+
+uint32_t obs_image_get_height(const obs_image_t *image)
+{
+	return obs_image_decoded(image) ? image->image.cy : 0;
+}
+
+gs_texture_t *obs_image_get_texture(obs_image_t *image)
+{
+	if (!obs_image_decoded(image))
+		return NULL;
+
+	if (!image->uploaded) {
+		gs_image_file_init_texture(&image->image);
+		image->uploaded = true;
+	}
+
+	return image->image.texture;
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool obs_init_image_cache(void)
+{
+	struct obs_core_image_cache *cache = &obs->image_cache;
+
+	if (pthread_mutex_init(&cache->mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&cache->decode_sem, 0) != 0)
+		return false;
+
+	for (size_t i = 0; i < DECODE_THREADS; i++) {
+		if (pthread_create(&cache->threads[i], NULL, decode_thread,
+					cache) != 0)
+			return false;
+		cache->num_threads++;
+	}
+
+	return true;
+}
+
+void obs_free_image_cache(void)
+{
+	struct obs_core_image_cache *cache = &obs->image_cache;
+
+	os_atomic_set_bool(&cache->stop, true);
+	for (size_t i = 0; i < cache->num_threads; i++)
+		os_sem_post(cache->decode_sem);
+	for (size_t i = 0; i < cache->num_threads; i++)
+		pthread_join(cache->threads[i], NULL);
+	cache->num_threads = 0;
+
+	if (cache->decodes || cache->hits)
+		blog(LOG_INFO, "Image cache: %"PRIu64" decodes "
+				"(avg %.2f ms), %"PRIu64" hits, "
+				"%"PRIu64" misses",
+				cache->decodes,
+				(double)cache->decode_ns /
+					(double)(cache->decodes ?
+						cache->decodes : 1) /
+					1000000.0,
+				cache->hits, cache->misses);
+
+	for (size_t i = 0; i < cache->images.num; i++) {
+		struct obs_image *image = cache->images.array[i];
+
+		long queued = da_find(cache->decode_queue, &image, 0) !=
+			DARRAY_INVALID;
+
+		if (image->refs > queued)
+			blog(LOG_WARNING, "Image '%s' was never released",
+					image->path);
+		image_destroy(image);
+	}
+
+	da_free(cache->images);
+	da_free(cache->decode_queue);
+	os_sem_destroy(cache->decode_sem);
+	cache->decode_sem = NULL;
+	pthread_mutex_destroy(&cache->mutex);
+}
@@ -44,6 +44,22 @@ static inline int64_t packet_dts_usec(struct encoder_packet *packet)
 	return packet->dts * MICROSECOND_DEN / packet->timebase_den;
 }
 
+/* FNV-1a, used to build the keys of cached source output */
+#define OBS_HASH_INIT 0xcbf29ce484222325ULL
+
+static inline uint64_t obs_hash_data(uint64_t hash, const void *data,
+		size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
 struct draw_callback {
 	void (*draw)(void *param, uint32_t cx, uint32_t cy);
 	void *param;
@@ -149,6 +165,12 @@ typedef struct obs_hotkey_pair obs_hotkey_pair_t;
 
 typedef struct obs_hotkeys_platform obs_hotkeys_platform_t;
 
+struct obs_hotkey_binding_key {
+	obs_key_t                       key;
+	uint32_t                        modifiers;
+	size_t                          binding_idx;
+};
+
 void *obs_hotkey_thread(void *param);
 
 struct obs_core_hotkeys;
@@ -157,6 +179,13 @@ void obs_hotkeys_platform_free(struct obs_core_hotkeys *hotkeys);
 bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *context,
 		obs_key_t key);
 
+/* waits up to timeout_ms for key/button events and calls changed() for every
+ * key that went up or down.  returns false if the platform does not deliver
+ * key events, in which case key states have to be polled instead */
+bool obs_hotkeys_platform_wait_events(obs_hotkeys_platform_t *context,
+		uint32_t timeout_ms,
+		void (*changed)(void *param, obs_key_t key), void *param);
+
 const char *obs_get_hotkey_translation(obs_key_t key, const char *def);
 
 struct obs_context_data;
@@ -219,6 +248,20 @@ struct obs_vframe_info {
 	int count;
 };
 
+/* interned effect parameter names used in per-item render paths */
+struct obs_effect_params {
+	size_t                          image;
+	size_t                          base_dimension_i;
+	size_t                          color_matrix;
+	size_t                          color_range_min;
+	size_t                          color_range_max;
+};
+
+struct fused_effect {
+	char                            *source;
+	gs_effect_t                     *effect;
+};
+
 struct obs_core_video {
 	graphics_t                      *graphics;
 	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
@@ -240,6 +283,7 @@ struct obs_core_video {
 	gs_effect_t                     *bilinear_lowres_effect;
 	gs_effect_t                     *premultiplied_alpha_effect;
 	gs_samplerstate_t               *point_sampler;
+	struct obs_effect_params        params;
 	gs_stagesurf_t                  *mapped_surface;
 	int                             cur_texture;
 
@@ -267,6 +311,32 @@ struct obs_core_video {
 
 	gs_texture_t                    *transparent_texture;
 
+	/* applied by obs_source_draw while rendering a source with
+	 * obs_source_video_render_cropped */
+	struct obs_sceneitem_crop       draw_crop;
+	bool                            draw_cropped;
+	bool                            draw_point_sampled;
+
+	/* set by obs_source_video_render_batched, obs_source_draw adds the
+	 * sprite to it instead of drawing it */
+	gs_sprite_batch_t               *draw_batch;
+
+	bool                            culling;
+	long                            items_culled_frame;
+	volatile long                   items_culled;
+	uint64_t                        items_culled_total;
+
+	bool                            filter_fusion;
+	DARRAY(struct fused_effect)     fused_effects;
+
+	/* incremented whenever a filter is updated or destroyed, which may
+	 * change the effect generated for a fused filter chain */
+	volatile long                   fused_version;
+
+	obs_source_t                    *cache_target;
+	uint64_t                        cache_hits;
+	uint64_t                        cache_misses;
+
 	gs_effect_t                     *deinterlace_discard_effect;
 	gs_effect_t                     *deinterlace_discard_2x_effect;
 	gs_effect_t                     *deinterlace_linear_effect;
@@ -281,6 +351,7 @@ struct audio_monitor;
 
 struct obs_core_audio {
 	audio_t                         *audio;
+	uint32_t                        frames_per_tick;
 
 	DARRAY(struct obs_source*)      render_order;
 	DARRAY(struct obs_source*)      root_nodes;
@@ -337,6 +408,13 @@ struct obs_core_hotkeys {
 	bool                            reroute_hotkeys : 1;
 	DARRAY(obs_hotkey_binding_t)    bindings;
 
+	/* bindings sorted by key and modifiers, so that key events only have
+	 * to look at the bindings they can affect.  rebuilt by the hotkey
+	 * thread whenever the bindings change */
+	DARRAY(struct obs_hotkey_binding_key) binding_index;
+	DARRAY(size_t)                  modifier_bindings;
+	bool                            binding_index_dirty;
+
 	obs_hotkey_callback_router_func router_func;
 	void                            *router_func_data;
 
@@ -356,6 +434,56 @@ struct obs_core_hotkeys {
 	char                            *sceneitem_hide;
 };
 
+/* file watch service */
+struct obs_file_watch;
+
+struct obs_core_file_watch {
+	pthread_mutex_t                 mutex;
+	DARRAY(struct obs_file_watch*)  watches;
+
+	pthread_t                       thread;
+	bool                            thread_initialized;
+	os_event_t                      *stop_event;
+
+	/* inotify instance and eventfd used to wake up the thread (linux) */
+	int                             inotify_fd;
+	int                             wake_fd;
+};
+
+extern bool obs_init_file_watch(void);
+extern void obs_free_file_watch(void);
+
+/* shared image cache */
+struct obs_image;
+
+struct obs_core_image_cache {
+	pthread_mutex_t                 mutex;
+	DARRAY(struct obs_image*)       images;
+	DARRAY(struct obs_image*)       decode_queue;
+
+	os_sem_t                        *decode_sem;
+	pthread_t                       threads[2];
+	size_t                          num_threads;
+	volatile bool                   stop;
+
+	uint64_t                        decodes;
+	uint64_t                        decode_ns;
+	uint64_t                        hits;
+	uint64_t                        misses;
+};
+
+extern bool obs_init_image_cache(void);
+extern void obs_free_image_cache(void);
+
+/* core stats */
+struct obs_core_stats {
+	obs_stat_t                      *frame_time;
+	DARRAY(obs_stat_t*)             sampled;
+};
+
+extern void obs_init_stats(void);
+extern void obs_free_stats(void);
+
 struct obs_core {
 	struct obs_module               *first_module;
 	DARRAY(struct obs_module_path)  module_paths;
@@ -375,15 +503,22 @@ struct obs_core {
 
 	char                            *locale;
 	char                            *module_config_path;
+	char                            *shader_cache_path;
 	bool                            name_store_owned;
 	profiler_name_store_t           *name_store;
 
+	/* tick size for the next obs_reset_audio, 0 for the default */
+	uint32_t                        audio_frames_per_tick;
+
 	/* segmented into multiple sub-structures to keep things a bit more
 	 * clean and organized */
 	struct obs_core_video           video;
 	struct obs_core_audio           audio;
 	struct obs_core_data            data;
 	struct obs_core_hotkeys         hotkeys;
+	struct obs_core_file_watch      file_watch;
+	struct obs_core_image_cache     image_cache;
+	struct obs_core_stats           stats;
 };
 
 extern struct obs_core *obs;
@@ -488,6 +623,15 @@ struct async_frame {
 	struct obs_source_frame *frame;
 	long unused_count;
 	bool used;
+	bool borrowed;
+};
+
+/* frame handed to obs_source_output_video_borrowed.  libobs owns the frame
+ * struct, but the planes are given back to the source with release() */
+struct borrowed_frame {
+	struct obs_source_frame *frame;
+	void (*release)(void *param);
+	void *param;
 };
 
 enum audio_action_type {
@@ -570,6 +714,10 @@ struct obs_source {
 	struct circlebuf                audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t                          last_audio_input_buf_size;
 	DARRAY(struct audio_action)     audio_actions;
+	float                           *audio_output_storage[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
+	/* what each mix outputs, usually audio_output_storage.  When the
+	 * mixes would only be copies of mix 0, they point to mix 0 instead,
+	 * and mixes that are not used point to silence */
 	float                           *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
 	struct resample_info            sample_info;
 	audio_resampler_t               *resampler;
@@ -579,7 +727,11 @@ struct obs_source {
 	pthread_mutex_t                 audio_cb_mutex;
 	DARRAY(struct audio_cb_info)    audio_cb_list;
 	struct obs_audio_data           audio_data;
+	uint8_t                         *audio_storage[MAX_AV_PLANES];
 	size_t                          audio_storage_size;
+	uint64_t                        audio_ingest_copied;
+	uint64_t                        audio_render_copied;
+	obs_stat_t                      *audio_copied_stat;
 	uint32_t                        audio_mixers;
 	float                           user_volume;
 	float                           volume;
@@ -604,6 +756,7 @@ struct obs_source {
 	bool                            async_update_texture;
 	DARRAY(struct async_frame)      async_cache;
 	DARRAY(struct obs_source_frame*)async_frames;
+	DARRAY(struct borrowed_frame)   borrowed_frames;
 	pthread_mutex_t                 async_mutex;
 	uint32_t                        async_width;
 	uint32_t                        async_height;
@@ -633,6 +786,26 @@ struct obs_source {
 	enum obs_allow_direct_render    allow_direct;
 	bool                            rendering_filter;
 
+	/* filters drawn in this filter's pass (this one first), and the
+	 * target that is rendered for them, see obs-source-fusion.c */
+	DARRAY(struct obs_source*)      fused_filters;
+	gs_effect_t                     *fused_effect;
+	struct obs_source               *fused_target;
+
+	/* the fused filters and fusion version that fused_key_effect was
+	 * looked up for, so the code only has to be generated on a change */
+	DARRAY(struct obs_source*)      fused_key;
+	long                            fused_key_version;
+	gs_effect_t                     *fused_key_effect;
+
+	/* output cache, see OBS_SOURCE_CACHEABLE */
+	volatile long                   content_version;
+	gs_texrender_t                  *cache_texrender;
+	uint64_t                        cache_key;
+	uint64_t                        cache_prev_key;
+	bool                            cache_valid;
+	bool                            rendering_cache;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id              mute_unmute_key;
 	obs_hotkey_id                   push_to_mute_key;
@@ -681,6 +854,22 @@ extern bool obs_source_init_context(struct obs_source *source,
 extern void obs_source_save(obs_source_t *source);
 extern void obs_source_load(obs_source_t *source);
 
+extern bool obs_source_can_draw_cropped(const obs_source_t *source);
+extern bool obs_source_can_draw_batched(const obs_source_t *source);
+extern bool obs_source_is_opaque(const obs_source_t *source);
+extern void obs_source_skip_video_render(obs_source_t *source);
+extern bool obs_source_get_content_key(obs_source_t *source, uint64_t *key);
+extern bool obs_scene_get_content_key(obs_scene_t *scene, uint64_t *key);
+extern void obs_source_video_render_cropped(obs_source_t *source,
+		const struct obs_sceneitem_crop *crop, bool point_sampled);
+extern void obs_source_video_render_batched(obs_source_t *source,
+		const struct obs_sceneitem_crop *crop,
+		gs_sprite_batch_t *batch);
+
+extern obs_source_t *obs_source_fuse_filters(obs_source_t *filter);
+extern void obs_source_set_fused_params(obs_source_t *filter);
+extern void obs_free_fused_effects(void);
+
 extern bool obs_transition_init(obs_source_t *transition);
 extern void obs_transition_free(obs_source_t *transition);
 extern void obs_transition_tick(obs_source_t *transition);
@@ -865,6 +1054,8 @@ struct obs_output {
 	volatile long                   delay_restart_refs;
 	volatile bool                   delay_active;
 	volatile bool                   delay_capturing;
+
+	DARRAY(obs_stat_t*)             stats;
 };
 
 static inline void do_output_signal(struct obs_output *output,
@@ -964,6 +1155,12 @@ struct obs_encoder {
 	DARRAY(struct encoder_callback) callbacks;
 
 	const char                      *profile_encoder_encode_name;
+
+	/* audio encoders are fed by the audio thread through a small
+	 * lock-free queue and encode on their own worker thread */
+	struct audio_encode_worker      *audio_worker;
+	pthread_mutex_t                 audio_stats_mutex;
+	struct obs_encoder_audio_stats  audio_stats;
 };
 
 extern struct obs_encoder_info *find_encoder(const char *id);
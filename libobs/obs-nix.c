@@ -30,8 +30,14 @@
 #include <X11/Xlib-xcb.h>
 #include <X11/keysym.h>
 #include <inttypes.h>
+#include <poll.h>
 #include "util/dstr.h"
 #include "obs-internal.h"
+#include "obsconfig.h"
+
+#if HAVE_XINPUT2
+#include <X11/extensions/XInput2.h>
+#endif
 
 const char *get_module_extension(void)
 {
@@ -266,6 +272,16 @@ struct obs_hotkeys_platform {
 	xcb_keysym_t *keysyms;
 	int num_keysyms;
 	int syms_per_code;
+
+	/* when XInput 2.1 is available, raw key/button events are read on a
+	 * separate connection by the hotkey thread, and key states are looked
+	 * up in these bitmaps rather than queried from the server */
+	Display *event_display;
+	int xi_opcode;
+	bool event_driven;
+	uint8_t key_state[32];
+	uint32_t button_state;
+	obs_key_t keycode_keys[256];
 };
 
 #define MOUSE_1 (1<<16)
@@ -646,6 +662,79 @@ error1:
 	return error != NULL || reply == NULL;
 }
 
+#if HAVE_XINPUT2
+static void fill_keycode_keys(obs_hotkeys_platform_t *context)
+{
+	for (size_t i = 0; i < 256; i++)
+		context->keycode_keys[i] = OBS_KEY_NONE;
+
+	for (size_t i = 0; i < OBS_KEY_LAST_VALUE; i++) {
+		struct keycode_list *codes = &context->keycodes[i];
+
+		for (size_t j = 0; j < codes->list.num; j++)
+			context->keycode_keys[codes->list.array[j]] =
+				(obs_key_t)i;
+	}
+
+	if (context->super_l_code)
+		context->keycode_keys[context->super_l_code] = OBS_KEY_META;
+	if (context->super_r_code)
+		context->keycode_keys[context->super_r_code] = OBS_KEY_META;
+}
+
+static void init_xinput2(obs_hotkeys_platform_t *context)
+{
+	unsigned char mask_bits[XIMaskLen(XI_LASTEVENT)] = {0};
+	XIEventMask mask;
+	int event, error, major = 2, minor = 1;
+	Window root, child;
+	int root_x, root_y, win_x, win_y;
+	unsigned int buttons;
+	Display *display;
+
+	display = XOpenDisplay(NULL);
+	if (!display)
+		return;
+
+	if (!XQueryExtension(display, "XInputExtension", &context->xi_opcode,
+				&event, &error) ||
+	    XIQueryVersion(display, &major, &minor) != Success ||
+	    (major == 2 && minor < 1)) {
+		blog(LOG_INFO, "XInput 2.1 not available, hotkeys will be "
+		               "polled");
+		XCloseDisplay(display);
+		return;
+	}
+
+	XISetMask(mask_bits, XI_RawKeyPress);
+	XISetMask(mask_bits, XI_RawKeyRelease);
+	XISetMask(mask_bits, XI_RawButtonPress);
+	XISetMask(mask_bits, XI_RawButtonRelease);
+
+	mask.deviceid = XIAllMasterDevices;
+	mask.mask_len = sizeof(mask_bits);
+	mask.mask     = mask_bits;
+
+	root = DefaultRootWindow(display);
+	XISelectEvents(display, root, &mask, 1);
+
+	/* keys that are already held down at startup */
+	XQueryKeymap(display, (char*)context->key_state);
+	if (XQueryPointer(display, root, &root, &child, &root_x, &root_y,
+				&win_x, &win_y, &buttons)) {
+		if (buttons & Button1Mask) context->button_state |= 1 << 1;
+		if (buttons & Button2Mask) context->button_state |= 1 << 2;
+		if (buttons & Button3Mask) context->button_state |= 1 << 3;
+	}
+
+	XSync(display, False);
+
+	fill_keycode_keys(context);
+	context->event_display = display;
+	context->event_driven = true;
+}
+#endif
+
 bool obs_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys)
 {
 	Display *display = XOpenDisplay(NULL);
@@ -657,6 +746,9 @@ bool obs_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys)
 
 	fill_base_keysyms(hotkeys);
 	fill_keycodes(hotkeys);
+#if HAVE_XINPUT2
+	init_xinput2(hotkeys->platform_context);
+#endif
 	return true;
 }
 
@@ -667,6 +759,8 @@ void obs_hotkeys_platform_free(struct obs_core_hotkeys *hotkeys)
 	for (size_t i = 0; i < OBS_KEY_LAST_VALUE; i++)
 		da_free(context->keycodes[i].list);
 
+	if (context->event_display)
+		XCloseDisplay(context->event_display);
 	XCloseDisplay(context->display);
 	bfree(context->keysyms);
 	bfree(context);
@@ -768,18 +862,148 @@ static bool key_pressed(xcb_connection_t *connection,
 	return pressed;
 }
 
+static inline bool state_key_pressed(obs_hotkeys_platform_t *context,
+		xcb_keycode_t code)
+{
+	return (context->key_state[code / 8] & (1 << (code % 8))) != 0;
+}
+
+static bool event_key_pressed(obs_hotkeys_platform_t *context, obs_key_t key)
+{
+	struct keycode_list *codes = &context->keycodes[key];
+
+	if (key >= OBS_KEY_MOUSE1 && key <= OBS_KEY_MOUSE29) {
+		switch (key) {
+		case OBS_KEY_MOUSE1: return context->button_state & (1 << 1);
+		case OBS_KEY_MOUSE2: return context->button_state & (1 << 3);
+		case OBS_KEY_MOUSE3: return context->button_state & (1 << 2);
+		default:             return false;
+		}
+
+	} else if (key == OBS_KEY_META) {
+		return state_key_pressed(context, context->super_l_code) ||
+		       state_key_pressed(context, context->super_r_code);
+	}
+
+	for (size_t i = 0; i < codes->list.num; i++) {
+		if (state_key_pressed(context, codes->list.array[i]))
+			return true;
+	}
+
+	return false;
+}
+
 bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *context,
 		obs_key_t key)
 {
 	xcb_connection_t *conn = XGetXCBConnection(context->display);
 
-	if (key >= OBS_KEY_MOUSE1 && key <= OBS_KEY_MOUSE29) {
+	if (context->event_driven) {
+		return event_key_pressed(context, key);
+	} else if (key >= OBS_KEY_MOUSE1 && key <= OBS_KEY_MOUSE29) {
 		return mouse_button_pressed(conn, context, key);
 	} else {
 		return key_pressed(conn, context, key);
 	}
 }
 
+#if HAVE_XINPUT2
+static inline obs_key_t key_from_button(int button)
+{
+	switch (button) {
+	case 1: return OBS_KEY_MOUSE1;
+	case 2: return OBS_KEY_MOUSE3;
+	case 3: return OBS_KEY_MOUSE2;
+	default: return OBS_KEY_NONE;
+	}
+}
+
+static void handle_raw_event(obs_hotkeys_platform_t *context,
+		XGenericEventCookie *cookie,
+		void (*changed)(void *param, obs_key_t key), void *param)
+{
+	XIRawEvent *raw = cookie->data;
+	bool down = cookie->evtype == XI_RawKeyPress ||
+	            cookie->evtype == XI_RawButtonPress;
+	obs_key_t key;
+
+	if (cookie->evtype == XI_RawKeyPress ||
+	    cookie->evtype == XI_RawKeyRelease) {
+		int code = raw->detail;
+		uint8_t bit = (uint8_t)(1 << (code % 8));
+
+		if (code < 0 || code > 255)
+			return;
+		/* ignore auto-repeat */
+		if (((context->key_state[code / 8] & bit) != 0) == down)
+			return;
+
+		if (down)
+			context->key_state[code / 8] |= bit;
+		else
+			context->key_state[code / 8] &= ~bit;
+
+		key = context->keycode_keys[code];
+
+	} else {
+		int button = raw->detail;
+
+		if (button < 0 || button > 31)
+			return;
+
+		if (down)
+			context->button_state |= 1U << button;
+		else
+			context->button_state &= ~(1U << button);
+
+		key = key_from_button(button);
+	}
+
+	if (key != OBS_KEY_NONE)
+		changed(param, key);
+}
+#endif
+
+bool obs_hotkeys_platform_wait_events(obs_hotkeys_platform_t *context,
+		uint32_t timeout_ms,
+		void (*changed)(void *param, obs_key_t key), void *param)
+{
+#if HAVE_XINPUT2
+	Display *display = context->event_display;
+
+	if (!context->event_driven)
+		return false;
+
+	if (!XPending(display)) {
+		struct pollfd fd = {ConnectionNumber(display), POLLIN, 0};
+		poll(&fd, 1, (int)timeout_ms);
+	}
+
+	while (XPending(display)) {
+		XEvent event;
+		XGenericEventCookie *cookie = &event.xcookie;
+
+		XNextEvent(display, &event);
+
+		if (cookie->type != GenericEvent ||
+		    cookie->extension != context->xi_opcode ||
+		    !XGetEventData(display, cookie))
+			continue;
+
+		handle_raw_event(context, cookie, changed, param);
+		XFreeEventData(display, cookie);
+	}
+
+	return true;
+#else
+	UNUSED_PARAMETER(context);
+	UNUSED_PARAMETER(timeout_ms);
+	UNUSED_PARAMETER(changed);
+	UNUSED_PARAMETER(param);
+	return false;
+#endif
+}
+
 static bool get_key_translation(struct dstr *dstr, xcb_keycode_t keycode)
 {
 	xcb_connection_t *connection;
@@ -94,6 +94,54 @@ static bool init_output_handlers(struct obs_output *output, const char *name,
 	return true;
 }
 
+static double get_bytes_sent(void *param)
+{
+	return (double)obs_output_get_total_bytes(param);
+}
+
+static double get_frames_dropped(void *param)
+{
+	return (double)obs_output_get_frames_dropped(param);
+}
+
+static double get_congestion(void *param)
+{
+	return (double)obs_output_get_congestion(param);
+}
+
+static void create_output_stats(struct obs_output *output)
+{
+	char *labels = obs_stat_label("output", output->context.name);
+	obs_stat_t *stat;
+
+#define add_sampled(name, help, type, func) \
+	do { \
+		stat = obs_stat_create_sampled(name, labels, help, type, \
+				func, output); \
+		da_push_back(output->stats, &stat); \
+	} while (false)
+
+	add_sampled("obs_output_bytes_sent_total", "Bytes sent by the output",
+			OBS_STAT_COUNTER, get_bytes_sent);
+	add_sampled("obs_output_frames_dropped_total",
+			"Frames dropped by the output", OBS_STAT_COUNTER,
+			get_frames_dropped);
+	add_sampled("obs_output_congestion",
+			"Output congestion, from 0 to 1", OBS_STAT_GAUGE,
+			get_congestion);
+
+#undef add_sampled
+
+	bfree(labels);
+}
+
+static void free_output_stats(struct obs_output *output)
+{
+	for (size_t i = 0; i < output->stats.num; i++)
+		obs_stat_destroy(output->stats.array[i]);
+	da_free(output->stats);
+}
+
 obs_output_t *obs_output_create(const char *id, const char *name,
 		obs_data_t *settings, obs_data_t *hotkey_data)
 {
@@ -153,6 +201,8 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 				output);
 	if (!output->context.data)
 		blog(LOG_ERROR, "Failed to create output '%s'!", name);
+	else
+		create_output_stats(output);
 
 	blog(LOG_DEBUG, "output '%s' (%s) created", name, id);
 	return output;
@@ -173,6 +223,7 @@ void obs_output_destroy(obs_output_t *output)
 {
 	if (output) {
 		obs_context_data_remove(&output->context);
+		free_output_stats(output);
 
 		blog(LOG_DEBUG, "output '%s' destroyed", output->context.name);
 
@@ -155,6 +155,12 @@ static void scene_destroy(void *data)
 
 	remove_all_items(scene);
 
+	if (scene->sprite_batch) {
+		obs_enter_graphics();
+		gs_sprite_batch_destroy(scene->sprite_batch);
+		obs_leave_graphics();
+	}
+
 	pthread_mutex_destroy(&scene->video_mutex);
 	pthread_mutex_destroy(&scene->audio_mutex);
 	bfree(scene);
@@ -425,8 +431,8 @@ static void render_item_texture(struct obs_scene_item *item)
 
 	if (type != OBS_SCALE_DISABLE) {
 		if (type == OBS_SCALE_POINT) {
-			gs_eparam_t *image = gs_effect_get_param_by_name(
-					effect, "image");
+			gs_eparam_t *image = gs_effect_get_param_by_id(
+					effect, obs->video.params.image);
 			gs_effect_set_next_sampler(image,
 					obs->video.point_sampler);
 
@@ -443,8 +449,8 @@ static void render_item_texture(struct obs_scene_item *item)
 				effect = obs->video.lanczos_effect;
 			}
 
-			scale_param = gs_effect_get_param_by_name(effect,
-					"base_dimension_i");
+			scale_param = gs_effect_get_param_by_id(effect,
+					obs->video.params.base_dimension_i);
 			if (scale_param) {
 				struct vec2 base_res_i = {
 					1.0f / (float)cx,
@@ -460,7 +466,58 @@ static void render_item_texture(struct obs_scene_item *item)
 		obs_source_draw(tex, 0, 0, 0, 0, 0);
 }
 
-static inline void render_item(struct obs_scene_item *item)
+/* whether render_item_texture would draw the item with the default effect and
+ * sampler, which is what allows it to be batched with other items */
+static inline bool item_default_effect(const struct obs_scene_item *item)
+{
+	enum obs_scale_type type = item->scale_filter;
+
+	if (type == OBS_SCALE_DISABLE)
+		return true;
+	if (type == OBS_SCALE_POINT)
+		return false;
+
+	if (close_float(item->output_scale.x, 1.0f, EPSILON) &&
+	    close_float(item->output_scale.y, 1.0f, EPSILON))
+		return true;
+
+	return type == OBS_SCALE_BILINEAR &&
+		item->output_scale.x >= 0.5f &&
+		item->output_scale.y >= 0.5f;
+}
+
+/* whether the crop and scale filter can be applied in the final draw of the
+ * item instead of rendering it to its texrender first */
+static inline bool item_direct_draw(const struct obs_scene_item *item)
+{
+	if (!item->item_render || item_is_scene(item))
+		return false;
+	if (!obs_source_can_draw_cropped(item->source))
+		return false;
+
+	return item->scale_filter == OBS_SCALE_POINT ||
+		item_default_effect(item);
+}
+
+static inline bool item_batchable(const struct obs_scene_item *item)
+{
+	return item->item_render && item_default_effect(item) &&
+		!item_direct_draw(item);
+}
+
+/* whether the source can add its texture to the batch itself, which lets
+ * items that show the same texture share a draw call */
+static inline bool item_source_batchable(const struct obs_scene_item *item)
+{
+	if (!obs_source_can_draw_batched(item->source))
+		return false;
+	if (!item->item_render)
+		return true;
+
+	return item_direct_draw(item) && item->scale_filter != OBS_SCALE_POINT;
+}
+
+static inline void update_item_texture(struct obs_scene_item *item)
 {
 	if (item->item_render) {
 		uint32_t width  = obs_source_get_width(item->source);
@@ -488,6 +545,48 @@ static inline void render_item(struct obs_scene_item *item)
 			gs_texrender_end(item->item_render);
 		}
 	}
+}
+
+static inline void batch_item(gs_sprite_batch_t *batch,
+		struct obs_scene_item *item)
+{
+	update_item_texture(item);
+
+	gs_matrix_push();
+	gs_matrix_mul(&item->draw_transform);
+	gs_sprite_batch_add(batch, gs_texrender_get_texture(item->item_render),
+			0, 0, 0);
+	gs_matrix_pop();
+}
+
+static inline void batch_item_source(gs_sprite_batch_t *batch,
+		struct obs_scene_item *item)
+{
+	gs_matrix_push();
+	gs_matrix_mul(&item->draw_transform);
+	obs_source_video_render_batched(item->source,
+			item->item_render ? &item->crop : NULL, batch);
+	gs_matrix_pop();
+}
+
+static inline void draw_batch(gs_sprite_batch_t *batch)
+{
+	if (gs_sprite_batch_count(batch))
+		gs_sprite_batch_draw(batch, obs->video.default_effect, "Draw");
+}
+
+static inline void render_item_direct(struct obs_scene_item *item)
+{
+	gs_matrix_push();
+	gs_matrix_mul(&item->draw_transform);
+	obs_source_video_render_cropped(item->source, &item->crop,
+			item->scale_filter == OBS_SCALE_POINT);
+	gs_matrix_pop();
+}
+
+static inline void render_item(struct obs_scene_item *item)
+{
+	update_item_texture(item);
 
 	gs_matrix_push();
 	gs_matrix_mul(&item->draw_transform);
@@ -516,20 +615,190 @@ static void scene_video_tick(void *data, float seconds)
 	UNUSED_PARAMETER(seconds);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Culling */
+
+static void get_item_box(const struct obs_scene_item *item,
+		struct vec3 *corners)
+{
+	uint32_t width  = obs_source_get_width(item->source);
+	uint32_t height = obs_source_get_height(item->source);
+	float cx = (float)(item->item_render ? calc_cx(item, width)  : width);
+	float cy = (float)(item->item_render ? calc_cy(item, height) : height);
+
+	vec3_set(corners,   0.0f, 0.0f, 0.0f);
+	vec3_set(corners+1,   cx, 0.0f, 0.0f);
+	vec3_set(corners+2, 0.0f,   cy, 0.0f);
+	vec3_set(corners+3,   cx,   cy, 0.0f);
+}
+
+static inline bool item_has_size(const struct obs_scene_item *item)
+{
+	return obs_source_get_width(item->source) &&
+		obs_source_get_height(item->source);
+}
+
+static bool item_outside_scene(const struct obs_scene_item *item,
+		float scene_cx, float scene_cy)
+{
+	struct vec3 corners[4];
+	struct vec3 min, max;
+
+	/* sources without a size might still draw something */
+	if (!item_has_size(item))
+		return false;
+
+	get_item_box(item, corners);
+
+	for (size_t i = 0; i < 4; i++)
+		vec3_transform(corners+i, corners+i, &item->draw_transform);
+
+	vec3_copy(&min, corners);
+	vec3_copy(&max, corners);
+	for (size_t i = 1; i < 4; i++) {
+		vec3_min(&min, &min, corners+i);
+		vec3_max(&max, &max, corners+i);
+	}
+
+	return max.x <= 0.0f || max.y <= 0.0f ||
+	       min.x >= scene_cx || min.y >= scene_cy;
+}
+
+/* checks whether the item covers the whole scene with opaque pixels, by
+ * transforming the scene corners into the item's space */
+static bool item_covers_scene(const struct obs_scene_item *item,
+		float scene_cx, float scene_cy)
+{
+	struct matrix4 inv;
+	struct vec3 box[4];
+	struct vec3 corners[4];
+
+	if (!item_has_size(item) || !obs_source_is_opaque(item->source))
+		return false;
+	if (!matrix4_inv(&inv, &item->draw_transform))
+		return false;
+
+	get_item_box(item, box);
+
+	vec3_set(corners,       0.0f,     0.0f, 0.0f);
+	vec3_set(corners+1, scene_cx,     0.0f, 0.0f);
+	vec3_set(corners+2,     0.0f, scene_cy, 0.0f);
+	vec3_set(corners+3, scene_cx, scene_cy, 0.0f);
+
+	for (size_t i = 0; i < 4; i++) {
+		struct vec3 *p = corners + i;
+		vec3_transform(p, p, &inv);
+
+		if (p->x < -EPSILON || p->y < -EPSILON ||
+		    p->x > box[3].x + EPSILON || p->y > box[3].y + EPSILON)
+			return false;
+	}
+
+	return true;
+}
+
+/* returns the topmost visible item that covers the whole scene, everything
+ * below it can be skipped */
+static struct obs_scene_item *find_occluder(struct obs_scene *scene,
+		float scene_cx, float scene_cy)
+{
+	struct obs_scene_item *item = scene->first_item;
+	struct obs_scene_item *occluder = NULL;
+
+	while (item) {
+		if (!obs_source_removed(item->source) && item->user_visible) {
+			if (source_size_changed(item))
+				update_item_transform(item);
+
+			if (item_covers_scene(item, scene_cx, scene_cy))
+				occluder = item;
+		}
+
+		item = item->next;
+	}
+
+	return occluder;
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool obs_scene_get_content_key(obs_scene_t *scene, uint64_t *key)
+{
+	struct obs_scene_item *item;
+	uint64_t hash = *key;
+	bool cacheable = true;
+
+	video_lock(scene);
+
+	for (item = scene->first_item; item; item = item->next) {
+		uint64_t child_key;
+
+		/* removed items are cleaned up while rendering, leaving them
+		 * out of the key makes sure that the scene is rendered */
+		if (obs_source_removed(item->source))
+			continue;
+
+		hash = obs_hash_data(hash, &item, sizeof(item));
+		hash = obs_hash_data(hash, &item->user_visible,
+				sizeof(item->user_visible));
+		if (!item->user_visible)
+			continue;
+
+		if (!obs_source_get_content_key(item->source, &child_key)) {
+			cacheable = false;
+			break;
+		}
+
+		hash = obs_hash_data(hash, &child_key, sizeof(child_key));
+		hash = obs_hash_data(hash, &item->draw_transform,
+				sizeof(item->draw_transform));
+		hash = obs_hash_data(hash, &item->crop, sizeof(item->crop));
+		hash = obs_hash_data(hash, &item->scale_filter,
+				sizeof(item->scale_filter));
+	}
+
+	video_unlock(scene);
+
+	*key = hash;
+	return cacheable;
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	DARRAY(struct obs_scene_item*) remove_items;
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
+	struct obs_scene_item *occluder = NULL;
+	bool culling = obs->video.culling;
+	float scene_cx = (float)obs->video.base_width;
+	float scene_cy = (float)obs->video.base_height;
+	bool occluded;
 
 	da_init(remove_items);
 
 	video_lock(scene);
+
+	if (culling)
+		occluder = find_occluder(scene, scene_cx, scene_cy);
+
+	/* items are drawn bottom to top, so everything before the occluder
+	 * is covered by it */
+	occluded = occluder != NULL;
 	item = scene->first_item;
 
+	if (!scene->sprite_batch)
+		scene->sprite_batch = gs_sprite_batch_create();
+
 	gs_blend_state_push();
 	gs_reset_blend_state();
 
+	/* the cache needs the correct alpha of the scene, see
+	 * update_render_cache in obs-source.c */
+	if (obs->video.cache_target == scene->source)
+		gs_blend_function_separate(GS_BLEND_SRCALPHA,
+				GS_BLEND_INVSRCALPHA, GS_BLEND_ONE,
+				GS_BLEND_INVSRCALPHA);
+
 	while (item) {
 		if (obs_source_removed(item->source)) {
 			struct obs_scene_item *del_item = item;
@@ -543,12 +812,39 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 		if (source_size_changed(item))
 			update_item_transform(item);
 
-		if (item->user_visible)
-			render_item(item);
+		/* consecutive items that are drawn as plain textures are
+		 * gathered and drawn together (with one draw call for items
+		 * that share a texture), anything else has to draw the items
+		 * gathered before it first to keep the item order */
+		if (item == occluder)
+			occluded = false;
+
+		if (item->user_visible && culling &&
+		    (occluded ||
+		     item_outside_scene(item, scene_cx, scene_cy))) {
+			obs_source_skip_video_render(item->source);
+			obs->video.items_culled_frame++;
+
+		} else if (item->user_visible) {
+			if (item_source_batchable(item)) {
+				batch_item_source(scene->sprite_batch, item);
+			} else if (item_batchable(item)) {
+				batch_item(scene->sprite_batch, item);
+			} else {
+				draw_batch(scene->sprite_batch);
+
+				if (item_direct_draw(item))
+					render_item_direct(item);
+				else
+					render_item(item);
+			}
+		}
 
 		item = item->next;
 	}
 
+	draw_batch(scene->sprite_batch);
+
 	gs_blend_state_pop();
 
 	video_unlock(scene);
@@ -776,7 +1072,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		new_frame_num = (timestamp - ts) * (uint64_t)sample_rate /
 			1000000000ULL;
 
-		if (ts && new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (ts && new_frame_num >= obs->audio.frames_per_tick)
 			break;
 
 		da_erase(item->audio_actions, i--);
@@ -794,7 +1090,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 	}
 
 	if (buf) {
-		for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+		for (; frame_num < obs->audio.frames_per_tick; frame_num++)
 			buf[frame_num] = cur_visible ? 1.0f : 0.0f;
 	}
 
@@ -823,7 +1119,7 @@ static bool apply_scene_item_volume(struct obs_scene_item *item,
 	pthread_mutex_unlock(&item->actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration = (uint64_t)AUDIO_OUTPUT_FRAMES *
+		uint64_t duration = (uint64_t)obs->audio.frames_per_tick *
 			1000000000ULL / (uint64_t)sample_rate;
 
 		if (!ts || action.timestamp < (ts + duration)) {
@@ -925,7 +1221,7 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 
 		pos = (size_t)ns_to_audio_frames(sample_rate,
 				source_ts - timestamp);
-		count = AUDIO_OUTPUT_FRAMES - pos;
+		count = obs->audio.frames_per_tick - pos;
 
 		if (!apply_buf && !item->visible) {
 			item = item->next;
@@ -0,0 +1,273 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "util/dstr.h"
+#include "obs-internal.h"
+
+/*
+ *   Every video filter normally renders its target to its own texture and
+ * then draws that texture with its effect, so a chain of N filters costs N
+ * full size passes.  When a filter that is being processed has a per-pixel
+ * function, it also takes over any directly following filters that have one,
+ * and draws all of them in a single pass of a generated effect that applies
+ * their functions in order.
+ *
+ *   Generated effects are kept for as long as libobs runs, keyed by their
+ * code.  Effects that fail to compile are kept as well (without an effect),
+ * so that the filters fall back to their own passes without trying to
+ * compile the same code every frame.
+ *
+ *   Each filter also remembers the effect it got for its list of fused
+ * filters.  As long as that list is the same and no filter has been updated
+ * or destroyed since, the effect is used without generating the code.
+ */
+
+static const char *fused_effect_header =
+"uniform float4x4 ViewProj;\n"
+"uniform texture2d image;\n"
+"\n"
+"sampler_state fused_sampler {\n"
+"\tFilter   = Linear;\n"
+"\tAddressU = Clamp;\n"
+"\tAddressV = Clamp;\n"
+"};\n"
+"\n"
+"struct FusedVertData {\n"
+"\tfloat4 pos : POSITION;\n"
+"\tfloat2 uv  : TEXCOORD0;\n"
+"};\n"
+"\n"
+"FusedVertData VSFused(FusedVertData v_in)\n"
+"{\n"
+"\tFusedVertData v_out;\n"
+"\tv_out.pos = mul(float4(v_in.pos.xyz, 1.0), ViewProj);\n"
+"\tv_out.uv  = v_in.uv;\n"
+"\treturn v_out;\n"
+"}\n"
+"\n";
+
+static const char *fused_effect_technique =
+"technique Draw\n"
+"{\n"
+"\tpass\n"
+"\t{\n"
+"\t\tvertex_shader = VSFused(v_in);\n"
+"\t\tpixel_shader  = PSFused(v_in);\n"
+"\t}\n"
+"}\n";
+
+static inline const char *get_pixel_function(obs_source_t *filter)
+{
+	if (!filter->context.data || !filter->info.get_pixel_function ||
+	    !filter->info.set_pixel_params)
+		return NULL;
+
+	/* the generated pass always draws at the size of the target */
+	if (filter->info.get_width || filter->info.get_height)
+		return NULL;
+
+	return filter->info.get_pixel_function(filter->context.data);
+}
+
+static inline void get_prefix(char *prefix, size_t size, size_t idx)
+{
+	snprintf(prefix, size, "f%d_", (int)idx);
+}
+
+static void build_fused_effect(struct dstr *code, obs_source_t *filter)
+{
+	struct dstr func = {0};
+	char prefix[16];
+	size_t num = filter->fused_filters.num;
+
+	dstr_copy(code, fused_effect_header);
+
+	for (size_t i = num; i > 0; i--) {
+		obs_source_t *fused = filter->fused_filters.array[i - 1];
+
+		get_prefix(prefix, sizeof(prefix), i - 1);
+		dstr_copy(&func, get_pixel_function(fused));
+		dstr_replace(&func, "$", prefix);
+
+		dstr_catf(code, "/* %s */\n", fused->info.id);
+		dstr_cat_dstr(code, &func);
+		dstr_cat(code, "\n\n");
+	}
+
+	dstr_cat(code, "float4 PSFused(FusedVertData v_in) : TARGET\n"
+	               "{\n"
+	               "\tfloat4 rgba = image.Sample(fused_sampler, v_in.uv);\n");
+
+	/* the filter closest to the source is applied first */
+	for (size_t i = num; i > 0; i--)
+		dstr_catf(code, "\trgba = f%d_process(rgba, v_in.uv);\n",
+				(int)(i - 1));
+
+	dstr_cat(code, "\treturn rgba;\n}\n\n");
+	dstr_cat(code, fused_effect_technique);
+
+	dstr_free(&func);
+}
+
+static gs_effect_t *find_fused_effect(obs_source_t *filter)
+{
+	struct obs_core_video *video = &obs->video;
+	struct fused_effect *fused;
+	struct dstr code = {0};
+	char *errors = NULL;
+
+	build_fused_effect(&code, filter);
+
+	for (size_t i = 0; i < video->fused_effects.num; i++) {
+		fused = video->fused_effects.array + i;
+
+		if (strcmp(fused->source, code.array) == 0) {
+			dstr_free(&code);
+			return fused->effect;
+		}
+	}
+
+	fused = da_push_back_new(video->fused_effects);
+	fused->source = code.array;
+	fused->effect = gs_effect_create(code.array, "fused filters",
+			&errors);
+
+	if (!fused->effect)
+		blog(LOG_WARNING, "Failed to compile the fused effect of "
+		                  "filter '%s', filters will be drawn "
+		                  "separately:\n%s",
+		                  filter->context.name,
+		                  errors ? errors : "(unknown error)");
+	else
+		blog(LOG_DEBUG, "Compiled fused effect for %d filters of "
+		                "'%s'",
+		                (int)filter->fused_filters.num,
+		                filter->filter_parent->context.name);
+
+	bfree(errors);
+	return fused->effect;
+}
+
+static inline bool fused_key_matches(obs_source_t *filter, long version)
+{
+	size_t size = filter->fused_filters.num * sizeof(obs_source_t*);
+
+	return filter->fused_key_version == version &&
+		filter->fused_key.num == filter->fused_filters.num &&
+		memcmp(filter->fused_key.array, filter->fused_filters.array,
+				size) == 0;
+}
+
+static gs_effect_t *get_fused_effect(obs_source_t *filter)
+{
+	long version = os_atomic_load_long(&obs->video.fused_version);
+
+	if (!fused_key_matches(filter, version)) {
+		da_copy(filter->fused_key, filter->fused_filters);
+		filter->fused_key_version = version;
+		filter->fused_key_effect  = find_fused_effect(filter);
+	}
+
+	return filter->fused_key_effect;
+}
+
+/* returns the target that has to be rendered for the filter, which skips
+ * past any filters that are fused into the pass of this one */
+obs_source_t *obs_source_fuse_filters(obs_source_t *filter)
+{
+	obs_source_t *parent = filter->filter_parent;
+	obs_source_t *target = filter->filter_target;
+
+	da_resize(filter->fused_filters, 0);
+	filter->fused_effect = NULL;
+
+	if (!obs->video.filter_fusion || !get_pixel_function(filter))
+		return target;
+
+	da_push_back(filter->fused_filters, &filter);
+
+	while (target && target != parent) {
+		/* disabled filters just draw their own target */
+		if (target->enabled) {
+			if (!get_pixel_function(target))
+				break;
+			da_push_back(filter->fused_filters, &target);
+		}
+
+		target = target->filter_target;
+	}
+
+	if (filter->fused_filters.num > 1)
+		filter->fused_effect = get_fused_effect(filter);
+
+	if (!filter->fused_effect) {
+		da_resize(filter->fused_filters, 0);
+		return filter->filter_target;
+	}
+
+	filter->fused_target = target;
+	return target;
+}
+
+void obs_source_set_fused_params(obs_source_t *filter)
+{
+	char prefix[16];
+
+	for (size_t i = 0; i < filter->fused_filters.num; i++) {
+		obs_source_t *fused = filter->fused_filters.array[i];
+
+		get_prefix(prefix, sizeof(prefix), i);
+		fused->info.set_pixel_params(fused->context.data,
+				filter->fused_effect, prefix);
+	}
+}
+
+gs_eparam_t *obs_filter_get_fused_param(gs_effect_t *effect,
+		const char *prefix, const char *name)
+{
+	struct dstr full_name = {0};
+	gs_eparam_t *param;
+
+	if (!obs_ptr_valid(prefix, "obs_filter_get_fused_param"))
+		return NULL;
+	if (!obs_ptr_valid(name, "obs_filter_get_fused_param"))
+		return NULL;
+
+	dstr_copy(&full_name, prefix);
+	dstr_cat(&full_name, name);
+	param = gs_effect_get_param_by_name(effect, full_name.array);
+	dstr_free(&full_name);
+
+	return param;
+}
+
+void obs_free_fused_effects(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->fused_effects.num; i++) {
+		struct fused_effect *fused = video->fused_effects.array + i;
+
+		gs_effect_destroy(fused->effect);
+		bfree(fused->source);
+	}
+
+	da_free(video->fused_effects);
+
+	/* filters must not use the effects they remember */
+	os_atomic_inc_long(&video->fused_version);
+}
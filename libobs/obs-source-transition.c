@@ -365,6 +365,9 @@ bool obs_transition_start(obs_source_t *transition,
 	if (same_as_source && !active)
 		return false;
 
+	if (dest)
+		obs_source_preload(dest);
+
 	if (transition->transition_use_fixed_duration)
 		duration_ms = transition->transition_fixed_duration;
 
@@ -770,7 +773,7 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 	obs_source_get_audio_mix(child, &child_audio);
 	pos = (size_t)ns_to_audio_frames(sample_rate, ts - min_ts);
 
-	if (pos > AUDIO_OUTPUT_FRAMES)
+	if (pos > obs->audio.frames_per_tick)
 		return;
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
@@ -785,7 +788,7 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 			float *in = input->data[ch];
 
 			mix_child(transition, out + pos, in,
-					AUDIO_OUTPUT_FRAMES - pos,
+					obs->audio.frames_per_tick - pos,
 					sample_rate, ts, mix);
 		}
 	}
@@ -805,9 +808,22 @@ static inline uint64_t calc_min_ts(obs_source_t *sources[2])
 	return min_ts;
 }
 
-#define TOTAL_AUDIO_SIZE \
-	(MAX_AUDIO_MIXES * MAX_AUDIO_CHANNELS * \
-	 AUDIO_OUTPUT_FRAMES * sizeof(float))
+/* the mixes of a source can point to each other, so each one is copied on
+ * its own */
+static void copy_child_audio(struct obs_source_audio_mix *audio,
+		obs_source_t *child)
+{
+	struct obs_source_audio_mix child_audio;
+
+	obs_source_get_audio_mix(child, &child_audio);
+
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+		for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++)
+			memcpy(audio->output[mix].data[ch],
+					child_audio.output[mix].data[ch],
+					AUDIO_OUTPUT_FRAMES * sizeof(float));
+	}
+}
 
 static inline bool stop_audio(obs_source_t *transition)
 {
@@ -872,9 +888,7 @@ bool obs_transition_audio_render(obs_source_t *transition,
 						min_ts, mixers, channels,
 						sample_rate, mix_b);
 		} else if (state.s[0]) {
-			memcpy(audio->output[0].data[0],
-					state.s[0]->audio_output_buf[0][0],
-					TOTAL_AUDIO_SIZE);
+			copy_child_audio(audio, state.s[0]);
 		}
 
 		obs_source_release(state.s[0]);
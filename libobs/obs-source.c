@@ -108,12 +108,34 @@ static void allocate_audio_output_buffer(struct obs_source *source)
 		size_t mix_pos = mix * AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS;
 
 		for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
-			source->audio_output_buf[mix][i] =
+			source->audio_output_storage[mix][i] =
 				ptr + mix_pos + AUDIO_OUTPUT_FRAMES * i;
+			source->audio_output_buf[mix][i] =
+				source->audio_output_storage[mix][i];
 		}
 	}
 }
 
+static double get_audio_copied(void *param)
+{
+	struct obs_source *source = param;
+	return (double)(source->audio_ingest_copied +
+			source->audio_render_copied);
+}
+
+static void create_audio_stats(struct obs_source *source)
+{
+	char *labels = obs_stat_label("source", source->context.name);
+
+	source->audio_copied_stat = obs_stat_create_sampled(
+			"obs_source_audio_bytes_copied_total", labels,
+			"Bytes of audio copied between the input of the "
+			"source and its mixes", OBS_STAT_COUNTER,
+			get_audio_copied, source);
+
+	bfree(labels);
+}
+
 static inline bool is_async_video_source(const struct obs_source *source)
 {
 	return (source->info.output_flags & OBS_SOURCE_ASYNC_VIDEO) ==
@@ -165,6 +187,9 @@ bool obs_source_init(struct obs_source *source)
 
 	if (is_audio_source(source) || is_composite_source(source))
 		allocate_audio_output_buffer(source);
+	if (is_audio_source(source) &&
+	    source->info.type == OBS_SOURCE_TYPE_INPUT)
+		create_audio_stats(source);
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION) {
 		if (!obs_transition_init(source))
@@ -490,10 +515,40 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
-static inline void obs_source_frame_decref(struct obs_source_frame *frame)
+static inline struct borrowed_frame *find_borrowed_frame(
+		struct obs_source *source, struct obs_source_frame *frame)
 {
-	if (os_atomic_dec_long(&frame->refs) == 0)
+	for (size_t i = 0; i < source->borrowed_frames.num; i++) {
+		struct borrowed_frame *bf = source->borrowed_frames.array + i;
+		if (bf->frame == frame)
+			return bf;
+	}
+
+	return NULL;
+}
+
+/* borrowed frames are given back to the source instead of being freed */
+static void async_frame_destroy(struct obs_source *source,
+		struct obs_source_frame *frame)
+{
+	struct borrowed_frame *bf = find_borrowed_frame(source, frame);
+
+	if (bf) {
+		struct borrowed_frame borrowed = *bf;
+
+		da_erase_item(source->borrowed_frames, bf);
+		borrowed.release(borrowed.param);
+		bfree(frame);
+	} else {
 		obs_source_frame_destroy(frame);
+	}
+}
+
+static inline void obs_source_frame_decref(struct obs_source *source,
+		struct obs_source_frame *frame)
+{
+	if (os_atomic_dec_long(&frame->refs) == 0)
+		async_frame_destroy(source, frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -520,11 +575,14 @@ void obs_source_destroy(struct obs_source *source)
 
 	if (source->filter_parent)
 		obs_source_filter_remove_refless(source->filter_parent, source);
+	if (source->info.type == OBS_SOURCE_TYPE_FILTER)
+		os_atomic_inc_long(&obs->video.fused_version);
 
 	while (source->filters.num)
 		obs_source_filter_remove(source, source->filters.array[0]);
 
 	obs_context_data_remove(&source->context);
+	obs_stat_destroy(source->audio_copied_stat);
 
 	blog(LOG_DEBUG, "%ssource '%s' destroyed",
 			source->context.private ? "private " : "",
@@ -544,7 +602,8 @@ void obs_source_destroy(struct obs_source *source)
 	obs_hotkey_pair_unregister(source->mute_unmute_key);
 
 	for (i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+		obs_source_frame_decref(source,
+				source->async_cache.array[i].frame);
 
 	gs_enter_context(obs->video.graphics);
 	if (source->async_texrender)
@@ -557,14 +616,16 @@ void obs_source_destroy(struct obs_source *source)
 		gs_texture_destroy(source->async_prev_texture);
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	if (source->cache_texrender)
+		gs_texrender_destroy(source->cache_texrender);
 	gs_leave_context();
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
-		bfree(source->audio_data.data[i]);
+		bfree(source->audio_storage[i]);
 	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
 		circlebuf_free(&source->audio_input_buf[i]);
 	audio_resampler_destroy(source->resampler);
-	bfree(source->audio_output_buf[0][0]);
+	bfree(source->audio_output_storage[0][0]);
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_free(source);
@@ -573,7 +634,10 @@ void obs_source_destroy(struct obs_source *source)
 	da_free(source->audio_cb_list);
 	da_free(source->async_cache);
 	da_free(source->async_frames);
+	da_free(source->borrowed_frames);
 	da_free(source->filters);
+	da_free(source->fused_filters);
+	da_free(source->fused_key);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_actions_mutex);
 	pthread_mutex_destroy(&source->audio_buf_mutex);
@@ -763,6 +827,9 @@ static void obs_source_deferred_update(obs_source_t *source)
 		source->info.update(source->context.data,
 				source->context.settings);
 
+	os_atomic_inc_long(&source->content_version);
+	if (source->info.type == OBS_SOURCE_TYPE_FILTER)
+		os_atomic_inc_long(&obs->video.fused_version);
 	source->defer_update = false;
 }
 
@@ -782,6 +849,14 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	}
 }
 
+void obs_source_invalidate_cache(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_invalidate_cache"))
+		return;
+
+	os_atomic_inc_long(&source->content_version);
+}
+
 void obs_source_update_properties(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_update_properties"))
@@ -1144,6 +1219,7 @@ static void source_output_audio_place(obs_source_t *source,
 				(buf_placement + size));
 	}
 
+	source->audio_ingest_copied += size * channels;
 	source->last_audio_input_buf_size = 0;
 }
 
@@ -1162,6 +1238,8 @@ static inline void source_output_audio_push_back(obs_source_t *source,
 		circlebuf_push_back(&source->audio_input_buf[i],
 				in->data[i], size);
 
+	source->audio_ingest_copied += size * channels;
+
 	/* reset audio input buffer size to ensure that audio doesn't get
 	 * perpetually cut */
 	source->last_audio_input_buf_size = 0;
@@ -1593,6 +1671,75 @@ bool update_async_texture(struct obs_source *source,
 	return true;
 }
 
+/* whether the sprite can be added to the batch of
+ * obs_source_video_render_batched, which is drawn with the default effect */
+static inline bool draw_batched(void)
+{
+	gs_effect_t *effect = obs->video.default_effect;
+
+	if (!obs->video.draw_batch || obs->video.draw_point_sampled)
+		return false;
+	if (gs_get_effect() != effect)
+		return false;
+
+	return gs_effect_get_current_technique(effect) ==
+		gs_effect_get_technique(effect, "Draw");
+}
+
+/* draws the current crop subregion of the texture if the source is being
+ * rendered with obs_source_video_render_cropped */
+static void draw_source_sprite(gs_texture_t *tex, uint32_t flip,
+		uint32_t cx, uint32_t cy)
+{
+	const struct obs_sceneitem_crop *crop = &obs->video.draw_crop;
+	gs_sprite_batch_t *batch = draw_batched() ?
+		obs->video.draw_batch : NULL;
+	float tex_cx, tex_cy;
+	float scale_x, scale_y;
+	float crop_cx, crop_cy;
+	uint32_t sub_x, sub_y;
+
+	if (!obs->video.draw_cropped) {
+		if (batch)
+			gs_sprite_batch_add(batch, tex, flip, cx, cy);
+		else
+			gs_draw_sprite(tex, flip, cx, cy);
+		return;
+	}
+
+	tex_cx  = (float)gs_texture_get_width(tex);
+	tex_cy  = (float)gs_texture_get_height(tex);
+	scale_x = tex_cx / (cx ? (float)cx : tex_cx);
+	scale_y = tex_cy / (cy ? (float)cy : tex_cy);
+
+	crop_cx = tex_cx - (float)(crop->left + crop->right) * scale_x;
+	crop_cy = tex_cy - (float)(crop->top + crop->bottom) * scale_y;
+	if (crop_cx < 1.0f || crop_cy < 1.0f)
+		return;
+
+	/* the visible top of a flipped texture is at its bottom */
+	sub_x = (uint32_t)((float)crop->left * scale_x);
+	sub_y = (uint32_t)((float)((flip & GS_FLIP_V) ?
+			crop->bottom : crop->top) * scale_y);
+
+	/* subregions are drawn at texture size */
+	gs_matrix_push();
+	gs_matrix_scale3f(1.0f / scale_x, 1.0f / scale_y, 1.0f);
+	if (batch)
+		gs_sprite_batch_add_subregion(batch, tex, flip, sub_x, sub_y,
+				(uint32_t)crop_cx, (uint32_t)crop_cy);
+	else
+		gs_draw_sprite_subregion(tex, flip, sub_x, sub_y,
+				(uint32_t)crop_cx, (uint32_t)crop_cy);
+	gs_matrix_pop();
+}
+
+static inline void set_draw_sampler(gs_eparam_t *image)
+{
+	if (obs->video.draw_point_sampled)
+		gs_effect_set_next_sampler(image, obs->video.point_sampler);
+}
+
 static inline void obs_source_draw_texture(struct obs_source *source,
 		gs_effect_t *effect, float *color_matrix,
 		float const *color_range_min, float const *color_range_max)
@@ -1605,25 +1752,29 @@ static inline void obs_source_draw_texture(struct obs_source *source,
 
 	if (color_range_min) {
 		size_t const size = sizeof(float) * 3;
-		param = gs_effect_get_param_by_name(effect, "color_range_min");
+		param = gs_effect_get_param_by_id(effect,
+				obs->video.params.color_range_min);
 		gs_effect_set_val(param, color_range_min, size);
 	}
 
 	if (color_range_max) {
 		size_t const size = sizeof(float) * 3;
-		param = gs_effect_get_param_by_name(effect, "color_range_max");
+		param = gs_effect_get_param_by_id(effect,
+				obs->video.params.color_range_max);
 		gs_effect_set_val(param, color_range_max, size);
 	}
 
 	if (color_matrix) {
-		param = gs_effect_get_param_by_name(effect, "color_matrix");
+		param = gs_effect_get_param_by_id(effect,
+				obs->video.params.color_matrix);
 		gs_effect_set_val(param, color_matrix, sizeof(float) * 16);
 	}
 
-	param = gs_effect_get_param_by_name(effect, "image");
+	param = gs_effect_get_param_by_id(effect, obs->video.params.image);
 	gs_effect_set_texture(param, tex);
+	set_draw_sampler(param);
 
-	gs_draw_sprite(tex, source->async_flip ? GS_FLIP_V : 0, 0, 0);
+	draw_source_sprite(tex, source->async_flip ? GS_FLIP_V : 0, 0, 0);
 }
 
 static void obs_source_draw_async_texture(struct obs_source *source)
@@ -1725,12 +1876,8 @@ static inline void obs_source_main_render(obs_source_t *source)
 
 static bool ready_async_frame(obs_source_t *source, uint64_t sys_time);
 
-static inline void render_video(obs_source_t *source)
+static inline void update_async_video(obs_source_t *source)
 {
-	if (source->info.type != OBS_SOURCE_TYPE_FILTER &&
-	    (source->info.output_flags & OBS_SOURCE_VIDEO) == 0)
-		return;
-
 	if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
 	    (source->info.output_flags & OBS_SOURCE_ASYNC) != 0 &&
 	    !source->rendering_filter) {
@@ -1738,13 +1885,176 @@ static inline void render_video(obs_source_t *source)
 			deinterlace_update_async_video(source);
 		obs_source_update_async_video(source);
 	}
+}
 
-	if (!source->context.data || !source->enabled) {
-		if (source->filter_parent)
-			obs_source_skip_video_filter(source);
-		return;
+bool obs_source_get_content_key(obs_source_t *source, uint64_t *key)
+{
+	uint64_t hash = OBS_HASH_INIT;
+	bool cacheable = true;
+	long version;
+	uint32_t cx, cy;
+
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE) {
+		obs_scene_t *scene = obs_scene_from_source(source);
+		if (!obs_scene_get_content_key(scene, &hash))
+			return false;
+
+	} else if ((source->info.output_flags & OBS_SOURCE_CACHEABLE) == 0) {
+		return false;
+	}
+
+	version = os_atomic_load_long(&source->content_version);
+	cx = obs_source_get_width(source);
+	cy = obs_source_get_height(source);
+
+	hash = obs_hash_data(hash, &version, sizeof(version));
+	hash = obs_hash_data(hash, &source->enabled, sizeof(source->enabled));
+	hash = obs_hash_data(hash, &cx, sizeof(cx));
+	hash = obs_hash_data(hash, &cy, sizeof(cy));
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		uint32_t flags = filter->info.output_flags;
+
+		if (filter->enabled && (flags & OBS_SOURCE_CACHEABLE) == 0) {
+			cacheable = false;
+			break;
+		}
+
+		version = os_atomic_load_long(&filter->content_version);
+		hash = obs_hash_data(hash, &filter, sizeof(filter));
+		hash = obs_hash_data(hash, &version, sizeof(version));
+		hash = obs_hash_data(hash, &filter->enabled,
+				sizeof(filter->enabled));
 	}
 
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	*key = hash;
+	return cacheable;
+}
+
+static inline bool cache_worthwhile(obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (source->info.type != OBS_SOURCE_TYPE_INPUT &&
+	    source->info.type != OBS_SOURCE_TYPE_SCENE)
+		return false;
+
+	/* the source is drawn for a filter of its own, or the cache would be
+	 * drawn with another effect than the one that is currently active */
+	if (source->rendering_filter || gs_get_effect())
+		return false;
+
+	/* an unfiltered single texture is as cheap to draw as the cache */
+	return source->filters.num || (flags & OBS_SOURCE_SINGLE_TEXTURE) == 0;
+}
+
+static inline void free_render_cache(obs_source_t *source)
+{
+	if (source->cache_texrender) {
+		gs_texrender_destroy(source->cache_texrender);
+		source->cache_texrender = NULL;
+	}
+
+	source->cache_valid = false;
+}
+
+static void render_source_video(obs_source_t *source);
+
+static bool update_render_cache(obs_source_t *source)
+{
+	uint32_t cx = obs_source_get_width(source);
+	uint32_t cy = obs_source_get_height(source);
+	obs_source_t *prev_target;
+	struct vec4 clear_color;
+
+	if (!cx || !cy)
+		return false;
+
+	if (!source->cache_texrender)
+		source->cache_texrender = gs_texrender_create(GS_RGBA,
+				GS_ZS_NONE);
+
+	gs_texrender_reset(source->cache_texrender);
+	if (!gs_texrender_begin(source->cache_texrender, cx, cy))
+		return false;
+
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	/* accumulate the correct alpha so the cache can be drawn like the
+	 * source itself with the premultiplied alpha effect */
+	gs_blend_state_push();
+	gs_enable_blending(true);
+	gs_blend_function_separate(GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA,
+			GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	prev_target = obs->video.cache_target;
+	obs->video.cache_target = source;
+	render_source_video(source);
+	obs->video.cache_target = prev_target;
+
+	gs_blend_state_pop();
+	gs_texrender_end(source->cache_texrender);
+	return true;
+}
+
+static void draw_render_cache(obs_source_t *source)
+{
+	gs_effect_t  *effect = obs->video.premultiplied_alpha_effect;
+	gs_texture_t *tex = gs_texrender_get_texture(source->cache_texrender);
+	gs_eparam_t  *image = gs_effect_get_param_by_name(effect, "image");
+
+	gs_effect_set_texture(image, tex);
+	set_draw_sampler(image);
+
+	while (gs_effect_loop(effect, "Draw"))
+		draw_source_sprite(tex, 0, 0, 0);
+}
+
+/* draws the cached output of the source if its content key is unchanged,
+ * content is only cached once it has stayed the same for a frame so that
+ * animated sources don't pay for rendering to the cache every frame */
+static bool render_cached(obs_source_t *source)
+{
+	uint64_t key;
+
+	if (!cache_worthwhile(source))
+		return false;
+
+	if (!obs_source_get_content_key(source, &key)) {
+		if (source->cache_texrender)
+			free_render_cache(source);
+		return false;
+	}
+
+	if (key != source->cache_prev_key) {
+		source->cache_prev_key = key;
+		return false;
+	}
+
+	if (!source->cache_valid || source->cache_key != key) {
+		source->cache_valid = update_render_cache(source);
+		source->cache_key = key;
+		obs->video.cache_misses++;
+
+		if (!source->cache_valid)
+			return false;
+	} else {
+		obs->video.cache_hits++;
+	}
+
+	draw_render_cache(source);
+	return true;
+}
+
+static void render_source_video(obs_source_t *source)
+{
 	if (source->filters.num && !source->rendering_filter)
 		obs_source_render_filters(source);
 
@@ -1761,6 +2071,24 @@ static inline void render_video(obs_source_t *source)
 		obs_source_render_async_video(source);
 }
 
+static inline void render_video(obs_source_t *source)
+{
+	if (source->info.type != OBS_SOURCE_TYPE_FILTER &&
+	    (source->info.output_flags & OBS_SOURCE_VIDEO) == 0)
+		return;
+
+	update_async_video(source);
+
+	if (!source->context.data || !source->enabled) {
+		if (source->filter_parent)
+			obs_source_skip_video_filter(source);
+		return;
+	}
+
+	if (!render_cached(source))
+		render_source_video(source);
+}
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_video_render"))
@@ -1771,6 +2099,98 @@ void obs_source_video_render(obs_source_t *source)
 	obs_source_release(source);
 }
 
+static void skip_child_video_render(obs_source_t *parent, obs_source_t *child,
+		void *param)
+{
+	update_async_video(child);
+
+	UNUSED_PARAMETER(parent);
+	UNUSED_PARAMETER(param);
+}
+
+/* async frames have to be consumed even if a source isn't drawn, otherwise
+ * they pile up until the frame cache is flushed */
+void obs_source_skip_video_render(obs_source_t *source)
+{
+	update_async_video(source);
+	obs_source_enum_active_tree(source, skip_child_video_render, NULL);
+}
+
+static inline bool format_has_alpha(enum video_format format)
+{
+	return format == VIDEO_FORMAT_RGBA || format == VIDEO_FORMAT_BGRA;
+}
+
+bool obs_source_is_opaque(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (source->filters.num || !source->enabled)
+		return false;
+	if ((flags & OBS_SOURCE_OPAQUE) != 0)
+		return true;
+	if (source->info.is_opaque && source->context.data)
+		return source->info.is_opaque(source->context.data);
+
+	return (flags & OBS_SOURCE_ASYNC) != 0 && !source->info.video_render &&
+		source->async_active && !format_has_alpha(source->async_format);
+}
+
+bool obs_source_can_draw_cropped(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (source->filters.num || deinterlacing_enabled(source))
+		return false;
+	if ((flags & OBS_SOURCE_SINGLE_TEXTURE) != 0)
+		return true;
+
+	return (flags & OBS_SOURCE_ASYNC) != 0 && !source->info.video_render;
+}
+
+/* whether the source only draws a single texture with the default effect,
+ * see obs_source_default_render */
+bool obs_source_can_draw_batched(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (source->filters.num)
+		return false;
+	if ((flags & (OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_ASYNC)) != 0)
+		return false;
+
+	return (flags & OBS_SOURCE_SINGLE_TEXTURE) != 0;
+}
+
+void obs_source_video_render_cropped(obs_source_t *source,
+		const struct obs_sceneitem_crop *crop, bool point_sampled)
+{
+	struct obs_core_video *video = &obs->video;
+
+	video->draw_crop          = *crop;
+	video->draw_cropped       = true;
+	video->draw_point_sampled = point_sampled;
+
+	obs_source_video_render(source);
+
+	video->draw_cropped       = false;
+	video->draw_point_sampled = false;
+}
+
+void obs_source_video_render_batched(obs_source_t *source,
+		const struct obs_sceneitem_crop *crop,
+		gs_sprite_batch_t *batch)
+{
+	obs->video.draw_batch = batch;
+
+	if (crop)
+		obs_source_video_render_cropped(source, crop, false);
+	else
+		obs_source_video_render(source);
+
+	obs->video.draw_batch = NULL;
+}
+
 static uint32_t get_base_width(const obs_source_t *source)
 {
 	bool is_filter = (source->info.type == OBS_SOURCE_TYPE_FILTER);
@@ -2232,7 +2652,8 @@ static inline bool async_texture_changed(struct obs_source *source,
 static inline void free_async_cache(struct obs_source *source)
 {
 	for (size_t i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+		obs_source_frame_decref(source,
+				source->async_cache.array[i].frame);
 
 	da_resize(source->async_cache, 0);
 	da_resize(source->async_frames, 0);
@@ -2250,7 +2671,7 @@ static void clean_cache(obs_source_t *source)
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				async_frame_destroy(source, af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
@@ -2293,7 +2714,7 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 	clean_cache(source);
 
 	if (!new_frame) {
-		struct async_frame new_af;
+		struct async_frame new_af = {0};
 		enum video_format format = frame->format;
 
 		if (format == VIDEO_FORMAT_Y800)
@@ -2347,6 +2768,131 @@ void obs_source_output_video(obs_source_t *source,
 	}
 }
 
+#define MAX_BORROWED_FRAMES 2
+
+static bool has_async_filters(struct obs_source *source)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		struct obs_source *filter = source->filters.array[i];
+		if (filter->enabled && filter->info.filter_video) {
+			found = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+	return found;
+}
+
+/* wraps a borrowed frame without copying its data.  async filters and
+ * deinterlacing may hold on to frames for an arbitrary amount of time, and
+ * Y800 needs conversion, so those cases use the copy path. */
+static struct obs_source_frame *borrow_video(struct obs_source *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param)
+{
+	struct obs_source_frame *new_frame = NULL;
+	struct async_frame new_af = {0};
+	struct borrowed_frame borrowed;
+
+	if (frame->format == VIDEO_FORMAT_Y800)
+		return NULL;
+	if (deinterlacing_enabled(source) || has_async_filters(source))
+		return NULL;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_frames.num >= MAX_ASYNC_FRAMES)
+		goto exit;
+	if (source->borrowed_frames.num >= MAX_BORROWED_FRAMES)
+		goto exit;
+
+	if (async_texture_changed(source, frame)) {
+		free_async_cache(source);
+		source->async_cache_width  = frame->width;
+		source->async_cache_height = frame->height;
+		source->async_cache_format = frame->format;
+	}
+
+	new_frame = bmalloc(sizeof(*new_frame));
+	*new_frame = *frame;
+	new_frame->refs       = 1;
+	new_frame->prev_frame = false;
+
+	borrowed.frame   = new_frame;
+	borrowed.release = release;
+	borrowed.param   = param;
+	da_push_back(source->borrowed_frames, &borrowed);
+
+	new_af.frame    = new_frame;
+	new_af.used     = true;
+	new_af.borrowed = true;
+	da_push_back(source->async_cache, &new_af);
+
+	da_push_back(source->async_frames, &new_frame);
+
+exit:
+	pthread_mutex_unlock(&source->async_mutex);
+	return new_frame;
+}
+
+void obs_source_output_video_borrowed(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param)
+{
+	if (!obs_source_valid(source, "obs_source_output_video_borrowed") ||
+	    !frame || !release) {
+		obs_source_output_video(source, frame);
+		if (release)
+			release(param);
+		return;
+	}
+
+	if (borrow_video(source, frame, release, param)) {
+		source->async_active = true;
+	} else {
+		obs_source_output_video(source, frame);
+		release(param);
+	}
+}
+
+void obs_source_flush_borrowed_video(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_flush_borrowed_video"))
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	for (size_t i = source->async_frames.num; i > 0; i--) {
+		struct obs_source_frame *frame =
+			source->async_frames.array[i - 1];
+		if (find_borrowed_frame(source, frame))
+			da_erase(source->async_frames, i - 1);
+	}
+
+	if (source->cur_async_frame &&
+	    find_borrowed_frame(source, source->cur_async_frame))
+		source->cur_async_frame = NULL;
+	if (source->prev_async_frame &&
+	    find_borrowed_frame(source, source->prev_async_frame))
+		source->prev_async_frame = NULL;
+
+	for (size_t i = source->async_cache.num; i > 0; i--) {
+		struct async_frame *af = &source->async_cache.array[i - 1];
+		if (af->borrowed) {
+			struct obs_source_frame *frame = af->frame;
+			da_erase(source->async_cache, i - 1);
+			obs_source_frame_decref(source, frame);
+		}
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
 		struct obs_audio_data *in)
 {
@@ -2403,29 +2949,67 @@ static inline void reset_resampler(obs_source_t *source,
 		blog(LOG_ERROR, "creation of resampler failed");
 }
 
-static void copy_audio_data(obs_source_t *source,
+static void set_audio_data(obs_source_t *source,
 		const uint8_t *const data[], uint32_t frames, uint64_t ts)
 {
-	size_t planes    = audio_output_get_planes(obs->audio.audio);
-	size_t blocksize = audio_output_get_block_size(obs->audio.audio);
-	size_t size      = (size_t)frames * blocksize;
-	bool   resize    = source->audio_storage_size < size;
+	size_t planes = audio_output_get_planes(obs->audio.audio);
 
 	source->audio_data.frames    = frames;
 	source->audio_data.timestamp = ts;
 
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		source->audio_data.data[i] =
+			i < planes ? (uint8_t*)data[i] : NULL;
+}
+
+/* copies the current audio data to storage owned by the source */
+static void copy_audio_data(obs_source_t *source)
+{
+	size_t planes    = audio_output_get_planes(obs->audio.audio);
+	size_t blocksize = audio_output_get_block_size(obs->audio.audio);
+	size_t size      = (size_t)source->audio_data.frames * blocksize;
+	bool   resize    = source->audio_storage_size < size;
+
 	for (size_t i = 0; i < planes; i++) {
 		/* ensure audio storage capacity */
 		if (resize) {
-			bfree(source->audio_data.data[i]);
-			source->audio_data.data[i] = bmalloc(size);
+			bfree(source->audio_storage[i]);
+			source->audio_storage[i] = bmalloc(size);
 		}
 
-		memcpy(source->audio_data.data[i], data[i], size);
+		memcpy(source->audio_storage[i], source->audio_data.data[i],
+				size);
+		source->audio_data.data[i] = source->audio_storage[i];
 	}
 
 	if (resize)
 		source->audio_storage_size = size;
+
+	source->audio_ingest_copied += size * planes;
+}
+
+/* filters and downmixing modify audio data in place, so audio that still
+ * points to the data of the caller has to be copied before either of them
+ * runs.  resampled audio is in the resampler's own buffers, which are free
+ * to be modified until the next call. */
+static bool audio_needs_copy(obs_source_t *source)
+{
+	if (source->resampler)
+		return false;
+
+	if (audio_output_get_channels(obs->audio.audio) != 1 &&
+	    (source->flags & OBS_SOURCE_FLAG_FORCE_MONO) != 0)
+		return true;
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		struct obs_source *filter = source->filters.array[i];
+
+		if (filter->enabled && filter->context.data &&
+		    filter->info.filter_audio)
+			return true;
+	}
+
+	return false;
 }
 
 /* TODO: SSE optimization */
@@ -2449,12 +3033,13 @@ static void downmix_to_mono_planar(struct obs_source *source, uint32_t frames)
 	}
 }
 
-/* resamples/remixes new audio to the designated main audio output format */
-static void process_audio(obs_source_t *source,
+/* resamples/remixes new audio to the designated main audio output format.
+ * the audio data of the source is not copied here, it points either to the
+ * output of the resampler or to the data of the caller. */
+static bool process_audio(obs_source_t *source,
 		const struct obs_source_audio *audio)
 {
 	uint32_t frames = audio->frames;
-	bool mono_output;
 
 	if (source->sample_info.samples_per_sec != audio->samples_per_sec ||
 	    source->sample_info.format          != audio->format          ||
@@ -2462,43 +3047,52 @@ static void process_audio(obs_source_t *source,
 		reset_resampler(source, audio);
 
 	if (source->audio_failed)
-		return;
+		return false;
 
 	if (source->resampler) {
 		uint8_t  *output[MAX_AV_PLANES];
 
 		memset(output, 0, sizeof(output));
 
-		audio_resampler_resample(source->resampler,
+		if (!audio_resampler_resample(source->resampler,
 				output, &frames, &source->resample_offset,
-				audio->data, audio->frames);
+				audio->data, audio->frames))
+			return false;
 
-		copy_audio_data(source, (const uint8_t *const *)output, frames,
+		set_audio_data(source, (const uint8_t *const *)output, frames,
 				audio->timestamp);
 	} else {
-		copy_audio_data(source, audio->data, audio->frames,
+		set_audio_data(source, audio->data, audio->frames,
 				audio->timestamp);
 	}
 
-	mono_output = audio_output_get_channels(obs->audio.audio) == 1;
-
-	if (!mono_output && (source->flags & OBS_SOURCE_FLAG_FORCE_MONO) != 0)
-		downmix_to_mono_planar(source, frames);
+	return true;
 }
 
 void obs_source_output_audio(obs_source_t *source,
 		const struct obs_source_audio *audio)
 {
 	struct obs_audio_data *output;
+	bool mono_output;
 
 	if (!obs_source_valid(source, "obs_source_output_audio"))
 		return;
 	if (!obs_ptr_valid(audio, "obs_source_output_audio"))
 		return;
 
-	process_audio(source, audio);
+	if (!process_audio(source, audio))
+		return;
 
 	pthread_mutex_lock(&source->filter_mutex);
+
+	if (audio_needs_copy(source))
+		copy_audio_data(source);
+
+	mono_output = audio_output_get_channels(obs->audio.audio) == 1;
+
+	if (!mono_output && (source->flags & OBS_SOURCE_FLAG_FORCE_MONO) != 0)
+		downmix_to_mono_planar(source, source->audio_data.frames);
+
 	output = filter_async_audio(source, &source->audio_data);
 
 	if (output) {
@@ -2527,7 +3121,13 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 		struct async_frame *f = &source->async_cache.array[i];
 
 		if (f->frame == frame) {
-			f->used = false;
+			/* borrowed frames go back to the source right away */
+			if (f->borrowed) {
+				da_erase(source->async_cache, i);
+				obs_source_frame_decref(source, frame);
+			} else {
+				f->used = false;
+			}
 			break;
 		}
 	}
@@ -2682,7 +3282,7 @@ void obs_source_release_frame(obs_source_t *source,
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			async_frame_destroy(source, frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -2751,7 +3351,8 @@ static inline void render_filter_tex(gs_texture_t *tex, gs_effect_t *effect,
 		uint32_t width, uint32_t height, const char *tech_name)
 {
 	gs_technique_t *tech    = gs_effect_get_technique(effect, tech_name);
-	gs_eparam_t    *image   = gs_effect_get_param_by_name(effect, "image");
+	gs_eparam_t    *image   = gs_effect_get_param_by_id(effect,
+			obs->video.params.image);
 	size_t      passes, i;
 
 	gs_effect_set_texture(image, tex);
@@ -2800,6 +3401,7 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 		return false;
 	}
 
+	target       = obs_source_fuse_filters(filter);
 	parent_flags = parent->info.output_flags;
 	cx           = get_base_width(target);
 	cy           = get_base_height(target);
@@ -2847,6 +3449,13 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 	return true;
 }
 
+/* the target that was rendered by obs_source_process_filter_begin */
+static inline obs_source_t *get_processed_target(obs_source_t *filter)
+{
+	return filter->fused_effect ?
+		filter->fused_target : obs_filter_get_target(filter);
+}
+
 void obs_source_process_filter_tech_end(obs_source_t *filter, gs_effect_t *effect,
 		uint32_t width, uint32_t height, const char *tech_name)
 {
@@ -2856,7 +3465,7 @@ void obs_source_process_filter_tech_end(obs_source_t *filter, gs_effect_t *effec
 
 	if (!filter) return;
 
-	target       = obs_filter_get_target(filter);
+	target       = get_processed_target(filter);
 	parent       = obs_filter_get_parent(filter);
 
 	if (!target || !parent)
@@ -2866,6 +3475,12 @@ void obs_source_process_filter_tech_end(obs_source_t *filter, gs_effect_t *effec
 
 	const char *tech = tech_name ? tech_name : "Draw";
 
+	if (filter->fused_effect) {
+		effect = filter->fused_effect;
+		tech = "Draw";
+		obs_source_set_fused_params(filter);
+	}
+
 	if (can_bypass(target, parent, parent_flags, filter->allow_direct)) {
 		render_filter_bypass(target, effect, tech);
 	} else {
@@ -2885,10 +3500,15 @@ void obs_source_process_filter_end(obs_source_t *filter, gs_effect_t *effect,
 	if (!obs_ptr_valid(filter, "obs_source_process_filter_end"))
 		return;
 
-	target       = obs_filter_get_target(filter);
+	target       = get_processed_target(filter);
 	parent       = obs_filter_get_parent(filter);
 	parent_flags = parent->info.output_flags;
 
+	if (filter->fused_effect) {
+		effect = filter->fused_effect;
+		obs_source_set_fused_params(filter);
+	}
+
 	if (can_bypass(target, parent, parent_flags, filter->allow_direct)) {
 		render_filter_bypass(target, effect, "Draw");
 	} else {
@@ -3074,6 +3694,30 @@ void obs_source_enum_active_tree(obs_source_t *source,
 	obs_source_release(source);
 }
 
+static inline void preload_source(obs_source_t *source)
+{
+	if (source->info.preload && source->context.data)
+		source->info.preload(source->context.data);
+}
+
+static void preload_tree(obs_source_t *parent, obs_source_t *child,
+		void *param)
+{
+	preload_source(child);
+
+	UNUSED_PARAMETER(parent);
+	UNUSED_PARAMETER(param);
+}
+
+void obs_source_preload(obs_source_t *source)
+{
+	if (!data_valid(source, "obs_source_preload"))
+		return;
+
+	preload_source(source);
+	obs_source_enum_active_tree(source, preload_tree, NULL);
+}
+
 static void enum_source_full_tree_callback(obs_source_t *parent,
 		obs_source_t *child, void *param)
 {
@@ -3319,9 +3963,12 @@ void obs_source_draw_set_color_matrix(const struct matrix4 *color_matrix,
 	if (!color_range_max)
 		color_range_max = &color_range_max_def;
 
-	matrix = gs_effect_get_param_by_name(effect, "color_matrix");
-	range_min = gs_effect_get_param_by_name(effect, "color_range_min");
-	range_max = gs_effect_get_param_by_name(effect, "color_range_max");
+	matrix = gs_effect_get_param_by_id(effect,
+			obs->video.params.color_matrix);
+	range_min = gs_effect_get_param_by_id(effect,
+			obs->video.params.color_range_min);
+	range_max = gs_effect_get_param_by_id(effect,
+			obs->video.params.color_range_max);
 
 	gs_effect_set_matrix4(matrix, color_matrix);
 	gs_effect_set_val(range_min, color_range_min, sizeof(float)*3);
@@ -3343,15 +3990,16 @@ void obs_source_draw(gs_texture_t *texture, int x, int y, uint32_t cx,
 	if (!obs_ptr_valid(texture, "obs_source_draw"))
 		return;
 
-	image = gs_effect_get_param_by_name(effect, "image");
+	image = gs_effect_get_param_by_id(effect, obs->video.params.image);
 	gs_effect_set_texture(image, texture);
+	set_draw_sampler(image);
 
 	if (change_pos) {
 		gs_matrix_push();
 		gs_matrix_translate3f((float)x, (float)y, 0.0f);
 	}
 
-	gs_draw_sprite(texture, flip ? GS_FLIP_V : 0, cx, cy);
+	draw_source_sprite(texture, flip ? GS_FLIP_V : 0, cx, cy);
 
 	if (change_pos)
 		gs_matrix_pop();
@@ -3646,19 +4294,25 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 		size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
+	size_t frames = obs->audio.frames_per_tick;
+
+	for (size_t ch = 0; ch < channels; ch++) {
+		register float *out = source->audio_output_buf[mix][ch];
+		register float *end = out + frames;
 
-	while (out < end)
-		*(out++) *= vol;
+		while (out < end)
+			*(out++) *= vol;
+	}
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 		size_t channels, float *vol_data)
 {
+	size_t frames = obs->audio.frames_per_tick;
+
 	for (size_t ch = 0; ch < channels; ch++) {
 		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
+		register float *end = out + frames;
 		register float *vol = vol_data;
 
 		while (out < end)
@@ -3684,7 +4338,8 @@ static inline void apply_audio_action(obs_source_t *source,
 static void apply_audio_actions(obs_source_t *source, size_t channels,
 		size_t sample_rate)
 {
-	float *vol_data = malloc(sizeof(float) * AUDIO_OUTPUT_FRAMES);
+	size_t frames = obs->audio.frames_per_tick;
+	float *vol_data = malloc(sizeof(float) * frames);
 	float cur_vol = get_source_volume(source, source->audio_ts);
 	size_t frame_num = 0;
 
@@ -3701,7 +4356,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		new_frame_num = conv_time_to_frames(sample_rate,
 				timestamp - source->audio_ts);
 
-		if (new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (new_frame_num >= frames)
 			break;
 
 		da_erase(source->audio_actions, i--);
@@ -3716,7 +4371,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		cur_vol = get_source_volume(source, timestamp);
 	}
 
-	for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+	for (; frame_num < frames; frame_num++)
 		vol_data[frame_num] = cur_vol;
 
 	pthread_mutex_unlock(&source->audio_actions_mutex);
@@ -3729,12 +4384,12 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 	free(vol_data);
 }
 
-static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
-		size_t channels, size_t sample_rate)
+/* whether any volume, mute or push-to-talk changes apply to this tick */
+static bool audio_actions_pending(obs_source_t *source, size_t sample_rate)
 {
 	struct audio_action action;
 	bool actions_pending;
-	float vol;
+	uint64_t duration;
 
 	pthread_mutex_lock(&source->audio_actions_mutex);
 
@@ -3744,14 +4399,22 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 
 	pthread_mutex_unlock(&source->audio_actions_mutex);
 
-	if (actions_pending) {
-		uint64_t duration = conv_frames_to_time(sample_rate,
-				AUDIO_OUTPUT_FRAMES);
+	if (!actions_pending)
+		return false;
+
+	duration = conv_frames_to_time(sample_rate,
+			obs->audio.frames_per_tick);
+	return action.timestamp < (source->audio_ts + duration);
+}
 
-		if (action.timestamp < (source->audio_ts + duration)) {
-			apply_audio_actions(source, channels, sample_rate);
-			return;
-		}
+static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
+		size_t channels, size_t sample_rate)
+{
+	float vol;
+
+	if (audio_actions_pending(source, sample_rate)) {
+		apply_audio_actions(source, channels, sample_rate);
+		return;
 	}
 
 	vol = get_source_volume(source, source->audio_ts);
@@ -3759,7 +4422,7 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 		return;
 
 	if (vol == 0.0f || mixers == 0) {
-		memset(source->audio_output_buf[0][0], 0,
+		memset(source->audio_output_storage[0][0], 0,
 				AUDIO_OUTPUT_FRAMES * sizeof(float) *
 				MAX_AUDIO_CHANNELS * MAX_AUDIO_MIXES);
 		return;
@@ -3809,10 +4472,40 @@ static void custom_audio_render(obs_source_t *source, uint32_t mixers,
 	apply_audio_volume(source, mixers, channels, sample_rate);
 }
 
+static float silent_audio[AUDIO_OUTPUT_FRAMES] = {0};
+
+static inline void reset_audio_output_views(obs_source_t *source)
+{
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+		for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++)
+			source->audio_output_buf[mix][ch] =
+				source->audio_output_storage[mix][ch];
+	}
+}
+
+/* when no volume has to be applied, every mix that is used is the same as
+ * mix 0, so point them all to it, and point the others to silence */
+static inline void set_audio_output_views(obs_source_t *source,
+		uint32_t mixers)
+{
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+		uint32_t mix_and_val = (1 << mix);
+		bool used = (source->audio_mixers & mix_and_val) != 0 &&
+		            (mixers & mix_and_val) != 0;
+
+		for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++)
+			source->audio_output_buf[mix][ch] = used ?
+				source->audio_output_storage[0][ch] :
+				silent_audio;
+	}
+}
+
 static inline void process_audio_source_tick(obs_source_t *source,
 		uint32_t mixers, size_t channels, size_t sample_rate,
 		size_t size)
 {
+	bool unity_volume;
+
 	pthread_mutex_lock(&source->audio_buf_mutex);
 
 	if (source->audio_input_buf[0].size < size) {
@@ -3823,11 +4516,25 @@ static inline void process_audio_source_tick(obs_source_t *source,
 
 	for (size_t ch = 0; ch < channels; ch++)
 		circlebuf_peek_front(&source->audio_input_buf[ch],
-				source->audio_output_buf[0][ch],
+				source->audio_output_storage[0][ch],
 				size);
 
 	pthread_mutex_unlock(&source->audio_buf_mutex);
 
+	source->audio_render_copied += size * channels;
+
+	unity_volume = !audio_actions_pending(source, sample_rate) &&
+		get_source_volume(source, source->audio_ts) == 1.0f;
+
+	/* actions that arrive after this are applied on the next tick */
+	if (unity_volume) {
+		set_audio_output_views(source, mixers);
+		source->audio_pending = false;
+		return;
+	}
+
+	reset_audio_output_views(source);
+
 	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
 		uint32_t mix_and_val = (1 << mix);
 
@@ -3841,6 +4548,8 @@ static inline void process_audio_source_tick(obs_source_t *source,
 		for (size_t ch = 0; ch < channels; ch++)
 			memcpy(source->audio_output_buf[mix][ch],
 					source->audio_output_buf[0][ch], size);
+
+		source->audio_render_copied += size * channels;
 	}
 
 	if ((source->audio_mixers & 1) == 0 || (mixers & 1) == 0)
@@ -128,6 +128,44 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_DO_NOT_MONITOR (1<<9)
 
+/**
+ * Source only draws a single texture
+ *
+ * Specifies that the source's video_render callback draws nothing but one
+ * texture covering the full size of the source, with obs_source_draw.  This
+ * allows scenes to crop the source by drawing a subregion of that texture,
+ * rather than rendering the source to an intermediate texture first.
+ *
+ * Async sources without a video_render callback are always drawn this way.
+ */
+#define OBS_SOURCE_SINGLE_TEXTURE (1<<10)
+
+/**
+ * Source is opaque
+ *
+ * Specifies that the source always covers its full size with opaque pixels.
+ * Scenes skip rendering items that are completely covered by an opaque item.
+ * Sources that are only opaque some of the time implement is_opaque instead.
+ *
+ * Async sources without a video_render callback are treated as opaque
+ * whenever their current frame format has no alpha channel.
+ */
+#define OBS_SOURCE_OPAQUE (1<<11)
+
+/**
+ * Source output can be cached
+ *
+ * Specifies that the video the source renders only depends on its settings,
+ * so libobs may keep its last rendered output (including filters) in a
+ * texture and draw that instead of rendering the source again.  The cache is
+ * invalidated when the source is updated, when its size or filters change,
+ * or when the source calls obs_source_invalidate_cache.
+ *
+ * Filters with this flag can be cached as part of their parent source.
+ * Scenes are cached when all of their visible items are cacheable.
+ */
+#define OBS_SOURCE_CACHEABLE (1<<12)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -423,6 +461,59 @@ struct obs_source_info {
 	void (*enum_all_sources)(void *data,
 			obs_source_enum_proc_t enum_callback,
 			void *param);
+
+	/**
+	 * Called when the source is about to be shown, so that it can start
+	 * loading any data it needs in the background (see
+	 * obs_source_preload).  Must not block.
+	 *
+	 * @param  data  Source data
+	 */
+	void (*preload)(void *data);
+
+	/**
+	 * Gets the per-pixel function of a video filter, if it has one with
+	 * its current settings.  Consecutive filters with a per-pixel
+	 * function are drawn in a single pass of a generated effect instead
+	 * of one pass each (see obs_set_filter_fusion).  Filters with a
+	 * per-pixel function must not change the size of their target.
+	 *
+	 *   The code is inserted into the generated effect after every '$'
+	 * in it has been replaced by a prefix that is unique within the
+	 * effect.  It has to declare the uniforms it uses, prefixed with '$',
+	 * and a function with the signature:
+	 *
+	 *   float4 $process(float4 rgba, float2 uv)
+	 *
+	 * which returns the filtered color of the pixel.
+	 *
+	 * @param  data  Filter data
+	 * @return       Code of the per-pixel function, or NULL if the
+	 *               filter can't currently be fused
+	 */
+	const char *(*get_pixel_function)(void *data);
+
+	/**
+	 * Sets the parameters of the per-pixel function in a generated
+	 * effect, see obs_filter_get_fused_param.  Required if
+	 * get_pixel_function is implemented.
+	 *
+	 * @param  data    Filter data
+	 * @param  effect  Generated effect
+	 * @param  prefix  Prefix that replaced '$' in the function's code
+	 */
+	void (*set_pixel_params)(void *data, gs_effect_t *effect,
+			const char *prefix);
+
+	/**
+	 * Called by scenes to find out whether the source currently covers
+	 * its full size with opaque pixels, for sources that don't always
+	 * do so (see OBS_SOURCE_OPAQUE).  Called from the graphics thread.
+	 *
+	 * @param  data  Source data
+	 * @return       true if the source is currently opaque
+	 */
+	bool (*is_opaque)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
@@ -0,0 +1,383 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+
+#include "util/dstr.h"
+#include "obs-internal.h"
+
+/*
+ * The stats registry is independent of the obs core, so that objects which
+ * outlive it during shutdown (such as outputs, or the modules that export
+ * stats) can still safely destroy their stats.
+ *
+ * Each stat has its own mutex, so updating a stat only ever contends with a
+ * snapshot being taken.  Sampled stats are read while the registry mutex is
+ * held, which is what guarantees that their callbacks are never called after
+ * obs_stat_destroy has returned.
+ */
+
+struct obs_stat {
+	char                *name;
+	char                *labels;
+	char                *help;
+	enum obs_stat_type  type;
+
+	pthread_mutex_t     mutex;
+	double              value;
+	uint64_t            count;
+	uint64_t            buckets[OBS_STAT_HISTOGRAM_BUCKETS];
+
+	obs_stat_sample_t   sample;
+	void                *param;
+};
+
+struct obs_stats_snapshot {
+	DARRAY(struct obs_stat_value) values;
+};
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct obs_stat*) stats;
+
+static const double histogram_bounds[OBS_STAT_HISTOGRAM_BUCKETS - 1] = {
+	0.5, 1.0, 2.0, 4.0, 8.0, 12.0, 16.7, 25.0, 33.3, 50.0, 100.0
+};
+
+/* ------------------------------------------------------------------------- */
+
+static obs_stat_t *stat_create(const char *name, const char *labels,
+		const char *help, enum obs_stat_type type,
+		obs_stat_sample_t sample, void *param)
+{
+	struct obs_stat *stat;
+
+	if (!obs_ptr_valid(name, "obs_stat_create"))
+		return NULL;
+
+	stat = bzalloc(sizeof(struct obs_stat));
+	stat->name   = bstrdup(name);
+	stat->labels = labels && *labels ? bstrdup(labels) : NULL;
+	stat->help   = help ? bstrdup(help) : NULL;
+	stat->type   = type;
+	stat->sample = sample;
+	stat->param  = param;
+
+	if (pthread_mutex_init(&stat->mutex, NULL) != 0) {
+		bfree(stat->name);
+		bfree(stat->labels);
+		bfree(stat->help);
+		bfree(stat);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&stats_mutex);
+	da_push_back(stats, &stat);
+	pthread_mutex_unlock(&stats_mutex);
+
+	return stat;
+}
+
+obs_stat_t *obs_stat_create(const char *name, const char *labels,
+		const char *help, enum obs_stat_type type)
+{
+	return stat_create(name, labels, help, type, NULL, NULL);
+}
+
+obs_stat_t *obs_stat_create_sampled(const char *name, const char *labels,
+		const char *help, enum obs_stat_type type,
+		obs_stat_sample_t sample, void *param)
+{
+	if (!obs_ptr_valid(sample, "obs_stat_create_sampled"))
+		return NULL;
+	if (type == OBS_STAT_HISTOGRAM) {
+		blog(LOG_ERROR, "obs_stat_create_sampled: histograms cannot "
+				"be sampled");
+		return NULL;
+	}
+
+	return stat_create(name, labels, help, type, sample, param);
+}
+
+void obs_stat_destroy(obs_stat_t *stat)
+{
+	if (!stat)
+		return;
+
+	pthread_mutex_lock(&stats_mutex);
+	da_erase_item(stats, &stat);
+	if (!stats.num)
+		da_free(stats);
+	pthread_mutex_unlock(&stats_mutex);
+
+	pthread_mutex_destroy(&stat->mutex);
+	bfree(stat->name);
+	bfree(stat->labels);
+	bfree(stat->help);
+	bfree(stat);
+}
+
+void obs_stat_add(obs_stat_t *stat, double val)
+{
+	if (!stat)
+		return;
+
+	pthread_mutex_lock(&stat->mutex);
+	stat->value += val;
+	pthread_mutex_unlock(&stat->mutex);
+}
+
+void obs_stat_set(obs_stat_t *stat, double val)
+{
+	if (!stat)
+		return;
+
+	pthread_mutex_lock(&stat->mutex);
+	stat->value = val;
+	pthread_mutex_unlock(&stat->mutex);
+}
+
+static inline size_t get_bucket(double val)
+{
+	size_t bucket = 0;
+
+	while (bucket < OBS_STAT_HISTOGRAM_BUCKETS - 1 &&
+	       val > histogram_bounds[bucket])
+		bucket++;
+
+	return bucket;
+}
+
+void obs_stat_observe(obs_stat_t *stat, double val)
+{
+	size_t bucket;
+
+	if (!stat)
+		return;
+
+	bucket = get_bucket(val);
+
+	pthread_mutex_lock(&stat->mutex);
+	stat->value += val;
+	stat->count++;
+	stat->buckets[bucket]++;
+	pthread_mutex_unlock(&stat->mutex);
+}
+
+double obs_stat_histogram_bound(size_t bucket)
+{
+	return bucket < OBS_STAT_HISTOGRAM_BUCKETS - 1 ?
+		histogram_bounds[bucket] : INFINITY;
+}
+
+char *obs_stat_label(const char *key, const char *value)
+{
+	struct dstr label = {0};
+
+	dstr_printf(&label, "%s=\"", key);
+
+	for (; value && *value; value++) {
+		if (*value == '"' || *value == '\\')
+			dstr_cat_ch(&label, '\\');
+		if (*value == '\n')
+			dstr_cat(&label, "\\n");
+		else
+			dstr_cat_ch(&label, *value);
+	}
+
+	dstr_cat_ch(&label, '"');
+	return label.array;
+}
+
+/* ------------------------------------------------------------------------- */
+
+obs_stats_snapshot_t *obs_stats_snapshot_create(void)
+{
+	struct obs_stats_snapshot *snap = bzalloc(sizeof(*snap));
+
+	pthread_mutex_lock(&stats_mutex);
+	da_reserve(snap->values, stats.num);
+
+	for (size_t i = 0; i < stats.num; i++) {
+		struct obs_stat *stat = stats.array[i];
+		struct obs_stat_value *val = da_push_back_new(snap->values);
+
+		val->name   = bstrdup(stat->name);
+		val->labels = bstrdup(stat->labels);
+		val->help   = bstrdup(stat->help);
+		val->type   = stat->type;
+
+		if (stat->sample) {
+			val->value = stat->sample(stat->param);
+			continue;
+		}
+
+		pthread_mutex_lock(&stat->mutex);
+		val->value = stat->value;
+		val->count = stat->count;
+		memcpy(val->buckets, stat->buckets, sizeof(val->buckets));
+		pthread_mutex_unlock(&stat->mutex);
+	}
+
+	pthread_mutex_unlock(&stats_mutex);
+	return snap;
+}
+
+void obs_stats_snapshot_free(obs_stats_snapshot_t *snap)
+{
+	if (!snap)
+		return;
+
+	for (size_t i = 0; i < snap->values.num; i++) {
+		struct obs_stat_value *val = snap->values.array + i;
+		bfree((char*)val->name);
+		bfree((char*)val->labels);
+		bfree((char*)val->help);
+	}
+
+	da_free(snap->values);
+	bfree(snap);
+}
+
+size_t obs_stats_snapshot_count(const obs_stats_snapshot_t *snap)
+{
+	return snap ? snap->values.num : 0;
+}
+
+const struct obs_stat_value *obs_stats_snapshot_get(
+		const obs_stats_snapshot_t *snap, size_t idx)
+{
+	return snap && idx < snap->values.num ? snap->values.array + idx : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Core stats */
+
+static double get_total_frames(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->video.total_frames;
+}
+
+static double get_lagged_frames(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->video.lagged_frames;
+}
+
+static double get_skipped_frames(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return obs->video.video ?
+		(double)video_output_get_skipped_frames(obs->video.video) : 0.0;
+}
+
+static double get_video_fps(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return obs->video.video_fps;
+}
+
+static double get_items_culled(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)os_atomic_load_long(&obs->video.items_culled);
+}
+
+static double get_items_culled_total(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->video.items_culled_total;
+}
+
+static double get_cache_hits(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->video.cache_hits;
+}
+
+static double get_cache_misses(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->video.cache_misses;
+}
+
+static double get_audio_buffering(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->audio.total_buffering_ticks;
+}
+
+void obs_init_stats(void)
+{
+	struct obs_core_stats *core = &obs->stats;
+
+	core->frame_time = obs_stat_create("obs_video_frame_time_ms", NULL,
+			"Time taken to tick, render and output a frame",
+			OBS_STAT_HISTOGRAM);
+
+#define add_sampled(name, help, type, func) \
+	do { \
+		obs_stat_t *stat = obs_stat_create_sampled(name, NULL, help, \
+				type, func, NULL); \
+		da_push_back(core->sampled, &stat); \
+	} while (false)
+
+	add_sampled("obs_video_frames_total",
+			"Frames rendered", OBS_STAT_COUNTER,
+			get_total_frames);
+	add_sampled("obs_video_frames_lagged_total",
+			"Frames missed due to rendering lag", OBS_STAT_COUNTER,
+			get_lagged_frames);
+	add_sampled("obs_video_frames_skipped_total",
+			"Frames skipped due to encoding lag", OBS_STAT_COUNTER,
+			get_skipped_frames);
+	add_sampled("obs_video_fps",
+			"Current render frame rate", OBS_STAT_GAUGE,
+			get_video_fps);
+	add_sampled("obs_video_items_culled",
+			"Scene items skipped in the last frame because they "
+			"were outside of their scene or covered",
+			OBS_STAT_GAUGE, get_items_culled);
+	add_sampled("obs_video_items_culled_total",
+			"Scene items skipped because they were outside of "
+			"their scene or covered", OBS_STAT_COUNTER,
+			get_items_culled_total);
+	add_sampled("obs_video_render_cache_hits_total",
+			"Sources drawn from their cached output",
+			OBS_STAT_COUNTER, get_cache_hits);
+	add_sampled("obs_video_render_cache_misses_total",
+			"Sources rendered to update their cached output",
+			OBS_STAT_COUNTER, get_cache_misses);
+	add_sampled("obs_audio_buffering_ticks",
+			"Audio ticks currently buffered to compensate for "
+			"source delay", OBS_STAT_GAUGE,
+			get_audio_buffering);
+
+#undef add_sampled
+}
+
+void obs_free_stats(void)
+{
+	struct obs_core_stats *core = &obs->stats;
+
+	for (size_t i = 0; i < core->sampled.num; i++)
+		obs_stat_destroy(core->sampled.array[i]);
+	da_free(core->sampled);
+
+	obs_stat_destroy(core->frame_time);
+	core->frame_time = NULL;
+}
@@ -491,6 +491,8 @@ static inline void output_video_data(struct obs_core_video *video,
 	}
 }
 
+static const char *lagged_frame_name = "lagged_frame";
+
 static inline void video_sleep(struct obs_core_video *video,
 		uint64_t *p_time, uint64_t interval_ns)
 {
@@ -510,6 +512,9 @@ static inline void video_sleep(struct obs_core_video *video,
 	video->total_frames += count;
 	video->lagged_frames += count - 1;
 
+	if (count > 1)
+		profile_mark(lagged_frame_name);
+
 	vframe_info.timestamp = cur_time;
 	vframe_info.count = count;
 	circlebuf_push_back(&video->vframe_info_buffer, &vframe_info,
@@ -586,22 +591,35 @@ void *obs_video_thread(void *param)
 	profile_register_root(video_thread_name, interval);
 
 	while (!video_output_stopped(obs->video.video)) {
+		uint64_t frame_start = os_gettime_ns();
+
 		profile_start(video_thread_name);
 
 		profile_start(tick_sources_name);
 		last_time = tick_sources(obs->video.video_time, last_time);
 		profile_end(tick_sources_name);
 
+		profile_start(output_frame_name);
+		output_frame();
+		profile_end(output_frame_name);
+
+		/* displays are rendered after the frame so that they can draw
+		 * the main texture that was just rendered */
 		profile_start(render_displays_name);
 		render_displays();
 		profile_end(render_displays_name);
 
-		profile_start(output_frame_name);
-		output_frame();
-		profile_end(output_frame_name);
+		os_atomic_set_long(&obs->video.items_culled,
+				obs->video.items_culled_frame);
+		obs->video.items_culled_total += obs->video.items_culled_frame;
+		obs->video.items_culled_frame = 0;
 
 		profile_end(video_thread_name);
 
+		obs_stat_observe(obs->stats.frame_time,
+				(double)(os_gettime_ns() - frame_start) /
+				1000000.0);
+
 		profile_reenable_thread();
 
 		video_sleep(&obs->video, &obs->video.video_time, interval);
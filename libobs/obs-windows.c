@@ -425,6 +425,17 @@ bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *context,
 	return vk_down(obs_key_to_virtual_key(key));
 }
 
+bool obs_hotkeys_platform_wait_events(obs_hotkeys_platform_t *context,
+		uint32_t timeout_ms,
+		void (*changed)(void *param, obs_key_t key), void *param)
+{
+	UNUSED_PARAMETER(context);
+	UNUSED_PARAMETER(timeout_ms);
+	UNUSED_PARAMETER(changed);
+	UNUSED_PARAMETER(param);
+	return false;
+}
+
 void obs_key_to_str(obs_key_t key, struct dstr *str)
 {
 	wchar_t name[128] = L"";
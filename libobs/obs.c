@@ -226,6 +226,7 @@ gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file)
 	return *effect;
 }
 
+static const char *obs_init_effects_name = "obs_init_graphics(effects)";
 static int obs_init_graphics(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -233,6 +234,7 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 	const uint8_t *transparent_tex = transparent_tex_data;
 	struct gs_sampler_info point_sampler = {0};
 	bool success = true;
+	uint64_t start_time;
 	int errorcode;
 
 	errorcode = gs_create(&video->graphics, ovi->graphics_module,
@@ -250,6 +252,12 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 
 	gs_enter_context(video->graphics);
 
+	profile_start(obs_init_effects_name);
+	start_time = os_gettime_ns();
+
+	if (obs->shader_cache_path)
+		gs_set_cache_dir(obs->shader_cache_path);
+
 	char *filename = find_libobs_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename,
 			NULL);
@@ -297,8 +305,23 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 			NULL);
 	bfree(filename);
 
+	profile_end(obs_init_effects_name);
+	blog(LOG_INFO, "Loaded core effects in %g ms%s",
+			(double)(os_gettime_ns() - start_time) / 1000000.0,
+			obs->shader_cache_path ? " (shader cache enabled)" : "");
+
 	video->point_sampler = gs_samplerstate_create(&point_sampler);
 
+	video->params.image = gs_effect_intern_param_name("image");
+	video->params.base_dimension_i =
+		gs_effect_intern_param_name("base_dimension_i");
+	video->params.color_matrix =
+		gs_effect_intern_param_name("color_matrix");
+	video->params.color_range_min =
+		gs_effect_intern_param_name("color_range_min");
+	video->params.color_range_max =
+		gs_effect_intern_param_name("color_range_max");
+
 	obs->video.transparent_texture = gs_texture_create(2, 2, GS_RGBA, 1,
 			&transparent_tex, 0);
 
@@ -476,6 +499,8 @@ static void obs_free_graphics(void)
 		gs_effect_destroy(video->bilinear_lowres_effect);
 		video->default_effect = NULL;
 
+		obs_free_fused_effects();
+
 		gs_leave_context();
 
 		gs_destroy(video->graphics);
@@ -505,8 +530,11 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->monitoring_device_id = bstrdup("default");
 
 	errorcode = audio_output_open(&audio->audio, ai);
-	if (errorcode == AUDIO_OUTPUT_SUCCESS)
+	if (errorcode == AUDIO_OUTPUT_SUCCESS) {
+		audio->frames_per_tick =
+			audio_output_get_frames_per_tick(audio->audio);
 		return true;
+	}
 	else if (errorcode == AUDIO_OUTPUT_INVALIDPARAM)
 		blog(LOG_ERROR, "Invalid audio parameters specified");
 	else
@@ -743,6 +771,12 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	obs = bzalloc(sizeof(struct obs_core));
 
 	pthread_mutex_init_value(&obs->audio.monitoring_mutex);
+	pthread_mutex_init_value(&obs->file_watch.mutex);
+	pthread_mutex_init_value(&obs->image_cache.mutex);
+	obs->file_watch.inotify_fd = -1;
+	obs->file_watch.wake_fd = -1;
+	obs->video.culling = true;
+	obs->video.filter_fusion = true;
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -759,6 +793,12 @@ static bool obs_init(const char *locale, const char *module_config_path,
 		return false;
 	if (!obs_init_hotkeys())
 		return false;
+	if (!obs_init_file_watch())
+		return false;
+	if (!obs_init_image_cache())
+		return false;
+
+	obs_init_stats();
 
 	if (module_config_path)
 		obs->module_config_path = bstrdup(module_config_path);
@@ -832,8 +872,11 @@ void obs_shutdown(void)
 	stop_video();
 	stop_hotkeys();
 
+	obs_free_stats();
 	obs_free_audio();
 	obs_free_data();
+	obs_free_file_watch();
+	obs_free_image_cache();
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
@@ -858,6 +901,7 @@ void obs_shutdown(void)
 		profiler_name_store_free(obs->name_store);
 
 	bfree(obs->module_config_path);
+	bfree(obs->shader_cache_path);
 	bfree(obs->locale);
 	bfree(obs);
 	obs = NULL;
@@ -901,6 +945,15 @@ const char *obs_get_locale(void)
 	return obs ? obs->locale : NULL;
 }
 
+void obs_set_shader_cache_path(const char *path)
+{
+	if (!obs)
+		return;
+
+	bfree(obs->shader_cache_path);
+	obs->shader_cache_path = bstrdup(path);
+}
+
 #define OBS_SIZE_MIN 2
 #define OBS_SIZE_MAX (32 * 1024)
 
@@ -992,14 +1045,19 @@ bool obs_reset_audio(const struct obs_audio_info *oai)
 	ai.samples_per_sec = oai->samples_per_sec;
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
+	ai.frames_per_tick = obs->audio_frames_per_tick;
 	ai.input_callback = audio_callback;
+	ai.input_param = NULL;
 
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO, "audio settings reset:\n"
 	               "\tsamples per sec: %d\n"
-	               "\tspeakers:        %d",
+	               "\tspeakers:        %d\n"
+	               "\tframes per tick: %d",
 	               (int)ai.samples_per_sec,
-	               (int)ai.speakers);
+	               (int)ai.speakers,
+	               (int)(ai.frames_per_tick ?
+	                     ai.frames_per_tick : AUDIO_OUTPUT_FRAMES));
 
 	return obs_init_audio(&ai);
 }
@@ -1047,6 +1105,34 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 	return true;
 }
 
+bool obs_set_audio_frames_per_tick(uint32_t frames)
+{
+	if (!obs) return false;
+
+	if (frames && (frames < AUDIO_OUTPUT_MIN_FRAMES ||
+	               frames > AUDIO_OUTPUT_FRAMES)) {
+		blog(LOG_WARNING, "obs_set_audio_frames_per_tick: %u frames "
+		                  "is out of range (%d to %d)",
+		                  frames, AUDIO_OUTPUT_MIN_FRAMES,
+		                  AUDIO_OUTPUT_FRAMES);
+		return false;
+	}
+
+	obs->audio_frames_per_tick = frames;
+	return true;
+}
+
+uint32_t obs_get_audio_frames_per_tick(void)
+{
+	if (!obs) return 0;
+
+	if (obs->audio.audio)
+		return obs->audio.frames_per_tick;
+
+	return obs->audio_frames_per_tick ?
+		obs->audio_frames_per_tick : AUDIO_OUTPUT_FRAMES;
+}
+
 bool obs_enum_source_types(size_t idx, const char **id)
 {
 	if (!obs) return false;
@@ -1435,6 +1521,70 @@ void obs_render_main_view(void)
 	obs_view_render(&obs->data.main_view);
 }
 
+void obs_set_scene_culling(bool enable)
+{
+	if (!obs) return;
+	obs->video.culling = enable;
+}
+
+bool obs_get_scene_culling(void)
+{
+	return obs ? obs->video.culling : false;
+}
+
+void obs_set_filter_fusion(bool enable)
+{
+	if (!obs) return;
+	obs->video.filter_fusion = enable;
+}
+
+bool obs_get_filter_fusion(void)
+{
+	return obs ? obs->video.filter_fusion : false;
+}
+
+gs_texture_t *obs_get_main_texture(void)
+{
+	struct obs_core_video *video;
+	int last_texture;
+
+	if (!obs) return NULL;
+
+	video = &obs->video;
+	last_texture = video->cur_texture == 0 ?
+		NUM_TEXTURES - 1 : video->cur_texture - 1;
+
+	if (!video->textures_rendered[last_texture])
+		return NULL;
+
+	return video->render_textures[last_texture];
+}
+
+void obs_render_main_texture(void)
+{
+	gs_texture_t *tex = obs_get_main_texture();
+	gs_effect_t *effect;
+	gs_eparam_t *param;
+
+	if (!tex) {
+		obs_render_main_view();
+		return;
+	}
+
+	effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	param = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(param, tex);
+
+	/* the main texture is already composited over black */
+	gs_blend_state_push();
+	gs_enable_blending(false);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, 0, 0);
+
+	gs_blend_state_pop();
+}
+
 void obs_set_master_volume(float volume)
 {
 	struct calldata data = {0};
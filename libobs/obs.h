@@ -62,6 +62,10 @@ typedef struct obs_service    obs_service_t;
 typedef struct obs_module     obs_module_t;
 typedef struct obs_fader      obs_fader_t;
 typedef struct obs_volmeter   obs_volmeter_t;
+typedef struct obs_file_watch obs_file_watch_t;
+typedef struct obs_image      obs_image_t;
+typedef struct obs_stat       obs_stat_t;
+typedef struct obs_stats_snapshot obs_stats_snapshot_t;
 
 typedef struct obs_weak_source  obs_weak_source_t;
 typedef struct obs_weak_output  obs_weak_output_t;
@@ -150,7 +154,8 @@ struct obs_transform_info {
  */
 struct obs_video_info {
 	/**
-	 * Graphics module to use (usually "libobs-opengl" or "libobs-d3d11")
+	 * Graphics module to use (usually "libobs-opengl" or "libobs-d3d11",
+	 * or "libobs-null" to run without a GPU)
 	 */
 	const char          *graphics_module;
 
@@ -271,6 +276,15 @@ EXPORT void obs_set_locale(const char *locale);
 /** @return the current locale */
 EXPORT const char *obs_get_locale(void);
 
+/**
+ * Sets the directory used to cache parsed effects and compiled shader
+ * programs between runs, which speeds up subsequent startups.  Takes effect
+ * on the next call to obs_reset_video that creates the graphics subsystem.
+ *
+ * @param  path  Cache directory, or NULL to disable the cache
+ */
+EXPORT void obs_set_shader_cache_path(const char *path);
+
 /**
  * Returns the profiler name store (see util/profiler.h) used by OBS, which is
  * either a name store passed to obs_startup, an internal name store, or NULL
@@ -303,6 +317,22 @@ EXPORT int obs_reset_video(struct obs_video_info *ovi);
  */
 EXPORT bool obs_reset_audio(const struct obs_audio_info *oai);
 
+/**
+ * Sets the number of frames processed per audio tick the next time audio is
+ * reset with obs_reset_audio, from AUDIO_OUTPUT_MIN_FRAMES to
+ * AUDIO_OUTPUT_FRAMES.  Smaller values lower audio latency at the cost of
+ * more frequent processing.  0 uses the default of AUDIO_OUTPUT_FRAMES.
+ *
+ * Returns false if the value is out of range.
+ */
+EXPORT bool obs_set_audio_frames_per_tick(uint32_t frames);
+
+/**
+ * Gets the number of frames processed per audio tick, or the number that the
+ * next obs_reset_audio will use if there is no audio
+ */
+EXPORT uint32_t obs_get_audio_frames_per_tick(void);
+
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 
@@ -545,6 +575,43 @@ EXPORT proc_handler_t *obs_get_proc_handler(void);
 /** Renders the main view */
 EXPORT void obs_render_main_view(void);
 
+/**
+ * Enables or disables culling of scene items (enabled by default).
+ *
+ *   Culled items are items that are completely outside of their scene, or
+ * completely covered by an opaque item above them.  Their sources are still
+ * ticked, but not rendered.
+ */
+EXPORT void obs_set_scene_culling(bool enable);
+EXPORT bool obs_get_scene_culling(void);
+
+/**
+ * Enables or disables fusion of video filters (enabled by default).
+ *
+ *   Consecutive filters that have a per-pixel function are drawn in a single
+ * pass of a generated effect, rather than each filter rendering to its own
+ * texture.  Filters that can't be fused are rendered as usual.
+ */
+EXPORT void obs_set_filter_fusion(bool enable);
+EXPORT bool obs_get_filter_fusion(void);
+
+/**
+ * Returns the texture the main view was last rendered to for output, or NULL
+ * if no frame has been rendered yet.
+ *
+ *   The texture is owned by libobs and is only valid within the graphics
+ * context until the next frame is rendered, so it should only be used from
+ * display draw callbacks (which are called right after it is rendered).
+ */
+EXPORT gs_texture_t *obs_get_main_texture(void);
+
+/**
+ * Draws the last rendered main view texture at base resolution instead of
+ * rendering the main view again.  Falls back to obs_render_main_view if no
+ * frame has been rendered yet.
+ */
+EXPORT void obs_render_main_texture(void);
+
 /** Sets the master user volume */
 EXPORT void obs_set_master_volume(float volume);
 
@@ -666,6 +733,164 @@ EXPORT void obs_display_set_background_color(obs_display_t *display,
 		uint32_t color);
 
 
+/* ------------------------------------------------------------------------- */
+/* File watches */
+
+typedef void (*obs_file_watch_cb)(void *param, const char *path);
+
+/**
+ * Watches a file or directory for changes.  All watches are serviced by a
+ * single thread (using inotify where available), and bursts of changes are
+ * coalesced into one callback.
+ *
+ *   The callback is called from the file watch thread, so it should do as
+ * little as possible -- typically just flag the change so that it can be
+ * handled on the next tick.  It must not add or remove file watches.
+ *
+ *   Watching a directory reports changes to any file within it.  The path
+ * does not need to exist yet.
+ *
+ * @param  path      Path of the file or directory to watch.
+ * @param  callback  Called when the file (or directory contents) changed.
+ * @param  param     User data passed to the callback.
+ * @return           The watch, or NULL on failure.
+ */
+EXPORT obs_file_watch_t *obs_file_watch_add(const char *path,
+		obs_file_watch_cb callback, void *param);
+
+/**
+ * Removes a file watch.  Once this returns, the callback is guaranteed to
+ * not be running and will not be called again.
+ */
+EXPORT void obs_file_watch_remove(obs_file_watch_t *watch);
+
+
+/* ------------------------------------------------------------------------- */
+/* Image cache */
+
+struct gs_image_file;
+
+/**
+ * Gets an image from the shared image cache, which is keyed by path and
+ * modification time.  If the image is not cached yet, it is decoded on a
+ * worker thread, and obs_image_get_texture returns NULL until it's done.
+ * Release with obs_image_release.
+ *
+ *   The image is shared with every other user of the same file, so animated
+ * images are not supported (only their first frame is shown).
+ */
+EXPORT obs_image_t *obs_image_cache_get(const char *path);
+EXPORT void obs_image_release(obs_image_t *image);
+
+/**
+ * Decodes an image on the image cache's worker threads without sharing it
+ * with anyone, for images that are changed by their user, such as animated
+ * gifs.  Once obs_image_decoded returns true, take the decoded image with
+ * obs_image_take_file.  Release with obs_image_release.
+ */
+EXPORT obs_image_t *obs_image_load_unshared(const char *path);
+
+/**
+ * Moves the decoded image out of an image from obs_image_load_unshared into
+ * file, which the caller then owns and frees with gs_image_file_free.  The
+ * texture is not created yet, see gs_image_file_init_texture.
+ *
+ * @return false if the image isn't decoded yet (or was already taken)
+ */
+EXPORT bool obs_image_take_file(obs_image_t *image,
+		struct gs_image_file *file);
+
+/**
+ * Starts decoding an image ahead of time.  Images no longer in use are kept
+ * in the cache for a while, so a preloaded image is ready when it's needed.
+ */
+EXPORT void obs_image_cache_preload(const char *path);
+
+/** Returns true once the image has finished decoding (or failed to) */
+EXPORT bool obs_image_decoded(const obs_image_t *image);
+EXPORT uint32_t obs_image_get_width(const obs_image_t *image);
+EXPORT uint32_t obs_image_get_height(const obs_image_t *image);
+
+/**
+ * Returns the texture of the image, or NULL if it isn't decoded yet or
+ * failed to load.  The texture is created on first use, so this must be
+ * called within the graphics context.
+ */
+EXPORT gs_texture_t *obs_image_get_texture(obs_image_t *image);
+
+
+/* ------------------------------------------------------------------------- */
+/* Stats */
+
+enum obs_stat_type {
+	OBS_STAT_COUNTER,
+	OBS_STAT_GAUGE,
+	OBS_STAT_HISTOGRAM
+};
+
+#define OBS_STAT_HISTOGRAM_BUCKETS 12
+
+/** Returns the current value of a sampled stat */
+typedef double (*obs_stat_sample_t)(void *param);
+
+/**
+ * Creates a stat.  Stats are identified by name (in Prometheus naming style,
+ * such as "obs_output_bytes_sent_total") and labels (such as
+ * output="simple_stream", or NULL), and help is a short description.
+ *
+ *   Histograms are meant for durations in milliseconds, and count samples in
+ * fixed buckets (see obs_stat_histogram_bound).
+ */
+EXPORT obs_stat_t *obs_stat_create(const char *name, const char *labels,
+		const char *help, enum obs_stat_type type);
+
+/**
+ * Creates a counter or gauge whose value is only read when a snapshot is
+ * taken, so it has no cost at all until then.  The sample callback must not
+ * block, and is never called again once obs_stat_destroy returns.
+ */
+EXPORT obs_stat_t *obs_stat_create_sampled(const char *name,
+		const char *labels, const char *help, enum obs_stat_type type,
+		obs_stat_sample_t sample, void *param);
+
+EXPORT void obs_stat_destroy(obs_stat_t *stat);
+
+/** Adds to a counter */
+EXPORT void obs_stat_add(obs_stat_t *stat, double val);
+/** Sets a gauge */
+EXPORT void obs_stat_set(obs_stat_t *stat, double val);
+/** Adds a sample to a histogram */
+EXPORT void obs_stat_observe(obs_stat_t *stat, double val);
+
+/** Returns the upper bound of a histogram bucket (the last is infinite) */
+EXPORT double obs_stat_histogram_bound(size_t bucket);
+
+/** Builds a label string such as key="value", escaping the value */
+EXPORT char *obs_stat_label(const char *key, const char *value);
+
+struct obs_stat_value {
+	const char         *name;
+	const char         *labels;
+	const char         *help;
+	enum obs_stat_type type;
+
+	/** Counter or gauge value, or the sum of all histogram samples */
+	double             value;
+
+	/** Number of histogram samples, and number of samples per bucket */
+	uint64_t           count;
+	uint64_t           buckets[OBS_STAT_HISTOGRAM_BUCKETS];
+};
+
+/** Copies the current value of every stat */
+EXPORT obs_stats_snapshot_t *obs_stats_snapshot_create(void);
+EXPORT void obs_stats_snapshot_free(obs_stats_snapshot_t *snap);
+
+EXPORT size_t obs_stats_snapshot_count(const obs_stats_snapshot_t *snap);
+EXPORT const struct obs_stat_value *obs_stats_snapshot_get(
+		const obs_stats_snapshot_t *snap, size_t idx);
+
+
 /* ------------------------------------------------------------------------- */
 /* Sources */
 
@@ -737,6 +962,12 @@ EXPORT obs_properties_t *obs_source_properties(const obs_source_t *source);
 /** Updates settings for this source */
 EXPORT void obs_source_update(obs_source_t *source, obs_data_t *settings);
 
+/**
+ * Tells libobs that the video of a source changed without a settings update,
+ * so that its cached output (see OBS_SOURCE_CACHEABLE) is rendered again.
+ */
+EXPORT void obs_source_invalidate_cache(obs_source_t *source);
+
 /** Renders a video source. */
 EXPORT void obs_source_video_render(obs_source_t *source);
 
@@ -815,6 +1046,12 @@ EXPORT void obs_source_enum_active_tree(obs_source_t *source,
 		obs_source_enum_proc_t enum_callback,
 		void *param);
 
+/**
+ * Hints to a source and all of its active children that they are about to be
+ * shown, so they can start loading their data in the background.
+ */
+EXPORT void obs_source_preload(obs_source_t *source);
+
 /** Returns true if active, false if not */
 EXPORT bool obs_source_active(const obs_source_t *source);
 
@@ -976,6 +1213,26 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/**
+ * Outputs asynchronous video data without copying it.  The frame's planes
+ * must stay valid until libobs calls release(param), which happens once the
+ * frame has been uploaded or dropped.  release can be called from any
+ * thread, and is called before this function returns if libobs has to fall
+ * back to copying the frame (for example with async filters, deinterlacing,
+ * or when too many frames are already borrowed from the source).
+ */
+EXPORT void obs_source_output_video_borrowed(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param);
+
+/**
+ * Drops any borrowed frames of the source that have not been used yet,
+ * calling their release callbacks.  A frame that is being uploaded at the
+ * time is released as soon as the upload finishes.  Call this before
+ * invalidating memory that was handed to obs_source_output_video_borrowed.
+ */
+EXPORT void obs_source_flush_borrowed_video(obs_source_t *source);
+
 /** Outputs audio data (always asynchronous) */
 EXPORT void obs_source_output_audio(obs_source_t *source,
 		const struct obs_source_audio *audio);
@@ -1029,6 +1286,17 @@ EXPORT void obs_source_process_filter_tech_end(obs_source_t *filter,
 /** Skips the filter if the filter is invalid and cannot be rendered */
 EXPORT void obs_source_skip_video_filter(obs_source_t *filter);
 
+/**
+ * Gets a parameter of a filter's per-pixel function from a generated effect,
+ * for use in the set_pixel_params callback.
+ *
+ * @param  effect  Generated effect
+ * @param  prefix  Prefix passed to set_pixel_params
+ * @param  name    Name of the uniform without the '$'
+ */
+EXPORT gs_eparam_t *obs_filter_get_fused_param(gs_effect_t *effect,
+		const char *prefix, const char *name);
+
 /**
  * Adds an active child source.  Must be called by parent sources on child
  * sources when the child is added and active.  This ensures that the source is
@@ -1669,6 +1937,24 @@ EXPORT bool obs_encoder_active(const obs_encoder_t *encoder);
 
 EXPORT void *obs_encoder_get_type_data(obs_encoder_t *encoder);
 
+struct obs_encoder_audio_stats {
+	uint64_t frames_encoded;
+	uint64_t avg_encode_ns;
+	uint64_t max_encode_ns;
+	uint64_t avg_queue_lag_ns;
+	uint64_t max_queue_lag_ns;
+	uint64_t queue_stalls;
+};
+
+/**
+ * Gets the timing statistics of an audio encoder's worker thread since it was
+ * last started: the time spent encoding each audio tick, and the time audio
+ * data spent waiting in the queue between the audio thread and the encoder.
+ * Returns false if this is not an audio encoder.
+ */
+EXPORT bool obs_encoder_get_audio_stats(const obs_encoder_t *encoder,
+		struct obs_encoder_audio_stats *stats);
+
 EXPORT const char *obs_encoder_get_id(const obs_encoder_t *encoder);
 
 EXPORT uint32_t obs_get_encoder_caps(const char *encoder_id);
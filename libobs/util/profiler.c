@@ -6,6 +6,7 @@
 #include "platform.h"
 #include "threading.h"
 
+#include <errno.h>
 #include <math.h>
 
 #include <zlib.h>
@@ -32,6 +33,44 @@ struct profiler_snapshot_entry {
 
 typedef struct profiler_time_entry profiler_time_entry;
 
+/*
+ * Every thread records its calls into its own preallocated arena, a ring of
+ * profile_calls stored in the order they were started along with their
+ * depth, so profile_start/profile_end never allocate or take a lock.  When
+ * the root call of a tree ends, the tree is published by advancing
+ * 'committed'.  The aggregator thread merges published trees into the root
+ * entries and hands the space back by advancing 'consumed'.
+ *
+ * If an arena is full, the tree being recorded is dropped.
+ *
+ * An arena is referenced by its thread and by the arena list.  The thread
+ * lets go of it when it exits (or when it notices that profiler_free let go
+ * of all arenas), the aggregator once it has merged the trees of an exited
+ * thread, and whoever lets go last frees it.
+ */
+
+#define ARENA_CALLS           4096 /* must be a power of two */
+#define ARENA_MAX_DEPTH       64
+#define AGGREGATE_INTERVAL_MS 10
+
+/*
+ * In timeline mode, every thread additionally keeps its most recent calls
+ * with their start and end times, so they can be written out as a Chrome
+ * trace (chrome://tracing, or ui.perfetto.dev).  The timeline ring is only
+ * allocated once timeline mode is enabled.
+ */
+
+#define TIMELINE_EVENTS       32768 /* must be a power of two */
+
+/*
+ * The timelines of threads that exit are kept on a list of retired
+ * timelines until profiler_free, so that a trace written at shutdown still
+ * has the graphics, video, audio and encoder threads.  Only the most recent
+ * ones are kept.
+ */
+
+#define MAX_RETIRED_TIMELINES 64
+
 typedef struct profile_call profile_call;
 struct profile_call {
 	const char *name;
@@ -43,11 +82,73 @@ struct profile_call {
 #ifdef TRACK_OVERHEAD
 	uint64_t overhead_end;
 #endif
-	uint64_t expected_time_between_calls;
-	DARRAY(profile_call) children;
-	profile_call *parent;
+	unsigned long depth;
+};
+
+struct call_frame {
+	const char *name;
+	unsigned long pos;
+	uint64_t start_time;
+};
+
+typedef struct timeline_event timeline_event;
+struct timeline_event {
+	const char *name;
+	uint64_t start_time;
+	uint64_t end_time;
+	bool mark;
+};
+
+typedef struct retired_timeline retired_timeline;
+struct retired_timeline {
+	timeline_event *timeline;
+	volatile long timeline_pos;
+	const char *thread_name;
+	long id;
+
+	retired_timeline *next;
 };
 
+typedef struct profile_arena profile_arena;
+struct profile_arena {
+	profile_call calls[ARENA_CALLS];
+	volatile long committed;
+	volatile long consumed;
+	volatile long dropped_trees;
+	volatile long refs;
+	volatile bool exited;
+
+	timeline_event *timeline;
+	volatile long timeline_pos;
+	const char *volatile thread_name;
+	long id;
+
+	/* only used by the thread owning the arena */
+	unsigned long write_pos;
+	struct call_frame stack[ARENA_MAX_DEPTH];
+	size_t depth;
+	size_t skipped_depth;
+	bool discard;
+
+	profile_arena *next;
+};
+
+static inline profile_call *get_call(profile_arena *arena, unsigned long pos)
+{
+	return &arena->calls[pos & (ARENA_CALLS - 1)];
+}
+
+/* publishes a position only after the entries before it have been written
+ * (or read), os_atomic_set_long is only an acquire barrier on GCC/Clang */
+static inline void publish_pos(volatile long *pos, long val)
+{
+#ifdef _MSC_VER
+	os_atomic_set_long(pos, val);
+#else
+	__atomic_store_n(pos, val, __ATOMIC_RELEASE);
+#endif
+}
+
 typedef struct profile_times_table_entry profile_times_table_entry;
 struct profile_times_table_entry {
 	size_t probes;
@@ -80,10 +181,9 @@ struct profile_entry {
 
 typedef struct profile_root_entry profile_root_entry;
 struct profile_root_entry {
-	pthread_mutex_t *mutex;
 	const char *name;
 	profile_entry *entry;
-	profile_call *prev_call;
+	uint64_t prev_start_time;
 };
 
 static inline uint64_t diff_ns_to_usec(uint64_t prev, uint64_t next)
@@ -228,18 +328,24 @@ static profile_entry *get_child(profile_entry *parent, const char *name)
 	return init_entry(da_push_back_new(parent->children), name);
 }
 
-static void merge_call(profile_entry *entry, profile_call *call,
-		profile_call *prev_call)
+/* merges the call at *pos and all of its children, and advances *pos past
+ * them */
+static void merge_call(profile_entry *entry, profile_arena *arena,
+		unsigned long *pos, unsigned long end, uint64_t prev_start_time)
 {
-	const size_t num = call->children.num;
-	for (size_t i = 0; i < num; i++) {
-		profile_call *child = &call->children.array[i];
-		merge_call(get_child(entry, child->name), child, NULL);
+	profile_call *call = get_call(arena, (*pos)++);
+
+	while (*pos != end) {
+		profile_call *child = get_call(arena, *pos);
+		if (child->depth <= call->depth)
+			break;
+
+		merge_call(get_child(entry, child->name), arena, pos, end, 0);
 	}
 
-	if (entry->expected_time_between_calls != 0 && prev_call) {
+	if (entry->expected_time_between_calls != 0 && prev_start_time) {
 		migrate_old_entries(&entry->times_between_calls, true);
-		uint64_t usec = diff_ns_to_usec(prev_call->start_time,
+		uint64_t usec = diff_ns_to_usec(prev_start_time,
 				call->start_time);
 		add_hashmap_entry(&entry->times_between_calls, usec, 1);
 	}
@@ -256,29 +362,271 @@ static void merge_call(profile_entry *entry, profile_call *call,
 #endif
 }
 
-static bool enabled = false;
+static volatile bool enabled = false;
 static pthread_mutex_t root_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DARRAY(profile_root_entry) root_entries;
 
+static profile_arena *arenas = NULL;
+static volatile long arena_generation = 0;
+static long next_arena_id = 1;
+static volatile bool timeline_enabled = false;
+static long dropped_trees = 0;
+static retired_timeline *retired_timelines = NULL;
+static size_t num_retired_timelines = 0;
+static pthread_once_t arena_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t arena_key;
+
+static bool aggregator_active = false;
+static pthread_t aggregator_thread;
+static os_event_t *aggregator_stop = NULL;
+
 #ifdef _MSC_VER
-static __declspec(thread) profile_call *thread_context = NULL;
+static __declspec(thread) profile_arena *thread_arena = NULL;
+static __declspec(thread) long thread_generation = 0;
 static __declspec(thread) bool thread_enabled = true;
 #else
-static __thread profile_call *thread_context = NULL;
+static __thread profile_arena *thread_arena = NULL;
+static __thread long thread_generation = 0;
 static __thread bool thread_enabled = true;
 #endif
 
+static profile_root_entry *get_root_entry(const char *name)
+{
+	profile_root_entry *r_entry = NULL;
+
+	for (size_t i = 0; i < root_entries.num; i++) {
+		if (root_entries.array[i].name == name) {
+			r_entry = &root_entries.array[i];
+			break;
+		}
+	}
+
+	if (!r_entry) {
+		r_entry = da_push_back_new(root_entries);
+		r_entry->name = name;
+		r_entry->entry = bzalloc(sizeof(profile_entry));
+		init_entry(r_entry->entry, name);
+	}
+
+	return r_entry;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Aggregation, always with root_mutex held */
+
+static void aggregate_arena(profile_arena *arena)
+{
+	unsigned long end = (unsigned long)os_atomic_load_long(
+			&arena->committed);
+	unsigned long pos = (unsigned long)arena->consumed;
+
+	while (pos != end) {
+		profile_call *root = get_call(arena, pos);
+		profile_root_entry *r_entry = get_root_entry(root->name);
+		uint64_t start_time = root->start_time;
+
+		merge_call(r_entry->entry, arena, &pos, end,
+				r_entry->prev_start_time);
+		r_entry->prev_start_time = start_time;
+	}
+
+	publish_pos(&arena->consumed, (long)end);
+}
+
+static void release_arena(profile_arena *arena)
+{
+	if (os_atomic_dec_long(&arena->refs) == 0) {
+		bfree(arena->timeline);
+		bfree(arena);
+	}
+}
+
+static void free_retired_timelines(retired_timeline *retired)
+{
+	while (retired) {
+		retired_timeline *next = retired->next;
+		bfree(retired->timeline);
+		bfree(retired);
+		retired = next;
+	}
+}
+
+/* takes over the timeline of an arena whose thread has exited */
+static void retire_timeline(profile_arena *arena)
+{
+	retired_timeline *retired;
+
+	if (!arena->timeline)
+		return;
+
+	retired = bzalloc(sizeof(retired_timeline));
+	retired->timeline     = arena->timeline;
+	retired->timeline_pos = os_atomic_load_long(&arena->timeline_pos);
+	retired->thread_name  = arena->thread_name;
+	retired->id           = arena->id;
+	retired->next         = retired_timelines;
+	arena->timeline       = NULL;
+
+	retired_timelines = retired;
+
+	if (++num_retired_timelines > MAX_RETIRED_TIMELINES) {
+		retired_timeline **last = &retired_timelines;
+
+		while ((*last)->next)
+			last = &(*last)->next;
+
+		free_retired_timelines(*last);
+		*last = NULL;
+		num_retired_timelines--;
+	}
+}
+
+/* lets go of the reference of the arena list */
+static void unlist_arena(profile_arena *arena)
+{
+	dropped_trees += os_atomic_load_long(&arena->dropped_trees);
+	release_arena(arena);
+}
+
+static void aggregate(void)
+{
+	profile_arena **prev_next = &arenas;
+	profile_arena *arena = arenas;
+
+	while (arena) {
+		profile_arena *next = arena->next;
+		bool exited = os_atomic_load_bool(&arena->exited);
+
+		aggregate_arena(arena);
+
+		if (exited) {
+			*prev_next = next;
+			retire_timeline(arena);
+			unlist_arena(arena);
+		} else {
+			prev_next = &arena->next;
+		}
+
+		arena = next;
+	}
+}
+
+static void *aggregator_thread_func(void *unused)
+{
+	os_set_thread_name("profiler: aggregator");
+
+	while (os_event_timedwait(aggregator_stop, AGGREGATE_INTERVAL_MS)
+			== ETIMEDOUT) {
+		pthread_mutex_lock(&root_mutex);
+		aggregate();
+		pthread_mutex_unlock(&root_mutex);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static void start_aggregator(void)
+{
+	if (aggregator_active)
+		return;
+	if (os_event_init(&aggregator_stop, OS_EVENT_TYPE_MANUAL) != 0)
+		return;
+
+	if (pthread_create(&aggregator_thread, NULL, aggregator_thread_func,
+				NULL) != 0) {
+		os_event_destroy(aggregator_stop);
+		aggregator_stop = NULL;
+		return;
+	}
+
+	aggregator_active = true;
+}
+
+static void stop_aggregator(void)
+{
+	bool active;
+
+	pthread_mutex_lock(&root_mutex);
+	active = aggregator_active;
+	aggregator_active = false;
+	pthread_mutex_unlock(&root_mutex);
+
+	if (!active)
+		return;
+
+	os_event_signal(aggregator_stop);
+	pthread_join(aggregator_thread, NULL);
+	os_event_destroy(aggregator_stop);
+	aggregator_stop = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Per-thread arenas */
+
+/* called with the thread's own reference, so the arena is still valid */
+static void arena_thread_exit(void *data)
+{
+	profile_arena *arena = data;
+
+	os_atomic_set_bool(&arena->exited, true);
+	thread_arena = NULL;
+	release_arena(arena);
+}
+
+static void init_arena_key(void)
+{
+	pthread_key_create(&arena_key, arena_thread_exit);
+}
+
+static profile_arena *create_arena(void)
+{
+	profile_arena *arena = bzalloc(sizeof(profile_arena));
+
+	arena->refs = 2;
+	pthread_once(&arena_key_once, init_arena_key);
+
+	pthread_mutex_lock(&root_mutex);
+	arena->id = next_arena_id++;
+	arena->next = arenas;
+	arenas = arena;
+	thread_generation = arena_generation;
+	pthread_mutex_unlock(&root_mutex);
+
+	pthread_setspecific(arena_key, arena);
+	thread_arena = arena;
+	return arena;
+}
+
+/* profiler_free lets go of all arenas, after which the thread lets go of
+ * its arena as well and starts a new one if the profiler is enabled again */
+static inline profile_arena *get_arena(void)
+{
+	if (!thread_arena)
+		return NULL;
+	if (thread_generation == os_atomic_load_long(&arena_generation))
+		return thread_arena;
+
+	pthread_setspecific(arena_key, NULL);
+	release_arena(thread_arena);
+	thread_arena = NULL;
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
-	enabled = true;
+	os_atomic_set_bool(&enabled, true);
+	start_aggregator();
 	pthread_mutex_unlock(&root_mutex);
 }
 
 void profiler_stop(void)
 {
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
+	os_atomic_set_bool(&enabled, false);
 	pthread_mutex_unlock(&root_mutex);
 }
 
@@ -287,9 +635,7 @@ void profile_reenable_thread(void)
 	if (thread_enabled)
 		return;
 
-	pthread_mutex_lock(&root_mutex);
-	thread_enabled = enabled;
-	pthread_mutex_unlock(&root_mutex);
+	thread_enabled = os_atomic_load_bool(&enabled);
 }
 
 static bool lock_root(void)
@@ -304,30 +650,6 @@ static bool lock_root(void)
 	return true;
 }
 
-static profile_root_entry *get_root_entry(const char *name)
-{
-	profile_root_entry *r_entry = NULL;
-
-	for (size_t i = 0; i < root_entries.num; i++) {
-		if (root_entries.array[i].name == name) {
-			r_entry = &root_entries.array[i];
-			break;
-		}
-	}
-
-	if (!r_entry) {
-		r_entry = da_push_back_new(root_entries);
-		r_entry->mutex = bmalloc(sizeof(pthread_mutex_t));
-		pthread_mutex_init(r_entry->mutex, NULL);
-
-		r_entry->name = name;
-		r_entry->entry = bzalloc(sizeof(profile_entry));
-		init_entry(r_entry->entry, name);
-	}
-
-	return r_entry;
-}
-
 void profile_register_root(const char *name,
 		uint64_t expected_time_between_calls)
 {
@@ -339,108 +661,361 @@ void profile_register_root(const char *name,
 	pthread_mutex_unlock(&root_mutex);
 }
 
-static void free_call_context(profile_call *context);
-
-static void merge_context(profile_call *context)
+void profile_start(const char *name)
 {
-	pthread_mutex_t *mutex = NULL;
-	profile_entry *entry = NULL;
-	profile_call *prev_call = NULL;
+#ifdef TRACK_OVERHEAD
+	uint64_t overhead_start = os_gettime_ns();
+#endif
+	profile_arena *arena;
+	struct call_frame *frame;
+	profile_call *call;
 
-	if (!lock_root()) {
-		free_call_context(context);
+	if (!thread_enabled)
 		return;
+
+	arena = get_arena();
+
+	/* the profiler can only be turned off between root calls */
+	if (!arena || !arena->depth) {
+		if (!os_atomic_load_bool(&enabled)) {
+			thread_enabled = false;
+			return;
+		}
+		if (!arena)
+			arena = create_arena();
 	}
 
-	profile_root_entry *r_entry = get_root_entry(context->name);
+	if (arena->depth == ARENA_MAX_DEPTH) {
+		arena->skipped_depth++;
+		return;
+	}
 
-	mutex     = r_entry->mutex;
-	entry     = r_entry->entry;
-	prev_call = r_entry->prev_call;
+	if (!arena->depth)
+		arena->thread_name = name;
+
+	frame = &arena->stack[arena->depth++];
+	frame->name = name;
+	frame->pos = arena->write_pos;
+	call = NULL;
+
+	if (!arena->discard) {
+		if (arena->write_pos - (unsigned long)os_atomic_load_long(
+					&arena->consumed) >= ARENA_CALLS) {
+			arena->discard = true;
+		} else {
+			call = get_call(arena, arena->write_pos++);
+			call->name = name;
+			call->depth = (unsigned long)(arena->depth - 1);
+#ifdef TRACK_OVERHEAD
+			call->overhead_start = overhead_start;
+#endif
+		}
+	}
 
-	r_entry->prev_call = context;
+	frame->start_time = os_gettime_ns();
+	if (call)
+		call->start_time = frame->start_time;
+}
 
-	pthread_mutex_lock(mutex);
-	pthread_mutex_unlock(&root_mutex);
+static void timeline_record(profile_arena *arena, const char *name,
+		uint64_t start_time, uint64_t end_time, bool mark)
+{
+	unsigned long pos = (unsigned long)arena->timeline_pos;
+	timeline_event *event;
 
-	merge_call(entry, context, prev_call);
+	if (!arena->timeline)
+		arena->timeline = bmalloc(sizeof(timeline_event) *
+				TIMELINE_EVENTS);
 
-	pthread_mutex_unlock(mutex);
+	event = &arena->timeline[pos & (TIMELINE_EVENTS - 1)];
+	event->name = name;
+	event->start_time = start_time;
+	event->end_time = end_time;
+	event->mark = mark;
 
-	free_call_context(prev_call);
+	publish_pos(&arena->timeline_pos, (long)(pos + 1));
 }
 
-void profile_start(const char *name)
+static void end_call(profile_arena *arena, struct call_frame *frame,
+		uint64_t end)
 {
-	if (!thread_enabled)
-		return;
+	arena->depth--;
 
-	profile_call new_call = {
-		.name = name,
+	if (os_atomic_load_bool(&timeline_enabled))
+		timeline_record(arena, frame->name, frame->start_time, end,
+				false);
+
+	if (!arena->discard) {
+		profile_call *call = get_call(arena, frame->pos);
+		call->name = frame->name;
+		call->end_time = end;
 #ifdef TRACK_OVERHEAD
-		.overhead_start = os_gettime_ns(),
+		call->overhead_end = os_gettime_ns();
 #endif
-		.parent = thread_context,
-	};
+	}
 
-	profile_call *call = NULL;
+	if (arena->depth)
+		return;
 
-	if (new_call.parent) {
-		size_t idx = da_push_back(new_call.parent->children, &new_call);
-		call = &new_call.parent->children.array[idx];
-	} else {
-		call = bmalloc(sizeof(profile_call));
-		memcpy(call, &new_call, sizeof(profile_call));
+	if (arena->discard) {
+		arena->write_pos = (unsigned long)arena->committed;
+		arena->discard = false;
+		os_atomic_inc_long(&arena->dropped_trees);
+		return;
 	}
 
-	thread_context = call;
-	call->start_time = os_gettime_ns();
+	publish_pos(&arena->committed, (long)arena->write_pos);
 }
 
 void profile_end(const char *name)
 {
 	uint64_t end = os_gettime_ns();
+	profile_arena *arena;
+	struct call_frame *frame;
+
 	if (!thread_enabled)
 		return;
 
-	profile_call *call = thread_context;
-	if (!call) {
+	arena = get_arena();
+	if (!arena)
+		return;
+
+	if (arena->skipped_depth) {
+		arena->skipped_depth--;
+		return;
+	}
+
+	if (!arena->depth) {
 		blog(LOG_ERROR, "Called profile end with no active profile");
 		return;
 	}
 
-	if (!call->name)
-		call->name = name;
+	frame = &arena->stack[arena->depth - 1];
+	if (!frame->name)
+		frame->name = name;
 
-	if (call->name != name) {
+	if (frame->name != name) {
 		blog(LOG_ERROR, "Called profile end with mismatching name: "
 				"start(\"%s\"[%p]) <-> end(\"%s\"[%p])",
-				call->name, call->name, name, name);
+				frame->name, frame->name, name, name);
 
-		profile_call *parent = call->parent;
-		while (parent && parent->parent &&  parent->name != name)
-			parent = parent->parent;
+		size_t idx = arena->depth - 1;
+		while (idx > 0 && arena->stack[idx].name != name)
+			idx--;
 
-		if (!parent || parent->name != name)
+		if (arena->stack[idx].name != name)
 			return;
 
-		while (call->name != name) {
-			profile_end(call->name);
-			call = call->parent;
-		}
+		while (arena->depth - 1 > idx)
+			profile_end(arena->stack[arena->depth - 1].name);
+
+		frame = &arena->stack[idx];
 	}
 
-	thread_context = call->parent;
+	end_call(arena, frame, end);
+}
 
-	call->end_time = end;
-#ifdef TRACK_OVERHEAD
-	call->overhead_end = os_gettime_ns();
-#endif
+/* ------------------------------------------------------------------------- */
+/* Timeline */
+
+void profiler_timeline_enable(bool enable)
+{
+	os_atomic_set_bool(&timeline_enabled, enable);
+}
 
-	if (call->parent)
+void profile_mark(const char *name)
+{
+	uint64_t time = os_gettime_ns();
+	profile_arena *arena;
+
+	if (!thread_enabled || !os_atomic_load_bool(&timeline_enabled))
 		return;
 
-	merge_context(call);
+	arena = get_arena();
+	if (!arena) {
+		if (!os_atomic_load_bool(&enabled))
+			return;
+		arena = create_arena();
+	}
+
+	timeline_record(arena, name, time, time, true);
+}
+
+typedef DARRAY(timeline_event) timeline_events_t;
+
+/* copies the events of a timeline, leaving out any that might have been
+ * overwritten while copying */
+static void timeline_copy(const timeline_event *timeline,
+		const volatile long *timeline_pos, timeline_events_t *events)
+{
+	unsigned long end = (unsigned long)os_atomic_load_long(timeline_pos);
+	unsigned long count = end < TIMELINE_EVENTS ? end : TIMELINE_EVENTS;
+	unsigned long start = end - count;
+	unsigned long valid_start;
+
+	da_resize((*events), 0);
+	if (!count)
+		return;
+
+	for (unsigned long pos = start; pos != end; pos++)
+		da_push_back((*events),
+				&timeline[pos & (TIMELINE_EVENTS - 1)]);
+
+	/* the writer may have lapped the oldest events while copying */
+	valid_start = (unsigned long)os_atomic_load_long(timeline_pos);
+	valid_start = valid_start > TIMELINE_EVENTS ?
+		valid_start - TIMELINE_EVENTS + 1 : 0;
+
+	if (valid_start > start) {
+		size_t invalid = valid_start - start;
+		if (invalid > events->num)
+			invalid = events->num;
+		da_erase_range((*events), 0, invalid);
+	}
+}
+
+static uint64_t timeline_last_mark(const timeline_event *timeline,
+		const volatile long *timeline_pos, timeline_events_t *events,
+		const char *name, uint64_t last)
+{
+	timeline_copy(timeline, timeline_pos, events);
+
+	for (size_t i = 0; i < events->num; i++) {
+		timeline_event *event = &events->array[i];
+		if (event->mark && event->start_time > last &&
+		    strcmp(event->name, name) == 0)
+			last = event->start_time;
+	}
+
+	return last;
+}
+
+uint64_t profiler_timeline_last_mark(const char *name)
+{
+	timeline_events_t events = {0};
+	uint64_t last = 0;
+
+	pthread_mutex_lock(&root_mutex);
+	for (profile_arena *arena = arenas; arena; arena = arena->next) {
+		if (arena->timeline)
+			last = timeline_last_mark(arena->timeline,
+					&arena->timeline_pos, &events, name,
+					last);
+	}
+	for (retired_timeline *retired = retired_timelines; retired;
+			retired = retired->next)
+		last = timeline_last_mark(retired->timeline,
+				&retired->timeline_pos, &events, name, last);
+	pthread_mutex_unlock(&root_mutex);
+
+	da_free(events);
+	return last;
+}
+
+static void json_cat_string(struct dstr *json, const char *str)
+{
+	dstr_cat_ch(json, '"');
+
+	for (; str && *str; str++) {
+		char ch = *str;
+
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(json, '\\');
+			dstr_cat_ch(json, ch);
+		} else if ((unsigned char)ch < 0x20) {
+			dstr_catf(json, "\\u%04x", (unsigned)ch);
+		} else {
+			dstr_cat_ch(json, ch);
+		}
+	}
+
+	dstr_cat_ch(json, '"');
+}
+
+static void timeline_dump(const timeline_event *timeline,
+		const volatile long *timeline_pos, const char *thread_name,
+		long id, timeline_events_t *events, struct dstr *json,
+		bool *first, uint64_t start_ns, uint64_t end_ns)
+{
+	bool any = false;
+
+	timeline_copy(timeline, timeline_pos, events);
+
+	for (size_t i = 0; i < events->num; i++) {
+		timeline_event *event = &events->array[i];
+
+		if (event->end_time < start_ns || event->start_time > end_ns)
+			continue;
+
+		dstr_cat(json, *first ? "\n" : ",\n");
+		*first = false;
+		any = true;
+
+		dstr_cat(json, "{\"name\":");
+		json_cat_string(json, event->name);
+
+		if (event->mark)
+			dstr_catf(json, ",\"ph\":\"i\",\"s\":\"g\","
+					"\"pid\":1,\"tid\":%ld,"
+					"\"ts\":%.3f}",
+					id,
+					(double)event->start_time / 1000.0);
+		else
+			dstr_catf(json, ",\"ph\":\"X\","
+					"\"pid\":1,\"tid\":%ld,"
+					"\"ts\":%.3f,\"dur\":%.3f}",
+					id,
+					(double)event->start_time / 1000.0,
+					(double)(event->end_time -
+						event->start_time) / 1000.0);
+	}
+
+	if (any && thread_name) {
+		dstr_catf(json, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+				"\"pid\":1,\"tid\":%ld,\"args\":{\"name\":",
+				id);
+		json_cat_string(json, thread_name);
+		dstr_cat(json, "}}");
+	}
+}
+
+bool profiler_timeline_dump_json(const char *filename, uint64_t start_ns,
+		uint64_t end_ns)
+{
+	timeline_events_t events = {0};
+	struct dstr json = {0};
+	bool first = true;
+	bool success = false;
+	FILE *f;
+
+	dstr_cat(&json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	pthread_mutex_lock(&root_mutex);
+	for (profile_arena *arena = arenas; arena; arena = arena->next) {
+		if (arena->timeline)
+			timeline_dump(arena->timeline, &arena->timeline_pos,
+					arena->thread_name, arena->id,
+					&events, &json, &first,
+					start_ns, end_ns);
+	}
+	for (retired_timeline *retired = retired_timelines; retired;
+			retired = retired->next)
+		timeline_dump(retired->timeline, &retired->timeline_pos,
+				retired->thread_name, retired->id,
+				&events, &json, &first, start_ns, end_ns);
+	pthread_mutex_unlock(&root_mutex);
+
+	dstr_cat(&json, "\n]}\n");
+
+	f = os_fopen(filename, "wb");
+	if (f) {
+		success = fwrite(json.array, 1, json.len, f) == json.len;
+		fclose(f);
+	}
+
+	da_free(events);
+	dstr_free(&json);
+	return success;
 }
 
 static int profiler_time_entry_compare(const void *first, const void *second)
@@ -762,24 +1337,6 @@ void profiler_print_time_between_calls(profiler_snapshot_t *snap)
 			profile_print_entry_expected, snap);
 }
 
-static void free_call_children(profile_call *call)
-{
-	if (!call)
-		return;
-
-	const size_t num = call->children.num;
-	for (size_t i = 0; i < num; i++)
-		free_call_children(&call->children.array[i]);
-
-	da_free(call->children);
-}
-
-static void free_call_context(profile_call *context)
-{
-	free_call_children(context);
-	bfree(context);
-}
-
 static void free_hashmap(profile_times_table *map)
 {
 	map->size = 0;
@@ -805,23 +1362,39 @@ static void free_profile_entry(profile_entry *entry)
 void profiler_free(void)
 {
 	DARRAY(profile_root_entry) old_root_entries = {0};
+	profile_arena *old_arenas;
+	retired_timeline *old_retired;
+
+	profiler_stop();
+	stop_aggregator();
 
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
+	os_atomic_inc_long(&arena_generation);
+	old_arenas = arenas;
+	arenas = NULL;
+	old_retired = retired_timelines;
+	retired_timelines = NULL;
+	num_retired_timelines = 0;
 	da_move(old_root_entries, root_entries);
 	pthread_mutex_unlock(&root_mutex);
 
-	for (size_t i = 0; i < old_root_entries.num; i++) {
-		profile_root_entry *entry = &old_root_entries.array[i];
+	/* arenas of threads that are still running are freed by them */
+	while (old_arenas) {
+		profile_arena *next = old_arenas->next;
+		unlist_arena(old_arenas);
+		old_arenas = next;
+	}
 
-		pthread_mutex_lock(entry->mutex);
-		pthread_mutex_unlock(entry->mutex);
+	free_retired_timelines(old_retired);
 
-		pthread_mutex_destroy(entry->mutex);
-		bfree(entry->mutex);
-		entry->mutex = NULL;
+	if (dropped_trees)
+		blog(LOG_INFO, "Profiler: %ld call trees were dropped because "
+				"a thread's profiler arena was full",
+				dropped_trees);
+	dropped_trees = 0;
 
-		free_call_context(entry->prev_call);
+	for (size_t i = 0; i < old_root_entries.num; i++) {
+		profile_root_entry *entry = &old_root_entries.array[i];
 
 		free_profile_entry(entry->entry);
 		bfree(entry->entry);
@@ -934,13 +1507,11 @@ profiler_snapshot_t *profile_snapshot_create(void)
 	profiler_snapshot_t *snap = bzalloc(sizeof(profiler_snapshot_t));
 
 	pthread_mutex_lock(&root_mutex);
+	aggregate();
 	da_reserve(snap->roots, root_entries.num);
-	for (size_t i = 0; i < root_entries.num; i++) {
-		pthread_mutex_lock(root_entries.array[i].mutex);
+	for (size_t i = 0; i < root_entries.num; i++)
 		add_entry_to_snapshot(root_entries.array[i].entry,
 				da_push_back_new(snap->roots));
-		pthread_mutex_unlock(root_entries.array[i].mutex);
-	}
 	pthread_mutex_unlock(&root_mutex);
 
 	for (size_t i = 0; i < snap->roots.num; i++)
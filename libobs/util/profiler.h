@@ -33,6 +33,31 @@ EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
 EXPORT void profiler_free(void);
 
+/* ------------------------------------------------------------------------- */
+/* Profiler timeline */
+
+/**
+ * Enables or disables timeline mode.  While enabled, every thread keeps its
+ * most recent profiled calls (a bounded number) with their start and end
+ * times, so they can be written out with profiler_timeline_dump_json.
+ */
+EXPORT void profiler_timeline_enable(bool enable);
+
+/** Adds an instant event (such as "lagged_frame") to the timeline */
+EXPORT void profile_mark(const char *name);
+
+/** Returns the time of the most recent mark with this name, or 0 */
+EXPORT uint64_t profiler_timeline_last_mark(const char *name);
+
+/**
+ * Writes the timeline events between start_ns and end_ns (os_gettime_ns
+ * time) in Chrome Trace Event JSON format, which can be loaded in
+ * chrome://tracing or ui.perfetto.dev.  Threads that have already exited are
+ * included until profiler_free.
+ */
+EXPORT bool profiler_timeline_dump_json(const char *filename,
+		uint64_t start_ns, uint64_t end_ns);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler name storage */
 
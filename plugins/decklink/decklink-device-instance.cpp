@@ -53,6 +53,13 @@ void DeckLinkDeviceInstance::HandleAudioPacket(
 	obs_source_output_audio(decklink->GetSource(), &currentPacket);
 }
 
+static void ReleaseVideoFrame(void *param)
+{
+	IDeckLinkVideoInputFrame *videoFrame =
+		reinterpret_cast<IDeckLinkVideoInputFrame*>(param);
+	videoFrame->Release();
+}
+
 void DeckLinkDeviceInstance::HandleVideoFrame(
 		IDeckLinkVideoInputFrame *videoFrame, const uint64_t timestamp)
 {
@@ -75,7 +82,11 @@ void DeckLinkDeviceInstance::HandleVideoFrame(
 			currentFrame.color_matrix, currentFrame.color_range_min,
 			currentFrame.color_range_max);
 
-	obs_source_output_video(decklink->GetSource(), &currentFrame);
+	/* the frame is refcounted, so keep it alive until obs has uploaded
+	 * it rather than having obs copy it */
+	videoFrame->AddRef();
+	obs_source_output_video_borrowed(decklink->GetSource(), &currentFrame,
+			ReleaseVideoFrame, videoFrame);
 }
 
 bool DeckLinkDeviceInstance::StartCapture(DeckLinkDeviceMode *mode_)
@@ -1,8 +1,8 @@
 #include <obs-module.h>
 #include <graphics/image-file.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <util/dstr.h>
-#include <sys/stat.h>
 
 #define blog(log_level, format, ...) \
 	blog(log_level, "[image_source: '%s'] " format, \
@@ -20,23 +20,27 @@ struct image_source {
 
 	char         *file;
 	bool         persistent;
-	time_t       file_timestamp;
-	float        update_time_elapsed;
+	obs_file_watch_t *watch;
+	volatile bool file_changed;
 	uint64_t     last_time;
 	bool         active;
 
+	/* animated gifs keep their own copy for their animation state, all
+	 * other images are shared through the libobs image cache.  Both are
+	 * decoded on the image cache's threads, an animated gif is moved
+	 * from loading to image on the first tick after it's decoded */
 	gs_image_file_t image;
+	obs_image_t  *loading;
+	obs_image_t  *cached;
 };
 
-
-static time_t get_modified_timestamp(const char *filename)
+static inline bool is_animated_file(const char *file)
 {
-	struct stat stats;
-	if (os_stat(filename, &stats) != 0)
-		return -1;
-	return stats.st_mtime;
+	const char *ext = os_get_path_extension(file);
+	return ext && astrcmpi(ext, ".gif") == 0;
 }
 
+
 static const char *image_source_get_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -46,43 +50,97 @@ static const char *image_source_get_name(void *unused)
 static void image_source_load(struct image_source *context)
 {
 	char *file = context->file;
+	obs_image_t *loading = NULL;
+	obs_image_t *cached = NULL;
+
+	if (file && *file && is_animated_file(file)) {
+		debug("loading animated image '%s'", file);
+		loading = obs_image_load_unshared(file);
+	} else if (file && *file) {
+		debug("loading cached image '%s'", file);
+		cached = obs_image_cache_get(file);
+	}
 
 	obs_enter_graphics();
 	gs_image_file_free(&context->image);
+	obs_image_release(context->loading);
+	obs_image_release(context->cached);
+	context->loading = loading;
+	context->cached = cached;
 	obs_leave_graphics();
+}
 
-	if (file && *file) {
-		debug("loading texture '%s'", file);
-		context->file_timestamp = get_modified_timestamp(file);
-		gs_image_file_init(&context->image, file);
-		context->update_time_elapsed = 0;
+/* takes over an animated gif once it's decoded, so only the texture is
+ * created on the graphics thread */
+static void image_source_finish_load(struct image_source *context)
+{
+	bool loaded;
 
-		obs_enter_graphics();
-		gs_image_file_init_texture(&context->image);
-		obs_leave_graphics();
+	obs_enter_graphics();
 
-		if (!context->image.loaded)
-			warn("failed to load texture '%s'", file);
+	loaded = obs_image_take_file(context->loading, &context->image);
+	if (loaded) {
+		obs_image_release(context->loading);
+		context->loading = NULL;
+		gs_image_file_init_texture(&context->image);
 	}
+
+	obs_leave_graphics();
+
+	if (!loaded)
+		return;
+	if (!context->image.loaded)
+		warn("failed to load texture '%s'", context->file);
+
+	context->last_time = 0;
+	obs_source_invalidate_cache(context->source);
 }
 
 static void image_source_unload(struct image_source *context)
 {
 	obs_enter_graphics();
 	gs_image_file_free(&context->image);
+	obs_image_release(context->loading);
+	obs_image_release(context->cached);
+	context->loading = NULL;
+	context->cached = NULL;
 	obs_leave_graphics();
 }
 
+static void image_source_preload(void *data)
+{
+	struct image_source *context = data;
+
+	if (!context->persistent && context->file &&
+	    !is_animated_file(context->file))
+		obs_image_cache_preload(context->file);
+}
+
+static void image_source_file_changed(void *data, const char *path)
+{
+	struct image_source *context = data;
+	os_atomic_set_bool(&context->file_changed, true);
+
+	UNUSED_PARAMETER(path);
+}
+
 static void image_source_update(void *data, obs_data_t *settings)
 {
 	struct image_source *context = data;
 	const char *file = obs_data_get_string(settings, "file");
 	const bool unload = obs_data_get_bool(settings, "unload");
 
+	if (!context->file || strcmp(context->file, file) != 0) {
+		obs_file_watch_remove(context->watch);
+		context->watch = obs_file_watch_add(file,
+				image_source_file_changed, context);
+	}
+
 	if (context->file)
 		bfree(context->file);
 	context->file = bstrdup(file);
 	context->persistent = !unload;
+	os_atomic_set_bool(&context->file_changed, false);
 
 	/* Load the image if the source is persistent or showing */
 	if (context->persistent || obs_source_showing(context->source))
@@ -125,6 +183,7 @@ static void image_source_destroy(void *data)
 {
 	struct image_source *context = data;
 
+	obs_file_watch_remove(context->watch);
 	image_source_unload(context);
 
 	if (context->file)
@@ -135,26 +194,30 @@ static void image_source_destroy(void *data)
 static uint32_t image_source_getwidth(void *data)
 {
 	struct image_source *context = data;
-	return context->image.cx;
+	return context->cached ?
+		obs_image_get_width(context->cached) : context->image.cx;
 }
 
 static uint32_t image_source_getheight(void *data)
 {
 	struct image_source *context = data;
-	return context->image.cy;
+	return context->cached ?
+		obs_image_get_height(context->cached) : context->image.cy;
 }
 
 static void image_source_render(void *data, gs_effect_t *effect)
 {
 	struct image_source *context = data;
+	gs_texture_t *texture = context->cached ?
+		obs_image_get_texture(context->cached) :
+		context->image.texture;
 
-	if (!context->image.texture)
+	if (!texture)
 		return;
 
-	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
-			context->image.texture);
-	gs_draw_sprite(context->image.texture, 0,
-			context->image.cx, context->image.cy);
+	obs_source_draw(texture, 0, 0, 0, 0, false);
+
+	UNUSED_PARAMETER(effect);
 }
 
 static void image_source_tick(void *data, float seconds)
@@ -162,17 +225,14 @@ static void image_source_tick(void *data, float seconds)
 	struct image_source *context = data;
 	uint64_t frame_time = obs_get_video_frame_time();
 
-	context->update_time_elapsed += seconds;
-
-	if (context->update_time_elapsed >= 1.0f) {
-		time_t t = get_modified_timestamp(context->file);
-		context->update_time_elapsed = 0.0f;
-
-		if (context->file_timestamp != t) {
-			image_source_load(context);
-		}
+	if (os_atomic_set_bool(&context->file_changed, false)) {
+		image_source_load(context);
+		obs_source_invalidate_cache(context->source);
 	}
 
+	if (context->loading)
+		image_source_finish_load(context);
+
 	if (obs_source_active(context->source)) {
 		if (!context->active) {
 			if (context->image.is_animated_gif)
@@ -190,6 +250,7 @@ static void image_source_tick(void *data, float seconds)
 				obs_enter_graphics();
 				gs_image_file_update_texture(&context->image);
 				obs_leave_graphics();
+				obs_source_invalidate_cache(context->source);
 			}
 
 			context->active = false;
@@ -206,10 +267,13 @@ static void image_source_tick(void *data, float seconds)
 			obs_enter_graphics();
 			gs_image_file_update_texture(&context->image);
 			obs_leave_graphics();
+			obs_source_invalidate_cache(context->source);
 		}
 	}
 
 	context->last_time = frame_time;
+
+	UNUSED_PARAMETER(seconds);
 }
 
 
@@ -251,7 +315,8 @@ static obs_properties_t *image_source_properties(void *data)
 static struct obs_source_info image_source_info = {
 	.id             = "image_source",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_SINGLE_TEXTURE |
+	                  OBS_SOURCE_CACHEABLE,
 	.get_name       = image_source_get_name,
 	.create         = image_source_create,
 	.destroy        = image_source_destroy,
@@ -263,7 +328,8 @@ static struct obs_source_info image_source_info = {
 	.get_height     = image_source_getheight,
 	.video_render   = image_source_render,
 	.video_tick     = image_source_tick,
-	.get_properties = image_source_properties
+	.get_properties = image_source_properties,
+	.preload        = image_source_preload
 };
 
 OBS_DECLARE_MODULE()
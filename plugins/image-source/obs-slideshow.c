@@ -1,3 +1,4 @@
+#include <inttypes.h>
 #include <obs-module.h>
 #include <util/threading.h>
 #include <util/platform.h>
@@ -9,6 +10,7 @@
 			obs_source_get_name(ss->source), ##__VA_ARGS__)
 
 #define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
 
 #define S_TR_SPEED                     "transition_speed"
 #define S_SLIDE_TIME                   "slide_time"
@@ -34,11 +36,26 @@
 #define T_TR_SWIPE                     T_TR_("Swipe")
 #define T_TR_SLIDE                     T_TR_("Slide")
 
+/* number of upcoming slides picked ahead of time in random mode */
+#define RANDOM_PREFETCH                2
+
+/* how long a slide change may be held back waiting for the next slide to
+ * finish decoding, in seconds */
+#define MAX_LOAD_WAIT                  2.0f
+
 /* ------------------------------------------------------------------------- */
 
+/*
+ * Only the slides in a small window around the current one (the previous,
+ * current and next slides, or the upcoming random picks) have an image
+ * source.  Image sources decode asynchronously through the libobs image
+ * cache, so the next slide is created a full slide ahead of time and is
+ * normally ready by the time it is shown.
+ */
+
 struct image_file_data {
 	char *path;
-	obs_source_t *source;
+	obs_source_t *source; /* NULL unless the slide is in the window */
 };
 
 struct slideshow {
@@ -52,12 +69,28 @@ struct slideshow {
 
 	float elapsed;
 	size_t cur_item;
+	size_t prev_item;
+	DARRAY(size_t) upcoming;
+	DARRAY(size_t) window;
 
 	uint32_t cx;
 	uint32_t cy;
 
 	pthread_mutex_t mutex;
 	DARRAY(struct image_file_data) files;
+
+	/* stats */
+	uint64_t slide_changes;
+	uint64_t late_changes;
+	double total_latency;
+	float max_latency;
+	size_t peak_resident;
+	uint64_t peak_resident_bytes;
+
+	/* folders in the list are watched, and rescanned when they change */
+	DARRAY(obs_file_watch_t*) watches;
+	volatile bool folder_changed;
+	bool rescan;
 };
 
 static obs_source_t *get_transition(struct slideshow *ss)
@@ -123,6 +156,34 @@ static inline size_t random_file(struct slideshow *ss)
 	return (size_t)rand() % ss->files.num;
 }
 
+static size_t find_file(struct darray *array, const char *path)
+{
+	DARRAY(struct image_file_data) files;
+	files.da = *array;
+
+	for (size_t i = 0; i < files.num; i++) {
+		if (strcmp(files.array[i].path, path) == 0)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+static void folder_changed(void *data, const char *path)
+{
+	struct slideshow *ss = data;
+	os_atomic_set_bool(&ss->folder_changed, true);
+
+	UNUSED_PARAMETER(path);
+}
+
+static void free_watches(struct slideshow *ss)
+{
+	for (size_t i = 0; i < ss->watches.num; i++)
+		obs_file_watch_remove(ss->watches.array[i]);
+	da_resize(ss->watches, 0);
+}
+
 /* ------------------------------------------------------------------------- */
 
 static const char *ss_getname(void *unused)
@@ -132,36 +193,156 @@ static const char *ss_getname(void *unused)
 }
 
 static void add_file(struct slideshow *ss, struct darray *array,
-		const char *path, uint32_t *cx, uint32_t *cy)
+		const char *path)
 {
 	DARRAY(struct image_file_data) new_files;
 	struct image_file_data data;
-	obs_source_t *new_source;
 
 	new_files.da = *array;
 
+	/* slides that are already loaded stay loaded */
 	pthread_mutex_lock(&ss->mutex);
-	new_source = get_source(&ss->files.da, path);
+	data.source = get_source(&ss->files.da, path);
 	pthread_mutex_unlock(&ss->mutex);
 
-	if (!new_source)
-		new_source = get_source(&new_files.da, path);
-	if (!new_source)
-		new_source = create_source_from_file(path);
+	data.path = bstrdup(path);
+	da_push_back(new_files, &data);
 
-	if (new_source) {
-		uint32_t new_cx = obs_source_get_width(new_source);
-		uint32_t new_cy = obs_source_get_height(new_source);
+	*array = new_files.da;
+}
 
-		data.path = bstrdup(path);
-		data.source = new_source;
-		da_push_back(new_files, &data);
+/* ------------------------------------------------------------------------- */
 
-		if (new_cx > *cx) *cx = new_cx;
-		if (new_cy > *cy) *cy = new_cy;
+static size_t pick_random(struct slideshow *ss, size_t last)
+{
+	size_t next = last;
+
+	if (ss->files.num > 1) {
+		while (next == last)
+			next = random_file(ss);
 	}
 
-	*array = new_files.da;
+	return next;
+}
+
+static void fill_upcoming(struct slideshow *ss)
+{
+	while (ss->upcoming.num < RANDOM_PREFETCH) {
+		size_t last = ss->upcoming.num ?
+			*(size_t*)da_end(ss->upcoming) : ss->cur_item;
+		size_t next = pick_random(ss, last);
+
+		da_push_back(ss->upcoming, &next);
+	}
+}
+
+static size_t peek_next_item(struct slideshow *ss)
+{
+	if (ss->randomize) {
+		fill_upcoming(ss);
+		return ss->upcoming.array[0];
+	}
+
+	return (ss->cur_item + 1) % ss->files.num;
+}
+
+static size_t pop_next_item(struct slideshow *ss)
+{
+	size_t next = peek_next_item(ss);
+
+	if (ss->randomize)
+		da_erase(ss->upcoming, 0);
+	return next;
+}
+
+static inline void add_to_window(struct slideshow *ss, size_t idx)
+{
+	if (idx < ss->files.num &&
+	    da_find(ss->window, &idx, 0) == DARRAY_INVALID)
+		da_push_back(ss->window, &idx);
+}
+
+/* creates the sources of the slides in the window, and releases all others */
+static void update_window(struct slideshow *ss)
+{
+	da_resize(ss->window, 0);
+
+	if (!ss->files.num)
+		return;
+
+	add_to_window(ss, ss->cur_item);
+	add_to_window(ss, ss->prev_item);
+
+	if (ss->randomize) {
+		fill_upcoming(ss);
+		for (size_t i = 0; i < ss->upcoming.num; i++)
+			add_to_window(ss, ss->upcoming.array[i]);
+	} else {
+		add_to_window(ss, peek_next_item(ss));
+	}
+
+	for (size_t i = 0; i < ss->files.num; i++) {
+		struct image_file_data *file = ss->files.array + i;
+		bool resident = da_find(ss->window, &i, 0) != DARRAY_INVALID;
+		obs_source_t *source;
+
+		if (resident && !file->source) {
+			source = create_source_from_file(file->path);
+
+			pthread_mutex_lock(&ss->mutex);
+			file->source = source;
+			pthread_mutex_unlock(&ss->mutex);
+
+		} else if (!resident && file->source) {
+			pthread_mutex_lock(&ss->mutex);
+			source = file->source;
+			file->source = NULL;
+			pthread_mutex_unlock(&ss->mutex);
+
+			obs_source_release(source);
+		}
+	}
+
+	if (ss->window.num > ss->peak_resident)
+		ss->peak_resident = ss->window.num;
+}
+
+/* the slideshow is as large as the largest slide that has been loaded so far,
+ * as the size of a slide is only known once it has been decoded */
+static void update_size(struct slideshow *ss)
+{
+	uint64_t resident_bytes = 0;
+	uint32_t cx = ss->cx;
+	uint32_t cy = ss->cy;
+
+	for (size_t i = 0; i < ss->window.num; i++) {
+		obs_source_t *source = ss->files.array[ss->window.array[i]].source;
+		uint32_t source_cx, source_cy;
+
+		if (!source)
+			continue;
+
+		source_cx = obs_source_get_width(source);
+		source_cy = obs_source_get_height(source);
+		resident_bytes += (uint64_t)source_cx * source_cy * 4;
+		if (source_cx > cx) cx = source_cx;
+		if (source_cy > cy) cy = source_cy;
+	}
+
+	if (resident_bytes > ss->peak_resident_bytes)
+		ss->peak_resident_bytes = resident_bytes;
+
+	if (cx != ss->cx || cy != ss->cy) {
+		ss->cx = cx;
+		ss->cy = cy;
+		obs_transition_set_size(ss->transition, cx, cy);
+	}
+}
+
+static inline bool slide_ready(struct slideshow *ss, size_t idx)
+{
+	obs_source_t *source = ss->files.array[idx].source;
+	return source && obs_source_get_width(source) != 0;
 }
 
 static bool valid_extension(const char *ext)
@@ -187,14 +368,19 @@ static void ss_update(void *data, obs_data_t *settings)
 	const char *tr_name;
 	uint32_t new_duration;
 	uint32_t new_speed;
-	uint32_t cx = 0;
-	uint32_t cy = 0;
 	size_t count;
+	size_t cur_item = DARRAY_INVALID;
+	size_t prev_item = DARRAY_INVALID;
+	bool rescan = ss->rescan;
+
+	ss->rescan = false;
 
 	/* ------------------------------------- */
 	/* get settings data */
 
 	da_init(new_files);
+	free_watches(ss);
+	os_atomic_set_bool(&ss->folder_changed, false);
 
 	tr_name = obs_data_get_string(settings, S_TRANSITION);
 	if (astrcmpi(tr_name, TR_CUT) == 0)
@@ -228,6 +414,11 @@ static void ss_update(void *data, obs_data_t *settings)
 		if (dir) {
 			struct dstr dir_path = {0};
 			struct os_dirent *ent;
+			obs_file_watch_t *watch;
+
+			watch = obs_file_watch_add(path, folder_changed, ss);
+			if (watch)
+				da_push_back(ss->watches, &watch);
 
 			for (;;) {
 				const char *ext;
@@ -245,14 +436,13 @@ static void ss_update(void *data, obs_data_t *settings)
 				dstr_copy(&dir_path, path);
 				dstr_cat_ch(&dir_path, '/');
 				dstr_cat(&dir_path, ent->d_name);
-				add_file(ss, &new_files.da, dir_path.array,
-						&cx, &cy);
+				add_file(ss, &new_files.da, dir_path.array);
 			}
 
 			dstr_free(&dir_path);
 			os_closedir(dir);
 		} else {
-			add_file(ss, &new_files.da, path, &cx, &cy);
+			add_file(ss, &new_files.da, path);
 		}
 
 		obs_data_release(item);
@@ -263,6 +453,14 @@ static void ss_update(void *data, obs_data_t *settings)
 
 	pthread_mutex_lock(&ss->mutex);
 
+	/* keep showing the current slide if a folder was just rescanned */
+	if (rescan && ss->cur_item < ss->files.num)
+		cur_item = find_file(&new_files.da,
+				ss->files.array[ss->cur_item].path);
+	if (rescan && ss->prev_item < ss->files.num)
+		prev_item = find_file(&new_files.da,
+				ss->files.array[ss->prev_item].path);
+
 	old_files.da = ss->files.da;
 	ss->files.da = new_files.da;
 	if (new_tr) {
@@ -288,11 +486,24 @@ static void ss_update(void *data, obs_data_t *settings)
 		obs_source_release(old_tr);
 	free_files(&old_files.da);
 
-	ss->cx = cx;
-	ss->cy = cy;
+	da_resize(ss->upcoming, 0);
+	da_resize(ss->window, 0);
+	ss->prev_item = prev_item;
+
+	if (cur_item != DARRAY_INVALID && !new_tr) {
+		ss->cur_item = cur_item;
+		update_window(ss);
+		update_size(ss);
+		obs_data_array_release(array);
+		return;
+	}
+
 	ss->cur_item = 0;
+	ss->prev_item = DARRAY_INVALID;
 	ss->elapsed = 0.0f;
-	obs_transition_set_size(ss->transition, cx, cy);
+	ss->cx = 0;
+	ss->cy = 0;
+	obs_transition_set_size(ss->transition, 0, 0);
 	obs_transition_set_alignment(ss->transition, OBS_ALIGN_CENTER);
 	obs_transition_set_scale_type(ss->transition,
 			OBS_TRANSITION_SCALE_ASPECT);
@@ -301,6 +512,10 @@ static void ss_update(void *data, obs_data_t *settings)
 		ss->cur_item = random_file(ss);
 	if (new_tr)
 		obs_source_add_active_child(ss->source, new_tr);
+
+	update_window(ss);
+	update_size(ss);
+
 	if (ss->files.num)
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
 				ss->tr_speed,
@@ -309,10 +524,31 @@ static void ss_update(void *data, obs_data_t *settings)
 	obs_data_array_release(array);
 }
 
+static void log_stats(struct slideshow *ss)
+{
+	if (!ss->slide_changes)
+		return;
+
+	info("%"PRIu64" slide changes, %"PRIu64" delayed waiting for the "
+			"next slide to load (avg %.1f ms, max %.1f ms), "
+			"peak %d slides / %.1f MB resident",
+			ss->slide_changes, ss->late_changes,
+			ss->late_changes ? ss->total_latency * 1000.0 /
+				(double)ss->late_changes : 0.0,
+			ss->max_latency * 1000.0f,
+			(int)ss->peak_resident,
+			(double)ss->peak_resident_bytes / (1024.0 * 1024.0));
+}
+
 static void ss_destroy(void *data)
 {
 	struct slideshow *ss = data;
 
+	log_stats(ss);
+	free_watches(ss);
+	da_free(ss->watches);
+	da_free(ss->upcoming);
+	da_free(ss->window);
 	obs_source_release(ss->transition);
 	free_files(&ss->files.da);
 	pthread_mutex_destroy(&ss->mutex);
@@ -323,6 +559,7 @@ static void *ss_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct slideshow *ss = bzalloc(sizeof(*ss));
 	ss->source = source;
+	ss->prev_item = DARRAY_INVALID;
 
 	pthread_mutex_init_value(&ss->mutex);
 	if (pthread_mutex_init(&ss->mutex, NULL) != 0)
@@ -355,29 +592,45 @@ static void ss_video_tick(void *data, float seconds)
 {
 	struct slideshow *ss = data;
 
+	if (os_atomic_set_bool(&ss->folder_changed, false)) {
+		ss->rescan = true;
+		obs_source_update(ss->source, NULL);
+	}
+
 	if (!ss->transition || !ss->slide_time)
 		return;
 
-	ss->elapsed += seconds;
-	if (ss->elapsed > ss->slide_time) {
-		ss->elapsed -= ss->slide_time;
-
-		if (ss->randomize) {
-			size_t next = ss->cur_item;
-			if (ss->files.num > 1) {
-				while (next == ss->cur_item)
-					next = random_file(ss);
-			}
-			ss->cur_item = next;
+	update_size(ss);
 
-		} else if (++ss->cur_item >= ss->files.num) {
-			ss->cur_item = 0;
+	ss->elapsed += seconds;
+	if (ss->elapsed > ss->slide_time && ss->files.num) {
+		float late = ss->elapsed - ss->slide_time;
+
+		/* hold the current slide until the next one is decoded */
+		if (!slide_ready(ss, peek_next_item(ss)) &&
+		    late < MAX_LOAD_WAIT)
+			return;
+
+		if (late > seconds) {
+			ss->total_latency += late;
+			ss->late_changes++;
+			if (late > ss->max_latency)
+				ss->max_latency = late;
+			ss->elapsed = 0.0f;
+		} else {
+			ss->elapsed -= ss->slide_time;
 		}
 
-		if (ss->files.num)
-			obs_transition_start(ss->transition,
-					OBS_TRANSITION_MODE_AUTO, ss->tr_speed,
-					ss->files.array[ss->cur_item].source);
+		ss->slide_changes++;
+		ss->prev_item = ss->cur_item;
+		ss->cur_item = pop_next_item(ss);
+
+		obs_transition_start(ss->transition,
+				OBS_TRANSITION_MODE_AUTO, ss->tr_speed,
+				ss->files.array[ss->cur_item].source);
+
+		/* start loading the slide after this one */
+		update_window(ss);
 	}
 }
 
@@ -386,6 +639,7 @@ static inline bool ss_audio_render_(obs_source_t *transition, uint64_t *ts_out,
 		uint32_t mixers, size_t channels, size_t sample_rate)
 {
 	struct obs_source_audio_mix child_audio;
+	size_t frames = audio_output_get_frames_per_tick(obs_get_audio());
 	uint64_t source_ts;
 
 	if (obs_source_audio_pending(transition))
@@ -404,8 +658,7 @@ static inline bool ss_audio_render_(obs_source_t *transition, uint64_t *ts_out,
 			float *out = audio_output->output[mix].data[ch];
 			float *in = child_audio.output[mix].data[ch];
 
-			memcpy(out, in, AUDIO_OUTPUT_FRAMES *
-					MAX_AUDIO_CHANNELS * sizeof(float));
+			memcpy(out, in, frames * sizeof(float));
 		}
 	}
 
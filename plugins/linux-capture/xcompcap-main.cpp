@@ -583,3 +583,11 @@ uint32_t XCompcapMain::height()
 
 	return p->height - p->cur_cut_bot - p->cur_cut_top;
 }
+
+bool XCompcapMain::opaque()
+{
+	PLock lock(&p->lock, true);
+
+	/* render() draws the window without alpha */
+	return lock.isLocked() && p->win && p->tex;
+}
@@ -21,6 +21,7 @@ class XCompcapMain
 
 	uint32_t width();
 	uint32_t height();
+	bool opaque();
 
 	private:
 	XCompcapMain_private *p;
@@ -37,6 +37,12 @@ static uint32_t xcompcap_getheight(void* data)
 	return cc->height();
 }
 
+static bool xcompcap_is_opaque(void* data)
+{
+	XCompcapMain* cc = (XCompcapMain*)data;
+	return cc->opaque();
+}
+
 static obs_properties_t *xcompcap_props(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -83,6 +89,7 @@ extern "C" void xcomposite_load(void)
 	sinfo.video_render   = xcompcap_video_render;
 	sinfo.get_width      = xcompcap_getwidth;
 	sinfo.get_height     = xcompcap_getheight;
+	sinfo.is_opaque      = xcompcap_is_opaque;
 
 	obs_register_source(&sinfo);
 }
@@ -18,12 +18,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
+#include <xcb/damage.h>
 #include <xcb/xinerama.h>
 
 #include <obs-module.h>
 #include <util/dstr.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -31,6 +36,29 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* more damaged rectangles than this are merged into their bounding box */
+#define XSHM_MAX_RECTS 64
+
+struct xshm_rect {
+	int16_t          x;
+	int16_t          y;
+	uint16_t         width;
+	uint16_t         height;
+	size_t           offset;
+};
+
+/**
+ * A frame captured by the damage capture thread
+ *
+ * The shared memory segment holds the pixels of all damaged rectangles
+ * packed one after another, each rectangle at its own offset.
+ */
+struct xshm_frame {
+	xcb_shm_t        *shm;
+	DARRAY(struct xshm_rect) rects;
+	bool             ready;
+};
+
 struct xshm_data {
 	obs_source_t     *source;
 
@@ -51,6 +79,25 @@ struct xshm_data {
 	bool             show_cursor;
 	bool             use_xinerama;
 	bool             advanced;
+
+	/* damage capture */
+	bool             use_damage;
+	bool             damaged;
+	bool             full_refresh;
+	uint8_t          damage_event;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t damage_region;
+
+	pthread_t        capture_thread;
+	bool             capture_thread_active;
+	os_event_t       *stop_event;
+	pthread_mutex_t  frame_mutex;
+	struct xshm_frame frames[2];
+	int              write_frame;
+	int              read_frame;
+
+	uint64_t         damage_frames;
+	uint64_t         damage_pixels;
 };
 
 /**
@@ -86,6 +133,23 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	return ok;
 }
 
+/**
+ * Check if the xserver supports damage based capture
+ */
+static bool xshm_check_damage_extensions(xcb_connection_t *xcb)
+{
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present) {
+		blog(LOG_INFO, "Missing DAMAGE extension !");
+		return false;
+	}
+	if (!xcb_get_extension_data(xcb, &xcb_xfixes_id)->present) {
+		blog(LOG_INFO, "Missing XFIXES extension !");
+		return false;
+	}
+
+	return true;
+}
+
 /**
  * Update the capture
  *
@@ -138,11 +202,410 @@ static const char* xshm_getname(void *unused)
 	return obs_module_text("X11SharedMemoryScreenInput");
 }
 
+/**
+ * Clip a damaged rectangle (root window coordinates) to the captured area
+ *
+ * @return false if the rectangle is outside of the captured area
+ */
+static bool xshm_clip_rect(struct xshm_data *data,
+		const xcb_rectangle_t *in, struct xshm_rect *out)
+{
+	int_fast32_t x1 = in->x - data->x_org;
+	int_fast32_t y1 = in->y - data->y_org;
+	int_fast32_t x2 = x1 + in->width;
+	int_fast32_t y2 = y1 + in->height;
+
+	if (x1 < 0)            x1 = 0;
+	if (y1 < 0)            y1 = 0;
+	if (x2 > data->width)  x2 = data->width;
+	if (y2 > data->height) y2 = data->height;
+
+	if (x2 <= x1 || y2 <= y1)
+		return false;
+
+	out->x      = (int16_t)x1;
+	out->y      = (int16_t)y1;
+	out->width  = (uint16_t)(x2 - x1);
+	out->height = (uint16_t)(y2 - y1);
+	out->offset = 0;
+	return true;
+}
+
+/**
+ * Replace the rectangles of a frame with their bounding box
+ */
+static void xshm_merge_rects(struct xshm_frame *frame)
+{
+	struct xshm_rect box = frame->rects.array[0];
+	int_fast32_t x2 = box.x + box.width;
+	int_fast32_t y2 = box.y + box.height;
+
+	for (size_t i = 1; i < frame->rects.num; i++) {
+		struct xshm_rect *rect = frame->rects.array + i;
+
+		if (rect->x < box.x)                 box.x = rect->x;
+		if (rect->y < box.y)                 box.y = rect->y;
+		if (rect->x + rect->width > x2)      x2 = rect->x + rect->width;
+		if (rect->y + rect->height > y2)     y2 = rect->y + rect->height;
+	}
+
+	box.width  = (uint16_t)(x2 - box.x);
+	box.height = (uint16_t)(y2 - box.y);
+
+	da_resize(frame->rects, 1);
+	frame->rects.array[0] = box;
+}
+
+/**
+ * Collect the damaged rectangles of the captured area into a frame
+ *
+ * The damage accumulated by the server is moved into our region, so any
+ * damage occurring after this call will generate a new notify event.
+ */
+static void xshm_damage_collect(struct xshm_data *data,
+		struct xshm_frame *frame)
+{
+	xcb_xfixes_fetch_region_cookie_t reg_c;
+	xcb_xfixes_fetch_region_reply_t  *reg_r;
+	xcb_rectangle_t                  *rects;
+	int                              count;
+	size_t                           offset = 0;
+
+	da_resize(frame->rects, 0);
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+			data->damage_region);
+	reg_c = xcb_xfixes_fetch_region_unchecked(data->xcb,
+			data->damage_region);
+	reg_r = xcb_xfixes_fetch_region_reply(data->xcb, reg_c, NULL);
+
+	if (data->full_refresh) {
+		xcb_rectangle_t full = {
+			.x      = (int16_t)data->x_org,
+			.y      = (int16_t)data->y_org,
+			.width  = (uint16_t)data->width,
+			.height = (uint16_t)data->height
+		};
+		struct xshm_rect *rect = da_push_back_new(frame->rects);
+		xshm_clip_rect(data, &full, rect);
+		data->full_refresh = false;
+		goto exit;
+	}
+
+	if (!reg_r)
+		goto exit;
+
+	rects = xcb_xfixes_fetch_region_rectangles(reg_r);
+	count = xcb_xfixes_fetch_region_rectangles_length(reg_r);
+
+	for (int i = 0; i < count; i++) {
+		struct xshm_rect rect;
+		if (xshm_clip_rect(data, rects + i, &rect))
+			da_push_back(frame->rects, &rect);
+	}
+
+	if (frame->rects.num > XSHM_MAX_RECTS)
+		xshm_merge_rects(frame);
+
+exit:
+	for (size_t i = 0; i < frame->rects.num; i++) {
+		struct xshm_rect *rect = frame->rects.array + i;
+		rect->offset = offset;
+		offset += (size_t)rect->width * rect->height * 4;
+	}
+
+	free(reg_r);
+}
+
+/**
+ * Fetch the pixels of all damaged rectangles into the frame's segment
+ */
+static bool xshm_damage_fetch(struct xshm_data *data,
+		struct xshm_frame *frame)
+{
+	xcb_shm_get_image_cookie_t *img_c;
+	bool success = true;
+
+	img_c = bmalloc(sizeof(*img_c) * frame->rects.num);
+
+	for (size_t i = 0; i < frame->rects.num; i++) {
+		struct xshm_rect *rect = frame->rects.array + i;
+		img_c[i] = xcb_shm_get_image_unchecked(data->xcb,
+				data->xcb_screen->root,
+				data->x_org + rect->x, data->y_org + rect->y,
+				rect->width, rect->height, ~0,
+				XCB_IMAGE_FORMAT_Z_PIXMAP, frame->shm->seg,
+				(uint32_t)rect->offset);
+	}
+
+	for (size_t i = 0; i < frame->rects.num; i++) {
+		xcb_shm_get_image_reply_t *img_r;
+
+		img_r = xcb_shm_get_image_reply(data->xcb, img_c[i], NULL);
+		if (!img_r)
+			success = false;
+		free(img_r);
+	}
+
+	bfree(img_c);
+	return success;
+}
+
+/**
+ * Process pending events of the capture connection
+ */
+static void xshm_damage_poll_events(struct xshm_data *data)
+{
+	xcb_generic_event_t *event;
+
+	while ((event = xcb_poll_for_event(data->xcb)) != NULL) {
+		uint8_t type = event->response_type & ~0x80;
+
+		if (type == data->damage_event + XCB_DAMAGE_NOTIFY)
+			data->damaged = true;
+
+		free(event);
+	}
+}
+
+/**
+ * Capture the damaged area into the next free frame if there is one
+ */
+static void xshm_damage_capture(struct xshm_data *data)
+{
+	struct xshm_frame *frame = &data->frames[data->write_frame];
+	bool ready;
+
+	pthread_mutex_lock(&data->frame_mutex);
+	ready = frame->ready;
+	pthread_mutex_unlock(&data->frame_mutex);
+
+	/* the tick has not uploaded this frame yet, leave the damage in the
+	 * server so it gets picked up with the next capture */
+	if (ready)
+		return;
+
+	data->damaged = false;
+	xshm_damage_collect(data, frame);
+
+	if (!frame->rects.num)
+		return;
+
+	if (!xshm_damage_fetch(data, frame)) {
+		data->full_refresh = true;
+		data->damaged = true;
+		return;
+	}
+
+	for (size_t i = 0; i < frame->rects.num; i++) {
+		struct xshm_rect *rect = frame->rects.array + i;
+		data->damage_pixels += (uint64_t)rect->width * rect->height;
+	}
+	data->damage_frames++;
+
+	pthread_mutex_lock(&data->frame_mutex);
+	frame->ready = true;
+	pthread_mutex_unlock(&data->frame_mutex);
+
+	data->write_frame ^= 1;
+}
+
+/**
+ * Damage capture thread
+ *
+ * Runs at the video frame rate and captures only the parts of the screen
+ * that changed since the last capture, so a static desktop costs next to
+ * nothing and the video thread never waits on the X server for pixels.
+ */
+static void *xshm_damage_thread(void *vptr)
+{
+	XSHM_DATA(vptr);
+	uint64_t interval = video_output_get_frame_time(obs_get_video());
+	uint64_t next = os_gettime_ns();
+
+	os_set_thread_name("xshm-input: capture");
+
+	while (os_event_try(data->stop_event) == EAGAIN) {
+		xshm_damage_poll_events(data);
+
+		if (data->damaged && obs_source_showing(data->source))
+			xshm_damage_capture(data);
+
+		next += interval;
+		if (!os_sleepto_ns(next))
+			next = os_gettime_ns();
+	}
+
+	return NULL;
+}
+
+/**
+ * Upload all captured frames to the texture, oldest first
+ *
+ * @return false if the texture could not be updated
+ * @note requires to be called within the obs graphics context
+ */
+static bool xshm_damage_upload(struct xshm_data *data)
+{
+	for (;;) {
+		struct xshm_frame *frame = &data->frames[data->read_frame];
+		bool ready;
+
+		pthread_mutex_lock(&data->frame_mutex);
+		ready = frame->ready;
+		pthread_mutex_unlock(&data->frame_mutex);
+
+		if (!ready)
+			break;
+
+		for (size_t i = 0; i < frame->rects.num; i++) {
+			struct xshm_rect *rect = frame->rects.array + i;
+			if (!gs_texture_set_image_region(data->texture,
+					rect->x, rect->y,
+					rect->width, rect->height,
+					frame->shm->data + rect->offset,
+					rect->width * 4))
+				return false;
+		}
+
+		pthread_mutex_lock(&data->frame_mutex);
+		frame->ready = false;
+		pthread_mutex_unlock(&data->frame_mutex);
+
+		data->read_frame ^= 1;
+	}
+
+	return true;
+}
+
+/**
+ * Stop damage based capture
+ */
+static void xshm_damage_stop(struct xshm_data *data)
+{
+	if (data->capture_thread_active) {
+		os_event_signal(data->stop_event);
+		pthread_join(data->capture_thread, NULL);
+		data->capture_thread_active = false;
+	}
+
+	if (data->damage_frames) {
+		double area = (double)data->width * (double)data->height;
+		blog(LOG_INFO, "Damage capture: %"PRIu64" frames, "
+				"%.1f%% of the screen area per frame",
+				data->damage_frames,
+				100.0 * (double)data->damage_pixels /
+				(double)data->damage_frames / area);
+	}
+
+	if (data->xcb && data->damage) {
+		xcb_damage_destroy(data->xcb, data->damage);
+		xcb_xfixes_destroy_region(data->xcb, data->damage_region);
+		xcb_flush(data->xcb);
+	}
+
+	for (size_t i = 0; i < 2; i++) {
+		struct xshm_frame *frame = &data->frames[i];
+		if (frame->shm)
+			xshm_xcb_detach(frame->shm);
+		da_free(frame->rects);
+		memset(frame, 0, sizeof(*frame));
+	}
+
+	os_event_destroy(data->stop_event);
+	data->stop_event    = NULL;
+	data->damage        = 0;
+	data->damage_region = 0;
+	data->damage_frames = 0;
+	data->damage_pixels = 0;
+}
+
+/**
+ * Switch from damage based capture to capturing full frames
+ *
+ * Used when the texture can't be updated partially after all.
+ */
+static void xshm_damage_fallback(struct xshm_data *data)
+{
+	blog(LOG_WARNING, "Partial texture update failed, "
+			"capturing full frames");
+
+	xshm_damage_stop(data);
+	data->use_damage = false;
+
+	data->xshm = xshm_xcb_attach(data->xcb, data->width, data->height);
+	if (!data->xshm)
+		blog(LOG_ERROR, "failed to attach shm !");
+}
+
+/**
+ * Start damage based capture
+ *
+ * Needs the OpenGL device, check that with the graphics context entered
+ * before calling this.
+ *
+ * @return false if damage based capture is not possible
+ */
+static bool xshm_damage_start(struct xshm_data *data)
+{
+	xcb_damage_query_version_cookie_t dmg_c;
+
+	if (!xshm_check_damage_extensions(data->xcb))
+		return false;
+
+	dmg_c = xcb_damage_query_version_unchecked(data->xcb,
+			XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION);
+	free(xcb_damage_query_version_reply(data->xcb, dmg_c, NULL));
+
+	for (size_t i = 0; i < 2; i++) {
+		data->frames[i].shm = xshm_xcb_attach(data->xcb,
+				data->width, data->height);
+		if (!data->frames[i].shm) {
+			blog(LOG_ERROR, "failed to attach shm !");
+			goto fail;
+		}
+	}
+
+	data->damage_event = xcb_get_extension_data(data->xcb,
+			&xcb_damage_id)->first_event;
+	data->damage = xcb_generate_id(data->xcb);
+	data->damage_region = xcb_generate_id(data->xcb);
+
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+	xcb_xfixes_create_region(data->xcb, data->damage_region, 0, NULL);
+	xcb_flush(data->xcb);
+
+	data->write_frame  = 0;
+	data->read_frame   = 0;
+	data->damaged      = true;
+	data->full_refresh = true;
+
+	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&data->capture_thread, NULL, xshm_damage_thread,
+				data) != 0)
+		goto fail;
+
+	data->capture_thread_active = true;
+	blog(LOG_INFO, "Using damage based capture on screen %"PRIuFAST32
+			" (%"PRIdFAST32"x%"PRIdFAST32")", data->screen_id,
+			data->width, data->height);
+	return true;
+
+fail:
+	xshm_damage_stop(data);
+	return false;
+}
+
 /**
  * Stop the capture
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->use_damage)
+		xshm_damage_stop(data);
+
 	obs_enter_graphics();
 
 	if (data->texture) {
@@ -196,12 +659,6 @@ static void xshm_capture_start(struct xshm_data *data)
 		goto fail;
 	}
 
-	data->xshm = xshm_xcb_attach(data->xcb, data->width, data->height);
-	if (!data->xshm) {
-		blog(LOG_ERROR, "failed to attach shm !");
-		goto fail;
-	}
-
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->x_org, data->y_org);
 
@@ -209,8 +666,29 @@ static void xshm_capture_start(struct xshm_data *data)
 
 	xshm_resize_texture(data);
 
+	/* partial texture updates are only implemented for OpenGL */
+	if (data->use_damage && gs_get_device_type() != GS_DEVICE_OPENGL) {
+		blog(LOG_INFO, "Damage based capture needs OpenGL");
+		data->use_damage = false;
+	}
+
 	obs_leave_graphics();
 
+	if (data->use_damage && !xshm_damage_start(data)) {
+		blog(LOG_INFO, "Damage based capture unavailable, "
+				"capturing full frames");
+		data->use_damage = false;
+	}
+
+	if (!data->use_damage) {
+		data->xshm = xshm_xcb_attach(data->xcb,
+				data->width, data->height);
+		if (!data->xshm) {
+			blog(LOG_ERROR, "failed to attach shm !");
+			goto fail;
+		}
+	}
+
 	return;
 fail:
 	xshm_capture_stop(data);
@@ -228,6 +706,7 @@ static void xshm_update(void *vptr, obs_data_t *settings)
 	data->screen_id   = obs_data_get_int(settings, "screen");
 	data->show_cursor = obs_data_get_bool(settings, "show_cursor");
 	data->advanced    = obs_data_get_bool(settings, "advanced");
+	data->use_damage  = obs_data_get_bool(settings, "use_damage");
 	data->server      = bstrdup(obs_data_get_string(settings, "server"));
 
 	xshm_capture_start(data);
@@ -241,6 +720,7 @@ static void xshm_defaults(obs_data_t *defaults)
 	obs_data_set_default_int(defaults, "screen", 0);
 	obs_data_set_default_bool(defaults, "show_cursor", true);
 	obs_data_set_default_bool(defaults, "advanced", false);
+	obs_data_set_default_bool(defaults, "use_damage", false);
 }
 
 /**
@@ -339,6 +819,8 @@ static obs_properties_t *xshm_properties(void *vptr)
 			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
 	obs_properties_add_bool(props, "show_cursor",
 			obs_module_text("CaptureCursor"));
+	obs_properties_add_bool(props, "use_damage",
+			obs_module_text("UseDamage"));
 	obs_property_t *advanced = obs_properties_add_bool(props, "advanced",
 			obs_module_text("AdvancedSettings"));
 	obs_property_t *server = obs_properties_add_text(props, "server",
@@ -367,6 +849,7 @@ static void xshm_destroy(void *vptr)
 
 	xshm_capture_stop(data);
 
+	pthread_mutex_destroy(&data->frame_mutex);
 	bfree(data);
 }
 
@@ -378,6 +861,11 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
 	data->source = source;
 
+	if (pthread_mutex_init(&data->frame_mutex, NULL) != 0) {
+		bfree(data);
+		return NULL;
+	}
+
 	xshm_update(data, settings);
 
 	return data;
@@ -400,6 +888,30 @@ static void xshm_video_tick(void *vptr, float seconds)
 	xcb_shm_get_image_reply_t            *img_r;
 	xcb_xfixes_get_cursor_image_cookie_t cur_c;
 	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
+	bool                                 uploaded;
+
+	if (data->use_damage) {
+		cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+		cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c,
+				NULL);
+
+		obs_enter_graphics();
+
+		uploaded = xshm_damage_upload(data);
+		xcb_xcursor_update(data->cursor, cur_r);
+
+		obs_leave_graphics();
+
+		free(cur_r);
+		if (uploaded)
+			return;
+
+		/* the texture may be missing parts of the damage now, so
+		 * continue with a full frame right away */
+		xshm_damage_fallback(data);
+		if (!data->xshm)
+			return;
+	}
 
 	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
 			data->x_org, data->y_org, data->width, data->height,
@@ -471,6 +983,15 @@ static uint32_t xshm_getheight(void *vptr)
 	return data->height;
 }
 
+/**
+ * The capture is drawn without alpha, so it is opaque once there is a texture
+ */
+static bool xshm_is_opaque(void *vptr)
+{
+	XSHM_DATA(vptr);
+	return data->texture != NULL;
+}
+
 struct obs_source_info xshm_input = {
 	.id             = "xshm_input",
 	.type           = OBS_SOURCE_TYPE_INPUT,
@@ -486,5 +1007,6 @@ struct obs_source_info xshm_input = {
 	.video_tick     = xshm_video_tick,
 	.video_render   = xshm_video_render,
 	.get_width      = xshm_getwidth,
-	.get_height     = xshm_getheight
+	.get_height     = xshm_getheight,
+	.is_opaque      = xshm_is_opaque
 };
@@ -63,6 +63,38 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
+/* buffers are only handed to obs without copying if this many are mapped,
+ * so the device always has some left to fill */
+#define V4L2_MIN_BORROW_BUFFERS 4
+
+/* how long stopping the capture waits for obs to release borrowed buffers */
+#define V4L2_RECLAIM_TIMEOUT_MS 3000
+
+struct v4l2_borrow_pool;
+
+/**
+ * Buffer handed to obs with obs_source_output_video_borrowed
+ */
+struct v4l2_borrowed_buffer {
+	struct v4l2_borrow_pool *pool;
+	struct v4l2_buffer buf;
+};
+
+/**
+ * Buffers of one capture run that can be borrowed by obs
+ *
+ * Every borrowed buffer holds a reference, as does the capture thread.  If
+ * obs still holds buffers when the capture stops, the pool takes over the
+ * memory mapping and unmaps it once the last buffer is released.
+ */
+struct v4l2_borrow_pool {
+	volatile long refs;
+	volatile bool capturing;
+	int_fast32_t dev;
+	struct v4l2_buffer_data buffers;
+	struct v4l2_borrowed_buffer *borrowed;
+};
+
 /**
  * Data structure for the v4l2 source
  */
@@ -142,6 +174,87 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+/**
+ * Create the pool of buffers that can be borrowed by obs
+ */
+static struct v4l2_borrow_pool *v4l2_create_pool(struct v4l2_data *data)
+{
+	struct v4l2_borrow_pool *pool = bzalloc(sizeof(*pool));
+
+	pool->refs = 1;
+	pool->capturing = true;
+	pool->dev = data->dev;
+	pool->borrowed = bzalloc(data->buffers.count *
+			sizeof(struct v4l2_borrowed_buffer));
+	for (uint_fast32_t i = 0; i < data->buffers.count; ++i)
+		pool->borrowed[i].pool = pool;
+
+	return pool;
+}
+
+/**
+ * Drop a reference to the pool, unmapping the buffers it took over with
+ * the last one
+ */
+static void v4l2_release_pool(struct v4l2_borrow_pool *pool)
+{
+	if (os_atomic_dec_long(&pool->refs) == 0) {
+		v4l2_destroy_mmap(&pool->buffers);
+		bfree(pool->borrowed);
+		bfree(pool);
+	}
+}
+
+/**
+ * Requeue a buffer once obs is done with it
+ */
+static void v4l2_release_buffer(void *param)
+{
+	struct v4l2_borrowed_buffer *borrowed = param;
+	struct v4l2_borrow_pool *pool = borrowed->pool;
+
+	if (os_atomic_load_bool(&pool->capturing) &&
+	    v4l2_ioctl(pool->dev, VIDIOC_QBUF, &borrowed->buf) < 0)
+		blog(LOG_DEBUG, "failed to enqueue buffer");
+
+	v4l2_release_pool(pool);
+}
+
+/**
+ * Take back all buffers obs still holds
+ *
+ * This has to happen before the buffers are unmapped.  Frames that are not
+ * in use are released by the flush, a frame that is being uploaded comes
+ * back when the upload is done.  If obs holds on to buffers for longer than
+ * the timeout, the pool takes over the memory mapping and keeps it until the
+ * last of them is released, rather than blocking the capture thread.
+ */
+static void v4l2_reclaim_buffers(struct v4l2_data *data,
+		struct v4l2_borrow_pool *pool)
+{
+	uint64_t timeout = os_gettime_ns() +
+		V4L2_RECLAIM_TIMEOUT_MS * 1000000ULL;
+
+	os_atomic_set_bool(&pool->capturing, false);
+	obs_source_flush_borrowed_video(data->source);
+
+	while (os_atomic_load_long(&pool->refs) > 1 &&
+	       os_gettime_ns() < timeout)
+		os_sleep_ms(1);
+
+	if (os_atomic_load_long(&pool->refs) > 1) {
+		blog(LOG_WARNING, "obs still holds %ld buffers, keeping them "
+				"mapped until they are released",
+				os_atomic_load_long(&pool->refs) - 1);
+
+		pool->buffers = data->buffers;
+		data->buffers.count = 0;
+		data->buffers.info = NULL;
+	}
+
+	v4l2_release_pool(pool);
+}
+
 /*
  * Worker thread to get video data
  */
@@ -158,6 +271,8 @@ static void *v4l2_thread(void *vptr)
 	struct obs_source_frame out;
 	size_t plane_offsets[MAX_AV_PLANES];
 
+	struct v4l2_borrow_pool *pool = NULL;
+
 	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
 		goto exit;
 
@@ -165,6 +280,9 @@ static void *v4l2_thread(void *vptr)
 	first_ts = 0;
 	v4l2_prep_obs_frame(data, &out, plane_offsets);
 
+	if (data->buffers.count >= V4L2_MIN_BORROW_BUFFERS)
+		pool = v4l2_create_pool(data);
+
 	while (os_event_try(data->event) == EAGAIN) {
 		FD_ZERO(&fds);
 		FD_SET(data->dev, &fds);
@@ -200,18 +318,33 @@ static void *v4l2_thread(void *vptr)
 		start = (uint8_t *) data->buffers.info[buf.index].start;
 		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 			out.data[i] = start + plane_offsets[i];
+
+		frames++;
+
+		if (pool) {
+			struct v4l2_borrowed_buffer *borrowed =
+				&pool->borrowed[buf.index];
+			borrowed->buf = buf;
+
+			os_atomic_inc_long(&pool->refs);
+			obs_source_output_video_borrowed(data->source, &out,
+					v4l2_release_buffer, borrowed);
+			continue;
+		}
+
 		obs_source_output_video(data->source, &out);
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
 			break;
 		}
-
-		frames++;
 	}
 
 	blog(LOG_INFO, "Stopped capture after %"PRIu64" frames", frames);
 
+	if (pool)
+		v4l2_reclaim_buffers(data, pool);
+
 exit:
 	v4l2_stop_capture(data->dev);
 	return NULL;
@@ -80,6 +80,11 @@ struct ffmpeg_data {
 
 	struct ffmpeg_cfg  config;
 
+	/* encoded mode, streams are created from existing obs encoders */
+	bool               encoded;
+	AVStream           *audio_streams[MAX_AUDIO_MIXES];
+	size_t             num_audio_streams;
+
 	bool               initialized;
 };
 
@@ -87,6 +92,8 @@ struct ffmpeg_output {
 	obs_output_t       *output;
 	volatile bool      active;
 	struct ffmpeg_data ff_data;
+	bool               encoded;
+	uint64_t           total_bytes;
 
 	bool               connecting;
 	pthread_t          start_thread;
@@ -366,6 +373,138 @@ static inline bool init_streams(struct ffmpeg_data *data)
 	return true;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Encoded mode */
+
+static bool new_encoded_stream(struct ffmpeg_data *data, AVStream **stream,
+		obs_encoder_t *encoder)
+{
+	const AVCodecDescriptor *desc;
+	AVCodecContext *context;
+	struct dstr codec = {0};
+	obs_data_t *settings;
+	uint8_t *header;
+	size_t size;
+
+	/* obs codec names aren't necessarily lower case (e.g. "AAC") */
+	dstr_copy(&codec, obs_encoder_get_codec(encoder));
+	dstr_to_lower(&codec);
+	desc = avcodec_descriptor_get_by_name(codec.array);
+
+	if (!desc) {
+		blog(LOG_WARNING, "Couldn't find codec '%s' of encoder '%s'",
+				codec.array, obs_encoder_get_name(encoder));
+		dstr_free(&codec);
+		return false;
+	}
+
+	dstr_free(&codec);
+
+	*stream = avformat_new_stream(data->output, NULL);
+	if (!*stream) {
+		blog(LOG_WARNING, "Couldn't create stream for encoder '%s'",
+				obs_encoder_get_name(encoder));
+		return false;
+	}
+
+	(*stream)->id = data->output->nb_streams-1;
+
+	settings = obs_encoder_get_settings(encoder);
+
+	context             = (*stream)->codec;
+	context->codec_type = desc->type;
+	context->codec_id   = desc->id;
+	context->bit_rate   = (int)obs_data_get_int(settings, "bitrate") * 1000;
+
+	obs_data_release(settings);
+
+	if (obs_encoder_get_extra_data(encoder, &header, &size) && size) {
+		context->extradata      = av_memdup(header, size);
+		context->extradata_size = (int)size;
+	}
+
+	if (data->output->oformat->flags & AVFMT_GLOBALHEADER)
+		context->flags |= CODEC_FLAG_GLOBAL_HEADER;
+
+	return true;
+}
+
+static bool create_encoded_video_stream(struct ffmpeg_data *data,
+		obs_encoder_t *encoder)
+{
+	video_t *video = obs_encoder_video(encoder);
+	const struct video_output_info *voi = video_output_get_info(video);
+	AVCodecContext *context;
+
+	if (!new_encoded_stream(data, &data->video, encoder))
+		return false;
+
+	context               = data->video->codec;
+	context->width        = (int)obs_encoder_get_width(encoder);
+	context->height       = (int)obs_encoder_get_height(encoder);
+	context->coded_width  = context->width;
+	context->coded_height = context->height;
+	context->time_base    = (AVRational){ voi->fps_den, voi->fps_num };
+
+	data->video->time_base = context->time_base;
+	return true;
+}
+
+static bool create_encoded_audio_stream(struct ffmpeg_data *data,
+		obs_encoder_t *encoder)
+{
+	audio_t *audio = obs_encoder_audio(encoder);
+	AVCodecContext *context;
+	AVStream *stream;
+
+	if (!new_encoded_stream(data, &stream, encoder))
+		return false;
+
+	av_dict_set(&stream->metadata, "title",
+			obs_encoder_get_name(encoder), 0);
+
+	context              = stream->codec;
+	context->sample_rate = (int)obs_encoder_get_sample_rate(encoder);
+	context->channels    = (int)audio_output_get_channels(audio);
+	context->sample_fmt  = AV_SAMPLE_FMT_S16;
+	context->time_base   = (AVRational){ 1, context->sample_rate };
+	context->channel_layout =
+			av_get_default_channel_layout(context->channels);
+
+	stream->time_base = context->time_base;
+
+	data->audio_streams[data->num_audio_streams++] = stream;
+	return true;
+}
+
+static bool init_encoded_streams(struct ffmpeg_data *data,
+		obs_output_t *output)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(output);
+
+	if (vencoder && !create_encoded_video_stream(data, vencoder))
+		return false;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		obs_encoder_t *aencoder = obs_output_get_audio_encoder(output,
+				i);
+		if (!aencoder)
+			break;
+
+		if (!create_encoded_audio_stream(data, aencoder))
+			return false;
+	}
+
+	if (!data->video && !data->num_audio_streams) {
+		blog(LOG_WARNING, "No encoders set for encoded FFmpeg output");
+		return false;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline bool open_output_file(struct ffmpeg_data *data)
 {
 	AVOutputFormat *format = data->output->oformat;
@@ -448,7 +587,8 @@ static void ffmpeg_data_free(struct ffmpeg_data *data)
 	if (data->initialized)
 		av_write_trailer(data->output);
 
-	if (data->video)
+	/* encoded streams have no codecs of their own to close */
+	if (data->video && !data->encoded)
 		close_video(data);
 	if (data->audio)
 		close_audio(data);
@@ -500,7 +640,7 @@ static void set_encoder_ids(struct ffmpeg_data *data)
 }
 
 static bool ffmpeg_data_init(struct ffmpeg_data *data,
-		struct ffmpeg_cfg *config)
+		struct ffmpeg_cfg *config, obs_output_t *encoded)
 {
 	bool is_rtmp = false;
 
@@ -534,21 +674,28 @@ static bool ffmpeg_data_init(struct ffmpeg_data *data,
 	avformat_alloc_output_context2(&data->output, output_format,
 			NULL, NULL);
 
-	if (is_rtmp) {
-		data->output->oformat->video_codec = AV_CODEC_ID_H264;
-		data->output->oformat->audio_codec = AV_CODEC_ID_AAC;
-	} else {
-		if (data->config.format_name)
-			set_encoder_ids(data);
-	}
-
 	if (!data->output) {
 		blog(LOG_WARNING, "Couldn't create avformat context");
 		goto fail;
 	}
 
-	if (!init_streams(data))
-		goto fail;
+	if (encoded) {
+		data->encoded = true;
+
+		if (!init_encoded_streams(data, encoded))
+			goto fail;
+	} else {
+		if (is_rtmp) {
+			data->output->oformat->video_codec = AV_CODEC_ID_H264;
+			data->output->oformat->audio_codec = AV_CODEC_ID_AAC;
+		} else {
+			if (data->config.format_name)
+				set_encoder_ids(data);
+		}
+
+		if (!init_streams(data))
+			goto fail;
+	}
 	if (!open_output_file(data))
 		goto fail;
 
@@ -576,6 +723,12 @@ static const char *ffmpeg_output_getname(void *unused)
 	return obs_module_text("FFmpegOutput");
 }
 
+static const char *ffmpeg_encoded_output_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("FFmpegEncodedOutput");
+}
+
 static void ffmpeg_log_callback(void *param, int level, const char *format,
 		va_list args)
 {
@@ -610,6 +763,15 @@ fail:
 	return NULL;
 }
 
+static void *ffmpeg_encoded_output_create(obs_data_t *settings,
+		obs_output_t *output)
+{
+	struct ffmpeg_output *data = ffmpeg_output_create(settings, output);
+	if (data)
+		data->encoded = true;
+	return data;
+}
+
 static void ffmpeg_output_full_stop(void *data);
 static void ffmpeg_deactivate(struct ffmpeg_output *output);
 
@@ -843,6 +1005,60 @@ static void receive_audio(void *param, struct audio_data *frame)
 	}
 }
 
+static inline AVStream *get_encoded_stream(struct ffmpeg_data *data,
+		struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO)
+		return data->video;
+
+	return packet->track_idx < data->num_audio_streams ?
+		data->audio_streams[packet->track_idx] : NULL;
+}
+
+static void receive_encoded(void *param, struct encoder_packet *packet)
+{
+	struct ffmpeg_output *output = param;
+	struct ffmpeg_data   *data   = &output->ff_data;
+	AVRational time_base;
+	AVPacket av_packet;
+	AVStream *stream;
+
+	if (!output->active)
+		return;
+
+	if (stopping(output)) {
+		if ((uint64_t)packet->sys_dts_usec * 1000 >= output->stop_ts) {
+			ffmpeg_output_full_stop(output);
+			return;
+		}
+	}
+
+	stream = get_encoded_stream(data, packet);
+	if (!stream)
+		return;
+
+	/* packet data is only valid for the duration of the callback */
+	if (av_new_packet(&av_packet, (int)packet->size) < 0) {
+		blog(LOG_WARNING, "receive_encoded: Failed to allocate packet");
+		return;
+	}
+
+	memcpy(av_packet.data, packet->data, packet->size);
+
+	time_base = (AVRational){ packet->timebase_num, packet->timebase_den };
+	av_packet.pts = av_rescale_q(packet->pts, time_base, stream->time_base);
+	av_packet.dts = av_rescale_q(packet->dts, time_base, stream->time_base);
+	av_packet.stream_index = stream->index;
+
+	if (packet->keyframe)
+		av_packet.flags |= AV_PKT_FLAG_KEY;
+
+	pthread_mutex_lock(&output->write_mutex);
+	da_push_back(output->packets, &av_packet);
+	pthread_mutex_unlock(&output->write_mutex);
+	os_sem_post(output->write_sem);
+}
+
 static uint64_t get_packet_sys_dts(struct ffmpeg_output *output,
 		AVPacket *packet)
 {
@@ -867,6 +1083,7 @@ static int process_packet(struct ffmpeg_output *output)
 {
 	AVPacket packet;
 	bool new_packet = false;
+	int size;
 	int ret;
 
 	pthread_mutex_lock(&output->write_mutex);
@@ -885,7 +1102,8 @@ static int process_packet(struct ffmpeg_output *output)
 			packet.size, packet.flags,
 			packet.stream_index, output->packets.num);*/
 
-	if (stopping(output)) {
+	/* encoded packets are checked against the stop time on arrival */
+	if (stopping(output) && !output->ff_data.encoded) {
 		uint64_t sys_ts = get_packet_sys_dts(output, &packet);
 		if (sys_ts >= output->stop_ts) {
 			ffmpeg_output_full_stop(output);
@@ -893,6 +1111,8 @@ static int process_packet(struct ffmpeg_output *output)
 		}
 	}
 
+	size = packet.size;
+
 	ret = av_interleaved_write_frame(output->ff_data.output, &packet);
 	if (ret < 0) {
 		av_free_packet(&packet);
@@ -901,6 +1121,7 @@ static int process_packet(struct ffmpeg_output *output)
 		return ret;
 	}
 
+	output->total_bytes += (uint64_t)size;
 	return 0;
 }
 
@@ -998,7 +1219,7 @@ static bool try_connect(struct ffmpeg_output *output)
 	if (!config.scale_height)
 		config.scale_height = config.height;
 
-	success = ffmpeg_data_init(&output->ff_data, &config);
+	success = ffmpeg_data_init(&output->ff_data, &config, NULL);
 	obs_data_release(settings);
 
 	if (!success)
@@ -1028,11 +1249,54 @@ static bool try_connect(struct ffmpeg_output *output)
 	return true;
 }
 
+static bool try_connect_encoded(struct ffmpeg_output *output)
+{
+	struct ffmpeg_cfg config = {0};
+	obs_data_t *settings;
+	bool success;
+	int ret;
+
+	if (!obs_output_can_begin_data_capture(output->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(output->output, 0))
+		return false;
+
+	settings = obs_output_get_settings(output->output);
+
+	config.url = obs_data_get_string(settings, "url");
+	config.format_name = get_string_or_null(settings, "format_name");
+	config.format_mime_type = get_string_or_null(settings,
+			"format_mime_type");
+	config.muxer_settings = obs_data_get_string(settings, "muxer_settings");
+
+	success = ffmpeg_data_init(&output->ff_data, &config, output->output);
+	obs_data_release(settings);
+
+	if (!success)
+		return false;
+
+	output->active = true;
+
+	ret = pthread_create(&output->write_thread, NULL, write_thread, output);
+	if (ret != 0) {
+		blog(LOG_WARNING, "ffmpeg_output_start: failed to create write "
+		                  "thread.");
+		ffmpeg_output_full_stop(output);
+		return false;
+	}
+
+	output->write_thread_active = true;
+	obs_output_begin_data_capture(output->output, 0);
+	return true;
+}
+
 static void *start_thread(void *data)
 {
 	struct ffmpeg_output *output = data;
+	bool success = output->encoded ?
+		try_connect_encoded(output) : try_connect(output);
 
-	if (!try_connect(output))
+	if (!success)
 		obs_output_signal_stop(output->output,
 				OBS_OUTPUT_CONNECT_FAILED);
 
@@ -1051,6 +1315,7 @@ static bool ffmpeg_output_start(void *data)
 	os_atomic_set_bool(&output->stopping, false);
 	output->audio_start_ts = 0;
 	output->video_start_ts = 0;
+	output->total_bytes = 0;
 
 	ret = pthread_create(&output->start_thread, NULL, start_thread, output);
 	return (output->connecting = (ret == 0));
@@ -1100,14 +1365,37 @@ static void ffmpeg_deactivate(struct ffmpeg_output *output)
 	ffmpeg_data_free(&output->ff_data);
 }
 
+static uint64_t ffmpeg_output_total_bytes(void *data)
+{
+	struct ffmpeg_output *output = data;
+	return output->total_bytes;
+}
+
 struct obs_output_info ffmpeg_output = {
-	.id        = "ffmpeg_output",
-	.flags     = OBS_OUTPUT_AUDIO | OBS_OUTPUT_VIDEO,
-	.get_name  = ffmpeg_output_getname,
-	.create    = ffmpeg_output_create,
-	.destroy   = ffmpeg_output_destroy,
-	.start     = ffmpeg_output_start,
-	.stop      = ffmpeg_output_stop,
-	.raw_video = receive_video,
-	.raw_audio = receive_audio,
+	.id              = "ffmpeg_output",
+	.flags           = OBS_OUTPUT_AUDIO | OBS_OUTPUT_VIDEO,
+	.get_name        = ffmpeg_output_getname,
+	.create          = ffmpeg_output_create,
+	.destroy         = ffmpeg_output_destroy,
+	.start           = ffmpeg_output_start,
+	.stop            = ffmpeg_output_stop,
+	.raw_video       = receive_video,
+	.raw_audio       = receive_audio,
+	.get_total_bytes = ffmpeg_output_total_bytes,
+};
+
+/* Muxes packets from existing obs encoders, so that several containers or
+ * destinations can share a single encode */
+struct obs_output_info ffmpeg_encoded_output = {
+	.id              = "ffmpeg_encoded_output",
+	.flags           = OBS_OUTPUT_AV |
+	                   OBS_OUTPUT_ENCODED |
+	                   OBS_OUTPUT_MULTI_TRACK,
+	.get_name        = ffmpeg_encoded_output_getname,
+	.create          = ffmpeg_encoded_output_create,
+	.destroy         = ffmpeg_output_destroy,
+	.start           = ffmpeg_output_start,
+	.stop            = ffmpeg_output_stop,
+	.encoded_packet  = receive_encoded,
+	.get_total_bytes = ffmpeg_output_total_bytes,
 };
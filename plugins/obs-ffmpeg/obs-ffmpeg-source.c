@@ -213,20 +213,42 @@ static bool video_frame_hwaccel(struct ff_frame *frame,
 	return true;
 }
 
+static void release_av_frame(void *param)
+{
+	AVFrame *frame = param;
+	av_frame_free(&frame);
+}
+
 static bool video_frame_direct(struct ff_frame *frame,
 		struct ffmpeg_source *s, struct obs_source_frame *obs_frame)
 {
+	AVFrame *ref;
 	int i;
 
-	for (i = 0; i < MAX_AV_PLANES; i++) {
-		obs_frame->data[i] = frame->frame->data[i];
-		obs_frame->linesize[i] = frame->frame->linesize[i];
-	}
-
 	if (!set_obs_frame_colorprops(frame, s, obs_frame))
 		return false;
 
-	obs_source_output_video(s->source, obs_frame);
+	/* the decoder reuses its frame after this callback, so hand obs a
+	 * new reference to the (refcounted) buffers instead of a copy */
+	ref = frame->frame->buf[0] ? av_frame_clone(frame->frame) : NULL;
+
+	if (!ref) {
+		for (i = 0; i < MAX_AV_PLANES; i++) {
+			obs_frame->data[i] = frame->frame->data[i];
+			obs_frame->linesize[i] = frame->frame->linesize[i];
+		}
+
+		obs_source_output_video(s->source, obs_frame);
+		return true;
+	}
+
+	for (i = 0; i < MAX_AV_PLANES; i++) {
+		obs_frame->data[i] = ref->data[i];
+		obs_frame->linesize[i] = ref->linesize[i];
+	}
+
+	obs_source_output_video_borrowed(s->source, obs_frame,
+			release_av_frame, ref);
 	return true;
 }
 
@@ -10,6 +10,7 @@ OBS_MODULE_USE_DEFAULT_LOCALE("obs-ffmpeg", "en-US")
 
 extern struct obs_source_info  ffmpeg_source;
 extern struct obs_output_info  ffmpeg_output;
+extern struct obs_output_info  ffmpeg_encoded_output;
 extern struct obs_output_info  ffmpeg_muxer;
 extern struct obs_output_info  replay_buffer;
 extern struct obs_encoder_info aac_encoder_info;
@@ -145,6 +146,7 @@ bool obs_module_load(void)
 
 	obs_register_source(&ffmpeg_source);
 	obs_register_output(&ffmpeg_output);
+	obs_register_output(&ffmpeg_encoded_output);
 	obs_register_output(&ffmpeg_muxer);
 	obs_register_output(&replay_buffer);
 	obs_register_encoder(&aac_encoder_info);
@@ -340,6 +340,39 @@ static void color_correction_filter_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+/*
+ * The same operations as the .effect file, as a per-pixel function so that
+ * the filter can share a single pass with its neighbouring filters.
+ */
+static const char *color_correction_pixel_function =
+"uniform float3 $gamma;\n"
+"uniform float4x4 $color_matrix;\n"
+"\n"
+"float4 $process(float4 rgba, float2 uv)\n"
+"{\n"
+"\trgba.rgb = pow(rgba.rgb, $gamma);\n"
+"\treturn mul($color_matrix, rgba);\n"
+"}\n";
+
+static const char *color_correction_filter_pixel_function(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return color_correction_pixel_function;
+}
+
+static void color_correction_filter_set_pixel_params(void *data,
+		gs_effect_t *effect, const char *prefix)
+{
+	struct color_correction_filter_data *filter = data;
+	gs_eparam_t *param;
+
+	param = obs_filter_get_fused_param(effect, prefix, SETTING_GAMMA);
+	gs_effect_set_vec3(param, &filter->gamma);
+
+	param = obs_filter_get_fused_param(effect, prefix, "color_matrix");
+	gs_effect_set_matrix4(param, &filter->final_matrix);
+}
+
 /*
  * This function sets the interface. the types (add_*_Slider), the type of
  * data collected (int), the internal name, user-facing name, minimum,
@@ -402,11 +435,13 @@ static void color_correction_filter_defaults(obs_data_t *settings)
 struct obs_source_info color_filter = {
 	.id = "color_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CACHEABLE,
 	.get_name = color_correction_filter_name,
 	.create = color_correction_filter_create,
 	.destroy = color_correction_filter_destroy,
 	.video_render = color_correction_filter_render,
+	.get_pixel_function = color_correction_filter_pixel_function,
+	.set_pixel_params = color_correction_filter_set_pixel_params,
 	.update = color_correction_filter_update,
 	.get_properties = color_correction_filter_properties,
 	.get_defaults = color_correction_filter_defaults
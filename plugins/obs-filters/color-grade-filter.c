@@ -145,15 +145,74 @@ static void color_grade_filter_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+/* the same as LUT in color_grade_filter.effect */
+static const char *color_grade_pixel_function =
+"uniform texture2d $clut;\n"
+"uniform float $clut_amount;\n"
+"\n"
+"sampler_state $clut_sampler {\n"
+"\tFilter    = Linear;\n"
+"\tAddressU  = Clamp;\n"
+"\tAddressV  = Clamp;\n"
+"};\n"
+"\n"
+"float4 $process(float4 rgba, float2 uv)\n"
+"{\n"
+"\tfloat blueColor = rgba.b * 63.0;\n"
+"\n"
+"\tfloat2 quad1;\n"
+"\tquad1.y = floor(floor(blueColor) / 8.0);\n"
+"\tquad1.x = floor(blueColor) - (quad1.y * 8.0);\n"
+"\n"
+"\tfloat2 quad2;\n"
+"\tquad2.y = floor(ceil(blueColor) / 8.0);\n"
+"\tquad2.x = ceil(blueColor) - (quad2.y * 8.0);\n"
+"\n"
+"\tfloat2 texPos1;\n"
+"\ttexPos1.x = (quad1.x * 0.125) + 0.5/512.0 + ((0.125 - 1.0/512.0) * rgba.r);\n"
+"\ttexPos1.y = (quad1.y * 0.125) + 0.5/512.0 + ((0.125 - 1.0/512.0) * rgba.g);\n"
+"\n"
+"\tfloat2 texPos2;\n"
+"\ttexPos2.x = (quad2.x * 0.125) + 0.5/512.0 + ((0.125 - 1.0/512.0) * rgba.r);\n"
+"\ttexPos2.y = (quad2.y * 0.125) + 0.5/512.0 + ((0.125 - 1.0/512.0) * rgba.g);\n"
+"\n"
+"\tfloat4 newColor1 = $clut.Sample($clut_sampler, texPos1);\n"
+"\tfloat4 newColor2 = $clut.Sample($clut_sampler, texPos2);\n"
+"\tfloat4 luttedColor = lerp(newColor1, newColor2, frac(blueColor));\n"
+"\n"
+"\treturn lerp(rgba, luttedColor, $clut_amount);\n"
+"}\n";
+
+static const char *color_grade_filter_pixel_function(void *data)
+{
+	struct lut_filter_data *filter = data;
+	return filter->target ? color_grade_pixel_function : NULL;
+}
+
+static void color_grade_filter_set_pixel_params(void *data,
+		gs_effect_t *effect, const char *prefix)
+{
+	struct lut_filter_data *filter = data;
+	gs_eparam_t *param;
+
+	param = obs_filter_get_fused_param(effect, prefix, "clut");
+	gs_effect_set_texture(param, filter->target);
+
+	param = obs_filter_get_fused_param(effect, prefix, "clut_amount");
+	gs_effect_set_float(param, filter->clut_amount);
+}
+
 struct obs_source_info color_grade_filter = {
 	.id                            = "clut_filter",
 	.type                          = OBS_SOURCE_TYPE_FILTER,
-	.output_flags                  = OBS_SOURCE_VIDEO,
+	.output_flags                  = OBS_SOURCE_VIDEO | OBS_SOURCE_CACHEABLE,
 	.get_name                      = color_grade_filter_get_name,
 	.create                        = color_grade_filter_create,
 	.destroy                       = color_grade_filter_destroy,
 	.update                        = color_grade_filter_update,
 	.get_defaults                  = color_grade_filter_defaults,
 	.get_properties                = color_grade_filter_properties,
-	.video_render                  = color_grade_filter_render
+	.video_render                  = color_grade_filter_render,
+	.get_pixel_function            = color_grade_filter_pixel_function,
+	.set_pixel_params              = color_grade_filter_set_pixel_params
 };
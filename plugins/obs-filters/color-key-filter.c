@@ -183,6 +183,54 @@ static void color_key_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+/* the same as PSColorKeyRGBA in color_key_filter.effect */
+static const char *color_key_pixel_function =
+"uniform float4 $color;\n"
+"uniform float $contrast;\n"
+"uniform float $brightness;\n"
+"uniform float $gamma;\n"
+"uniform float4 $key_color;\n"
+"uniform float $similarity;\n"
+"uniform float $smoothness;\n"
+"\n"
+"float4 $process(float4 rgba, float2 uv)\n"
+"{\n"
+"\trgba *= $color;\n"
+"\n"
+"\tfloat colorDist = distance($key_color.rgb, rgba.rgb);\n"
+"\trgba.a *= saturate(max(colorDist - $similarity, 0.0) /\n"
+"\t\t\t$smoothness);\n"
+"\n"
+"\treturn float4(pow(rgba.rgb, float3($gamma, $gamma, $gamma)) *\n"
+"\t\t\t$contrast + $brightness, rgba.a);\n"
+"}\n";
+
+static const char *color_key_pixel_function_get(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return color_key_pixel_function;
+}
+
+static void color_key_set_pixel_params(void *data, gs_effect_t *effect,
+		const char *prefix)
+{
+	struct color_key_filter_data *filter = data;
+
+#define set_param(type, name, val) \
+	gs_effect_set_ ## type(obs_filter_get_fused_param(effect, prefix, \
+				name), val)
+
+	set_param(vec4,  "color",      &filter->color);
+	set_param(float, "contrast",   filter->contrast);
+	set_param(float, "brightness", filter->brightness);
+	set_param(float, "gamma",      filter->gamma);
+	set_param(vec4,  "key_color",  &filter->key_color);
+	set_param(float, "similarity", filter->similarity);
+	set_param(float, "smoothness", filter->smoothness);
+
+#undef set_param
+}
+
 static bool key_type_changed(obs_properties_t *props, obs_property_t *p,
 		obs_data_t *settings)
 {
@@ -245,11 +293,13 @@ static void color_key_defaults(obs_data_t *settings)
 struct obs_source_info color_key_filter = {
 	.id                            = "color_key_filter",
 	.type                          = OBS_SOURCE_TYPE_FILTER,
-	.output_flags                  = OBS_SOURCE_VIDEO,
+	.output_flags                  = OBS_SOURCE_VIDEO | OBS_SOURCE_CACHEABLE,
 	.get_name                      = color_key_name,
 	.create                        = color_key_create,
 	.destroy                       = color_key_destroy,
 	.video_render                  = color_key_render,
+	.get_pixel_function            = color_key_pixel_function_get,
+	.set_pixel_params              = color_key_set_pixel_params,
 	.update                        = color_key_update,
 	.get_properties                = color_key_properties,
 	.get_defaults                  = color_key_defaults
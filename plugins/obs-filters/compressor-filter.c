@@ -4,6 +4,7 @@
 
 #include <obs-module.h>
 #include <media-io/audio-math.h>
+#include <media-io/audio-dsp.h>
 
 /* -------------------------------------------------------- */
 
@@ -139,39 +140,23 @@ static inline void analyze_envelope(struct compressor_data *cd,
 		resize_env_buffer(cd, num_samples);
 	}
 
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (samples[chan]) {
-			float env = cd->envelope;
-			for (uint32_t i = 0; i < num_samples; ++i) {
-				const float env_in = fabsf(samples[chan][i]);
-				if (env < env_in) {
-					env = env_in + cd->attack_gain *
-						(env - env_in);
-				} else {
-					env = env_in + cd->release_gain *
-						(env - env_in);
-				}
-				cd->envelope_buf[i] = fmaxf(
-						cd->envelope_buf[i], env);
-			}
-		}
-	}
+	audio_dsp_envelope(cd->envelope_buf, samples, cd->num_channels,
+			num_samples, cd->envelope, cd->attack_gain,
+			cd->release_gain);
 	cd->envelope = cd->envelope_buf[num_samples - 1];
 }
 
 static inline void process_compression(const struct compressor_data *cd,
 	float **samples, uint32_t num_samples)
 {
-	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
-
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
+	/* turns the envelope buffer into per-sample gains */
+	audio_dsp_compressor_gain(cd->envelope_buf, num_samples, cd->slope,
+			cd->threshold, cd->output_gain);
+
+	for (size_t c = 0; c < cd->num_channels; ++c) {
+		if (samples[c]) {
+			audio_dsp_mul(samples[c], cd->envelope_buf,
+					num_samples);
 		}
 	}
 }
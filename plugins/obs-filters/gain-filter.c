@@ -1,5 +1,6 @@
 #include <obs-module.h>
 #include <media-io/audio-math.h>
+#include <media-io/audio-dsp.h>
 #include <math.h>
 
 #define do_log(level, format, ...) \
@@ -16,6 +17,7 @@
 
 struct gain_data {
 	obs_source_t *context;
+	size_t channels;
 	float multiple;
 };
 
@@ -36,6 +38,7 @@ static void gain_update(void *data, obs_data_t *s)
 	struct gain_data *gf = data;
 	double val = obs_data_get_double(s, S_GAIN_DB);
 
+	gf->channels = audio_output_get_channels(obs_get_audio());
 	gf->multiple = db_to_mul((float)val);
 }
 
@@ -52,15 +55,12 @@ static struct obs_audio_data *gain_filter_audio(void *data,
 {
 	struct gain_data *gf = data;
 
-	float *adata[2] = {(float*)audio->data[0], (float*)audio->data[1]};
-	const float multiple = gf->multiple;
+	const size_t channels = gf->channels;
 
-	for (size_t c = 0; c < 2; c++) {
-		if (audio->data[c]) {
-			for (size_t i = 0; i < audio->frames; i++) {
-				adata[c][i] *= multiple;
-			}
-		}
+	for (size_t c = 0; c < channels; c++) {
+		if (audio->data[c])
+			audio_dsp_scale((float*)audio->data[c], audio->frames,
+					gf->multiple);
 	}
 
 	return audio;
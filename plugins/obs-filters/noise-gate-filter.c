@@ -1,4 +1,5 @@
 #include <media-io/audio-math.h>
+#include <media-io/audio-dsp.h>
 #include <obs-module.h>
 #include <math.h>
 
@@ -39,6 +40,10 @@ struct noise_gate_data {
 	float attenuation;
 	float level;
 	float held_time;
+
+	/* per-sample levels, then per-sample attenuation */
+	float *gain_buf;
+	size_t gain_buf_len;
 };
 
 #define VOL_MIN -96.0f
@@ -53,6 +58,7 @@ static const char *noise_gate_name(void *unused)
 static void noise_gate_destroy(void *data)
 {
 	struct noise_gate_data *ng = data;
+	bfree(ng->gain_buf);
 	bfree(ng);
 }
 
@@ -109,7 +115,6 @@ static struct obs_audio_data *noise_gate_filter_audio(void *data,
 {
 	struct noise_gate_data *ng = data;
 
-	float *adata[2] = {(float*)audio->data[0], (float*)audio->data[1]};
 	const float close_threshold = ng->close_threshold;
 	const float open_threshold = ng->open_threshold;
 	const float sample_rate_i = ng->sample_rate_i;
@@ -118,11 +123,26 @@ static struct obs_audio_data *noise_gate_filter_audio(void *data,
 	const float decay_rate = ng->decay_rate;
 	const float hold_time = ng->hold_time;
 	const size_t channels = ng->channels;
+	const size_t frames = audio->frames;
+	float *gain_buf;
+
+	if (ng->gain_buf_len < frames) {
+		ng->gain_buf_len = frames;
+		ng->gain_buf = brealloc(ng->gain_buf, frames * sizeof(float));
+	}
+
+	gain_buf = ng->gain_buf;
 
-	for (size_t i = 0; i < audio->frames; i++) {
-		float cur_level = (channels == 2)
-			? fmaxf(fabsf(adata[0][i]), fabsf(adata[1][i]))
-			: fabsf(adata[0][i]);
+	memset(gain_buf, 0, frames * sizeof(float));
+	audio_dsp_abs_max(gain_buf, (const float*)audio->data[0], frames);
+	if (channels == 2)
+		audio_dsp_abs_max(gain_buf, (const float*)audio->data[1],
+				frames);
+
+	/* the gate itself is a state machine over samples; it replaces each
+	 * level in the buffer with the attenuation for that sample */
+	for (size_t i = 0; i < frames; i++) {
+		float cur_level = gain_buf[i];
 
 		if (cur_level > open_threshold && !ng->is_open) {
 			ng->is_open = true;
@@ -145,8 +165,13 @@ static struct obs_audio_data *noise_gate_filter_audio(void *data,
 			}
 		}
 
-		for (size_t c = 0; c < channels; c++)
-			adata[c][i] *= ng->attenuation;
+		gain_buf[i] = ng->attenuation;
+	}
+
+	for (size_t c = 0; c < channels; c++) {
+		if (audio->data[c])
+			audio_dsp_mul((float*)audio->data[c], gain_buf,
+					frames);
 	}
 
 	return audio;
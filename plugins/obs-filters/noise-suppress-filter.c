@@ -2,6 +2,7 @@
 #include <inttypes.h>
 
 #include <util/circlebuf.h>
+#include <media-io/audio-dsp.h>
 #include <obs-module.h>
 #include <speex/speex_preprocess.h>
 
@@ -155,9 +156,8 @@ static inline void process(struct noise_suppress_data *ng)
 
 	/* Convert to 16bit */
 	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++)
-			ng->segment_buffers[i][j] = (spx_int16_t)
-				(ng->copy_buffers[i][j] * c_32_to_16);
+		audio_dsp_float_to_s16(ng->segment_buffers[i],
+				ng->copy_buffers[i], ng->frames, c_32_to_16);
 
 	/* Execute */
 	for (size_t i = 0; i < ng->channels; i++)
@@ -165,9 +165,9 @@ static inline void process(struct noise_suppress_data *ng)
 
 	/* Convert back to 32bit */
 	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++)
-			ng->copy_buffers[i][j] =
-				(float)ng->segment_buffers[i][j] / c_16_to_32;
+		audio_dsp_s16_to_float(ng->copy_buffers[i],
+				ng->segment_buffers[i], ng->frames,
+				1.0f / c_16_to_32);
 
 	/* Push to output circlebuf */
 	for (size_t i = 0; i < ng->channels; i++)
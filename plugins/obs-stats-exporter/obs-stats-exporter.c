@@ -0,0 +1,444 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define do_log(level, format, ...) \
+	blog(level, "[stats-exporter] " format, ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+/* don't let a reader that went away kill the process with SIGPIPE */
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+OBS_DECLARE_MODULE()
+
+/*
+ * Periodically writes a snapshot of the libobs stats registry for external
+ * monitoring.  Configured with config.json in the module config directory:
+ *
+ *   {
+ *       "format":      "prometheus" or "jsonl",
+ *       "path":        file to write (prometheus: replaced on every write,
+ *                      jsonl: one line appended per snapshot),
+ *       "socket":      unix socket to send every snapshot to,
+ *       "interval_ms": time between snapshots (default 5000)
+ *   }
+ *
+ * The exporter does nothing unless a path or a socket is configured.
+ */
+
+enum export_format {
+	FORMAT_PROMETHEUS,
+	FORMAT_JSONL
+};
+
+struct stats_exporter {
+	enum export_format format;
+	char               *path;
+	char               *socket_path;
+	uint32_t           interval_ms;
+
+	int                socket;
+	bool               socket_failed;
+
+	pthread_t          thread;
+	os_event_t         *stop_event;
+	bool               thread_active;
+};
+
+static struct stats_exporter exporter = {0};
+
+/* ------------------------------------------------------------------------- */
+
+static const char *type_name(enum obs_stat_type type)
+{
+	switch (type) {
+	case OBS_STAT_COUNTER:   return "counter";
+	case OBS_STAT_GAUGE:     return "gauge";
+	case OBS_STAT_HISTOGRAM: return "histogram";
+	}
+
+	return "untyped";
+}
+
+static void cat_labels(struct dstr *out, const char *labels, const char *le)
+{
+	if (!labels && !le)
+		return;
+
+	dstr_cat_ch(out, '{');
+	if (labels)
+		dstr_cat(out, labels);
+	if (labels && le)
+		dstr_cat_ch(out, ',');
+	if (le)
+		dstr_catf(out, "le=\"%s\"", le);
+	dstr_cat_ch(out, '}');
+}
+
+static void cat_histogram(struct dstr *out, const struct obs_stat_value *val)
+{
+	uint64_t total = 0;
+	char le[32];
+
+	for (size_t i = 0; i < OBS_STAT_HISTOGRAM_BUCKETS; i++) {
+		double bound = obs_stat_histogram_bound(i);
+
+		if (i == OBS_STAT_HISTOGRAM_BUCKETS - 1)
+			strcpy(le, "+Inf");
+		else
+			snprintf(le, sizeof(le), "%g", bound);
+
+		total += val->buckets[i];
+
+		dstr_catf(out, "%s_bucket", val->name);
+		cat_labels(out, val->labels, le);
+		dstr_catf(out, " %llu\n", (unsigned long long)total);
+	}
+
+	dstr_catf(out, "%s_sum", val->name);
+	cat_labels(out, val->labels, NULL);
+	dstr_catf(out, " %.15g\n", val->value);
+
+	dstr_catf(out, "%s_count", val->name);
+	cat_labels(out, val->labels, NULL);
+	dstr_catf(out, " %llu\n", (unsigned long long)val->count);
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	const struct obs_stat_value *val_a = *(const struct obs_stat_value**)a;
+	const struct obs_stat_value *val_b = *(const struct obs_stat_value**)b;
+	return strcmp(val_a->name, val_b->name);
+}
+
+static void format_prometheus(struct dstr *out, obs_stats_snapshot_t *snap)
+{
+	DARRAY(const struct obs_stat_value*) sorted = {0};
+	size_t count = obs_stats_snapshot_count(snap);
+	const char *last_name = NULL;
+
+	/* all values of a metric have to be grouped together */
+	da_reserve(sorted, count);
+	for (size_t i = 0; i < count; i++) {
+		const struct obs_stat_value *val =
+			obs_stats_snapshot_get(snap, i);
+		da_push_back(sorted, &val);
+	}
+
+	qsort(sorted.array, sorted.num, sizeof(*sorted.array), compare_names);
+
+	for (size_t i = 0; i < sorted.num; i++) {
+		const struct obs_stat_value *val = sorted.array[i];
+
+		/* metadata is only written once per metric name */
+		if (!last_name || strcmp(last_name, val->name) != 0) {
+			if (val->help)
+				dstr_catf(out, "# HELP %s %s\n", val->name,
+						val->help);
+			dstr_catf(out, "# TYPE %s %s\n", val->name,
+					type_name(val->type));
+			last_name = val->name;
+		}
+
+		if (val->type == OBS_STAT_HISTOGRAM) {
+			cat_histogram(out, val);
+		} else {
+			dstr_cat(out, val->name);
+			cat_labels(out, val->labels, NULL);
+			dstr_catf(out, " %.15g\n", val->value);
+		}
+	}
+
+	da_free(sorted);
+}
+
+static void cat_json_string(struct dstr *out, const char *str)
+{
+	dstr_cat_ch(out, '"');
+
+	for (; str && *str; str++) {
+		if (*str == '"' || *str == '\\')
+			dstr_cat_ch(out, '\\');
+		if ((unsigned char)*str < 0x20)
+			dstr_catf(out, "\\u%04x", (unsigned)*str);
+		else
+			dstr_cat_ch(out, *str);
+	}
+
+	dstr_cat_ch(out, '"');
+}
+
+static void format_jsonl(struct dstr *out, obs_stats_snapshot_t *snap)
+{
+	size_t count = obs_stats_snapshot_count(snap);
+
+	dstr_catf(out, "{\"time\":%lld,\"stats\":[", (long long)time(NULL));
+
+	for (size_t i = 0; i < count; i++) {
+		const struct obs_stat_value *val =
+			obs_stats_snapshot_get(snap, i);
+
+		if (i)
+			dstr_cat_ch(out, ',');
+
+		dstr_cat(out, "{\"name\":");
+		cat_json_string(out, val->name);
+		if (val->labels) {
+			dstr_cat(out, ",\"labels\":");
+			cat_json_string(out, val->labels);
+		}
+		dstr_catf(out, ",\"type\":\"%s\",\"value\":%.15g",
+				type_name(val->type), val->value);
+
+		if (val->type == OBS_STAT_HISTOGRAM) {
+			dstr_catf(out, ",\"count\":%llu,\"buckets\":[",
+					(unsigned long long)val->count);
+			for (size_t j = 0; j < OBS_STAT_HISTOGRAM_BUCKETS; j++)
+				dstr_catf(out, j ? ",%llu" : "%llu",
+					(unsigned long long)val->buckets[j]);
+			dstr_cat_ch(out, ']');
+		}
+
+		dstr_cat_ch(out, '}');
+	}
+
+	dstr_cat(out, "]}\n");
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void write_file(const struct dstr *out)
+{
+	FILE *f;
+
+	if (exporter.format == FORMAT_PROMETHEUS) {
+		if (!os_quick_write_utf8_file_safe(exporter.path, out->array,
+					out->len, false, "tmp", NULL))
+			warn("Failed to write '%s'", exporter.path);
+		return;
+	}
+
+	f = os_fopen(exporter.path, "ab");
+	if (!f) {
+		warn("Failed to open '%s'", exporter.path);
+		return;
+	}
+
+	fwrite(out->array, 1, out->len, f);
+	fclose(f);
+}
+
+#ifndef _WIN32
+static bool connect_socket(void)
+{
+	struct sockaddr_un addr = {0};
+
+	if (exporter.socket != -1)
+		return true;
+
+	if (strlen(exporter.socket_path) >= sizeof(addr.sun_path)) {
+		if (!exporter.socket_failed)
+			warn("Socket path '%s' is too long",
+					exporter.socket_path);
+		exporter.socket_failed = true;
+		return false;
+	}
+
+	exporter.socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (exporter.socket == -1)
+		return false;
+
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(exporter.socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, exporter.socket_path);
+
+	if (connect(exporter.socket, (struct sockaddr*)&addr,
+				sizeof(addr)) != 0) {
+		/* only log the first failure until it works again */
+		if (!exporter.socket_failed)
+			warn("Failed to connect to '%s': %s",
+					exporter.socket_path, strerror(errno));
+		exporter.socket_failed = true;
+
+		close(exporter.socket);
+		exporter.socket = -1;
+		return false;
+	}
+
+	if (exporter.socket_failed)
+		info("Connected to '%s'", exporter.socket_path);
+	exporter.socket_failed = false;
+	return true;
+}
+
+static void write_socket(const struct dstr *out)
+{
+	size_t sent = 0;
+
+	if (!connect_socket())
+		return;
+
+	while (sent < out->len) {
+		ssize_t ret = send(exporter.socket, out->array + sent,
+				out->len - sent, SEND_FLAGS);
+		if (ret <= 0) {
+			if (ret < 0 && errno == EINTR)
+				continue;
+
+			close(exporter.socket);
+			exporter.socket = -1;
+			return;
+		}
+
+		sent += (size_t)ret;
+	}
+}
+#endif
+
+static void export_stats(void)
+{
+	obs_stats_snapshot_t *snap = obs_stats_snapshot_create();
+	struct dstr out = {0};
+
+	if (exporter.format == FORMAT_PROMETHEUS)
+		format_prometheus(&out, snap);
+	else
+		format_jsonl(&out, snap);
+
+	obs_stats_snapshot_free(snap);
+
+	if (!out.len) {
+		dstr_free(&out);
+		return;
+	}
+
+	if (exporter.path)
+		write_file(&out);
+#ifndef _WIN32
+	if (exporter.socket_path)
+		write_socket(&out);
+#endif
+
+	dstr_free(&out);
+}
+
+static void *export_thread(void *unused)
+{
+	os_set_thread_name("stats-exporter: export thread");
+
+	while (os_event_timedwait(exporter.stop_event, exporter.interval_ms)
+			== ETIMEDOUT)
+		export_stats();
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool load_config(void)
+{
+	char *file = obs_module_config_path("config.json");
+	obs_data_t *config = obs_data_create_from_json_file(file);
+	const char *format;
+	const char *path;
+	const char *socket_path;
+
+	bfree(file);
+
+	if (!config)
+		return false;
+
+	obs_data_set_default_string(config, "format", "prometheus");
+	obs_data_set_default_int(config, "interval_ms", 5000);
+
+	format      = obs_data_get_string(config, "format");
+	path        = obs_data_get_string(config, "path");
+	socket_path = obs_data_get_string(config, "socket");
+
+	exporter.format = astrcmpi(format, "jsonl") == 0 ?
+		FORMAT_JSONL : FORMAT_PROMETHEUS;
+	exporter.interval_ms = (uint32_t)obs_data_get_int(config,
+			"interval_ms");
+	if (exporter.interval_ms < 100)
+		exporter.interval_ms = 100;
+
+	if (path && *path)
+		exporter.path = bstrdup(path);
+#ifndef _WIN32
+	if (socket_path && *socket_path)
+		exporter.socket_path = bstrdup(socket_path);
+#else
+	if (socket_path && *socket_path)
+		warn("Unix sockets are not supported on this platform");
+#endif
+
+	obs_data_release(config);
+	return exporter.path || exporter.socket_path;
+}
+
+bool obs_module_load(void)
+{
+	exporter.socket = -1;
+
+	if (!load_config())
+		return true;
+
+	if (os_event_init(&exporter.stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		return true;
+
+	if (pthread_create(&exporter.thread, NULL, export_thread, NULL) != 0) {
+		warn("Failed to create export thread");
+		return true;
+	}
+
+	exporter.thread_active = true;
+	info("Exporting stats in %s format every %u ms to %s%s%s",
+			exporter.format == FORMAT_JSONL ? "jsonl" : "prometheus",
+			exporter.interval_ms,
+			exporter.path ? exporter.path : "",
+			exporter.path && exporter.socket_path ? " and " : "",
+			exporter.socket_path ? exporter.socket_path : "");
+	return true;
+}
+
+void obs_module_unload(void)
+{
+	if (exporter.thread_active) {
+		os_event_signal(exporter.stop_event);
+		pthread_join(exporter.thread, NULL);
+		exporter.thread_active = false;
+	}
+
+#ifndef _WIN32
+	if (exporter.socket != -1)
+		close(exporter.socket);
+#endif
+
+	os_event_destroy(exporter.stop_event);
+	bfree(exporter.path);
+	bfree(exporter.socket_path);
+	memset(&exporter, 0, sizeof(exporter));
+}
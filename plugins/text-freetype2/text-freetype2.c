@@ -17,9 +17,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
 #include "find-font.h"
@@ -38,7 +38,8 @@ static struct obs_source_info freetype2_source_info = {
 #ifdef _WIN32
 	                OBS_SOURCE_DEPRECATED |
 #endif
-	                OBS_SOURCE_CUSTOM_DRAW,
+	                OBS_SOURCE_CUSTOM_DRAW |
+	                OBS_SOURCE_CACHEABLE,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create,
 	.destroy = ft2_source_destroy,
@@ -190,6 +191,8 @@ static void ft2_source_destroy(void *data)
 	if (srcdata->text_file != NULL)
 		bfree(srcdata->text_file);
 
+	obs_file_watch_remove(srcdata->text_file_watch);
+
 	obs_enter_graphics();
 
 	if (srcdata->tex != NULL) {
@@ -228,25 +231,28 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+static void ft2_text_file_changed(void *data, const char *path)
+{
+	struct ft2_source *srcdata = data;
+	os_atomic_set_bool(&srcdata->text_file_changed, true);
+
+	UNUSED_PARAMETER(path);
+}
+
 static void ft2_video_tick(void *data, float seconds)
 {
 	struct ft2_source *srcdata = data;
 	if (srcdata == NULL) return;
 	if (!srcdata->from_file || !srcdata->text_file) return;
 
-	if (os_gettime_ns() - srcdata->last_checked >= 1000000000) {
-		time_t t = get_modified_timestamp(srcdata->text_file);
-		srcdata->last_checked = os_gettime_ns();
-
-		if (srcdata->m_timestamp != t) {
-			if (srcdata->log_mode)
-				read_from_end(srcdata, srcdata->text_file);
-			else
-				load_text_from_file(srcdata,
-					srcdata->text_file);
-			cache_glyphs(srcdata, srcdata->text);
-			set_up_vertex_buffer(srcdata);
-		}
+	if (os_atomic_set_bool(&srcdata->text_file_changed, false)) {
+		if (srcdata->log_mode)
+			read_from_end(srcdata, srcdata->text_file);
+		else
+			load_text_from_file(srcdata, srcdata->text_file);
+		cache_glyphs(srcdata, srcdata->text);
+		set_up_vertex_buffer(srcdata);
+		obs_source_invalidate_cache(srcdata->src);
 	}
 
 	UNUSED_PARAMETER(seconds);
@@ -349,6 +355,13 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	srcdata->file_load_failed = false;
 	srcdata->from_file = from_file;
 
+	/* the text no longer comes from the file, stop reloading it */
+	if (!from_file && srcdata->text_file_watch) {
+		obs_file_watch_remove(srcdata->text_file_watch);
+		srcdata->text_file_watch = NULL;
+		os_atomic_set_bool(&srcdata->text_file_changed, false);
+	}
+
 	if (srcdata->font_name != NULL) {
 		if (strcmp(font_name,  srcdata->font_name)  == 0 &&
 		    strcmp(font_style, srcdata->font_style) == 0 &&
@@ -412,11 +425,15 @@ skip_font_load:
 			bfree(srcdata->text_file);
 
 			srcdata->text_file = bstrdup(tmp);
+			obs_file_watch_remove(srcdata->text_file_watch);
+			srcdata->text_file_watch = obs_file_watch_add(tmp,
+					ft2_text_file_changed, srcdata);
+			os_atomic_set_bool(&srcdata->text_file_changed, false);
+
 			if (chat_log_mode)
 				read_from_end(srcdata, tmp);
 			else
 				load_text_from_file(srcdata, tmp);
-			srcdata->last_checked = os_gettime_ns();
 		}
 	}
 	else {
@@ -37,8 +37,8 @@ struct ft2_source {
 	bool from_file;
 	char *text_file;
 	wchar_t *text;
-	time_t m_timestamp;
-	uint64_t last_checked;
+	obs_file_watch_t *text_file_watch;
+	volatile bool text_file_changed;
 
 	uint32_t cx, cy, max_h, custom_width;
 	uint32_t texbuf_x, texbuf_y;
@@ -83,7 +83,6 @@ static const char *ft2_source_get_name(void *unused);
 
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata);
 
-time_t get_modified_timestamp(char *filename);
 void load_text_from_file(struct ft2_source *srcdata, const char *filename);
 void read_from_end(struct ft2_source *srcdata, const char *filename);
 
@@ -19,7 +19,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <util/platform.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
 
@@ -324,18 +323,6 @@ void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
 	}
 }
 
-time_t get_modified_timestamp(char *filename)
-{
-	struct stat stats;
-
-	// stat is apparently terrifying and horrible, but we only call it once
-	// every second at most.
-	if (os_stat(filename, &stats) != 0)
-		return -1;
-
-	return stats.st_mtime;
-}
-
 static void remove_cr(wchar_t* source)
 {
 	int j = 0;
@@ -377,8 +364,6 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 		srcdata->text = bzalloc(filesize);
 		bytes_read = fread(srcdata->text, filesize - 2, 1, tmp_file);
 
-		srcdata->m_timestamp =
-			get_modified_timestamp(srcdata->text_file);
 		bfree(tmp_read);
 		fclose(tmp_file);
 
@@ -386,7 +371,6 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 	}
 
 	fseek(tmp_file, 0, SEEK_SET);
-	srcdata->m_timestamp = get_modified_timestamp(srcdata->text_file);
 
 	tmp_read = bzalloc(filesize + 1);
 	bytes_read = fread(tmp_read, filesize, 1, tmp_file);
@@ -464,8 +448,6 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 				tmp_file);
 
 		remove_cr(srcdata->text);
-		srcdata->m_timestamp =
-			get_modified_timestamp(srcdata->text_file);
 		bfree(tmp_read);
 		fclose(tmp_file);
 
@@ -485,7 +467,6 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 		srcdata->text, (strlen(tmp_read) + 1));
 
 	remove_cr(srcdata->text);
-	srcdata->m_timestamp = get_modified_timestamp(srcdata->text_file);
 	bfree(tmp_read);
 }
 
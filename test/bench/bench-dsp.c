@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <obs-data.h>
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-math.h>
+#include <media-io/audio-dsp.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+/*
+ *   Microbenchmark for the per-sample kernels of the built-in audio filters
+ * (obs-filters).  Every kernel is run in its original scalar form and in its
+ * vectorized form over the same synthetic signal, packet by packet with state
+ * carried between packets like the filters do.  The outputs are compared,
+ * and the time per sample of both is written as JSON to stdout.
+ *
+ *   Exits with an error if a vectorized kernel is further from the scalar one
+ * than its tolerance (exact, unless the kernel uses the approximate log/exp).
+ *
+ * Example:
+ *   obs-bench-dsp --frames 1024 --packets 20000
+ */
+
+#define SAMPLE_RATE      48000
+#define CHANNELS         2
+#define SIGNAL_PACKETS   64
+
+struct dsp_state {
+	/* compressor (ratio 4:1, -18 dB threshold, 6/60 ms, +3 dB) */
+	float            *env_buf;
+	float            envelope;
+	float            attack_gain;
+	float            release_gain;
+	float            slope;
+	float            threshold;
+	float            output_gain;
+
+	/* noise gate (-26/-32 dB, 25/200/150 ms) */
+	float            *gain_buf;
+	float            open_threshold;
+	float            close_threshold;
+	float            decay_rate;
+	float            attack_rate;
+	float            release_rate;
+	float            hold_time;
+	float            sample_rate_i;
+	bool             is_open;
+	float            attenuation;
+	float            level;
+	float            held_time;
+
+	/* gain filter (-6 dB) */
+	float            multiple;
+
+	/* noise suppression conversion */
+	int16_t          *s16_buf;
+};
+
+typedef void (*dsp_kernel_t)(struct dsp_state *state, float **data,
+		size_t frames);
+
+struct dsp_kernel {
+	const char       *name;
+	dsp_kernel_t     scalar;
+	dsp_kernel_t     vectorized;
+	double           tolerance_db;
+};
+
+static void reset_state(struct dsp_state *state)
+{
+	const float sample_rate = (float)SAMPLE_RATE;
+
+	state->envelope = 0.0f;
+	state->attack_gain = expf(-1.0f / (sample_rate * 0.006f));
+	state->release_gain = expf(-1.0f / (sample_rate * 0.060f));
+	state->slope = 1.0f - 1.0f / 4.0f;
+	state->threshold = -18.0f;
+	state->output_gain = db_to_mul(3.0f);
+
+	state->open_threshold = db_to_mul(-26.0f);
+	state->close_threshold = db_to_mul(-32.0f);
+	state->decay_rate = (state->open_threshold - state->close_threshold) /
+		((1.0f / 75.0f) * sample_rate);
+	state->attack_rate = 1.0f / (0.025f * sample_rate);
+	state->release_rate = 1.0f / (0.150f * sample_rate);
+	state->hold_time = 0.200f;
+	state->sample_rate_i = 1.0f / sample_rate;
+	state->is_open = false;
+	state->attenuation = 0.0f;
+	state->level = 0.0f;
+	state->held_time = 0.0f;
+
+	state->multiple = db_to_mul(-6.0f);
+}
+
+/* ------------------------------------------------------------------------- */
+/* compressor-filter.c                                                       */
+
+static void compressor_envelope(struct dsp_state *state, float **data,
+		size_t frames)
+{
+	memset(state->env_buf, 0, frames * sizeof(float));
+	for (size_t c = 0; c < CHANNELS; c++) {
+		float env = state->envelope;
+		for (size_t i = 0; i < frames; i++) {
+			const float env_in = fabsf(data[c][i]);
+			if (env < env_in)
+				env = env_in + state->attack_gain *
+					(env - env_in);
+			else
+				env = env_in + state->release_gain *
+					(env - env_in);
+			state->env_buf[i] = fmaxf(state->env_buf[i], env);
+		}
+	}
+	state->envelope = state->env_buf[frames - 1];
+}
+
+static void compressor_scalar(struct dsp_state *state, float **data,
+		size_t frames)
+{
+	compressor_envelope(state, data, frames);
+
+	for (size_t i = 0; i < frames; i++) {
+		const float env_db = mul_to_db(state->env_buf[i]);
+		float gain = state->slope * (state->threshold - env_db);
+		gain = db_to_mul(fminf(0, gain));
+
+		for (size_t c = 0; c < CHANNELS; c++)
+			data[c][i] *= gain * state->output_gain;
+	}
+}
+
+static void compressor_vectorized(struct dsp_state *state, float **data,
+		size_t frames)
+{
+	audio_dsp_envelope(state->env_buf, (const float**)data, CHANNELS,
+			frames, state->envelope, state->attack_gain,
+			state->release_gain);
+	state->envelope = state->env_buf[frames - 1];
+
+	audio_dsp_compressor_gain(state->env_buf, frames, state->slope,
+			state->threshold, state->output_gain);
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio_dsp_mul(data[c], state->env_buf, frames);
+}
+
+/* ------------------------------------------------------------------------- */
+/* noise-gate-filter.c                                                       */
+
+static inline float gate_attenuation(struct dsp_state *state, float cur_level)
+{
+	if (cur_level > state->open_threshold && !state->is_open)
+		state->is_open = true;
+	if (state->level < state->close_threshold && state->is_open) {
+		state->held_time = 0.0f;
+		state->is_open = false;
+	}
+
+	state->level = fmaxf(state->level, cur_level) - state->decay_rate;
+
+	if (state->is_open) {
+		state->attenuation = fminf(1.0f,
+				state->attenuation + state->attack_rate);
+	} else {
+		state->held_time += state->sample_rate_i;
+		if (state->held_time > state->hold_time)
+			state->attenuation = fmaxf(0.0f,
+					state->attenuation -
+					state->release_rate);
+	}
+
+	return state->attenuation;
+}
+
+static void noise_gate_scalar(struct dsp_state *state, float **data,
+		size_t frames)
+{
+	for (size_t i = 0; i < frames; i++) {
+		float cur_level = fmaxf(fabsf(data[0][i]), fabsf(data[1][i]));
+		float attenuation = gate_attenuation(state, cur_level);
+
+		for (size_t c = 0; c < CHANNELS; c++)
+			data[c][i] *= attenuation;
+	}
+}
+
+static void noise_gate_vectorized(struct dsp_state *state, float **data,
+		size_t frames)
+{
+	float *gain_buf = state->gain_buf;
+
+	memset(gain_buf, 0, frames * sizeof(float));
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio_dsp_abs_max(gain_buf, data[c], frames);
+
+	for (size_t i = 0; i < frames; i++)
+		gain_buf[i] = gate_attenuation(state, gain_buf[i]);
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio_dsp_mul(data[c], gain_buf, frames);
+}
+
+/* ------------------------------------------------------------------------- */
+/* gain-filter.c                                                             */
+
+static void gain_scalar(struct dsp_state *state, float **data, size_t frames)
+{
+	for (size_t c = 0; c < CHANNELS; c++)
+		for (size_t i = 0; i < frames; i++)
+			data[c][i] *= state->multiple;
+}
+
+static void gain_vectorized(struct dsp_state *state, float **data,
+		size_t frames)
+{
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio_dsp_scale(data[c], frames, state->multiple);
+}
+
+/* ------------------------------------------------------------------------- */
+/* noise-suppress-filter.c (conversion to and from speex only)               */
+
+static const float c_32_to_16 = (float)INT16_MAX;
+static const float c_16_to_32 = ((float)INT16_MAX + 1.0f);
+
+static void convert_scalar(struct dsp_state *state, float **data,
+		size_t frames)
+{
+	for (size_t c = 0; c < CHANNELS; c++) {
+		for (size_t i = 0; i < frames; i++)
+			state->s16_buf[i] = (int16_t)(data[c][i] * c_32_to_16);
+		for (size_t i = 0; i < frames; i++)
+			data[c][i] = (float)state->s16_buf[i] / c_16_to_32;
+	}
+}
+
+static void convert_vectorized(struct dsp_state *state, float **data,
+		size_t frames)
+{
+	for (size_t c = 0; c < CHANNELS; c++) {
+		audio_dsp_float_to_s16(state->s16_buf, data[c], frames,
+				c_32_to_16);
+		audio_dsp_s16_to_float(data[c], state->s16_buf, frames,
+				1.0f / c_16_to_32);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const struct dsp_kernel kernels[] = {
+	{"compressor",     compressor_scalar, compressor_vectorized, 0.001},
+	{"noise_gate",     noise_gate_scalar, noise_gate_vectorized, 0.0},
+	{"gain",           gain_scalar,       gain_vectorized,       0.0},
+	{"noise_suppress", convert_scalar,    convert_vectorized,    0.0},
+};
+
+/* bursts of a two tone signal fading between -60 and 0 dB, so that the
+ * compressor and the gate go through all of their states */
+static float *create_signal(size_t frames)
+{
+	size_t total = frames * SIGNAL_PACKETS;
+	float *signal = bmalloc(total * CHANNELS * sizeof(float));
+
+	for (size_t i = 0; i < total; i++) {
+		double t = (double)i / SAMPLE_RATE;
+		double level_db = -30.0 + 30.0 * sin(2.0 * M_PI * 1.3 * t);
+		double amp = pow(10.0, level_db / 20.0);
+
+		for (size_t c = 0; c < CHANNELS; c++) {
+			double tone = 0.7 * sin(2.0 * M_PI * (440.0 + c) * t) +
+				0.3 * sin(2.0 * M_PI * 3100.0 * t);
+			signal[c * total + i] = (float)(amp * tone);
+		}
+	}
+
+	return signal;
+}
+
+static inline void load_packet(float **data, const float *signal,
+		size_t frames, size_t packet)
+{
+	size_t total = frames * SIGNAL_PACKETS;
+	size_t offset = (packet % SIGNAL_PACKETS) * frames;
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		memcpy(data[c], signal + c * total + offset,
+				frames * sizeof(float));
+}
+
+/* returns the largest difference in dB between the two outputs; samples
+ * below -120 dB in both are treated as equal */
+static double compare(const struct dsp_kernel *kernel, const float *signal,
+		size_t frames, float **ref, float **out,
+		struct dsp_state *state_ref, struct dsp_state *state_out)
+{
+	const float floor = db_to_mul(-120.0f);
+	double max_diff_db = 0.0;
+
+	reset_state(state_ref);
+	reset_state(state_out);
+
+	for (size_t p = 0; p < SIGNAL_PACKETS; p++) {
+		load_packet(ref, signal, frames, p);
+		load_packet(out, signal, frames, p);
+		kernel->scalar(state_ref, ref, frames);
+		kernel->vectorized(state_out, out, frames);
+
+		for (size_t c = 0; c < CHANNELS; c++) {
+			for (size_t i = 0; i < frames; i++) {
+				float a = fabsf(ref[c][i]);
+				float b = fabsf(out[c][i]);
+				double diff;
+
+				if (a == b || (a < floor && b < floor))
+					continue;
+				if ((ref[c][i] < 0.0f) != (out[c][i] < 0.0f) ||
+				    a < floor || b < floor)
+					return INFINITY;
+
+				diff = fabs(20.0 * log10((double)b / a));
+				if (diff > max_diff_db)
+					max_diff_db = diff;
+			}
+		}
+	}
+
+	return max_diff_db;
+}
+
+static double time_kernel(dsp_kernel_t kernel, struct dsp_state *state,
+		const float *signal, float **data, size_t frames,
+		size_t packets)
+{
+	uint64_t total_ns = 0;
+
+	reset_state(state);
+
+	for (size_t p = 0; p < packets; p++) {
+		uint64_t start;
+
+		load_packet(data, signal, frames, p);
+		start = os_gettime_ns();
+		kernel(state, data, frames);
+		total_ns += os_gettime_ns() - start;
+	}
+
+	return (double)total_ns / ((double)packets * frames);
+}
+
+static void alloc_state(struct dsp_state *state, size_t frames)
+{
+	state->env_buf = bmalloc(frames * sizeof(float));
+	state->gain_buf = bmalloc(frames * sizeof(float));
+	state->s16_buf = bmalloc(frames * sizeof(int16_t));
+}
+
+static void free_state(struct dsp_state *state)
+{
+	bfree(state->env_buf);
+	bfree(state->gain_buf);
+	bfree(state->s16_buf);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+	"usage: obs-bench-dsp [options]\n"
+	"\n"
+	"  --frames N                 frames per packet (1024)\n"
+	"  --packets N                packets timed per kernel (20000)\n"
+	"  --kernel NAME              only run compressor, noise_gate, gain\n"
+	"                             or noise_suppress\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct dsp_state state_ref = {0};
+	struct dsp_state state_out = {0};
+	float *ref[CHANNELS];
+	float *out[CHANNELS];
+	const char *only = NULL;
+	size_t frames = 1024;
+	size_t packets = 20000;
+	obs_data_t *results;
+	obs_data_array_t *array;
+	float *signal;
+	bool success = true;
+
+	for (int i = 1; i < argc; i++) {
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		long long num = val ? atoll(val) : 0;
+
+		if (strcmp(argv[i], "--frames") == 0 && num > 0) {
+			frames = (size_t)num;
+		} else if (strcmp(argv[i], "--packets") == 0 && num > 0) {
+			packets = (size_t)num;
+		} else if (strcmp(argv[i], "--kernel") == 0 && val) {
+			only = val;
+		} else {
+			usage();
+			return 1;
+		}
+		i++;
+	}
+
+	signal = create_signal(frames);
+	alloc_state(&state_ref, frames);
+	alloc_state(&state_out, frames);
+	for (size_t c = 0; c < CHANNELS; c++) {
+		ref[c] = bmalloc(frames * sizeof(float));
+		out[c] = bmalloc(frames * sizeof(float));
+	}
+
+	results = obs_data_create();
+	array = obs_data_array_create();
+	obs_data_set_int(results, "frames", (long long)frames);
+	obs_data_set_int(results, "packets", (long long)packets);
+	obs_data_set_int(results, "channels", CHANNELS);
+
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		const struct dsp_kernel *kernel = &kernels[k];
+		obs_data_t *item;
+		double diff_db, scalar_ns, vectorized_ns;
+		bool passed;
+
+		if (only && strcmp(only, kernel->name) != 0)
+			continue;
+
+		diff_db = compare(kernel, signal, frames, ref, out,
+				&state_ref, &state_out);
+		passed = diff_db <= kernel->tolerance_db;
+		scalar_ns = time_kernel(kernel->scalar, &state_ref, signal,
+				ref, frames, packets);
+		vectorized_ns = time_kernel(kernel->vectorized, &state_out,
+				signal, out, frames, packets);
+
+		if (!passed) {
+			fprintf(stderr, "%s: outputs differ by %g dB "
+					"(tolerance %g dB)\n", kernel->name,
+					diff_db, kernel->tolerance_db);
+			success = false;
+		}
+
+		item = obs_data_create();
+		obs_data_set_string(item, "name", kernel->name);
+		obs_data_set_double(item, "scalar_ns_per_frame", scalar_ns);
+		obs_data_set_double(item, "vectorized_ns_per_frame",
+				vectorized_ns);
+		obs_data_set_double(item, "speedup",
+				vectorized_ns > 0.0 ? scalar_ns / vectorized_ns
+				                    : 0.0);
+		obs_data_set_double(item, "max_diff_db",
+				isfinite(diff_db) ? diff_db : -1.0);
+		obs_data_set_double(item, "tolerance_db", kernel->tolerance_db);
+		obs_data_set_bool(item, "passed", passed);
+		obs_data_array_push_back(array, item);
+		obs_data_release(item);
+	}
+
+	obs_data_set_array(results, "kernels", array);
+	obs_data_set_bool(results, "passed", success);
+	printf("%s\n", obs_data_get_json(results));
+
+	obs_data_array_release(array);
+	obs_data_release(results);
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		bfree(ref[c]);
+		bfree(out[c]);
+	}
+	free_state(&state_ref);
+	free_state(&state_out);
+	bfree(signal);
+
+	return success ? 0 : 1;
+}
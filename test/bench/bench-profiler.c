@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <obs-data.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+/*
+ *   Microbenchmark for the overhead of profile_start/profile_end.  Every
+ * thread records profiled trees shaped like a typical frame (one root call
+ * with a number of child calls), and the time per start/end pair is written
+ * as JSON to stdout.  Runs with several threads show how much the threads
+ * get in each other's way.
+ *
+ *   Trees are spaced --pace-us apart and only the profiled sections are
+ * timed, so the profiler gets to process recorded calls the way it would
+ * with real frames instead of being flooded by a tight loop.
+ *
+ * Example:
+ *   obs-bench-profiler --iterations 20000 --children 9 --threads 4
+ */
+
+struct bench_thread {
+	pthread_t        thread;
+	long long        iterations;
+	int              children;
+	uint64_t         pace_ns;
+	uint64_t         ns;
+};
+
+static const char *root_name  = "bench_root";
+static const char *child_name = "bench_child";
+
+static void *bench_thread(void *data)
+{
+	struct bench_thread *bt = data;
+	uint64_t next = os_gettime_ns();
+
+	profile_reenable_thread();
+
+	for (long long i = 0; i < bt->iterations; i++) {
+		uint64_t start;
+
+		next += bt->pace_ns;
+
+		start = os_gettime_ns();
+		profile_start(root_name);
+		for (int j = 0; j < bt->children; j++) {
+			profile_start(child_name);
+			profile_end(child_name);
+		}
+		profile_end(root_name);
+		bt->ns += os_gettime_ns() - start;
+
+		os_sleepto_ns(next);
+	}
+
+	return NULL;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+	"usage: obs-bench-profiler [options]\n"
+	"\n"
+	"  --iterations N             profiled trees per thread (20000)\n"
+	"  --children N               child calls per tree (9)\n"
+	"  --pace-us N                microseconds between trees (100)\n"
+	"  --threads N                threads profiling at the same time (1)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	long long iterations = 20000;
+	int children = 9;
+	long long pace_us = 100;
+	int threads = 1;
+	struct bench_thread *bt;
+	double ns_per_call = 0.0;
+	obs_data_t *results;
+
+	for (int i = 1; i < argc; i++) {
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		long long num = val ? atoll(val) : 0;
+
+		if (strcmp(argv[i], "--iterations") == 0 && num > 0) {
+			iterations = num;
+		} else if (strcmp(argv[i], "--children") == 0 && num >= 0 &&
+		           val) {
+			children = (int)num;
+		} else if (strcmp(argv[i], "--pace-us") == 0 && num >= 0 &&
+		           val) {
+			pace_us = num;
+		} else if (strcmp(argv[i], "--threads") == 0 && num > 0) {
+			threads = (int)num;
+		} else {
+			usage();
+			return 1;
+		}
+		i++;
+	}
+
+	profiler_start();
+
+	bt = bzalloc(sizeof(*bt) * threads);
+	for (int i = 0; i < threads; i++) {
+		bt[i].iterations = iterations;
+		bt[i].children   = children;
+		bt[i].pace_ns    = (uint64_t)pace_us * 1000;
+		if (pthread_create(&bt[i].thread, NULL, bench_thread,
+					&bt[i]) != 0) {
+			fprintf(stderr, "Failed to create thread\n");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < threads; i++) {
+		pthread_join(bt[i].thread, NULL);
+		ns_per_call += (double)bt[i].ns /
+			((double)iterations * (children + 1));
+	}
+
+	profiler_stop();
+
+	results = obs_data_create();
+	obs_data_set_int(results, "iterations", iterations);
+	obs_data_set_int(results, "children", children);
+	obs_data_set_int(results, "pace_us", pace_us);
+	obs_data_set_int(results, "threads", threads);
+	obs_data_set_double(results, "ns_per_call", ns_per_call / threads);
+	printf("%s\n", obs_data_get_json(results));
+	obs_data_release(results);
+
+	bfree(bt);
+	profiler_free();
+	return 0;
+}
@@ -0,0 +1,437 @@
+#include <math.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <media-io/video-frame.h>
+#include "bench.h"
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#define BAND_HEIGHT 16
+
+/* ------------------------------------------------------------------------- */
+/* synthetic video */
+
+struct bench_video {
+	obs_source_t       *source;
+	os_event_t         *stop_signal;
+	pthread_t          thread;
+	bool               initialized;
+
+	struct video_frame frame;
+	enum video_format  format;
+	uint32_t           width;
+	uint32_t           height;
+	uint32_t           fps_num;
+	uint32_t           fps_den;
+};
+
+static const char *bench_video_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Synthetic Video (Benchmark)";
+}
+
+static void bench_video_destroy(void *data)
+{
+	struct bench_video *bv = data;
+
+	if (bv) {
+		if (bv->initialized) {
+			os_event_signal(bv->stop_signal);
+			pthread_join(bv->thread, NULL);
+		}
+
+		os_event_destroy(bv->stop_signal);
+		video_frame_free(&bv->frame);
+		bfree(bv);
+	}
+}
+
+/* fills every plane with a diagonal gradient, so that encoders get content
+ * that is neither trivially flat nor pure noise */
+static void fill_gradient(struct bench_video *bv)
+{
+	for (size_t plane = 0; plane < MAX_AV_PLANES; plane++) {
+		uint8_t *data = bv->frame.data[plane];
+		uint32_t linesize = bv->frame.linesize[plane];
+		uint32_t height = bv->height;
+
+		if (!data)
+			break;
+
+		if (plane > 0 && (bv->format == VIDEO_FORMAT_I420 ||
+		                  bv->format == VIDEO_FORMAT_NV12))
+			height /= 2;
+
+		for (uint32_t y = 0; y < height; y++) {
+			for (uint32_t x = 0; x < linesize; x++)
+				data[y * linesize + x] =
+					(uint8_t)((x + y + plane * 64) & 0xFF);
+		}
+	}
+}
+
+/* moves a band down the first plane, so that every frame is different */
+static inline void update_band(struct bench_video *bv, uint64_t frame_idx)
+{
+	uint32_t band_count = bv->height / BAND_HEIGHT;
+	uint32_t linesize = bv->frame.linesize[0];
+	uint32_t band;
+
+	if (!band_count)
+		return;
+
+	band = (uint32_t)(frame_idx % band_count);
+
+	memset(bv->frame.data[0] + (size_t)band * BAND_HEIGHT * linesize,
+			(int)(frame_idx & 0xFF),
+			(size_t)BAND_HEIGHT * linesize);
+}
+
+static void *video_thread(void *data)
+{
+	struct bench_video *bv = data;
+	uint64_t interval = 1000000000ULL * bv->fps_den / bv->fps_num;
+	uint64_t cur_time = os_gettime_ns();
+	uint64_t frame_idx = 0;
+
+	struct obs_source_frame frame = {
+		.width  = bv->width,
+		.height = bv->height,
+		.format = bv->format
+	};
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame.data[i]     = bv->frame.data[i];
+		frame.linesize[i] = bv->frame.linesize[i];
+	}
+
+	video_format_get_parameters(VIDEO_CS_DEFAULT, VIDEO_RANGE_PARTIAL,
+			frame.color_matrix, frame.color_range_min,
+			frame.color_range_max);
+
+	os_set_thread_name("bench-video");
+
+	while (os_event_try(bv->stop_signal) == EAGAIN) {
+		update_band(bv, frame_idx++);
+
+		frame.timestamp = cur_time;
+		obs_source_output_video(bv->source, &frame);
+
+		if (!os_sleepto_ns(cur_time += interval))
+			cur_time = os_gettime_ns();
+	}
+
+	return NULL;
+}
+
+static void *bench_video_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct bench_video *bv = bzalloc(sizeof(struct bench_video));
+	bv->source  = source;
+	bv->width   = (uint32_t)obs_data_get_int(settings, "width");
+	bv->height  = (uint32_t)obs_data_get_int(settings, "height");
+	bv->format  = (enum video_format)obs_data_get_int(settings, "format");
+	bv->fps_num = (uint32_t)obs_data_get_int(settings, "fps_num");
+	bv->fps_den = (uint32_t)obs_data_get_int(settings, "fps_den");
+
+	if (!bv->width || !bv->height || !bv->fps_num || !bv->fps_den ||
+	    bv->format == VIDEO_FORMAT_NONE) {
+		blog(LOG_ERROR, "bench_video: invalid settings");
+		bench_video_destroy(bv);
+		return NULL;
+	}
+
+	video_frame_init(&bv->frame, bv->format, bv->width, bv->height);
+	fill_gradient(bv);
+
+	if (os_event_init(&bv->stop_signal, OS_EVENT_TYPE_MANUAL) != 0) {
+		bench_video_destroy(bv);
+		return NULL;
+	}
+
+	if (pthread_create(&bv->thread, NULL, video_thread, bv) != 0) {
+		bench_video_destroy(bv);
+		return NULL;
+	}
+
+	bv->initialized = true;
+	return bv;
+}
+
+static void bench_video_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "width", 1280);
+	obs_data_set_default_int(settings, "height", 720);
+	obs_data_set_default_int(settings, "format", VIDEO_FORMAT_NV12);
+	obs_data_set_default_int(settings, "fps_num", 30);
+	obs_data_set_default_int(settings, "fps_den", 1);
+}
+
+static struct obs_source_info bench_video_info = {
+	.id           = BENCH_VIDEO_SOURCE,
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_ASYNC_VIDEO,
+	.get_name     = bench_video_getname,
+	.create       = bench_video_create,
+	.destroy      = bench_video_destroy,
+	.get_defaults = bench_video_defaults,
+};
+
+/* ------------------------------------------------------------------------- */
+/* synthetic audio */
+
+#define AUDIO_RATE   48000
+#define AUDIO_FRAMES 480
+
+struct bench_audio {
+	obs_source_t *source;
+	os_event_t   *stop_signal;
+	pthread_t    thread;
+	bool         initialized;
+
+	double       frequency;
+	int          channels;
+};
+
+static const char *bench_audio_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Synthetic Audio (Benchmark)";
+}
+
+static void bench_audio_destroy(void *data)
+{
+	struct bench_audio *ba = data;
+
+	if (ba) {
+		if (ba->initialized) {
+			os_event_signal(ba->stop_signal);
+			pthread_join(ba->thread, NULL);
+		}
+
+		os_event_destroy(ba->stop_signal);
+		bfree(ba);
+	}
+}
+
+static void *audio_thread(void *data)
+{
+	struct bench_audio *ba = data;
+	uint64_t interval = 1000000000ULL * AUDIO_FRAMES / AUDIO_RATE;
+	uint64_t cur_time = os_gettime_ns();
+	double rate = ba->frequency / AUDIO_RATE * M_PI * 2.0;
+	double phase = 0.0;
+	float samples[2][AUDIO_FRAMES];
+
+	struct obs_source_audio audio = {
+		.data            = {(uint8_t*)samples[0], (uint8_t*)samples[1]},
+		.frames          = AUDIO_FRAMES,
+		.speakers        = ba->channels == 1 ?
+			SPEAKERS_MONO : SPEAKERS_STEREO,
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = AUDIO_RATE
+	};
+
+	os_set_thread_name("bench-audio");
+
+	while (os_event_try(ba->stop_signal) == EAGAIN) {
+		for (size_t i = 0; i < AUDIO_FRAMES; i++) {
+			samples[0][i] = (float)(sin(phase) * 0.5);
+			samples[1][i] = samples[0][i];
+
+			phase += rate;
+			if (phase > M_PI * 2.0)
+				phase -= M_PI * 2.0;
+		}
+
+		audio.timestamp = cur_time;
+		obs_source_output_audio(ba->source, &audio);
+
+		if (!os_sleepto_ns(cur_time += interval))
+			cur_time = os_gettime_ns();
+	}
+
+	return NULL;
+}
+
+static void *bench_audio_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct bench_audio *ba = bzalloc(sizeof(struct bench_audio));
+	ba->source    = source;
+	ba->frequency = obs_data_get_double(settings, "frequency");
+	ba->channels  = (int)obs_data_get_int(settings, "channels");
+
+	if (os_event_init(&ba->stop_signal, OS_EVENT_TYPE_MANUAL) != 0) {
+		bench_audio_destroy(ba);
+		return NULL;
+	}
+
+	if (pthread_create(&ba->thread, NULL, audio_thread, ba) != 0) {
+		bench_audio_destroy(ba);
+		return NULL;
+	}
+
+	ba->initialized = true;
+	return ba;
+}
+
+static void bench_audio_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_double(settings, "frequency", 440.0);
+	obs_data_set_default_int(settings, "channels", 2);
+}
+
+static struct obs_source_info bench_audio_info = {
+	.id           = BENCH_AUDIO_SOURCE,
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name     = bench_audio_getname,
+	.create       = bench_audio_create,
+	.destroy      = bench_audio_destroy,
+	.get_defaults = bench_audio_defaults,
+};
+
+/* ------------------------------------------------------------------------- */
+/* null output */
+
+struct bench_output {
+	obs_output_t              *output;
+	pthread_mutex_t           mutex;
+	struct bench_output_stats stats;
+};
+
+static const char *bench_output_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Null Output (Benchmark)";
+}
+
+static void get_stats_proc(void *data, calldata_t *cd)
+{
+	struct bench_output *bo = data;
+	struct bench_output_stats *stats = calldata_ptr(cd, "stats");
+
+	if (!stats)
+		return;
+
+	pthread_mutex_lock(&bo->mutex);
+	*stats = bo->stats;
+	pthread_mutex_unlock(&bo->mutex);
+}
+
+static void *bench_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct bench_output *bo = bzalloc(sizeof(struct bench_output));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
+	bo->output = output;
+
+	if (pthread_mutex_init(&bo->mutex, NULL) != 0) {
+		bfree(bo);
+		return NULL;
+	}
+
+	proc_handler_add(ph, "void get_stats(in ptr stats)", get_stats_proc,
+			bo);
+
+	UNUSED_PARAMETER(settings);
+	return bo;
+}
+
+static void bench_output_destroy(void *data)
+{
+	struct bench_output *bo = data;
+
+	pthread_mutex_destroy(&bo->mutex);
+	bfree(bo);
+}
+
+static bool bench_output_start(void *data)
+{
+	struct bench_output *bo = data;
+
+	if (!obs_output_can_begin_data_capture(bo->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(bo->output, 0))
+		return false;
+
+	pthread_mutex_lock(&bo->mutex);
+	memset(&bo->stats, 0, sizeof(bo->stats));
+	pthread_mutex_unlock(&bo->mutex);
+
+	return obs_output_begin_data_capture(bo->output, 0);
+}
+
+static void bench_output_stop(void *data, uint64_t ts)
+{
+	struct bench_output *bo = data;
+
+	obs_output_end_data_capture(bo->output);
+	UNUSED_PARAMETER(ts);
+}
+
+static void bench_output_packet(void *data, struct encoder_packet *packet)
+{
+	struct bench_output *bo = data;
+
+	pthread_mutex_lock(&bo->mutex);
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		bo->stats.video_packets++;
+		bo->stats.video_bytes += packet->size;
+	} else {
+		bo->stats.audio_packets++;
+		bo->stats.audio_bytes += packet->size;
+	}
+
+	pthread_mutex_unlock(&bo->mutex);
+}
+
+static uint64_t bench_output_total_bytes(void *data)
+{
+	struct bench_output *bo = data;
+	uint64_t bytes;
+
+	pthread_mutex_lock(&bo->mutex);
+	bytes = bo->stats.video_bytes + bo->stats.audio_bytes;
+	pthread_mutex_unlock(&bo->mutex);
+
+	return bytes;
+}
+
+static struct obs_output_info bench_output_info = {
+	.id              = BENCH_NULL_OUTPUT,
+	.flags           = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.get_name        = bench_output_getname,
+	.create          = bench_output_create,
+	.destroy         = bench_output_destroy,
+	.start           = bench_output_start,
+	.stop            = bench_output_stop,
+	.encoded_packet  = bench_output_packet,
+	.get_total_bytes = bench_output_total_bytes,
+};
+
+void bench_null_output_get_stats(obs_output_t *output,
+		struct bench_output_stats *stats)
+{
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	calldata_t cd = {0};
+
+	memset(stats, 0, sizeof(*stats));
+
+	calldata_set_ptr(&cd, "stats", stats);
+	proc_handler_call(ph, "get_stats", &cd);
+	calldata_free(&cd);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void bench_register_types(void)
+{
+	obs_register_source(&bench_video_info);
+	obs_register_source(&bench_audio_info);
+	obs_register_output(&bench_output_info);
+}
@@ -0,0 +1,977 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <util/base.h>
+#include <util/dstr.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <graphics/vec2.h>
+#include "bench.h"
+
+/*
+ *   Headless pipeline benchmark.  Starts libobs with the null graphics module
+ * (by default), puts a number of synthetic video and audio sources in a
+ * scene, encodes the result with real encoders and sends it to a null or
+ * file output.  After a warmup period it measures the pipeline for a fixed
+ * time and writes the results as JSON to stdout or to a file.
+ *
+ * Example:
+ *   obs-bench --video 4 --video-size 1920x1080 --audio 8 --duration 30
+ */
+
+struct bench_config {
+	const char        *graphics;
+	uint32_t          canvas_cx;
+	uint32_t          canvas_cy;
+	uint32_t          fps_num;
+	uint32_t          fps_den;
+
+	int               video_count;
+	uint32_t          video_cx;
+	uint32_t          video_cy;
+	enum video_format video_format;
+	uint32_t          video_fps_num;
+	uint32_t          video_fps_den;
+	int               audio_count;
+
+	const char        *layout;
+	int               crop;
+	DARRAY(const char*) filters;
+
+	const char        *video_encoder;
+	const char        *audio_encoder;
+	int               video_bitrate;
+	int               audio_bitrate;
+	const char        *encoder_settings;
+	const char        *output;
+
+	double            warmup;
+	double            duration;
+	const char        *results;
+	const char        *timeline;
+	bool              verbose;
+	DARRAY(const char*) module_paths;
+};
+
+struct bench_context {
+	obs_scene_t         *scene;
+	DARRAY(obs_source_t*) sources;
+	obs_encoder_t       *video_encoder;
+	obs_encoder_t       *audio_encoder;
+	obs_output_t        *output;
+	bool                null_output;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static int log_level = LOG_WARNING;
+
+static void do_log(int level, const char *msg, va_list args, void *param)
+{
+	/* results go to stdout, so everything else goes to stderr */
+	if (level <= log_level) {
+		vfprintf(stderr, msg, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+	"usage: obs-bench [options]\n"
+	"\n"
+	"  --graphics null|opengl     graphics module (default: null)\n"
+	"  --canvas WxH               canvas and output size (1920x1080)\n"
+	"  --fps N[/D]                canvas frame rate (30)\n"
+	"  --video N                  synthetic video sources (1)\n"
+	"  --video-size WxH           size of each video source (1280x720)\n"
+	"  --video-format FORMAT      I420, NV12, YUY2, RGBA, BGRA, ... (NV12)\n"
+	"  --video-fps N[/D]          frame rate of each video source (30)\n"
+	"  --audio N                  synthetic audio sources (1)\n"
+	"  --layout grid|stack        tile the video sources, or stack them\n"
+	"                             full size on top of each other (grid)\n"
+	"  --crop PX                  crop every video item on all sides (0)\n"
+	"  --filter ID                add a filter to every video source\n"
+	"                             (may be repeated)\n"
+	"  --video-encoder ID         video encoder (obs_x264)\n"
+	"  --audio-encoder ID         audio encoder (ffmpeg_aac)\n"
+	"  --video-bitrate KBPS       video bitrate (2500)\n"
+	"  --audio-bitrate KBPS       audio bitrate (160)\n"
+	"  --encoder-settings JSON    extra video encoder settings\n"
+	"  --output null|none|PATH    discard packets, render only, or write\n"
+	"                             a file (.flv, or anything ffmpeg muxes)\n"
+	"  --warmup SEC               time before measuring starts (2)\n"
+	"  --duration SEC             time to measure (10)\n"
+	"  --results FILE             write results to FILE, not stdout\n"
+	"  --timeline FILE            write a Chrome trace of the whole run,\n"
+	"                             including shutdown, to FILE\n"
+	"  --module-path BIN DATA     add a module search path\n"
+	"  --verbose                  show libobs log output\n");
+}
+
+static bool parse_size(const char *str, uint32_t *cx, uint32_t *cy)
+{
+	return sscanf(str, "%ux%u", cx, cy) == 2 && *cx && *cy;
+}
+
+static bool parse_fps(const char *str, uint32_t *num, uint32_t *den)
+{
+	int count = sscanf(str, "%u/%u", num, den);
+
+	if (count == 1)
+		*den = 1;
+	return count >= 1 && *num && *den;
+}
+
+static bool parse_format(const char *str, enum video_format *format)
+{
+	for (int i = VIDEO_FORMAT_I420; i <= VIDEO_FORMAT_I444; i++) {
+		if (astrcmpi(str, get_video_format_name(i)) == 0) {
+			*format = (enum video_format)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool parse_args(struct bench_config *config, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		bool valid = val != NULL;
+
+#define is_arg(name) (strcmp(arg, name) == 0)
+
+		if (is_arg("--verbose")) {
+			config->verbose = true;
+			continue;
+		} else if (is_arg("--help") || is_arg("-h")) {
+			return false;
+		}
+
+		if (!val) {
+			fprintf(stderr, "Missing value for '%s'\n", arg);
+			return false;
+		}
+
+		if (is_arg("--graphics")) {
+			config->graphics = val;
+		} else if (is_arg("--canvas")) {
+			valid = parse_size(val, &config->canvas_cx,
+					&config->canvas_cy);
+		} else if (is_arg("--fps")) {
+			valid = parse_fps(val, &config->fps_num,
+					&config->fps_den);
+		} else if (is_arg("--video")) {
+			config->video_count = atoi(val);
+			valid = config->video_count >= 0;
+		} else if (is_arg("--video-size")) {
+			valid = parse_size(val, &config->video_cx,
+					&config->video_cy);
+		} else if (is_arg("--video-format")) {
+			valid = parse_format(val, &config->video_format);
+		} else if (is_arg("--video-fps")) {
+			valid = parse_fps(val, &config->video_fps_num,
+					&config->video_fps_den);
+		} else if (is_arg("--audio")) {
+			config->audio_count = atoi(val);
+			valid = config->audio_count >= 0;
+		} else if (is_arg("--layout")) {
+			config->layout = val;
+		} else if (is_arg("--crop")) {
+			config->crop = atoi(val);
+			valid = config->crop >= 0;
+		} else if (is_arg("--filter")) {
+			da_push_back(config->filters, &val);
+		} else if (is_arg("--video-encoder")) {
+			config->video_encoder = val;
+		} else if (is_arg("--audio-encoder")) {
+			config->audio_encoder = val;
+		} else if (is_arg("--video-bitrate")) {
+			config->video_bitrate = atoi(val);
+			valid = config->video_bitrate > 0;
+		} else if (is_arg("--audio-bitrate")) {
+			config->audio_bitrate = atoi(val);
+			valid = config->audio_bitrate > 0;
+		} else if (is_arg("--encoder-settings")) {
+			config->encoder_settings = val;
+		} else if (is_arg("--output")) {
+			config->output = val;
+		} else if (is_arg("--warmup")) {
+			config->warmup = atof(val);
+			valid = config->warmup >= 0.0;
+		} else if (is_arg("--duration")) {
+			config->duration = atof(val);
+			valid = config->duration > 0.0;
+		} else if (is_arg("--results")) {
+			config->results = val;
+		} else if (is_arg("--timeline")) {
+			config->timeline = val;
+		} else if (is_arg("--module-path")) {
+			if (i + 2 >= argc) {
+				fprintf(stderr, "--module-path needs a binary "
+				                "and a data path\n");
+				return false;
+			}
+			da_push_back(config->module_paths, &argv[i + 1]);
+			da_push_back(config->module_paths, &argv[i + 2]);
+			i++;
+		} else {
+			fprintf(stderr, "Unknown option '%s'\n", arg);
+			return false;
+		}
+
+#undef is_arg
+
+		if (!valid) {
+			fprintf(stderr, "Invalid value '%s' for '%s'\n",
+					val, arg);
+			return false;
+		}
+
+		i++;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *get_graphics_module(const char *name)
+{
+	if (astrcmpi(name, "null") == 0)
+		return DL_NULL;
+	if (astrcmpi(name, "opengl") == 0)
+		return DL_OPENGL;
+	if (astrcmpi(name, "d3d11") == 0)
+		return DL_D3D11;
+	return name;
+}
+
+static bool start_obs(const struct bench_config *config,
+		profiler_name_store_t *names)
+{
+	struct obs_video_info ovi = {0};
+	struct obs_audio_info oai = {0};
+	int ret;
+
+	if (!obs_startup("en-US", NULL, names)) {
+		blog(LOG_ERROR, "Couldn't start libobs");
+		return false;
+	}
+
+	ovi.graphics_module = get_graphics_module(config->graphics);
+	ovi.fps_num         = config->fps_num;
+	ovi.fps_den         = config->fps_den;
+	ovi.base_width      = config->canvas_cx;
+	ovi.base_height     = config->canvas_cy;
+	ovi.output_width    = config->canvas_cx;
+	ovi.output_height   = config->canvas_cy;
+	ovi.output_format   = VIDEO_FORMAT_NV12;
+	ovi.gpu_conversion  = true;
+	ovi.colorspace      = VIDEO_CS_709;
+	ovi.range           = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type      = OBS_SCALE_BICUBIC;
+
+	ret = obs_reset_video(&ovi);
+	if (ret != OBS_VIDEO_SUCCESS) {
+		blog(LOG_ERROR, "Couldn't initialize video with graphics "
+		                "module '%s' (%d)", ovi.graphics_module, ret);
+		return false;
+	}
+
+	oai.samples_per_sec = 48000;
+	oai.speakers        = SPEAKERS_STEREO;
+
+	if (!obs_reset_audio(&oai)) {
+		blog(LOG_ERROR, "Couldn't initialize audio");
+		return false;
+	}
+
+	for (size_t i = 0; i + 1 < config->module_paths.num; i += 2)
+		obs_add_module_path(config->module_paths.array[i],
+				config->module_paths.array[i + 1]);
+
+	obs_load_all_modules();
+	bench_register_types();
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void add_video_item(const struct bench_config *config,
+		struct bench_context *bench, obs_source_t *source, int idx)
+{
+	obs_sceneitem_t *item = obs_scene_add(bench->scene, source);
+	struct vec2 pos = {0};
+	struct vec2 bounds;
+
+	vec2_set(&bounds, (float)config->canvas_cx, (float)config->canvas_cy);
+
+	if (strcmp(config->layout, "grid") == 0) {
+		int cols = (int)ceil(sqrt((double)config->video_count));
+		int rows = (config->video_count + cols - 1) / cols;
+
+		bounds.x /= (float)cols;
+		bounds.y /= (float)rows;
+		vec2_set(&pos, bounds.x * (float)(idx % cols),
+				bounds.y * (float)(idx / cols));
+	}
+
+	obs_sceneitem_set_pos(item, &pos);
+	obs_sceneitem_set_bounds_type(item, OBS_BOUNDS_SCALE_INNER);
+	obs_sceneitem_set_bounds(item, &bounds);
+
+	if (config->crop) {
+		struct obs_sceneitem_crop crop = {
+			config->crop, config->crop, config->crop, config->crop
+		};
+		obs_sceneitem_set_crop(item, &crop);
+	}
+}
+
+static bool add_filters(const struct bench_config *config,
+		obs_source_t *source)
+{
+	for (size_t i = 0; i < config->filters.num; i++) {
+		const char *id = config->filters.array[i];
+		obs_source_t *filter;
+
+		filter = obs_source_create_private(id, id, NULL);
+		if (!filter) {
+			blog(LOG_ERROR, "Couldn't create filter '%s'", id);
+			return false;
+		}
+
+		obs_source_filter_add(source, filter);
+		obs_source_release(filter);
+	}
+
+	return true;
+}
+
+static bool create_sources(const struct bench_config *config,
+		struct bench_context *bench)
+{
+	struct dstr name = {0};
+	bool success = true;
+
+	bench->scene = obs_scene_create("bench scene");
+
+	for (int i = 0; success && i < config->video_count; i++) {
+		obs_data_t *settings = obs_data_create();
+		obs_source_t *source;
+
+		obs_data_set_int(settings, "width", config->video_cx);
+		obs_data_set_int(settings, "height", config->video_cy);
+		obs_data_set_int(settings, "format", config->video_format);
+		obs_data_set_int(settings, "fps_num", config->video_fps_num);
+		obs_data_set_int(settings, "fps_den", config->video_fps_den);
+
+		dstr_printf(&name, "video %d", i);
+		source = obs_source_create(BENCH_VIDEO_SOURCE, name.array,
+				settings, NULL);
+		obs_data_release(settings);
+
+		if (!source) {
+			success = false;
+			break;
+		}
+
+		da_push_back(bench->sources, &source);
+		success = add_filters(config, source);
+		add_video_item(config, bench, source, i);
+	}
+
+	for (int i = 0; success && i < config->audio_count; i++) {
+		obs_data_t *settings = obs_data_create();
+		obs_source_t *source;
+
+		/* different tones, so that mixing isn't trivially
+		 * cancelling or clipping */
+		obs_data_set_double(settings, "frequency", 220.0 + 55.0 * i);
+
+		dstr_printf(&name, "audio %d", i);
+		source = obs_source_create(BENCH_AUDIO_SOURCE, name.array,
+				settings, NULL);
+		obs_data_release(settings);
+
+		if (!source) {
+			success = false;
+			break;
+		}
+
+		da_push_back(bench->sources, &source);
+		obs_scene_add(bench->scene, source);
+	}
+
+	dstr_free(&name);
+
+	if (!success) {
+		blog(LOG_ERROR, "Couldn't create the benchmark sources");
+		return false;
+	}
+
+	obs_set_output_source(0, obs_scene_get_source(bench->scene));
+	return true;
+}
+
+static const char *get_output_id(const char *output)
+{
+	const char *ext;
+
+	if (strcmp(output, "null") == 0)
+		return BENCH_NULL_OUTPUT;
+
+	ext = strrchr(output, '.');
+	return ext && astrcmpi(ext, ".flv") == 0 ? "flv_output" :
+		"ffmpeg_muxer";
+}
+
+static bool create_output(const struct bench_config *config,
+		struct bench_context *bench)
+{
+	obs_data_t *settings;
+	const char *id;
+
+	if (strcmp(config->output, "none") == 0)
+		return true;
+
+	settings = obs_data_create();
+	obs_data_set_int(settings, "bitrate", config->video_bitrate);
+	obs_data_set_string(settings, "rate_control", "CBR");
+
+	if (config->encoder_settings) {
+		obs_data_t *extra =
+			obs_data_create_from_json(config->encoder_settings);
+		if (!extra) {
+			blog(LOG_ERROR, "Invalid encoder settings");
+			obs_data_release(settings);
+			return false;
+		}
+
+		obs_data_apply(settings, extra);
+		obs_data_release(extra);
+	}
+
+	bench->video_encoder = obs_video_encoder_create(config->video_encoder,
+			"bench video", settings, NULL);
+	obs_data_release(settings);
+
+	settings = obs_data_create();
+	obs_data_set_int(settings, "bitrate", config->audio_bitrate);
+	bench->audio_encoder = obs_audio_encoder_create(config->audio_encoder,
+			"bench audio", settings, 0, NULL);
+	obs_data_release(settings);
+
+	if (!bench->video_encoder || !bench->audio_encoder) {
+		blog(LOG_ERROR, "Couldn't create encoders '%s' and '%s'",
+				config->video_encoder, config->audio_encoder);
+		return false;
+	}
+
+	obs_encoder_set_video(bench->video_encoder, obs_get_video());
+	obs_encoder_set_audio(bench->audio_encoder, obs_get_audio());
+
+	id = get_output_id(config->output);
+	bench->null_output = strcmp(id, BENCH_NULL_OUTPUT) == 0;
+
+	settings = obs_data_create();
+	obs_data_set_string(settings, "path", config->output);
+	bench->output = obs_output_create(id, "bench output", settings, NULL);
+	obs_data_release(settings);
+
+	if (!bench->output) {
+		blog(LOG_ERROR, "Couldn't create output '%s'", id);
+		return false;
+	}
+
+	obs_output_set_video_encoder(bench->output, bench->video_encoder);
+	obs_output_set_audio_encoder(bench->output, bench->audio_encoder, 0);
+
+	if (!obs_output_start(bench->output)) {
+		blog(LOG_ERROR, "Couldn't start output '%s'", id);
+		return false;
+	}
+
+	return true;
+}
+
+static void stop_output(struct bench_context *bench)
+{
+	uint64_t timeout = os_gettime_ns() + 10000000000ULL;
+
+	if (!bench->output || !obs_output_active(bench->output))
+		return;
+
+	obs_output_stop(bench->output);
+
+	while (obs_output_active(bench->output)) {
+		if (os_gettime_ns() > timeout) {
+			blog(LOG_WARNING, "Output took too long to stop, "
+			                  "forcing it to stop");
+			obs_output_force_stop(bench->output);
+			break;
+		}
+
+		os_sleep_ms(10);
+	}
+}
+
+static void free_bench(struct bench_context *bench)
+{
+	obs_set_output_source(0, NULL);
+
+	obs_output_release(bench->output);
+	obs_encoder_release(bench->video_encoder);
+	obs_encoder_release(bench->audio_encoder);
+
+	for (size_t i = 0; i < bench->sources.num; i++)
+		obs_source_release(bench->sources.array[i]);
+	da_free(bench->sources);
+
+	obs_scene_release(bench->scene);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct bench_sample {
+	uint64_t                  time;
+	obs_stats_snapshot_t      *stats;
+	uint64_t                  output_bytes;
+	int                       output_frames;
+	int                       output_dropped;
+	struct bench_output_stats packets;
+};
+
+static void take_sample(struct bench_context *bench,
+		struct bench_sample *sample)
+{
+	sample->time  = os_gettime_ns();
+	sample->stats = obs_stats_snapshot_create();
+
+	if (bench->output) {
+		sample->output_bytes = obs_output_get_total_bytes(
+				bench->output);
+		sample->output_frames = obs_output_get_total_frames(
+				bench->output);
+		sample->output_dropped = obs_output_get_frames_dropped(
+				bench->output);
+	}
+
+	if (bench->null_output)
+		bench_null_output_get_stats(bench->output, &sample->packets);
+}
+
+static const struct obs_stat_value *find_stat(obs_stats_snapshot_t *snap,
+		const char *name)
+{
+	size_t count = obs_stats_snapshot_count(snap);
+
+	for (size_t i = 0; i < count; i++) {
+		const struct obs_stat_value *val =
+			obs_stats_snapshot_get(snap, i);
+
+		if (!val->labels && strcmp(val->name, name) == 0)
+			return val;
+	}
+
+	return NULL;
+}
+
+static double stat_delta(const struct bench_sample *start,
+		const struct bench_sample *end, const char *name)
+{
+	const struct obs_stat_value *a = find_stat(start->stats, name);
+	const struct obs_stat_value *b = find_stat(end->stats, name);
+
+	return a && b ? b->value - a->value : 0.0;
+}
+
+/* sum of a stat over all of its labels, such as over every source */
+static double stat_sum(obs_stats_snapshot_t *snap, const char *name)
+{
+	size_t count = obs_stats_snapshot_count(snap);
+	double sum = 0.0;
+
+	for (size_t i = 0; i < count; i++) {
+		const struct obs_stat_value *val =
+			obs_stats_snapshot_get(snap, i);
+
+		if (strcmp(val->name, name) == 0)
+			sum += val->value;
+	}
+
+	return sum;
+}
+
+static double stat_value(const struct bench_sample *sample, const char *name)
+{
+	const struct obs_stat_value *val = find_stat(sample->stats, name);
+	return val ? val->value : 0.0;
+}
+
+/* upper bound of the histogram bucket that contains the percentile */
+static double get_percentile(const uint64_t *buckets, uint64_t count,
+		double percentile)
+{
+	uint64_t target = (uint64_t)ceil((double)count * percentile);
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < OBS_STAT_HISTOGRAM_BUCKETS; i++) {
+		total += buckets[i];
+		if (total >= target && total)
+			return obs_stat_histogram_bound(i);
+	}
+
+	return 0.0;
+}
+
+static obs_data_t *render_results(const struct bench_sample *start,
+		const struct bench_sample *end)
+{
+	const char *name = "obs_video_frame_time_ms";
+	const struct obs_stat_value *a = find_stat(start->stats, name);
+	const struct obs_stat_value *b = find_stat(end->stats, name);
+	obs_data_t *render = obs_data_create();
+	obs_data_array_t *buckets = obs_data_array_create();
+	uint64_t counts[OBS_STAT_HISTOGRAM_BUCKETS] = {0};
+	uint64_t count = 0;
+	double sum = 0.0;
+
+	if (a && b) {
+		count = b->count - a->count;
+		sum = b->value - a->value;
+
+		for (size_t i = 0; i < OBS_STAT_HISTOGRAM_BUCKETS; i++)
+			counts[i] = b->buckets[i] - a->buckets[i];
+	}
+
+	for (size_t i = 0; i < OBS_STAT_HISTOGRAM_BUCKETS; i++) {
+		obs_data_t *bucket = obs_data_create();
+		double bound = obs_stat_histogram_bound(i);
+
+		/* JSON has no infinity, the last bucket has no bound */
+		if (isfinite(bound))
+			obs_data_set_double(bucket, "le", bound);
+		obs_data_set_int(bucket, "count", (long long)counts[i]);
+
+		obs_data_array_push_back(buckets, bucket);
+		obs_data_release(bucket);
+	}
+
+	obs_data_set_int(render, "frames", (long long)count);
+	obs_data_set_double(render, "mean_ms", count ? sum / count : 0.0);
+	obs_data_set_double(render, "p50_ms",
+			get_percentile(counts, count, 0.50));
+	obs_data_set_double(render, "p95_ms",
+			get_percentile(counts, count, 0.95));
+	obs_data_set_double(render, "p99_ms",
+			get_percentile(counts, count, 0.99));
+	obs_data_set_array(render, "buckets", buckets);
+
+	obs_data_array_release(buckets);
+	return render;
+}
+
+static obs_data_t *output_results(const struct bench_sample *start,
+		const struct bench_sample *end, double seconds,
+		bool null_output)
+{
+	obs_data_t *output = obs_data_create();
+	uint64_t bytes = end->output_bytes - start->output_bytes;
+	int frames = end->output_frames - start->output_frames;
+
+	obs_data_set_int(output, "frames", frames);
+	obs_data_set_int(output, "frames_dropped",
+			end->output_dropped - start->output_dropped);
+	obs_data_set_int(output, "bytes", (long long)bytes);
+	obs_data_set_double(output, "frames_per_sec", frames / seconds);
+	obs_data_set_double(output, "kbps", (double)bytes * 8.0 / 1000.0 /
+			seconds);
+
+	if (null_output) {
+		const struct bench_output_stats *a = &start->packets;
+		const struct bench_output_stats *b = &end->packets;
+
+		obs_data_set_int(output, "video_packets",
+				(long long)(b->video_packets - a->video_packets));
+		obs_data_set_int(output, "audio_packets",
+				(long long)(b->audio_packets - a->audio_packets));
+		obs_data_set_int(output, "video_bytes",
+				(long long)(b->video_bytes - a->video_bytes));
+		obs_data_set_int(output, "audio_bytes",
+				(long long)(b->audio_bytes - a->audio_bytes));
+	}
+
+	return output;
+}
+
+static obs_data_t *config_results(const struct bench_config *config)
+{
+	obs_data_t *cfg = obs_data_create();
+	obs_data_array_t *filters = obs_data_array_create();
+
+	obs_data_set_string(cfg, "graphics", config->graphics);
+	obs_data_set_int(cfg, "canvas_width", config->canvas_cx);
+	obs_data_set_int(cfg, "canvas_height", config->canvas_cy);
+	obs_data_set_double(cfg, "fps",
+			(double)config->fps_num / config->fps_den);
+	obs_data_set_int(cfg, "video_sources", config->video_count);
+	obs_data_set_int(cfg, "video_width", config->video_cx);
+	obs_data_set_int(cfg, "video_height", config->video_cy);
+	obs_data_set_string(cfg, "video_format",
+			get_video_format_name(config->video_format));
+	obs_data_set_double(cfg, "video_fps",
+			(double)config->video_fps_num / config->video_fps_den);
+	obs_data_set_int(cfg, "audio_sources", config->audio_count);
+	obs_data_set_string(cfg, "layout", config->layout);
+	obs_data_set_int(cfg, "crop", config->crop);
+	obs_data_set_string(cfg, "video_encoder", config->video_encoder);
+	obs_data_set_string(cfg, "audio_encoder", config->audio_encoder);
+	obs_data_set_int(cfg, "video_bitrate", config->video_bitrate);
+	obs_data_set_int(cfg, "audio_bitrate", config->audio_bitrate);
+	obs_data_set_string(cfg, "output", config->output);
+	obs_data_set_double(cfg, "duration", config->duration);
+
+	for (size_t i = 0; i < config->filters.num; i++) {
+		obs_data_t *filter = obs_data_create();
+		obs_data_set_string(filter, "id", config->filters.array[i]);
+		obs_data_array_push_back(filters, filter);
+		obs_data_release(filter);
+	}
+
+	obs_data_set_array(cfg, "filters", filters);
+	obs_data_array_release(filters);
+	return cfg;
+}
+
+/* every unlabelled core stat at the end of the run, for anything that the
+ * summary does not cover */
+static obs_data_t *stats_results(const struct bench_sample *end)
+{
+	obs_data_t *stats = obs_data_create();
+	size_t count = obs_stats_snapshot_count(end->stats);
+
+	for (size_t i = 0; i < count; i++) {
+		const struct obs_stat_value *val =
+			obs_stats_snapshot_get(end->stats, i);
+
+		if (!val->labels)
+			obs_data_set_double(stats, val->name, val->value);
+	}
+
+	return stats;
+}
+
+static obs_data_t *run_bench(const struct bench_config *config,
+		struct bench_context *bench)
+{
+	struct bench_sample start = {0};
+	struct bench_sample end = {0};
+	struct obs_audio_info oai;
+	obs_data_t *results = obs_data_create();
+	obs_data_t *obj;
+	uint64_t stop_time;
+	double max_buffering = 0.0;
+	double seconds;
+	double frames;
+	double copied;
+
+	os_sleep_ms((uint32_t)(config->warmup * 1000.0));
+
+	take_sample(bench, &start);
+	stop_time = start.time + (uint64_t)(config->duration * 1000000000.0);
+
+	/* audio buffering is a gauge, so watch it for the whole run */
+	while (os_gettime_ns() < stop_time) {
+		obs_stats_snapshot_t *snap = obs_stats_snapshot_create();
+		const struct obs_stat_value *val =
+			find_stat(snap, "obs_audio_buffering_ticks");
+
+		if (val && val->value > max_buffering)
+			max_buffering = val->value;
+
+		obs_stats_snapshot_free(snap);
+		os_sleep_ms(100);
+	}
+
+	take_sample(bench, &end);
+	seconds = (double)(end.time - start.time) / 1000000000.0;
+
+	obs_data_set_double(results, "seconds", seconds);
+
+	obj = config_results(config);
+	obs_data_set_obj(results, "config", obj);
+	obs_data_release(obj);
+
+	frames = stat_delta(&start, &end, "obs_video_frames_total");
+
+	obj = obs_data_create();
+	obs_data_set_int(obj, "frames", (long long)frames);
+	obs_data_set_int(obj, "frames_lagged", (long long)stat_delta(&start,
+				&end, "obs_video_frames_lagged_total"));
+	obs_data_set_int(obj, "frames_skipped", (long long)stat_delta(&start,
+				&end, "obs_video_frames_skipped_total"));
+	obs_data_set_double(obj, "fps", frames / seconds);
+	obs_data_set_obj(results, "video", obj);
+	obs_data_release(obj);
+
+	obj = render_results(&start, &end);
+	obs_data_set_obj(results, "render", obj);
+	obs_data_release(obj);
+
+	obs_get_audio_info(&oai);
+
+	obj = obs_data_create();
+	obs_data_set_double(obj, "buffering_ticks", stat_value(&end,
+				"obs_audio_buffering_ticks"));
+	obs_data_set_double(obj, "max_buffering_ticks", max_buffering);
+	obs_data_set_double(obj, "max_buffering_ms", max_buffering *
+			obs_get_audio_frames_per_tick() * 1000.0 /
+			oai.samples_per_sec);
+
+	copied = stat_sum(end.stats, "obs_source_audio_bytes_copied_total") -
+		stat_sum(start.stats, "obs_source_audio_bytes_copied_total");
+	obs_data_set_double(obj, "bytes_copied_per_sec", copied / seconds);
+	obs_data_set_double(obj, "bytes_copied_per_sec_per_source",
+			config->audio_count ?
+			copied / seconds / config->audio_count : 0.0);
+	obs_data_set_obj(results, "audio", obj);
+	obs_data_release(obj);
+
+	if (bench->output) {
+		obj = output_results(&start, &end, seconds, bench->null_output);
+		obs_data_set_obj(results, "output", obj);
+		obs_data_release(obj);
+	}
+
+	obj = stats_results(&end);
+	obs_data_set_obj(results, "stats", obj);
+	obs_data_release(obj);
+
+	obs_stats_snapshot_free(start.stats);
+	obs_stats_snapshot_free(end.stats);
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* the trace is written after obs_shutdown, so it has to include the threads
+ * that have exited by then */
+static bool save_timeline(const char *file)
+{
+	char *json;
+	bool success;
+
+	if (!profiler_timeline_dump_json(file, 0, UINT64_MAX)) {
+		fprintf(stderr, "Couldn't write '%s'\n", file);
+		return false;
+	}
+
+	json = os_quick_read_utf8_file(file);
+	success = json && strstr(json, "\"obs_video_thread(") != NULL;
+	if (!success)
+		fprintf(stderr, "The timeline in '%s' has no events of the "
+		                "graphics thread\n", file);
+
+	bfree(json);
+	return success;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_context bench = {0};
+	profiler_name_store_t *names;
+	obs_data_t *results = NULL;
+	bool timeline_saved = true;
+	bool success = false;
+
+	struct bench_config config = {
+		.graphics      = "null",
+		.canvas_cx     = 1920,
+		.canvas_cy     = 1080,
+		.fps_num       = 30,
+		.fps_den       = 1,
+		.video_count   = 1,
+		.video_cx      = 1280,
+		.video_cy      = 720,
+		.video_format  = VIDEO_FORMAT_NV12,
+		.video_fps_num = 30,
+		.video_fps_den = 1,
+		.audio_count   = 1,
+		.layout        = "grid",
+		.video_encoder = "obs_x264",
+		.audio_encoder = "ffmpeg_aac",
+		.video_bitrate = 2500,
+		.audio_bitrate = 160,
+		.output        = "null",
+		.warmup        = 2.0,
+		.duration      = 10.0,
+	};
+
+	if (!parse_args(&config, argc, argv)) {
+		usage();
+		return 1;
+	}
+
+	if (strcmp(config.layout, "grid") != 0 &&
+	    strcmp(config.layout, "stack") != 0) {
+		fprintf(stderr, "Invalid layout '%s'\n", config.layout);
+		usage();
+		return 1;
+	}
+
+	log_level = config.verbose ? LOG_DEBUG : LOG_WARNING;
+	base_set_log_handler(do_log, NULL);
+
+	/* the thread names of the timeline are in the name store, so it has
+	 * to outlive obs_shutdown */
+	names = profiler_name_store_create();
+	if (config.timeline) {
+		profiler_start();
+		profiler_timeline_enable(true);
+	}
+
+	if (start_obs(&config, names) &&
+	    create_sources(&config, &bench) &&
+	    create_output(&config, &bench)) {
+		results = run_bench(&config, &bench);
+		success = true;
+	}
+
+	stop_output(&bench);
+	free_bench(&bench);
+	obs_shutdown();
+
+	if (config.timeline) {
+		if (results)
+			timeline_saved = save_timeline(config.timeline);
+		profiler_free();
+	}
+	profiler_name_store_free(names);
+
+	if (results) {
+		if (config.results) {
+			success = obs_data_save_json(results, config.results);
+			if (!success)
+				fprintf(stderr, "Couldn't write '%s'\n",
+						config.results);
+		} else {
+			printf("%s\n", obs_data_get_json(results));
+		}
+
+		obs_data_release(results);
+	}
+
+	da_free(config.filters);
+	da_free(config.module_paths);
+
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	return success && timeline_saved ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <obs.h>
+
+/*
+ *   Synthetic sources and a null output for the pipeline benchmark.  These
+ * are registered by the benchmark itself rather than by a module, so that it
+ * only depends on the modules that provide the encoders under test.
+ */
+
+/* settings: "width", "height", "format" (video_format), "fps_num",
+ * "fps_den" */
+#define BENCH_VIDEO_SOURCE "bench_video"
+
+/* settings: "frequency", "channels" */
+#define BENCH_AUDIO_SOURCE "bench_audio"
+
+/* counts the packets it receives and discards them */
+#define BENCH_NULL_OUTPUT "bench_null_output"
+
+struct bench_output_stats {
+	uint64_t video_packets;
+	uint64_t audio_packets;
+	uint64_t video_bytes;
+	uint64_t audio_bytes;
+};
+
+extern void bench_register_types(void);
+
+/** Gets the packet counts of a bench_null_output */
+extern void bench_null_output_get_stats(obs_output_t *output,
+		struct bench_output_stats *stats);